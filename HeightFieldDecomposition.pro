@@ -51,6 +51,9 @@ HEADERS += \
     common.h \
     GUI/managers/enginemanager.h \
     engine/tricubic.h \
+    engine/tricubickernel.h \
+    engine/linesearch.h \
+    engine/boxminimizer.h \
     engine/energy.h \
     engine/box.h \
     engine/boxlist.h \
@@ -60,7 +63,14 @@ HEADERS += \
     engine/splitting.h \
     engine/reconstruction.h \
     engine/unsigned_distances.h \
+    engine/voxelization.h \
+    engine/distancefield.h \
+    engine/progressivemesh.h \
+    engine/atomicbitset.h \
+    engine/setcover.h \
     lib/grid/grid.h \
+    lib/grid/blockedarray3d.h \
+    lib/grid/mappedfile.h \
     lib/packing/binpack2d.h \
     lib/graph/undirectednode.h \
     lib/graph/directedgraph.h \
@@ -68,10 +78,17 @@ HEADERS += \
 
 SOURCES += \
     engine/unsigned_distances.cpp \
+    engine/voxelization.cpp \
+    engine/distancefield.cpp \
+    engine/progressivemesh.cpp \
+    engine/setcover.cpp \
     main.cpp \
     common.cpp \
     GUI/managers/enginemanager.cpp \
     engine/tricubic.cpp \
+    engine/tricubickernel.cpp \
+    engine/linesearch.cpp \
+    engine/boxminimizer.cpp \
     engine/energy.cpp \
     engine/box.cpp \
     engine/boxlist.cpp \
@@ -81,6 +98,7 @@ SOURCES += \
     engine/splitting.cpp \
     engine/reconstruction.cpp \
     lib/grid/grid.cpp \
+    lib/grid/mappedfile.cpp \
     lib/grid/drawablegrid.cpp \
     engine/tinyfeaturedetection.cpp \
     engine/tinyfeaturedetection2.cpp
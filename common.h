@@ -47,6 +47,7 @@ extern int ENGINE_MANAGER_ID;
 extern cg3::viewer::MainWindow* mw;
 
 const int MAX_BFGS_ITERATIONS = 150;
+const int MAX_BFGS_LIMITS_ITERATIONS = 100;
 
 static const std::vector<cg3::Vec3d> XYZ = {
 	cg3::Vec3d( 1.0f,  0.0f,  0.0f),                         //    +X : label  0
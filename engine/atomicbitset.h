@@ -0,0 +1,67 @@
+#ifndef ATOMICBITSET_H
+#define ATOMICBITSET_H
+
+#include <vector>
+
+/**
+ * @brief The AtomicBitset class
+ *
+ * Dense set of indices in [0, size), stored as bits: set and test can be called
+ * concurrently by OpenMP threads (bits are never reset).
+ */
+class AtomicBitset {
+    public:
+        AtomicBitset(unsigned int size = 0);
+
+        unsigned int size() const;
+        unsigned int count() const;
+        bool test(unsigned int i) const;
+        bool set(unsigned int i);
+
+    private:
+        unsigned int n;
+        unsigned int nSet;
+        std::vector<unsigned long long int> words;
+};
+
+inline AtomicBitset::AtomicBitset(unsigned int size) : n(size), nSet(0), words((size + 63) / 64, 0) {
+}
+
+inline unsigned int AtomicBitset::size() const {
+    return n;
+}
+
+/**
+ * @brief AtomicBitset::count
+ * @return the number of indices in the set
+ */
+inline unsigned int AtomicBitset::count() const {
+    unsigned int c;
+    #pragma omp atomic read
+    c = nSet;
+    return c;
+}
+
+inline bool AtomicBitset::test(unsigned int i) const {
+    unsigned long long int word;
+    #pragma omp atomic read
+    word = words[i / 64];
+    return (word >> (i % 64)) & 1;
+}
+
+/**
+ * @brief AtomicBitset::set
+ * @return true if i was not in the set
+ */
+inline bool AtomicBitset::set(unsigned int i) {
+    unsigned long long int mask = 1ULL << (i % 64), word;
+    #pragma omp atomic capture
+    {word = words[i / 64]; words[i / 64] |= mask;}
+    if (word & mask)
+        return false;
+    #pragma omp atomic update
+    nSet++;
+    return true;
+}
+
+#endif // ATOMICBITSET_H
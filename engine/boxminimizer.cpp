@@ -0,0 +1,196 @@
+#include "boxminimizer.h"
+
+#include <cmath>
+#include <limits>
+#include <Eigen/Dense>
+
+BoxMinimizer::BoxMinimizer() : state(nullptr), maxIterations(0), nIterations(0), tolerance(0), started(false), steepest(true), value(0), bestValue(0) {
+}
+
+/**
+ * @brief BoxMinimizer::start
+ * @param state: box to minimize; its counters are incremented (not reset), so that
+ * they sum the minimizations of the same box on more levels of the grid
+ * @param bb: bounding box of the grid, the box is kept inside it
+ * (and, in bounded mode, the start point is projected on the bounds)
+ * @param maxIterations: maximum number of BFGS iterations of this minimization
+ * @param tolerance: the minimization stops when the relative decrease of the energy is below tolerance
+ * (it must be greater than the relative error of the energy evaluations)
+ */
+void BoxMinimizer::start(BoxState& state, const cg3::BoundingBox3& bb, int maxIterations, double tolerance) {
+    this->state = &state;
+    this->maxIterations = maxIterations;
+    this->tolerance = tolerance;
+    lower << bb.minX(), bb.minY(), bb.minZ(), bb.minX(), bb.minY(), bb.minZ();
+    upper << bb.maxX(), bb.maxY(), bb.maxZ(), bb.maxX(), bb.maxY(), bb.maxZ();
+    if (state.constraintsAsBounds){
+        for (unsigned int i = 0; i < 3; i++){
+            double cMin = std::min(std::min(state.c1[i], state.c2[i]), state.c3[i]);
+            double cMax = std::max(std::max(state.c1[i], state.c2[i]), state.c3[i]);
+            upper(i) = cMin;
+            lower(i) = std::min(lower(i), cMin);
+            lower(i+3) = cMax;
+            upper(i+3) = std::max(upper(i+3), cMax);
+        }
+        state.x = state.x.cwiseMax(lower).cwiseMin(upper);
+    }
+    nIterations = 0;
+    x = state.x;
+    point = x;
+    Binv = Matrix6d::Identity();
+    started = false;
+    steepest = true;
+}
+
+/**
+ * @brief BoxMinimizer::update
+ * @param value: energy on getPoint()
+ * @param gradient: gradient on getPoint()
+ * @return true if energy and gradient must be evaluated on the new getPoint(),
+ * false if the minimization is terminated (the result is in the state).
+ */
+bool BoxMinimizer::update(double value, const Vector6d& gradient) {
+    state->nEnergyEvaluations++;
+    state->nGradientEvaluations++;
+    if (!started){
+        started = true;
+        this->value = value;
+        this->gradient = gradient;
+        return newIteration();
+    }
+    if (value < bestValue){
+        bestValue = value;
+        bestPoint = point;
+        bestGradient = gradient;
+    }
+    switch (lineSearch.update(value, gradient.dot(direction))){
+        case LineSearch::EVALUATE:
+            point = x + lineSearch.getStep() * direction;
+            return true;
+        case LineSearch::CONVERGED:
+            return accept(point, value, gradient);
+        default: // FAILED
+            if (bestValue < this->value)
+                return accept(bestPoint, bestValue, bestGradient);
+            if (steepest)
+                return false;
+            Binv = Matrix6d::Identity();
+            steepest = true;
+            return newIteration();
+    }
+}
+
+/**
+ * @brief BoxMinimizer::newIteration
+ *
+ * Checks the termination criteria and starts the line search along the
+ * quasi-Newton direction (steepest descent if it is not a descent direction).
+ */
+bool BoxMinimizer::newIteration() {
+    if (nIterations >= maxIterations)
+        return false;
+    computeDirection();
+    if (direction.isZero(0) || gradient.norm() <= 1e-7)
+        return false;
+    double slope = gradient.dot(direction);
+    if (!(slope < 0)){
+        if (steepest)
+            return false;
+        Binv = Matrix6d::Identity();
+        steepest = true;
+        return newIteration();
+    }
+    double maxStep = getMaxStep();
+    if (maxStep <= 0)
+        return false;
+    bestValue = value;
+    lineSearch.start(value, slope, std::min(1.0, maxStep), maxStep);
+    point = x + lineSearch.getStep() * direction;
+    return true;
+}
+
+/**
+ * @brief BoxMinimizer::accept
+ *
+ * Moves on newX and updates the inverse hessian approximation (the update is
+ * skipped when the curvature condition y*s > 0 does not hold).
+ * On the first update, the identity is scaled as in Nocedal and Wright (6.20).
+ */
+bool BoxMinimizer::accept(const Vector6d& newX, double newValue, const Vector6d& newGradient) {
+    Vector6d s = newX - x;
+    Vector6d y = newGradient - gradient;
+    double ys = y.dot(s);
+    if (ys > std::numeric_limits<double>::epsilon() * s.norm() * y.norm()){
+        if (steepest)
+            Binv *= ys / y.dot(y);
+        double ro = 1.0 / ys;
+        Vector6d By = Binv*y;
+        Binv += ((ys + y.dot(By))*ro*ro) * s*s.transpose() - ro * (By*s.transpose() + s*By.transpose());
+        steepest = false;
+    }
+    double decrease = value - newValue;
+    x = newX;
+    value = newValue;
+    gradient = newGradient;
+    state->x = x;
+    state->nIterations++;
+    nIterations++;
+    if (decrease <= tolerance * (1 + std::abs(value)))
+        return false;
+    return newIteration();
+}
+
+/**
+ * @brief BoxMinimizer::computeDirection
+ *
+ * Variables on a bound whose gradient points outside are fixed: the direction
+ * minimizes the quadratic model on the free variables only (the fixed rows
+ * and columns of the hessian approximation are replaced by the identity).
+ * The components that would still move the box out of the bounds from one
+ * of its faces are removed.
+ */
+void BoxMinimizer::computeDirection() {
+    bool fixed[6];
+    unsigned int nFixed = 0;
+    for (unsigned int i = 0; i < 6; i++){
+        fixed[i] = (x(i) <= lower(i) && gradient(i) > 0) || (x(i) >= upper(i) && gradient(i) < 0);
+        if (fixed[i])
+            nFixed++;
+    }
+    if (nFixed == 0)
+        direction = -Binv*gradient;
+    else if (nFixed == 6)
+        direction.setZero();
+    else {
+        Matrix6d H = Binv.inverse();
+        Vector6d freeGradient = gradient;
+        for (unsigned int i = 0; i < 6; i++){
+            if (fixed[i]){
+                H.row(i).setZero();
+                H.col(i).setZero();
+                H(i,i) = 1;
+                freeGradient(i) = 0;
+            }
+        }
+        direction = -H.llt().solve(freeGradient);
+    }
+    for (unsigned int i = 0; i < 6; i++){
+        if ((direction(i) < 0 && x(i) <= lower(i)) || (direction(i) > 0 && x(i) >= upper(i)))
+            direction(i) = 0;
+    }
+}
+
+/**
+ * @brief BoxMinimizer::getMaxStep
+ * @return the greatest step along the direction that keeps the variables inside their bounds
+ */
+double BoxMinimizer::getMaxStep() const {
+    double maxStep = std::numeric_limits<double>::max();
+    for (unsigned int i = 0; i < 6; i++){
+        if (direction(i) < 0)
+            maxStep = std::min(maxStep, (lower(i) - x(i)) / direction(i));
+        else if (direction(i) > 0)
+            maxStep = std::min(maxStep, (upper(i) - x(i)) / direction(i));
+    }
+    return maxStep;
+}
@@ -0,0 +1,109 @@
+#ifndef BOXMINIMIZER_H
+#define BOXMINIMIZER_H
+
+#include <cg3/geometry/bounding_box3.h>
+#include "box.h"
+#include "linesearch.h"
+
+typedef Eigen::Matrix<double, 6, 1> Vector6d;
+typedef Eigen::Matrix<double, 6, 6> Matrix6d;
+typedef Eigen::Matrix<double, 6, Eigen::Dynamic, Eigen::RowMajor> BoxLanes; //one box per column, structure-of-arrays
+
+/**
+ * @brief The BoxState struct
+ *
+ * Optimization variables of a box (min and max as a 6-vector), its constraint
+ * points and, optionally, the limits on its lengths.
+ * It does not allocate memory, unlike Box3D.
+ * If constraintsAsBounds is true, the constraint points are not enforced by the
+ * barrier of the energy, but as bounds on the variables (see BoxMinimizer).
+ * It also counts the iterations and the evaluations spent on the box.
+ */
+struct BoxState {
+        BoxState();
+        BoxState(const Box3D& b);
+        BoxState(const Box3D& b, const cg3::Point3d& limits);
+        void setTo(Box3D& b) const;
+
+        Vector6d x;
+        cg3::Point3d c1, c2, c3;
+        cg3::Point3d limits;
+        bool hasLimits;
+        bool constraintsAsBounds;
+
+        int nIterations;
+        int nEnergyEvaluations;
+        int nGradientEvaluations;
+};
+
+/**
+ * @brief The BoxMinimizer class
+ *
+ * BFGS minimization of the energy of a box, with a strong Wolfe line search
+ * (LineSearch) whose steps are bounded in order to keep the box inside the
+ * bounding box of the grid.
+ * It is written in reverse communication, so that it can be used both on a
+ * single box (Energy::BFGS) and on many boxes in lockstep (Energy::lockstepBFGS):
+ * the caller evaluates energy and gradient on getPoint() and passes them to
+ * update(), until update() returns false. The state is updated on every
+ * accepted iteration.
+ * Every variable is bounded by the bounding box of the grid and, if
+ * constraintsAsBounds is set on the state, by the constraint points (the
+ * min corner must stay below them, the max corner above them).
+ * Variables on a bound whose gradient points outside are fixed, and the
+ * direction is computed on the free ones (projected quasi-Newton, as in L-BFGS-B).
+ */
+class BoxMinimizer {
+    public:
+        BoxMinimizer();
+
+        void start(BoxState& state, const cg3::BoundingBox3& bb, int maxIterations, double tolerance = 1e-12);
+        const Vector6d& getPoint() const;
+        bool update(double value, const Vector6d& gradient);
+        BoxState* getState() const;
+
+    private:
+        bool newIteration();
+        bool accept(const Vector6d& newX, double newValue, const Vector6d& newGradient);
+        void computeDirection();
+        double getMaxStep() const;
+
+        BoxState* state;
+        Vector6d lower, upper;
+        int maxIterations, nIterations;
+        double tolerance;
+        bool started, steepest;
+        double value;
+        Vector6d x, gradient, direction, point;
+        Matrix6d Binv;
+        LineSearch lineSearch;
+        double bestValue;
+        Vector6d bestPoint, bestGradient;
+};
+
+inline BoxState::BoxState() : hasLimits(false), constraintsAsBounds(false), nIterations(0), nEnergyEvaluations(0), nGradientEvaluations(0) {
+}
+
+inline BoxState::BoxState(const Box3D& b) : c1(b.getConstraint1()), c2(b.getConstraint2()), c3(b.getConstraint3()), hasLimits(false), constraintsAsBounds(false), nIterations(0), nEnergyEvaluations(0), nGradientEvaluations(0) {
+    x << b.min().x(), b.min().y(), b.min().z(), b.max().x(), b.max().y(), b.max().z();
+}
+
+inline BoxState::BoxState(const Box3D& b, const cg3::Point3d& limits) : BoxState(b) {
+    this->limits = limits;
+    hasLimits = true;
+}
+
+inline void BoxState::setTo(Box3D& b) const {
+    b.setMin(cg3::Point3d(x(0), x(1), x(2)));
+    b.setMax(cg3::Point3d(x(3), x(4), x(5)));
+}
+
+inline const Vector6d& BoxMinimizer::getPoint() const {
+    return point;
+}
+
+inline BoxState* BoxMinimizer::getState() const {
+    return state;
+}
+
+#endif // BOXMINIMIZER_H
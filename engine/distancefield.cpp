@@ -0,0 +1,121 @@
+#include "distancefield.h"
+
+#include <cmath>
+#include <limits>
+#include <queue>
+
+/**
+ * @brief getNarrowBand
+ *
+ * Breadth-first visit (6-connectivity) of the inside points of the grid,
+ * starting from the ones adjacent to an outside point.
+ * @return the inside points at most width steps far from an outside point
+ */
+std::vector<cg3::Point3i> getNarrowBand(
+        const cg3::Array3D<unsigned char>& isInside,
+        unsigned int width)
+{
+    const int sizeX = isInside.sizeX(), sizeY = isInside.sizeY(), sizeZ = isInside.sizeZ();
+    const int dirs[6][3] = {{1,0,0}, {-1,0,0}, {0,1,0}, {0,-1,0}, {0,0,1}, {0,0,-1}};
+    cg3::Array3D<unsigned int> steps(sizeX, sizeY, sizeZ, std::numeric_limits<unsigned int>::max());
+    std::vector<cg3::Point3i> band;
+    std::queue<cg3::Point3i> queue;
+
+    for (int i = 0; i < sizeX; i++){
+        for (int j = 0; j < sizeY; j++){
+            for (int k = 0; k < sizeZ; k++){
+                if (!isInside(i,j,k))
+                    continue;
+                for (unsigned int d = 0; d < 6; d++){
+                    int ni = i+dirs[d][0], nj = j+dirs[d][1], nk = k+dirs[d][2];
+                    if (ni < 0 || nj < 0 || nk < 0 || ni >= sizeX || nj >= sizeY || nk >= sizeZ || !isInside(ni,nj,nk)){
+                        steps(i,j,k) = 1;
+                        queue.push(cg3::Point3i(i,j,k));
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    while (!queue.empty()){
+        cg3::Point3i p = queue.front();
+        queue.pop();
+        band.push_back(p);
+        unsigned int s = steps(p.x(), p.y(), p.z());
+        if (s >= width)
+            continue;
+        for (unsigned int d = 0; d < 6; d++){
+            int ni = p.x()+dirs[d][0], nj = p.y()+dirs[d][1], nk = p.z()+dirs[d][2];
+            if (ni >= 0 && nj >= 0 && nk >= 0 && ni < sizeX && nj < sizeY && nk < sizeZ &&
+                    isInside(ni,nj,nk) && steps(ni,nj,nk) > s+1){
+                steps(ni,nj,nk) = s+1;
+                queue.push(cg3::Point3i(ni,nj,nk));
+            }
+        }
+    }
+    return band;
+}
+
+/**
+ * @brief fastSweeping
+ *
+ * Fills the unknown distances (infinite values) of the inside points by Gauss-Seidel
+ * sweeps in the 8 diagonal orders of the grid, until no distance changes
+ * (fast sweeping method, Zhao 2005). Instead of the first order upwind solution
+ * of the eikonal equation, every point takes the source (a point with known
+ * distance) of one of its neighbours which minimizes |p - source| + distance(source):
+ * the error does not accumulate along the sweeps, and it is zero when the
+ * closest surface point of p is also the closest one of its source.
+ * The finite distances are kept fixed. Every unknown point must have only
+ * inside points as neighbours (see getNarrowBand).
+ * @param distances: euclidean distances from the surface
+ */
+void fastSweeping(
+        cg3::Array3D<double>& distances,
+        const cg3::Array3D<unsigned char>& isInside,
+        double unit)
+{
+    const int sizeX = distances.sizeX(), sizeY = distances.sizeY(), sizeZ = distances.sizeZ();
+    const int dirs[6][3] = {{1,0,0}, {-1,0,0}, {0,1,0}, {0,-1,0}, {0,0,1}, {0,0,-1}};
+    cg3::Array3D<unsigned char> fixed(sizeX, sizeY, sizeZ, true);
+    cg3::Array3D<cg3::Point3i> sources(sizeX, sizeY, sizeZ, cg3::Point3i(-1,-1,-1));
+    for (int i = 0; i < sizeX; i++){
+        for (int j = 0; j < sizeY; j++){
+            for (int k = 0; k < sizeZ; k++){
+                if (isInside(i,j,k) && std::isfinite(distances(i,j,k)))
+                    sources(i,j,k) = cg3::Point3i(i,j,k);
+                else if (isInside(i,j,k) && i > 0 && j > 0 && k > 0 && i < sizeX-1 && j < sizeY-1 && k < sizeZ-1)
+                    fixed(i,j,k) = false;
+            }
+        }
+    }
+
+    bool changed = true;
+    while (changed){
+        changed = false;
+        for (unsigned int sweep = 0; sweep < 8; sweep++){
+            int di = sweep & 1 ? -1 : 1, dj = sweep & 2 ? -1 : 1, dk = sweep & 4 ? -1 : 1;
+            for (int i = di > 0 ? 1 : sizeX-2; i > 0 && i < sizeX-1; i += di){
+                for (int j = dj > 0 ? 1 : sizeY-2; j > 0 && j < sizeY-1; j += dj){
+                    for (int k = dk > 0 ? 1 : sizeZ-2; k > 0 && k < sizeZ-1; k += dk){
+                        if (fixed(i,j,k))
+                            continue;
+                        for (unsigned int d = 0; d < 6; d++){
+                            cg3::Point3i s = sources(i+dirs[d][0], j+dirs[d][1], k+dirs[d][2]);
+                            if (s.x() < 0 || s == sources(i,j,k))
+                                continue;
+                            double u = unit * std::sqrt((double)((s.x()-i)*(s.x()-i) + (s.y()-j)*(s.y()-j) + (s.z()-k)*(s.z()-k)))
+                                    + distances(s.x(), s.y(), s.z());
+                            if (u < distances(i,j,k)){
+                                distances(i,j,k) = u;
+                                sources(i,j,k) = s;
+                                changed = true;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
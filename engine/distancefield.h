@@ -0,0 +1,18 @@
+#ifndef DISTANCEFIELD_H
+#define DISTANCEFIELD_H
+
+#include <cg3/data_structures/arrays/arrays.h>
+#include <cg3/geometry/point3.h>
+
+#define NARROW_BAND_WIDTH 3 //number of grid units, from the surface, where the distances are exact
+
+std::vector<cg3::Point3i> getNarrowBand(
+        const cg3::Array3D<unsigned char>& isInside,
+        unsigned int width = NARROW_BAND_WIDTH);
+
+void fastSweeping(
+        cg3::Array3D<double>& distances,
+        const cg3::Array3D<unsigned char>& isInside,
+        double unit);
+
+#endif // DISTANCEFIELD_H
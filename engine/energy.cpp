@@ -5,10 +5,10 @@
 
 using namespace cg3;
 
-Energy::Energy() {
+Energy::Energy() : g(nullptr), precision(TricubicKernel::DOUBLE_PRECISION) {
 }
 
-Energy::Energy(const Grid& g) : g(&g){
+Energy::Energy(const Grid& g, TricubicKernel::Precision precision) : g(&g), precision(precision) {
 }
 
 void Energy::calculateFullBoxValues(Grid &g) const {
@@ -93,146 +93,188 @@ int Energy::gradientDiscend(Box3D& b, BoxList& iterations, bool saveIt) const {
 }
 
 int Energy::BFGS(Box3D& b, BoxList& iterations, bool saveIt) const {
-    int nIterations = 0;
-    double alfa = 1;
-    double ro;
-	Point3d c1 = b.getConstraint1();
-	Point3d c2 = b.getConstraint2();
-	Point3d c3 = b.getConstraint3();
-    Eigen::VectorXd x(6);
-	x << b.min().x(), b.min().y(), b.min().z(), b.max().x(), b.max().y(), b.max().z();
-    Eigen::VectorXd new_x(6), gradient(6), newGradient(6), direction(6);
-    Eigen::MatrixXd I = Eigen::MatrixXd::Identity(6,6);
-    Eigen::MatrixXd Binv = I;
-    Eigen::VectorXd s(6), y(6);
-    double objValue = energy(x, c1, c2, c3), newObjValue;
-
-    gradientEnergy(gradient, x, c1, c2, c3);
-
-    direction = -Binv*gradient;
-
-    do{
-        new_x = x +alfa * direction;
-		while ((! g->getBoundingBox().isIntern(new_x(0), new_x(1), new_x(2)) || ! g->getBoundingBox().isIntern(new_x(3), new_x(4), new_x(5))) && alfa != 0){
-            alfa /= 2;
-            new_x = x +alfa * direction;
-        }
-
-        newObjValue = energy(new_x, c1, c2, c3);
-
-        while (newObjValue >= objValue && alfa > 1e-10){
-            alfa/= 2;
-            new_x = x +alfa * direction;
+    BoxState state(b);
+    return BFGS(state, MAX_BFGS_ITERATIONS, b, iterations, saveIt);
+}
 
-            newObjValue = energy(new_x, c1, c2, c3);
+int Energy::BFGS(Box3D& b, const Point3d& limits, BoxList& iterations, bool saveIt) const {
+    BoxState state(b, limits);
+    return BFGS(state, MAX_BFGS_LIMITS_ITERATIONS, b, iterations, saveIt);
+}
+
+/**
+ * @brief Energy::BFGS
+ *
+ * Minimizes the energy of the box described by state with a BoxMinimizer
+ * (BFGS with strong Wolfe line search), coarse to fine: the box is first
+ * minimized on the coarsest level of the pyramid of the grid (see Grid::calculatePyramid),
+ * then on every finer level, starting from the previous result (boxes with small
+ * limits skip the levels where they would span few cells, see isCoarseLevelUsed).
+ * The loop does not allocate memory (unless saveIt is true, where every
+ * iteration is saved as a copy of b in iterations).
+ * At the end, the result is stored both in state and in b; the numbers of
+ * iterations and evaluations (of all the levels) are stored in state.
+ */
+int Energy::BFGS(BoxState& state, int maxIterations, Box3D& b, BoxList& iterations, bool saveIt) const {
+    const BoundingBox3 bb = g->getBoundingBox();
+    for (unsigned int l = g->getNumberCoarseLevels(); l > 0; l--){
+        if (isCoarseLevelUsed(state, g->getCoarseLevel(l))){
+            Energy coarse(g->getCoarseLevel(l), precision);
+            coarse.minimize(state, maxIterations, bb, std::max(getTolerance(), COARSE_LEVELS_TOLERANCE), b, iterations, saveIt);
         }
+    }
+    minimize(state, maxIterations, bb, getTolerance(), b, iterations, saveIt);
+    state.setTo(b);
+    if (saveIt) iterations.addBox(b);
 
-        if (alfa > 1e-10){
-            gradientEnergy(newGradient, new_x, c1, c2, c3);
-
-            new_x = x +alfa * direction;
+    return state.nIterations;
+}
+
+/**
+ * @brief The BoxVectorQueue class
+ *
+ * The boxes of a vector, in order.
+ */
+class BoxVectorQueue : public BoxQueue {
+    public:
+        BoxVectorQueue(std::vector<BoxState>& states);
+        BoxState* next();
+        void finished(BoxState* state);
+
+    private:
+        std::vector<BoxState>& states;
+        unsigned int first;
+};
+
+BoxVectorQueue::BoxVectorQueue(std::vector<BoxState>& states) : states(states), first(0) {
+}
+
+BoxState* BoxVectorQueue::next() {
+    return first < states.size() ? &states[first++] : nullptr;
+}
+
+void BoxVectorQueue::finished(BoxState*) {
+}
+
+/**
+ * @brief Energy::lockstepBFGS
+ *
+ * Runs the same minimization of Energy::BFGS on all the states (see the queue version).
+ * @param states: boxes to minimize, updated with the results and the numbers
+ * of iterations and evaluations
+ */
+void Energy::lockstepBFGS(std::vector<BoxState>& states, unsigned int lanes) const {
+    BoxVectorQueue queue(states);
+    lockstepBFGS(queue, lanes);
+}
+
+/**
+ * @brief Energy::lockstepBFGS
+ *
+ * Runs the same minimization of Energy::BFGS on the boxes of the queue, advancing up to lanes
+ * boxes in lockstep: at every step, the energies and gradients of the lanes on the same level
+ * of the pyramid are evaluated as a single batch. When a box converges on a coarse level it moves
+ * on the next level in its lane; when it converges on the grid of this energy, it is given back
+ * to the queue and the lane takes the next box of the queue. Every box follows exactly the
+ * iterations it would follow with Energy::BFGS.
+ */
+void Energy::lockstepBFGS(BoxQueue& queue, unsigned int lanes) const {
+    const BoundingBox3 bb = g->getBoundingBox();
+    unsigned int nCoarseLevels = g->getNumberCoarseLevels();
+    std::vector<Energy> levels(nCoarseLevels+1);
+    levels[0] = *this;
+    for (unsigned int v = 1; v <= nCoarseLevels; v++)
+        levels[v] = Energy(g->getCoarseLevel(v), precision);
+    BoxLanes points(6, lanes), gradients(6, lanes);
+    std::vector<double> values(lanes);
+    std::vector<BoxMinimizer> minimizers(lanes);
+    std::vector<unsigned int> laneLevels(lanes, 0);
+    //the states of the lanes on every level, nullptr for the lanes on other levels
+    std::vector<std::vector<const BoxState*> > levelStates(nCoarseLevels+1, std::vector<const BoxState*>(lanes, nullptr));
+    std::vector<unsigned int> nLevelLanes(nCoarseLevels+1, 0);
+    unsigned int active = 0;
+
+    for (unsigned int l = 0; l < lanes; l++){
+        BoxState* state = queue.next();
+        if (state == nullptr)
+            break;
+        laneLevels[l] = getFirstLevel(*state, nCoarseLevels);
+        minimizers[l].start(*state, bb, state->hasLimits ? MAX_BFGS_LIMITS_ITERATIONS : MAX_BFGS_ITERATIONS,
+                            laneLevels[l] > 0 ? std::max(getTolerance(), COARSE_LEVELS_TOLERANCE) : getTolerance());
+        levelStates[laneLevels[l]][l] = state;
+        nLevelLanes[laneLevels[l]]++;
+        points.col(l) = minimizers[l].getPoint();
+        active++;
+    }
 
-            s = new_x - x;
-            y = newGradient - gradient;
-            double tmp = (y.transpose()*s);
-            ro = 1.0 / tmp;
-            Binv = (I - ro*s*y.transpose())*Binv*(I - ro*y*s.transpose()) + ro*s*s.transpose();
-            if (saveIt){
-				b.setMin(Point3d(x(0), x(1), x(2)));
-				b.setMax(Point3d(x(3), x(4), x(5)));
-                iterations.addBox(b);
-            }
-            x = new_x;
-            objValue = newObjValue;
-            nIterations++;
-            gradient = newGradient;
-            direction = -Binv*gradient;
-            double dot = gradient.dot(direction);
-            if (dot >= 0) {
-                Binv = I;
-                direction = -gradient;
+    while (active > 0){
+        for (unsigned int v = 0; v <= nCoarseLevels; v++)
+            if (nLevelLanes[v] > 0)
+                levels[v].energyAndGradient(values.data(), gradients, points, levelStates[v]);
+
+        for (unsigned int l = 0; l < lanes; l++){
+            BoxState* state = minimizers[l].getState();
+            if (levelStates[laneLevels[l]][l] == nullptr)
+                continue;
+            if (!minimizers[l].update(values[l], gradients.col(l))){ // converged: next level, or refill the lane
+                levelStates[laneLevels[l]][l] = nullptr;
+                nLevelLanes[laneLevels[l]]--;
+                if (laneLevels[l] > 0)
+                    laneLevels[l] = getFirstLevel(*state, laneLevels[l]-1);
+                else {
+                    queue.finished(state);
+                    state = queue.next();
+                    if (state == nullptr){
+                        active--;
+                        continue;
+                    }
+                    laneLevels[l] = getFirstLevel(*state, nCoarseLevels);
+                }
+                minimizers[l].start(*state, bb, state->hasLimits ? MAX_BFGS_LIMITS_ITERATIONS : MAX_BFGS_ITERATIONS,
+                                    laneLevels[l] > 0 ? std::max(getTolerance(), COARSE_LEVELS_TOLERANCE) : getTolerance());
+                levelStates[laneLevels[l]][l] = state;
+                nLevelLanes[laneLevels[l]]++;
             }
-            alfa *= 2;
+            points.col(l) = minimizers[l].getPoint();
         }
-    }while (alfa > 1e-6 && gradient.norm() > 1e-7 && nIterations < MAX_BFGS_ITERATIONS);
-	b.setMin(Point3d(x(0), x(1), x(2)));
-	b.setMax(Point3d(x(3), x(4), x(5)));
-    if (saveIt) iterations.addBox(b);
-
-    return nIterations;
+    }
 }
 
-int Energy::BFGS(Box3D& b, const Point3d& limits, BoxList& iterations, bool saveIt) const {
-    int nIterations = 0;
-    double alfa = 1;
-    double ro;
-	Point3d c1 = b.getConstraint1();
-	Point3d c2 = b.getConstraint2();
-	Point3d c3 = b.getConstraint3();
-    Eigen::VectorXd x(6);
-	x << b.min().x(), b.min().y(), b.min().z(), b.max().x(), b.max().y(), b.max().z();
-    Eigen::VectorXd new_x(6), gradient(6), newGradient(6), direction(6);
-    Eigen::MatrixXd I = Eigen::MatrixXd::Identity(6,6);
-    Eigen::MatrixXd Binv = I;
-    Eigen::VectorXd s(6), y(6);
-    double objValue = energy(x, c1, c2, c3, limits), newObjValue;
-
-    gradientEnergy(gradient, x, c1, c2, c3, limits);
-
-    direction = -Binv*gradient;
-
-    do{
-        new_x = x +alfa * direction;
-		while ((! g->getBoundingBox().isIntern(new_x(0), new_x(1), new_x(2)) || ! g->getBoundingBox().isIntern(new_x(3), new_x(4), new_x(5))) && alfa != 0){
-            alfa /= 2;
-            new_x = x +alfa * direction;
+/**
+ * @brief Energy::minimize
+ *
+ * Minimization of Energy::BFGS on the grid of this energy only.
+ * @param bb: bounds of the box (the bounding box of the finest grid)
+ */
+void Energy::minimize(BoxState& state, int maxIterations, const BoundingBox3& bb, double tolerance, Box3D& b, BoxList& iterations, bool saveIt) const {
+    BoxMinimizer minimizer;
+    Vector6d gradient;
+    int nIterations = state.nIterations;
+    minimizer.start(state, bb, maxIterations, tolerance);
+    bool running;
+    do {
+        double value = energyAndGradient(gradient, minimizer.getPoint(), state);
+        running = minimizer.update(value, gradient);
+        if (saveIt && state.nIterations > nIterations){
+            state.setTo(b);
+            iterations.addBox(b);
         }
+        nIterations = state.nIterations;
+    } while (running);
+}
 
-        newObjValue = energy(new_x, c1, c2, c3, limits);
-
-        while (newObjValue >= objValue && alfa > 1e-10){
-            alfa/= 2;
-            new_x = x +alfa * direction;
-
-            newObjValue = energy(new_x, c1, c2, c3, limits);
-        }
-
-        if (alfa > 1e-10){
-            gradientEnergy(newGradient, new_x, c1, c2, c3, limits);
-
-            new_x = x +alfa * direction;
-
-            s = new_x - x;
-            y = newGradient - gradient;
-            double tmp = (y.transpose()*s);
-            ro = 1.0 / tmp;
-            Binv = (I - ro*s*y.transpose())*Binv*(I - ro*y*s.transpose()) + ro*s*s.transpose();
-            if (saveIt){
-				b.setMin(Point3d(x(0), x(1), x(2)));
-				b.setMax(Point3d(x(3), x(4), x(5)));
-                iterations.addBox(b);
-            }
-            x = new_x;
-            objValue = newObjValue;
-            nIterations++;
-            gradient = newGradient;
-            direction = -Binv*gradient;
-            double dot = gradient.dot(direction);
-            if (dot >= 0) {
-                Binv = I;
-                direction = -gradient;
-            }
-            alfa *= 2;
-        }
-    }while (alfa > 1e-6 && gradient.norm() > 1e-7 && nIterations < 100);
-	b.setMin(Point3d(x(0), x(1), x(2)));
-	b.setMax(Point3d(x(3), x(4), x(5)));
-    if (saveIt) iterations.addBox(b);
+void Energy::gradientBarrier(Eigen::VectorXd &gBarrier, const Eigen::VectorXd &x, const Point3d& c1, const Point3d& c2, const Point3d& c3, double s)  const {
 
-    return nIterations;
+    gBarrier <<
+        -derivateFi(c1.x()-x(0),s) - derivateFi(c2.x()-x(0),s) - derivateFi(c3.x()-x(0),s),
+        -derivateFi(c1.y()-x(1),s) - derivateFi(c2.y()-x(1),s) - derivateFi(c3.y()-x(1),s),
+        -derivateFi(c1.z()-x(2),s) - derivateFi(c2.z()-x(2),s) - derivateFi(c3.z()-x(2),s),
+        derivateFi(x(3)-c1.x(),s) + derivateFi(x(3)-c2.x(),s) + derivateFi(x(3)-c3.x(),s),
+        derivateFi(x(4)-c1.y(),s) + derivateFi(x(4)-c2.y(),s) + derivateFi(x(4)-c3.y(),s),
+        derivateFi(x(5)-c1.z(),s) + derivateFi(x(5)-c2.z(),s) + derivateFi(x(5)-c3.z(),s);
 }
 
-void Energy::gradientBarrier(Eigen::VectorXd &gBarrier, const Eigen::VectorXd &x, const Point3d& c1, const Point3d& c2, const Point3d& c3, double s)  const {
+void Energy::gradientBarrier(Vector6d &gBarrier, const Vector6d &x, const Point3d& c1, const Point3d& c2, const Point3d& c3, double s)  const {
 
     gBarrier <<
         -derivateFi(c1.x()-x(0),s) - derivateFi(c2.x()-x(0),s) - derivateFi(c3.x()-x(0),s),
@@ -264,6 +306,16 @@ void Energy::gradientBarrierLimits(Eigen::VectorXd& gBarrier, const Eigen::Vecto
             -derivateFi(l.z()-x(5)+x(2),s);
 }
 
+void Energy::gradientBarrierLimits(Vector6d& gBarrier, const Vector6d &x, const Point3d& l, double s) const {
+    gBarrier <<
+            derivateFi(l.x()-x(3)+x(0),s),
+            derivateFi(l.y()-x(4)+x(1),s),
+            derivateFi(l.z()-x(5)+x(2),s),
+            -derivateFi(l.x()-x(3)+x(0),s),
+            -derivateFi(l.y()-x(4)+x(1),s),
+            -derivateFi(l.z()-x(5)+x(2),s);
+}
+
 void Energy::gradientBarrierLimits(Eigen::VectorXd& gBarrier, const BoundingBox3& b, const Point3d& l, double s) const {
     gBarrier <<
             derivateFi(l.x()-b.maxX()+b.minX(),s),
@@ -275,812 +327,118 @@ void Energy::gradientBarrierLimits(Eigen::VectorXd& gBarrier, const BoundingBox3
 }
 
 double Energy::gradientXMinComponent(const gridreal*& a, double u1, double v1, double w1, double v2, double w2) {
-    double u12 = u1*u1; double u13 = u12*u1;
-    double v12 = v1*v1; double v13 = v12*v1; double v14 = v13*v1;
-    double w12 = w1*w1; double w13 = w12*w1; double w14 = w13*w1;
-    double v22 = v2*v2; double v23 = v22*v2; double v24 = v23*v2;
-    double w22 = w2*w2; double w23 = w22*w2; double w24 = w23*w2;
-    double G_result;
-    G_result =
-            -w14 *
-            ((1.0L/4.0L)*a[48]*v1 - 1.0L/4.0L*a[48]*v2 + (1.0L/4.0L)*a[49]*u1*v1 - 1.0L/4.0L*a[49]*u1*v2 +
-            (1.0L/4.0L)*a[50]*u12*v1 - 1.0L/4.0L*a[50]*u12*v2 + (1.0L/4.0L)*a[51]*u13*v1 - 1.0L/4.0L*a[51]*u13*v2 +
-            (1.0L/8.0L)*a[52]*v12 - 1.0L/8.0L*a[52]*v22 + (1.0L/8.0L)*a[53]*u1*v12 - 1.0L/8.0L*a[53]*u1*v22 +
-            (1.0L/8.0L)*a[54]*u12*v12 - 1.0L/8.0L*a[54]*u12*v22 + (1.0L/8.0L)*a[55]*u13*v12 - 1.0L/8.0L*a[55]*u13*v22 +
-            (1.0L/12.0L)*a[56]*v13 - 1.0L/12.0L*a[56]*v23 + (1.0L/12.0L)*a[57]*u1*v13 - 1.0L/12.0L*a[57]*u1*v23 +
-            (1.0L/12.0L)*a[58]*u12*v13 - 1.0L/12.0L*a[58]*u12*v23 + (1.0L/12.0L)*a[59]*u13*v13 - 1.0L/12.0L*a[59]*u13*v23 +
-            (1.0L/16.0L)*a[60]*v14 - 1.0L/16.0L*a[60]*v24 + (1.0L/16.0L)*a[61]*u1*v14 - 1.0L/16.0L*a[61]*u1*v24 +
-            (1.0L/16.0L)*a[62]*u12*v14 - 1.0L/16.0L*a[62]*u12*v24 + (1.0L/16.0L)*a[63]*u13*v14 - 1.0L/16.0L*a[63]*u13*v24)
-            - w13 *
-            ((1.0L/3.0L)*a[32]*v1 - 1.0L/3.0L*a[32]*v2 + (1.0L/3.0L)*a[33]*u1*v1 - 1.0L/3.0L*a[33]*u1*v2 +
-            (1.0L/3.0L)*a[34]*u12*v1 - 1.0L/3.0L*a[34]*u12*v2 + (1.0L/3.0L)*a[35]*u13*v1 - 1.0L/3.0L*a[35]*u13*v2 +
-            (1.0L/6.0L)*a[36]*v12 - 1.0L/6.0L*a[36]*v22 + (1.0L/6.0L)*a[37]*u1*v12 - 1.0L/6.0L*a[37]*u1*v22 +
-            (1.0L/6.0L)*a[38]*u12*v12 - 1.0L/6.0L*a[38]*u12*v22 + (1.0L/6.0L)*a[39]*u13*v12 - 1.0L/6.0L*a[39]*u13*v22 +
-            (1.0L/9.0L)*a[40]*v13 - 1.0L/9.0L*a[40]*v23 + (1.0L/9.0L)*a[41]*u1*v13 - 1.0L/9.0L*a[41]*u1*v23 +
-            (1.0L/9.0L)*a[42]*u12*v13 - 1.0L/9.0L*a[42]*u12*v23 + (1.0L/9.0L)*a[43]*u13*v13 - 1.0L/9.0L*a[43]*u13*v23 +
-            (1.0L/12.0L)*a[44]*v14 - 1.0L/12.0L*a[44]*v24 + (1.0L/12.0L)*a[45]*u1*v14 - 1.0L/12.0L*a[45]*u1*v24 +
-            (1.0L/12.0L)*a[46]*u12*v14 - 1.0L/12.0L*a[46]*u12*v24 + (1.0L/12.0L)*a[47]*u13*v14 - 1.0L/12.0L*a[47]*u13*v24)
-            - w12 *
-            ((1.0L/2.0L)*a[16]*v1 - 1.0L/2.0L*a[16]*v2 + (1.0L/2.0L)*a[17]*u1*v1 - 1.0L/2.0L*a[17]*u1*v2 +
-            (1.0L/2.0L)*a[18]*u12*v1 - 1.0L/2.0L*a[18]*u12*v2 + (1.0L/2.0L)*a[19]*u13*v1 - 1.0L/2.0L*a[19]*u13*v2 +
-            (1.0L/4.0L)*a[20]*v12 - 1.0L/4.0L*a[20]*v22 + (1.0L/4.0L)*a[21]*u1*v12 - 1.0L/4.0L*a[21]*u1*v22 +
-            (1.0L/4.0L)*a[22]*u12*v12 - 1.0L/4.0L*a[22]*u12*v22 + (1.0L/4.0L)*a[23]*u13*v12 - 1.0L/4.0L*a[23]*u13*v22 +
-            (1.0L/6.0L)*a[24]*v13 - 1.0L/6.0L*a[24]*v23 + (1.0L/6.0L)*a[25]*u1*v13 - 1.0L/6.0L*a[25]*u1*v23 +
-            (1.0L/6.0L)*a[26]*u12*v13 - 1.0L/6.0L*a[26]*u12*v23 + (1.0L/6.0L)*a[27]*u13*v13 - 1.0L/6.0L*a[27]*u13*v23 +
-            (1.0L/8.0L)*a[28]*v14 - 1.0L/8.0L*a[28]*v24 + (1.0L/8.0L)*a[29]*u1*v14 - 1.0L/8.0L*a[29]*u1*v24 +
-            (1.0L/8.0L)*a[30]*u12*v14 - 1.0L/8.0L*a[30]*u12*v24 + (1.0L/8.0L)*a[31]*u13*v14 - 1.0L/8.0L*a[31]*u13*v24)
-            - w1 *
-            (a[0]*v1 - a[0]*v2 + a[1]*u1*v1 - a[1]*u1*v2 +
-            (1.0L/3.0L)*a[10]*u12*v13 - 1.0L/3.0L*a[10]*u12*v23 + (1.0L/3.0L)*a[11]*u13*v13 - 1.0L/3.0L*a[11]*u13*v23 +
-            (1.0L/4.0L)*a[12]*v14 - 1.0L/4.0L*a[12]*v24 + (1.0L/4.0L)*a[13]*u1*v14 - 1.0L/4.0L*a[13]*u1*v24 +
-            (1.0L/4.0L)*a[14]*u12*v14 - 1.0L/4.0L*a[14]*u12*v24 + (1.0L/4.0L)*a[15]*u13*v14 - 1.0L/4.0L*a[15]*u13*v24 +
-            a[2]*u12*v1 - a[2]*u12*v2 + a[3]*u13*v1 - a[3]*u13*v2 +
-            (1.0L/2.0L)*a[4]*v12 - 1.0L/2.0L*a[4]*v22 + (1.0L/2.0L)*a[5]*u1*v12 - 1.0L/2.0L*a[5]*u1*v22 +
-            (1.0L/2.0L)*a[6]*u12*v12 - 1.0L/2.0L*a[6]*u12*v22 + (1.0L/2.0L)*a[7]*u13*v12 - 1.0L/2.0L*a[7]*u13*v22 +
-            (1.0L/3.0L)*a[8]*v13 - 1.0L/3.0L*a[8]*v23 + (1.0L/3.0L)*a[9]*u1*v13 - 1.0L/3.0L*a[9]*u1*v23)
-            + w24 *
-            ((1.0L/4.0L)*a[48]*v1 - 1.0L/4.0L*a[48]*v2 + (1.0L/4.0L)*a[49]*u1*v1 - 1.0L/4.0L*a[49]*u1*v2 +
-            (1.0L/4.0L)*a[50]*u12*v1 - 1.0L/4.0L*a[50]*u12*v2 + (1.0L/4.0L)*a[51]*u13*v1 - 1.0L/4.0L*a[51]*u13*v2 +
-            (1.0L/8.0L)*a[52]*v12 - 1.0L/8.0L*a[52]*v22 + (1.0L/8.0L)*a[53]*u1*v12 - 1.0L/8.0L*a[53]*u1*v22 +
-            (1.0L/8.0L)*a[54]*u12*v12 - 1.0L/8.0L*a[54]*u12*v22 + (1.0L/8.0L)*a[55]*u13*v12 - 1.0L/8.0L*a[55]*u13*v22 +
-            (1.0L/12.0L)*a[56]*v13 - 1.0L/12.0L*a[56]*v23 + (1.0L/12.0L)*a[57]*u1*v13 - 1.0L/12.0L*a[57]*u1*v23 +
-            (1.0L/12.0L)*a[58]*u12*v13 - 1.0L/12.0L*a[58]*u12*v23 + (1.0L/12.0L)*a[59]*u13*v13 - 1.0L/12.0L*a[59]*u13*v23 +
-            (1.0L/16.0L)*a[60]*v14 - 1.0L/16.0L*a[60]*v24 + (1.0L/16.0L)*a[61]*u1*v14 - 1.0L/16.0L*a[61]*u1*v24 +
-            (1.0L/16.0L)*a[62]*u12*v14 - 1.0L/16.0L*a[62]*u12*v24 + (1.0L/16.0L)*a[63]*u13*v14 - 1.0L/16.0L*a[63]*u13*v24)
-            + w23 *
-            ((1.0L/3.0L)*a[32]*v1 - 1.0L/3.0L*a[32]*v2 + (1.0L/3.0L)*a[33]*u1*v1 - 1.0L/3.0L*a[33]*u1*v2 +
-            (1.0L/3.0L)*a[34]*u12*v1 - 1.0L/3.0L*a[34]*u12*v2 + (1.0L/3.0L)*a[35]*u13*v1 - 1.0L/3.0L*a[35]*u13*v2 +
-            (1.0L/6.0L)*a[36]*v12 - 1.0L/6.0L*a[36]*v22 + (1.0L/6.0L)*a[37]*u1*v12 - 1.0L/6.0L*a[37]*u1*v22 +
-            (1.0L/6.0L)*a[38]*u12*v12 - 1.0L/6.0L*a[38]*u12*v22 + (1.0L/6.0L)*a[39]*u13*v12 - 1.0L/6.0L*a[39]*u13*v22 +
-            (1.0L/9.0L)*a[40]*v13 - 1.0L/9.0L*a[40]*v23 + (1.0L/9.0L)*a[41]*u1*v13 - 1.0L/9.0L*a[41]*u1*v23 +
-            (1.0L/9.0L)*a[42]*u12*v13 - 1.0L/9.0L*a[42]*u12*v23 + (1.0L/9.0L)*a[43]*u13*v13 - 1.0L/9.0L*a[43]*u13*v23 +
-            (1.0L/12.0L)*a[44]*v14 - 1.0L/12.0L*a[44]*v24 + (1.0L/12.0L)*a[45]*u1*v14 - 1.0L/12.0L*a[45]*u1*v24 +
-            (1.0L/12.0L)*a[46]*u12*v14 - 1.0L/12.0L*a[46]*u12*v24 + (1.0L/12.0L)*a[47]*u13*v14 - 1.0L/12.0L*a[47]*u13*v24)
-            + w22 *
-            ((1.0L/2.0L)*a[16]*v1 - 1.0L/2.0L*a[16]*v2 + (1.0L/2.0L)*a[17]*u1*v1 - 1.0L/2.0L*a[17]*u1*v2 +
-            (1.0L/2.0L)*a[18]*u12*v1 - 1.0L/2.0L*a[18]*u12*v2 + (1.0L/2.0L)*a[19]*u13*v1 - 1.0L/2.0L*a[19]*u13*v2 +
-            (1.0L/4.0L)*a[20]*v12 - 1.0L/4.0L*a[20]*v22 + (1.0L/4.0L)*a[21]*u1*v12 - 1.0L/4.0L*a[21]*u1*v22 +
-            (1.0L/4.0L)*a[22]*u12*v12 - 1.0L/4.0L*a[22]*u12*v22 + (1.0L/4.0L)*a[23]*u13*v12 - 1.0L/4.0L*a[23]*u13*v22 +
-            (1.0L/6.0L)*a[24]*v13 - 1.0L/6.0L*a[24]*v23 + (1.0L/6.0L)*a[25]*u1*v13 - 1.0L/6.0L*a[25]*u1*v23 +
-            (1.0L/6.0L)*a[26]*u12*v13 - 1.0L/6.0L*a[26]*u12*v23 + (1.0L/6.0L)*a[27]*u13*v13 - 1.0L/6.0L*a[27]*u13*v23 +
-            (1.0L/8.0L)*a[28]*v14 - 1.0L/8.0L*a[28]*v24 + (1.0L/8.0L)*a[29]*u1*v14 - 1.0L/8.0L*a[29]*u1*v24 +
-            (1.0L/8.0L)*a[30]*u12*v14 - 1.0L/8.0L*a[30]*u12*v24 + (1.0L/8.0L)*a[31]*u13*v14 - 1.0L/8.0L*a[31]*u13*v24)
-            + w2 *
-            (a[0]*v1 - a[0]*v2 + a[1]*u1*v1 - a[1]*u1*v2 +
-            (1.0L/3.0L)*a[10]*u12*v13 - 1.0L/3.0L*a[10]*u12*v23 + (1.0L/3.0L)*a[11]*u13*v13 - 1.0L/3.0L*a[11]*u13*v23 +
-            (1.0L/4.0L)*a[12]*v14 - 1.0L/4.0L*a[12]*v24 + (1.0L/4.0L)*a[13]*u1*v14 - 1.0L/4.0L*a[13]*u1*v24 +
-            (1.0L/4.0L)*a[14]*u12*v14 - 1.0L/4.0L*a[14]*u12*v24 + (1.0L/4.0L)*a[15]*u13*v14 - 1.0L/4.0L*a[15]*u13*v24 +
-            a[2]*u12*v1 - a[2]*u12*v2 + a[3]*u13*v1 - a[3]*u13*v2 +
-            (1.0L/2.0L)*a[4]*v12 - 1.0L/2.0L*a[4]*v22 + (1.0L/2.0L)*a[5]*u1*v12 - 1.0L/2.0L*a[5]*u1*v22 +
-            (1.0L/2.0L)*a[6]*u12*v12 - 1.0L/2.0L*a[6]*u12*v22 + (1.0L/2.0L)*a[7]*u13*v12 - 1.0L/2.0L*a[7]*u13*v22 +
-            (1.0L/3.0L)*a[8]*v13 - 1.0L/3.0L*a[8]*v23 + (1.0L/3.0L)*a[9]*u1*v13 - 1.0L/3.0L*a[9]*u1*v23);
-    return G_result;
+    double x[4], y[4], z[4];
+    TricubicKernel::powers(x, u1);
+    TricubicKernel::moments(y, v1, v2);
+    TricubicKernel::moments(z, w1, w2);
+    return -TricubicKernel::contract(a, x, y, z);
 }
 
 double Energy::gradientYMinComponent(const gridreal*& a, double u1, double v1, double w1, double u2, double w2) {
-    double u12 = u1*u1; double u13 = u12*u1; double u14 = u13*u1;
-    double v12 = v1*v1; double v13 = v12*v1;
-    double w12 = w1*w1; double w13 = w12*w1; double w14 = w13*w1;
-    double u22 = u2*u2; double u23 = u22*u2; double u24 = u23*u2;
-    double w22 = w2*w2; double w23 = w22*w2; double w24 = w23*w2;
-    double G_result;
-    G_result =
-            -w14 *
-            ((1.0L/4.0L)*a[48]*u1 - 1.0L/4.0L*a[48]*u2 + (1.0L/8.0L)*a[49]*u12 - 1.0L/8.0L*a[49]*u22 +
-            (1.0L/12.0L)*a[50]*u13 - 1.0L/12.0L*a[50]*u23 + (1.0L/16.0L)*a[51]*u14 - 1.0L/16.0L*a[51]*u24 +
-            (1.0L/4.0L)*a[52]*u1*v1 - 1.0L/4.0L*a[52]*u2*v1 + (1.0L/8.0L)*a[53]*u12*v1 - 1.0L/8.0L*a[53]*u22*v1 +
-            (1.0L/12.0L)*a[54]*u13*v1 - 1.0L/12.0L*a[54]*u23*v1 + (1.0L/16.0L)*a[55]*u14*v1 - 1.0L/16.0L*a[55]*u24*v1 +
-            (1.0L/4.0L)*a[56]*u1*v12 - 1.0L/4.0L*a[56]*u2*v12 + (1.0L/8.0L)*a[57]*u12*v12 - 1.0L/8.0L*a[57]*u22*v12 +
-            (1.0L/12.0L)*a[58]*u13*v12 - 1.0L/12.0L*a[58]*u23*v12 + (1.0L/16.0L)*a[59]*u14*v12 - 1.0L/16.0L*a[59]*u24*v12 +
-            (1.0L/4.0L)*a[60]*u1*v13 - 1.0L/4.0L*a[60]*u2*v13 + (1.0L/8.0L)*a[61]*u12*v13 - 1.0L/8.0L*a[61]*u22*v13 +
-            (1.0L/12.0L)*a[62]*u13*v13 - 1.0L/12.0L*a[62]*u23*v13 + (1.0L/16.0L)*a[63]*u14*v13 - 1.0L/16.0L*a[63]*u24*v13)
-            - w13 *
-            ((1.0L/3.0L)*a[32]*u1 - 1.0L/3.0L*a[32]*u2 + (1.0L/6.0L)*a[33]*u12 - 1.0L/6.0L*a[33]*u22 +
-            (1.0L/9.0L)*a[34]*u13 - 1.0L/9.0L*a[34]*u23 + (1.0L/12.0L)*a[35]*u14 - 1.0L/12.0L*a[35]*u24 +
-            (1.0L/3.0L)*a[36]*u1*v1 - 1.0L/3.0L*a[36]*u2*v1 + (1.0L/6.0L)*a[37]*u12*v1 - 1.0L/6.0L*a[37]*u22*v1 +
-            (1.0L/9.0L)*a[38]*u13*v1 - 1.0L/9.0L*a[38]*u23*v1 + (1.0L/12.0L)*a[39]*u14*v1 - 1.0L/12.0L*a[39]*u24*v1 +
-            (1.0L/3.0L)*a[40]*u1*v12 - 1.0L/3.0L*a[40]*u2*v12 + (1.0L/6.0L)*a[41]*u12*v12 - 1.0L/6.0L*a[41]*u22*v12 +
-            (1.0L/9.0L)*a[42]*u13*v12 - 1.0L/9.0L*a[42]*u23*v12 + (1.0L/12.0L)*a[43]*u14*v12 - 1.0L/12.0L*a[43]*u24*v12 +
-            (1.0L/3.0L)*a[44]*u1*v13 - 1.0L/3.0L*a[44]*u2*v13 + (1.0L/6.0L)*a[45]*u12*v13 - 1.0L/6.0L*a[45]*u22*v13 +
-            (1.0L/9.0L)*a[46]*u13*v13 - 1.0L/9.0L*a[46]*u23*v13 + (1.0L/12.0L)*a[47]*u14*v13 - 1.0L/12.0L*a[47]*u24*v13)
-            - w12 *
-            ((1.0L/2.0L)*a[16]*u1 - 1.0L/2.0L*a[16]*u2 + (1.0L/4.0L)*a[17]*u12 - 1.0L/4.0L*a[17]*u22 +
-            (1.0L/6.0L)*a[18]*u13 - 1.0L/6.0L*a[18]*u23 + (1.0L/8.0L)*a[19]*u14 - 1.0L/8.0L*a[19]*u24 +
-            (1.0L/2.0L)*a[20]*u1*v1 - 1.0L/2.0L*a[20]*u2*v1 + (1.0L/4.0L)*a[21]*u12*v1 - 1.0L/4.0L*a[21]*u22*v1 +
-            (1.0L/6.0L)*a[22]*u13*v1 - 1.0L/6.0L*a[22]*u23*v1 + (1.0L/8.0L)*a[23]*u14*v1 - 1.0L/8.0L*a[23]*u24*v1 +
-            (1.0L/2.0L)*a[24]*u1*v12 - 1.0L/2.0L*a[24]*u2*v12 + (1.0L/4.0L)*a[25]*u12*v12 - 1.0L/4.0L*a[25]*u22*v12 +
-            (1.0L/6.0L)*a[26]*u13*v12 - 1.0L/6.0L*a[26]*u23*v12 + (1.0L/8.0L)*a[27]*u14*v12 - 1.0L/8.0L*a[27]*u24*v12 +
-            (1.0L/2.0L)*a[28]*u1*v13 - 1.0L/2.0L*a[28]*u2*v13 + (1.0L/4.0L)*a[29]*u12*v13 - 1.0L/4.0L*a[29]*u22*v13 +
-            (1.0L/6.0L)*a[30]*u13*v13 - 1.0L/6.0L*a[30]*u23*v13 + (1.0L/8.0L)*a[31]*u14*v13 - 1.0L/8.0L*a[31]*u24*v13)
-            - w1 *
-            (a[0]*u1 - a[0]*u2 + (1.0L/2.0L)*a[1]*u12 - 1.0L/2.0L*a[1]*u22 +
-            (1.0L/3.0L)*a[10]*u13*v12 - 1.0L/3.0L*a[10]*u23*v12 + (1.0L/4.0L)*a[11]*u14*v12 - 1.0L/4.0L*a[11]*u24*v12 +
-            a[12]*u1*v13 - a[12]*u2*v13 + (1.0L/2.0L)*a[13]*u12*v13 - 1.0L/2.0L*a[13]*u22*v13 +
-            (1.0L/3.0L)*a[14]*u13*v13 - 1.0L/3.0L*a[14]*u23*v13 + (1.0L/4.0L)*a[15]*u14*v13 - 1.0L/4.0L*a[15]*u24*v13 +
-            (1.0L/3.0L)*a[2]*u13 - 1.0L/3.0L*a[2]*u23 + (1.0L/4.0L)*a[3]*u14 - 1.0L/4.0L*a[3]*u24 +
-            a[4]*u1*v1 - a[4]*u2*v1 + (1.0L/2.0L)*a[5]*u12*v1 - 1.0L/2.0L*a[5]*u22*v1 +
-            (1.0L/3.0L)*a[6]*u13*v1 - 1.0L/3.0L*a[6]*u23*v1 + (1.0L/4.0L)*a[7]*u14*v1 - 1.0L/4.0L*a[7]*u24*v1 +
-            a[8]*u1*v12 - a[8]*u2*v12 + (1.0L/2.0L)*a[9]*u12*v12 - 1.0L/2.0L*a[9]*u22*v12)
-            + w24 *
-            ((1.0L/4.0L)*a[48]*u1 - 1.0L/4.0L*a[48]*u2 + (1.0L/8.0L)*a[49]*u12 - 1.0L/8.0L*a[49]*u22 +
-            (1.0L/12.0L)*a[50]*u13 - 1.0L/12.0L*a[50]*u23 + (1.0L/16.0L)*a[51]*u14 - 1.0L/16.0L*a[51]*u24 +
-            (1.0L/4.0L)*a[52]*u1*v1 - 1.0L/4.0L*a[52]*u2*v1 + (1.0L/8.0L)*a[53]*u12*v1 - 1.0L/8.0L*a[53]*u22*v1 +
-            (1.0L/12.0L)*a[54]*u13*v1 - 1.0L/12.0L*a[54]*u23*v1 + (1.0L/16.0L)*a[55]*u14*v1 - 1.0L/16.0L*a[55]*u24*v1 +
-            (1.0L/4.0L)*a[56]*u1*v12 - 1.0L/4.0L*a[56]*u2*v12 + (1.0L/8.0L)*a[57]*u12*v12 - 1.0L/8.0L*a[57]*u22*v12 +
-            (1.0L/12.0L)*a[58]*u13*v12 - 1.0L/12.0L*a[58]*u23*v12 + (1.0L/16.0L)*a[59]*u14*v12 - 1.0L/16.0L*a[59]*u24*v12 +
-            (1.0L/4.0L)*a[60]*u1*v13 - 1.0L/4.0L*a[60]*u2*v13 + (1.0L/8.0L)*a[61]*u12*v13 - 1.0L/8.0L*a[61]*u22*v13 +
-            (1.0L/12.0L)*a[62]*u13*v13 - 1.0L/12.0L*a[62]*u23*v13 + (1.0L/16.0L)*a[63]*u14*v13 - 1.0L/16.0L*a[63]*u24*v13)
-            + w23 *
-            ((1.0L/3.0L)*a[32]*u1 - 1.0L/3.0L*a[32]*u2 + (1.0L/6.0L)*a[33]*u12 - 1.0L/6.0L*a[33]*u22 +
-            (1.0L/9.0L)*a[34]*u13 - 1.0L/9.0L*a[34]*u23 + (1.0L/12.0L)*a[35]*u14 - 1.0L/12.0L*a[35]*u24 +
-            (1.0L/3.0L)*a[36]*u1*v1 - 1.0L/3.0L*a[36]*u2*v1 + (1.0L/6.0L)*a[37]*u12*v1 - 1.0L/6.0L*a[37]*u22*v1 +
-            (1.0L/9.0L)*a[38]*u13*v1 - 1.0L/9.0L*a[38]*u23*v1 + (1.0L/12.0L)*a[39]*u14*v1 - 1.0L/12.0L*a[39]*u24*v1 +
-            (1.0L/3.0L)*a[40]*u1*v12 - 1.0L/3.0L*a[40]*u2*v12 + (1.0L/6.0L)*a[41]*u12*v12 - 1.0L/6.0L*a[41]*u22*v12 +
-            (1.0L/9.0L)*a[42]*u13*v12 - 1.0L/9.0L*a[42]*u23*v12 + (1.0L/12.0L)*a[43]*u14*v12 - 1.0L/12.0L*a[43]*u24*v12 +
-            (1.0L/3.0L)*a[44]*u1*v13 - 1.0L/3.0L*a[44]*u2*v13 + (1.0L/6.0L)*a[45]*u12*v13 - 1.0L/6.0L*a[45]*u22*v13 +
-            (1.0L/9.0L)*a[46]*u13*v13 - 1.0L/9.0L*a[46]*u23*v13 + (1.0L/12.0L)*a[47]*u14*v13 - 1.0L/12.0L*a[47]*u24*v13)
-            + w22 *
-            ((1.0L/2.0L)*a[16]*u1 - 1.0L/2.0L*a[16]*u2 + (1.0L/4.0L)*a[17]*u12 - 1.0L/4.0L*a[17]*u22 +
-            (1.0L/6.0L)*a[18]*u13 - 1.0L/6.0L*a[18]*u23 + (1.0L/8.0L)*a[19]*u14 - 1.0L/8.0L*a[19]*u24 +
-            (1.0L/2.0L)*a[20]*u1*v1 - 1.0L/2.0L*a[20]*u2*v1 + (1.0L/4.0L)*a[21]*u12*v1 - 1.0L/4.0L*a[21]*u22*v1 +
-            (1.0L/6.0L)*a[22]*u13*v1 - 1.0L/6.0L*a[22]*u23*v1 + (1.0L/8.0L)*a[23]*u14*v1 - 1.0L/8.0L*a[23]*u24*v1 +
-            (1.0L/2.0L)*a[24]*u1*v12 - 1.0L/2.0L*a[24]*u2*v12 + (1.0L/4.0L)*a[25]*u12*v12 - 1.0L/4.0L*a[25]*u22*v12 +
-            (1.0L/6.0L)*a[26]*u13*v12 - 1.0L/6.0L*a[26]*u23*v12 + (1.0L/8.0L)*a[27]*u14*v12 - 1.0L/8.0L*a[27]*u24*v12 +
-            (1.0L/2.0L)*a[28]*u1*v13 - 1.0L/2.0L*a[28]*u2*v13 + (1.0L/4.0L)*a[29]*u12*v13 - 1.0L/4.0L*a[29]*u22*v13 +
-            (1.0L/6.0L)*a[30]*u13*v13 - 1.0L/6.0L*a[30]*u23*v13 + (1.0L/8.0L)*a[31]*u14*v13 - 1.0L/8.0L*a[31]*u24*v13)
-            + w2 *
-            (a[0]*u1 - a[0]*u2 + (1.0L/2.0L)*a[1]*u12 - 1.0L/2.0L*a[1]*u22 +
-            (1.0L/3.0L)*a[10]*u13*v12 - 1.0L/3.0L*a[10]*u23*v12 + (1.0L/4.0L)*a[11]*u14*v12 - 1.0L/4.0L*a[11]*u24*v12 +
-            a[12]*u1*v13 - a[12]*u2*v13 + (1.0L/2.0L)*a[13]*u12*v13 - 1.0L/2.0L*a[13]*u22*v13 +
-            (1.0L/3.0L)*a[14]*u13*v13 - 1.0L/3.0L*a[14]*u23*v13 + (1.0L/4.0L)*a[15]*u14*v13 - 1.0L/4.0L*a[15]*u24*v13 +
-            (1.0L/3.0L)*a[2]*u13 - 1.0L/3.0L*a[2]*u23 + (1.0L/4.0L)*a[3]*u14 - 1.0L/4.0L*a[3]*u24 +
-            a[4]*u1*v1 - a[4]*u2*v1 + (1.0L/2.0L)*a[5]*u12*v1 - 1.0L/2.0L*a[5]*u22*v1 +
-            (1.0L/3.0L)*a[6]*u13*v1 - 1.0L/3.0L*a[6]*u23*v1 + (1.0L/4.0L)*a[7]*u14*v1 - 1.0L/4.0L*a[7]*u24*v1 +
-            a[8]*u1*v12 - a[8]*u2*v12 + (1.0L/2.0L)*a[9]*u12*v12 - 1.0L/2.0L*a[9]*u22*v12);
-    return G_result;
+    double x[4], y[4], z[4];
+    TricubicKernel::moments(x, u1, u2);
+    TricubicKernel::powers(y, v1);
+    TricubicKernel::moments(z, w1, w2);
+    return -TricubicKernel::contract(a, x, y, z);
 }
 
 double Energy::gradientZMinComponent(const gridreal*& a, double u1, double v1, double w1, double u2, double v2) {
-    double u12 = u1*u1; double u13 = u12*u1; double u14 = u13*u1;
-    double v12 = v1*v1; double v13 = v12*v1; double v14 = v13*v1;
-    double w12 = w1*w1; double w13 = w12*w1;
-    double u22 = u2*u2; double u23 = u22*u2; double u24 = u23*u2;
-    double v22 = v2*v2; double v23 = v22*v2; double v24 = v23*v2;
-    double G_result;
-    G_result =
-            -a[0]*u1*v1 + a[0]*u1*v2 + a[0]*u2*v1 - a[0]*u2*v2
-            - 1.0L/2.0L*a[1]*u12*v1 +  (1.0L/2.0L)*a[1]*u12*v2 + (1.0L/2.0L)*a[1]*u22*v1 - 1.0L/2.0L*a[1]*u22*v2
-            - 1.0L/9.0L*a[10]*u13*v13 + (1.0L/9.0L)*a[10]*u13*v23 + (1.0L/9.0L)*a[10]*u23*v13 - 1.0L/9.0L*a[10]*u23*v23
-            - 1.0L/12.0L*a[11]*u14*v13 + (1.0L/12.0L)*a[11]*u14*v23 + (1.0L/12.0L)*a[11]*u24*v13 - 1.0L/12.0L*a[11]*u24*v23
-            - 1.0L/4.0L*a[12]*u1*v14 + (1.0L/4.0L)*a[12]*u1*v24 + (1.0L/4.0L)*a[12]*u2*v14 - 1.0L/4.0L*a[12]*u2*v24
-            - 1.0L/8.0L*a[13]*u12*v14 + (1.0L/8.0L)*a[13]*u12*v24 + (1.0L/8.0L)*a[13]*u22*v14 - 1.0L/8.0L*a[13]*u22*v24
-            - 1.0L/12.0L*a[14]*u13*v14 + (1.0L/12.0L)*a[14]*u13*v24 + (1.0L/12.0L)*a[14]*u23*v14 - 1.0L/12.0L*a[14]*u23*v24
-            - 1.0L/16.0L*a[15]*u14*v14 + (1.0L/16.0L)*a[15]*u14*v24 + (1.0L/16.0L)*a[15]*u24*v14 - 1.0L/16.0L*a[15]*u24*v24
-            - 1.0L/3.0L*a[2]*u13*v1 + (1.0L/3.0L)*a[2]*u13*v2 + (1.0L/3.0L)*a[2]*u23*v1 - 1.0L/3.0L*a[2]*u23*v2
-            - 1.0L/4.0L*a[3]*u14*v1 + (1.0L/4.0L)*a[3]*u14*v2 + (1.0L/4.0L)*a[3]*u24*v1 - 1.0L/4.0L*a[3]*u24*v2
-            - 1.0L/2.0L*a[4]*u1*v12 + (1.0L/2.0L)*a[4]*u1*v22 + (1.0L/2.0L)*a[4]*u2*v12 - 1.0L/2.0L*a[4]*u2*v22
-            - 1.0L/4.0L*a[5]*u12*v12 + (1.0L/4.0L)*a[5]*u12*v22 + (1.0L/4.0L)*a[5]*u22*v12 - 1.0L/4.0L*a[5]*u22*v22
-            - 1.0L/6.0L*a[6]*u13*v12 + (1.0L/6.0L)*a[6]*u13*v22 + (1.0L/6.0L)*a[6]*u23*v12 - 1.0L/6.0L*a[6]*u23*v22
-            - 1.0L/8.0L*a[7]*u14*v12 + (1.0L/8.0L)*a[7]*u14*v22 + (1.0L/8.0L)*a[7]*u24*v12 - 1.0L/8.0L*a[7]*u24*v22
-            - 1.0L/3.0L*a[8]*u1*v13 + (1.0L/3.0L)*a[8]*u1*v23 + (1.0L/3.0L)*a[8]*u2*v13 - 1.0L/3.0L*a[8]*u2*v23
-            - 1.0L/6.0L*a[9]*u12*v13 + (1.0L/6.0L)*a[9]*u12*v23 + (1.0L/6.0L)*a[9]*u22*v13 - 1.0L/6.0L*a[9]*u22*v23
-            - 4*w13 *
-            ((1.0L/4.0L)*a[48]*u1*v1 - 1.0L/4.0L*a[48]*u1*v2 - 1.0L/4.0L*a[48]*u2*v1 + (1.0L/4.0L)*a[48]*u2*v2 +
-            (1.0L/8.0L)*a[49]*u12*v1 - 1.0L/8.0L*a[49]*u12*v2 - 1.0L/8.0L*a[49]*u22*v1 + (1.0L/8.0L)*a[49]*u22*v2 +
-            (1.0L/12.0L)*a[50]*u13*v1 - 1.0L/12.0L*a[50]*u13*v2 - 1.0L/12.0L*a[50]*u23*v1 + (1.0L/12.0L)*a[50]*u23*v2 +
-            (1.0L/16.0L)*a[51]*u14*v1 - 1.0L/16.0L*a[51]*u14*v2 - 1.0L/16.0L*a[51]*u24*v1 + (1.0L/16.0L)*a[51]*u24*v2 +
-            (1.0L/8.0L)*a[52]*u1*v12 - 1.0L/8.0L*a[52]*u1*v22 - 1.0L/8.0L*a[52]*u2*v12 + (1.0L/8.0L)*a[52]*u2*v22 +
-            (1.0L/16.0L)*a[53]*u12*v12 - 1.0L/16.0L*a[53]*u12*v22 - 1.0L/16.0L*a[53]*u22*v12 + (1.0L/16.0L)*a[53]*u22*v22 +
-            (1.0L/24.0L)*a[54]*u13*v12 - 1.0L/24.0L*a[54]*u13*v22 - 1.0L/24.0L*a[54]*u23*v12 + (1.0L/24.0L)*a[54]*u23*v22 +
-            (1.0L/32.0L)*a[55]*u14*v12 - 1.0L/32.0L*a[55]*u14*v22 - 1.0L/32.0L*a[55]*u24*v12 + (1.0L/32.0L)*a[55]*u24*v22 +
-            (1.0L/12.0L)*a[56]*u1*v13 - 1.0L/12.0L*a[56]*u1*v23 - 1.0L/12.0L*a[56]*u2*v13 + (1.0L/12.0L)*a[56]*u2*v23 +
-            (1.0L/24.0L)*a[57]*u12*v13 - 1.0L/24.0L*a[57]*u12*v23 - 1.0L/24.0L*a[57]*u22*v13 + (1.0L/24.0L)*a[57]*u22*v23 +
-            (1.0L/36.0L)*a[58]*u13*v13 - 1.0L/36.0L*a[58]*u13*v23 - 1.0L/36.0L*a[58]*u23*v13 + (1.0L/36.0L)*a[58]*u23*v23 +
-            (1.0L/48.0L)*a[59]*u14*v13 - 1.0L/48.0L*a[59]*u14*v23 - 1.0L/48.0L*a[59]*u24*v13 + (1.0L/48.0L)*a[59]*u24*v23 +
-            (1.0L/16.0L)*a[60]*u1*v14 - 1.0L/16.0L*a[60]*u1*v24 - 1.0L/16.0L*a[60]*u2*v14 + (1.0L/16.0L)*a[60]*u2*v24 +
-            (1.0L/32.0L)*a[61]*u12*v14 - 1.0L/32.0L*a[61]*u12*v24 - 1.0L/32.0L*a[61]*u22*v14 + (1.0L/32.0L)*a[61]*u22*v24 +
-            (1.0L/48.0L)*a[62]*u13*v14 - 1.0L/48.0L*a[62]*u13*v24 - 1.0L/48.0L*a[62]*u23*v14 + (1.0L/48.0L)*a[62]*u23*v24 +
-            (1.0L/64.0L)*a[63]*u14*v14 - 1.0L/64.0L*a[63]*u14*v24 - 1.0L/64.0L*a[63]*u24*v14 + (1.0L/64.0L)*a[63]*u24*v24)
-            - 3*w12 *
-            ((1.0L/3.0L)*a[32]*u1*v1 - 1.0L/3.0L*a[32]*u1*v2 - 1.0L/3.0L*a[32]*u2*v1 + (1.0L/3.0L)*a[32]*u2*v2 +
-            (1.0L/6.0L)*a[33]*u12*v1 - 1.0L/6.0L*a[33]*u12*v2 - 1.0L/6.0L*a[33]*u22*v1 + (1.0L/6.0L)*a[33]*u22*v2 +
-            (1.0L/9.0L)*a[34]*u13*v1 - 1.0L/9.0L*a[34]*u13*v2 - 1.0L/9.0L*a[34]*u23*v1 + (1.0L/9.0L)*a[34]*u23*v2 +
-            (1.0L/12.0L)*a[35]*u14*v1 - 1.0L/12.0L*a[35]*u14*v2 - 1.0L/12.0L*a[35]*u24*v1 + (1.0L/12.0L)*a[35]*u24*v2 +
-            (1.0L/6.0L)*a[36]*u1*v12 - 1.0L/6.0L*a[36]*u1*v22 - 1.0L/6.0L*a[36]*u2*v12 + (1.0L/6.0L)*a[36]*u2*v22 +
-            (1.0L/12.0L)*a[37]*u12*v12 - 1.0L/12.0L*a[37]*u12*v22 - 1.0L/12.0L*a[37]*u22*v12 + (1.0L/12.0L)*a[37]*u22*v22 +
-            (1.0L/18.0L)*a[38]*u13*v12 - 1.0L/18.0L*a[38]*u13*v22 - 1.0L/18.0L*a[38]*u23*v12 + (1.0L/18.0L)*a[38]*u23*v22 +
-            (1.0L/24.0L)*a[39]*u14*v12 - 1.0L/24.0L*a[39]*u14*v22 - 1.0L/24.0L*a[39]*u24*v12 + (1.0L/24.0L)*a[39]*u24*v22 +
-            (1.0L/9.0L)*a[40]*u1*v13 - 1.0L/9.0L*a[40]*u1*v23 - 1.0L/9.0L*a[40]*u2*v13 + (1.0L/9.0L)*a[40]*u2*v23 +
-            (1.0L/18.0L)*a[41]*u12*v13 - 1.0L/18.0L*a[41]*u12*v23 - 1.0L/18.0L*a[41]*u22*v13 + (1.0L/18.0L)*a[41]*u22*v23 +
-            (1.0L/27.0L)*a[42]*u13*v13 - 1.0L/27.0L*a[42]*u13*v23 - 1.0L/27.0L*a[42]*u23*v13 + (1.0L/27.0L)*a[42]*u23*v23 +
-            (1.0L/36.0L)*a[43]*u14*v13 - 1.0L/36.0L*a[43]*u14*v23 - 1.0L/36.0L*a[43]*u24*v13 + (1.0L/36.0L)*a[43]*u24*v23 +
-            (1.0L/12.0L)*a[44]*u1*v14 - 1.0L/12.0L*a[44]*u1*v24 - 1.0L/12.0L*a[44]*u2*v14 + (1.0L/12.0L)*a[44]*u2*v24 +
-            (1.0L/24.0L)*a[45]*u12*v14 - 1.0L/24.0L*a[45]*u12*v24 - 1.0L/24.0L*a[45]*u22*v14 + (1.0L/24.0L)*a[45]*u22*v24 +
-            (1.0L/36.0L)*a[46]*u13*v14 - 1.0L/36.0L*a[46]*u13*v24 - 1.0L/36.0L*a[46]*u23*v14 + (1.0L/36.0L)*a[46]*u23*v24 +
-            (1.0L/48.0L)*a[47]*u14*v14 - 1.0L/48.0L*a[47]*u14*v24 - 1.0L/48.0L*a[47]*u24*v14 + (1.0L/48.0L)*a[47]*u24*v24)
-            - 2*w1 *
-            ((1.0L/2.0L)*a[16]*u1*v1 - 1.0L/2.0L*a[16]*u1*v2 - 1.0L/2.0L*a[16]*u2*v1 + (1.0L/2.0L)*a[16]*u2*v2 +
-            (1.0L/4.0L)*a[17]*u12*v1 - 1.0L/4.0L*a[17]*u12*v2 - 1.0L/4.0L*a[17]*u22*v1 + (1.0L/4.0L)*a[17]*u22*v2 +
-            (1.0L/6.0L)*a[18]*u13*v1 - 1.0L/6.0L*a[18]*u13*v2 - 1.0L/6.0L*a[18]*u23*v1 + (1.0L/6.0L)*a[18]*u23*v2 +
-            (1.0L/8.0L)*a[19]*u14*v1 - 1.0L/8.0L*a[19]*u14*v2 - 1.0L/8.0L*a[19]*u24*v1 + (1.0L/8.0L)*a[19]*u24*v2 +
-            (1.0L/4.0L)*a[20]*u1*v12 - 1.0L/4.0L*a[20]*u1*v22 - 1.0L/4.0L*a[20]*u2*v12 + (1.0L/4.0L)*a[20]*u2*v22 +
-            (1.0L/8.0L)*a[21]*u12*v12 - 1.0L/8.0L*a[21]*u12*v22 - 1.0L/8.0L*a[21]*u22*v12 + (1.0L/8.0L)*a[21]*u22*v22 +
-            (1.0L/12.0L)*a[22]*u13*v12 - 1.0L/12.0L*a[22]*u13*v22 - 1.0L/12.0L*a[22]*u23*v12 + (1.0L/12.0L)*a[22]*u23*v22 +
-            (1.0L/16.0L)*a[23]*u14*v12 - 1.0L/16.0L*a[23]*u14*v22 - 1.0L/16.0L*a[23]*u24*v12 + (1.0L/16.0L)*a[23]*u24*v22 +
-            (1.0L/6.0L)*a[24]*u1*v13 - 1.0L/6.0L*a[24]*u1*v23 - 1.0L/6.0L*a[24]*u2*v13 + (1.0L/6.0L)*a[24]*u2*v23 +
-            (1.0L/12.0L)*a[25]*u12*v13 - 1.0L/12.0L*a[25]*u12*v23 - 1.0L/12.0L*a[25]*u22*v13 + (1.0L/12.0L)*a[25]*u22*v23 +
-            (1.0L/18.0L)*a[26]*u13*v13 - 1.0L/18.0L*a[26]*u13*v23 - 1.0L/18.0L*a[26]*u23*v13 + (1.0L/18.0L)*a[26]*u23*v23 +
-            (1.0L/24.0L)*a[27]*u14*v13 - 1.0L/24.0L*a[27]*u14*v23 - 1.0L/24.0L*a[27]*u24*v13 + (1.0L/24.0L)*a[27]*u24*v23 +
-            (1.0L/8.0L)*a[28]*u1*v14 - 1.0L/8.0L*a[28]*u1*v24 - 1.0L/8.0L*a[28]*u2*v14 + (1.0L/8.0L)*a[28]*u2*v24 +
-            (1.0L/16.0L)*a[29]*u12*v14 - 1.0L/16.0L*a[29]*u12*v24 - 1.0L/16.0L*a[29]*u22*v14 + (1.0L/16.0L)*a[29]*u22*v24 +
-            (1.0L/24.0L)*a[30]*u13*v14 - 1.0L/24.0L*a[30]*u13*v24 - 1.0L/24.0L*a[30]*u23*v14 + (1.0L/24.0L)*a[30]*u23*v24 +
-            (1.0L/32.0L)*a[31]*u14*v14 - 1.0L/32.0L*a[31]*u14*v24 - 1.0L/32.0L*a[31]*u24*v14 + (1.0L/32.0L)*a[31]*u24*v24);
-    return G_result;
-
+    double x[4], y[4], z[4];
+    TricubicKernel::moments(x, u1, u2);
+    TricubicKernel::moments(y, v1, v2);
+    TricubicKernel::powers(z, w1);
+    return -TricubicKernel::contract(a, x, y, z);
 }
 
 double Energy::gradientXMaxComponent(const gridreal*& a, double v1, double w1, double u2, double v2, double w2) {
-    double v12 = v1*v1; double v13 = v12*v1; double v14 = v13*v1;
-    double w12 = w1*w1; double w13 = w12*w1; double w14 = w13*w1;
-    double u22 = u2*u2; double u23 = u22*u2;
-    double v22 = v2*v2; double v23 = v22*v2; double v24 = v23*v2;
-    double w22 = w2*w2; double w23 = w22*w2; double w24 = w23*w2;
-    double G_result;
-    G_result =
-            -w14 *
-            (-1.0L/4.0L*a[48]*v1 + (1.0L/4.0L)*a[48]*v2 - 1.0L/4.0L*a[49]*u2*v1 + (1.0L/4.0L)*a[49]*u2*v2 -
-            1.0L/4.0L*a[50]*u22*v1 + (1.0L/4.0L)*a[50]*u22*v2 - 1.0L/4.0L*a[51]*u23*v1 + (1.0L/4.0L)*a[51]*u23*v2 -
-            1.0L/8.0L*a[52]*v12 + (1.0L/8.0L)*a[52]*v22 - 1.0L/8.0L*a[53]*u2*v12 + (1.0L/8.0L)*a[53]*u2*v22 -
-            1.0L/8.0L*a[54]*u22*v12 + (1.0L/8.0L)*a[54]*u22*v22 - 1.0L/8.0L*a[55]*u23*v12 + (1.0L/8.0L)*a[55]*u23*v22 -
-            1.0L/12.0L*a[56]*v13 + (1.0L/12.0L)*a[56]*v23 - 1.0L/12.0L*a[57]*u2*v13 + (1.0L/12.0L)*a[57]*u2*v23 -
-            1.0L/12.0L*a[58]*u22*v13 + (1.0L/12.0L)*a[58]*u22*v23 - 1.0L/12.0L*a[59]*u23*v13 + (1.0L/12.0L)*a[59]*u23*v23 -
-            1.0L/16.0L*a[60]*v14 + (1.0L/16.0L)*a[60]*v24 - 1.0L/16.0L*a[61]*u2*v14 + (1.0L/16.0L)*a[61]*u2*v24 -
-            1.0L/16.0L*a[62]*u22*v14 + (1.0L/16.0L)*a[62]*u22*v24 - 1.0L/16.0L*a[63]*u23*v14 + (1.0L/16.0L)*a[63]*u23*v24)
-            - w13 *
-            (-1.0L/3.0L*a[32]*v1 + (1.0L/3.0L)*a[32]*v2 - 1.0L/3.0L*a[33]*u2*v1 + (1.0L/3.0L)*a[33]*u2*v2 -
-            1.0L/3.0L*a[34]*u22*v1 + (1.0L/3.0L)*a[34]*u22*v2 - 1.0L/3.0L*a[35]*u23*v1 + (1.0L/3.0L)*a[35]*u23*v2 -
-            1.0L/6.0L*a[36]*v12 + (1.0L/6.0L)*a[36]*v22 - 1.0L/6.0L*a[37]*u2*v12 + (1.0L/6.0L)*a[37]*u2*v22 -
-            1.0L/6.0L*a[38]*u22*v12 + (1.0L/6.0L)*a[38]*u22*v22 - 1.0L/6.0L*a[39]*u23*v12 + (1.0L/6.0L)*a[39]*u23*v22 -
-            1.0L/9.0L*a[40]*v13 + (1.0L/9.0L)*a[40]*v23 - 1.0L/9.0L*a[41]*u2*v13 + (1.0L/9.0L)*a[41]*u2*v23 -
-            1.0L/9.0L*a[42]*u22*v13 + (1.0L/9.0L)*a[42]*u22*v23 - 1.0L/9.0L*a[43]*u23*v13 + (1.0L/9.0L)*a[43]*u23*v23 -
-            1.0L/12.0L*a[44]*v14 + (1.0L/12.0L)*a[44]*v24 - 1.0L/12.0L*a[45]*u2*v14 + (1.0L/12.0L)*a[45]*u2*v24 -
-            1.0L/12.0L*a[46]*u22*v14 + (1.0L/12.0L)*a[46]*u22*v24 - 1.0L/12.0L*a[47]*u23*v14 + (1.0L/12.0L)*a[47]*u23*v24)
-            - w12 *
-            (-1.0L/2.0L*a[16]*v1 + (1.0L/2.0L)*a[16]*v2 - 1.0L/2.0L*a[17]*u2*v1 + (1.0L/2.0L)*a[17]*u2*v2 -
-            1.0L/2.0L*a[18]*u22*v1 + (1.0L/2.0L)*a[18]*u22*v2 - 1.0L/2.0L*a[19]*u23*v1 + (1.0L/2.0L)*a[19]*u23*v2 -
-            1.0L/4.0L*a[20]*v12 + (1.0L/4.0L)*a[20]*v22 - 1.0L/4.0L*a[21]*u2*v12 + (1.0L/4.0L)*a[21]*u2*v22 -
-            1.0L/4.0L*a[22]*u22*v12 + (1.0L/4.0L)*a[22]*u22*v22 - 1.0L/4.0L*a[23]*u23*v12 + (1.0L/4.0L)*a[23]*u23*v22 -
-            1.0L/6.0L*a[24]*v13 + (1.0L/6.0L)*a[24]*v23 - 1.0L/6.0L*a[25]*u2*v13 + (1.0L/6.0L)*a[25]*u2*v23 -
-            1.0L/6.0L*a[26]*u22*v13 + (1.0L/6.0L)*a[26]*u22*v23 - 1.0L/6.0L*a[27]*u23*v13 + (1.0L/6.0L)*a[27]*u23*v23 -
-            1.0L/8.0L*a[28]*v14 + (1.0L/8.0L)*a[28]*v24 - 1.0L/8.0L*a[29]*u2*v14 + (1.0L/8.0L)*a[29]*u2*v24 -
-            1.0L/8.0L*a[30]*u22*v14 + (1.0L/8.0L)*a[30]*u22*v24 - 1.0L/8.0L*a[31]*u23*v14 + (1.0L/8.0L)*a[31]*u23*v24)
-            - w1 *
-            (-a[0]*v1 + a[0]*v2 - a[1]*u2*v1 + a[1]*u2*v2 -
-            1.0L/3.0L*a[10]*u22*v13 + (1.0L/3.0L)*a[10]*u22*v23 - 1.0L/3.0L*a[11]*u23*v13 + (1.0L/3.0L)*a[11]*u23*v23 -
-            1.0L/4.0L*a[12]*v14 + (1.0L/4.0L)*a[12]*v24 - 1.0L/4.0L*a[13]*u2*v14 + (1.0L/4.0L)*a[13]*u2*v24 -
-            1.0L/4.0L*a[14]*u22*v14 + (1.0L/4.0L)*a[14]*u22*v24 - 1.0L/4.0L*a[15]*u23*v14 + (1.0L/4.0L)*a[15]*u23*v24 -
-            a[2]*u22*v1 + a[2]*u22*v2 - a[3]*u23*v1 + a[3]*u23*v2 -
-            1.0L/2.0L*a[4]*v12 + (1.0L/2.0L)*a[4]*v22 - 1.0L/2.0L*a[5]*u2*v12 + (1.0L/2.0L)*a[5]*u2*v22 -
-            1.0L/2.0L*a[6]*u22*v12 + (1.0L/2.0L)*a[6]*u22*v22 - 1.0L/2.0L*a[7]*u23*v12 + (1.0L/2.0L)*a[7]*u23*v22 -
-            1.0L/3.0L*a[8]*v13 + (1.0L/3.0L)*a[8]*v23 - 1.0L/3.0L*a[9]*u2*v13 + (1.0L/3.0L)*a[9]*u2*v23)
-            + w24 *
-            (-1.0L/4.0L*a[48]*v1 + (1.0L/4.0L)*a[48]*v2 - 1.0L/4.0L*a[49]*u2*v1 + (1.0L/4.0L)*a[49]*u2*v2 -
-            1.0L/4.0L*a[50]*u22*v1 + (1.0L/4.0L)*a[50]*u22*v2 - 1.0L/4.0L*a[51]*u23*v1 + (1.0L/4.0L)*a[51]*u23*v2 -
-            1.0L/8.0L*a[52]*v12 + (1.0L/8.0L)*a[52]*v22 - 1.0L/8.0L*a[53]*u2*v12 + (1.0L/8.0L)*a[53]*u2*v22 -
-            1.0L/8.0L*a[54]*u22*v12 + (1.0L/8.0L)*a[54]*u22*v22 - 1.0L/8.0L*a[55]*u23*v12 + (1.0L/8.0L)*a[55]*u23*v22 -
-            1.0L/12.0L*a[56]*v13 + (1.0L/12.0L)*a[56]*v23 - 1.0L/12.0L*a[57]*u2*v13 + (1.0L/12.0L)*a[57]*u2*v23 -
-            1.0L/12.0L*a[58]*u22*v13 + (1.0L/12.0L)*a[58]*u22*v23 - 1.0L/12.0L*a[59]*u23*v13 + (1.0L/12.0L)*a[59]*u23*v23 -
-            1.0L/16.0L*a[60]*v14 + (1.0L/16.0L)*a[60]*v24 - 1.0L/16.0L*a[61]*u2*v14 + (1.0L/16.0L)*a[61]*u2*v24 -
-            1.0L/16.0L*a[62]*u22*v14 + (1.0L/16.0L)*a[62]*u22*v24 - 1.0L/16.0L*a[63]*u23*v14 + (1.0L/16.0L)*a[63]*u23*v24)
-            + w23 *
-            (-1.0L/3.0L*a[32]*v1 + (1.0L/3.0L)*a[32]*v2 - 1.0L/3.0L*a[33]*u2*v1 + (1.0L/3.0L)*a[33]*u2*v2 -
-            1.0L/3.0L*a[34]*u22*v1 + (1.0L/3.0L)*a[34]*u22*v2 - 1.0L/3.0L*a[35]*u23*v1 + (1.0L/3.0L)*a[35]*u23*v2 -
-            1.0L/6.0L*a[36]*v12 + (1.0L/6.0L)*a[36]*v22 - 1.0L/6.0L*a[37]*u2*v12 + (1.0L/6.0L)*a[37]*u2*v22 -
-            1.0L/6.0L*a[38]*u22*v12 + (1.0L/6.0L)*a[38]*u22*v22 - 1.0L/6.0L*a[39]*u23*v12 + (1.0L/6.0L)*a[39]*u23*v22 -
-            1.0L/9.0L*a[40]*v13 + (1.0L/9.0L)*a[40]*v23 - 1.0L/9.0L*a[41]*u2*v13 + (1.0L/9.0L)*a[41]*u2*v23 -
-            1.0L/9.0L*a[42]*u22*v13 + (1.0L/9.0L)*a[42]*u22*v23 - 1.0L/9.0L*a[43]*u23*v13 + (1.0L/9.0L)*a[43]*u23*v23 -
-            1.0L/12.0L*a[44]*v14 + (1.0L/12.0L)*a[44]*v24 - 1.0L/12.0L*a[45]*u2*v14 + (1.0L/12.0L)*a[45]*u2*v24 -
-            1.0L/12.0L*a[46]*u22*v14 + (1.0L/12.0L)*a[46]*u22*v24 - 1.0L/12.0L*a[47]*u23*v14 + (1.0L/12.0L)*a[47]*u23*v24)
-            + w22 *
-            (-1.0L/2.0L*a[16]*v1 + (1.0L/2.0L)*a[16]*v2 - 1.0L/2.0L*a[17]*u2*v1 + (1.0L/2.0L)*a[17]*u2*v2 -
-            1.0L/2.0L*a[18]*u22*v1 + (1.0L/2.0L)*a[18]*u22*v2 - 1.0L/2.0L*a[19]*u23*v1 + (1.0L/2.0L)*a[19]*u23*v2 -
-            1.0L/4.0L*a[20]*v12 + (1.0L/4.0L)*a[20]*v22 - 1.0L/4.0L*a[21]*u2*v12 + (1.0L/4.0L)*a[21]*u2*v22 -
-            1.0L/4.0L*a[22]*u22*v12 + (1.0L/4.0L)*a[22]*u22*v22 - 1.0L/4.0L*a[23]*u23*v12 + (1.0L/4.0L)*a[23]*u23*v22 -
-            1.0L/6.0L*a[24]*v13 + (1.0L/6.0L)*a[24]*v23 - 1.0L/6.0L*a[25]*u2*v13 + (1.0L/6.0L)*a[25]*u2*v23 -
-            1.0L/6.0L*a[26]*u22*v13 + (1.0L/6.0L)*a[26]*u22*v23 - 1.0L/6.0L*a[27]*u23*v13 + (1.0L/6.0L)*a[27]*u23*v23 -
-            1.0L/8.0L*a[28]*v14 + (1.0L/8.0L)*a[28]*v24 - 1.0L/8.0L*a[29]*u2*v14 + (1.0L/8.0L)*a[29]*u2*v24 -
-            1.0L/8.0L*a[30]*u22*v14 + (1.0L/8.0L)*a[30]*u22*v24 - 1.0L/8.0L*a[31]*u23*v14 + (1.0L/8.0L)*a[31]*u23*v24)
-            + w2 *
-            (-a[0]*v1 + a[0]*v2 - a[1]*u2*v1 + a[1]*u2*v2 -
-            1.0L/3.0L*a[10]*u22*v13 + (1.0L/3.0L)*a[10]*u22*v23 - 1.0L/3.0L*a[11]*u23*v13 + (1.0L/3.0L)*a[11]*u23*v23 -
-            1.0L/4.0L*a[12]*v14 + (1.0L/4.0L)*a[12]*v24 - 1.0L/4.0L*a[13]*u2*v14 + (1.0L/4.0L)*a[13]*u2*v24 -
-            1.0L/4.0L*a[14]*u22*v14 + (1.0L/4.0L)*a[14]*u22*v24 - 1.0L/4.0L*a[15]*u23*v14 + (1.0L/4.0L)*a[15]*u23*v24 -
-            a[2]*u22*v1 + a[2]*u22*v2 - a[3]*u23*v1 + a[3]*u23*v2 -
-            1.0L/2.0L*a[4]*v12 + (1.0L/2.0L)*a[4]*v22 - 1.0L/2.0L*a[5]*u2*v12 + (1.0L/2.0L)*a[5]*u2*v22 -
-            1.0L/2.0L*a[6]*u22*v12 + (1.0L/2.0L)*a[6]*u22*v22 - 1.0L/2.0L*a[7]*u23*v12 + (1.0L/2.0L)*a[7]*u23*v22 -
-            1.0L/3.0L*a[8]*v13 + (1.0L/3.0L)*a[8]*v23 - 1.0L/3.0L*a[9]*u2*v13 + (1.0L/3.0L)*a[9]*u2*v23);
-    return G_result;
+    double x[4], y[4], z[4];
+    TricubicKernel::powers(x, u2);
+    TricubicKernel::moments(y, v1, v2);
+    TricubicKernel::moments(z, w1, w2);
+    return TricubicKernel::contract(a, x, y, z);
 }
 
 double Energy::gradientYMaxComponent(const gridreal*& a, double u1, double w1, double u2, double v2, double w2) {
-    double u12 = u1*u1; double u13 = u12*u1; double u14 = u13*u1;
-    double w12 = w1*w1; double w13 = w12*w1; double w14 = w13*w1;
-    double u22 = u2*u2; double u23 = u22*u2; double u24 = u23*u2;
-    double v22 = v2*v2; double v23 = v22*v2;
-    double w22 = w2*w2; double w23 = w22*w2; double w24 = w23*w2;
-    double G_result;
-    G_result =
-            -w14 *
-            (-1.0L/4.0L*a[48]*u1 + (1.0L/4.0L)*a[48]*u2 - 1.0L/8.0L*a[49]*u12 + (1.0L/8.0L)*a[49]*u22 -
-            1.0L/12.0L*a[50]*u13 + (1.0L/12.0L)*a[50]*u23 - 1.0L/16.0L*a[51]*u14 + (1.0L/16.0L)*a[51]*u24 -
-            1.0L/4.0L*a[52]*u1*v2 + (1.0L/4.0L)*a[52]*u2*v2 - 1.0L/8.0L*a[53]*u12*v2 + (1.0L/8.0L)*a[53]*u22*v2 -
-            1.0L/12.0L*a[54]*u13*v2 + (1.0L/12.0L)*a[54]*u23*v2 - 1.0L/16.0L*a[55]*u14*v2 + (1.0L/16.0L)*a[55]*u24*v2 -
-            1.0L/4.0L*a[56]*u1*v22 + (1.0L/4.0L)*a[56]*u2*v22 - 1.0L/8.0L*a[57]*u12*v22 + (1.0L/8.0L)*a[57]*u22*v22 -
-            1.0L/12.0L*a[58]*u13*v22 + (1.0L/12.0L)*a[58]*u23*v22 - 1.0L/16.0L*a[59]*u14*v22 + (1.0L/16.0L)*a[59]*u24*v22 -
-            1.0L/4.0L*a[60]*u1*v23 + (1.0L/4.0L)*a[60]*u2*v23 - 1.0L/8.0L*a[61]*u12*v23 + (1.0L/8.0L)*a[61]*u22*v23 -
-            1.0L/12.0L*a[62]*u13*v23 + (1.0L/12.0L)*a[62]*u23*v23 - 1.0L/16.0L*a[63]*u14*v23 + (1.0L/16.0L)*a[63]*u24*v23)
-            - w13 *
-            (-1.0L/3.0L*a[32]*u1 + (1.0L/3.0L)*a[32]*u2 - 1.0L/6.0L*a[33]*u12 + (1.0L/6.0L)*a[33]*u22 -
-            1.0L/9.0L*a[34]*u13 + (1.0L/9.0L)*a[34]*u23 - 1.0L/12.0L*a[35]*u14 + (1.0L/12.0L)*a[35]*u24 -
-            1.0L/3.0L*a[36]*u1*v2 + (1.0L/3.0L)*a[36]*u2*v2 - 1.0L/6.0L*a[37]*u12*v2 + (1.0L/6.0L)*a[37]*u22*v2 -
-            1.0L/9.0L*a[38]*u13*v2 + (1.0L/9.0L)*a[38]*u23*v2 - 1.0L/12.0L*a[39]*u14*v2 + (1.0L/12.0L)*a[39]*u24*v2 -
-            1.0L/3.0L*a[40]*u1*v22 + (1.0L/3.0L)*a[40]*u2*v22 - 1.0L/6.0L*a[41]*u12*v22 + (1.0L/6.0L)*a[41]*u22*v22 -
-            1.0L/9.0L*a[42]*u13*v22 + (1.0L/9.0L)*a[42]*u23*v22 - 1.0L/12.0L*a[43]*u14*v22 + (1.0L/12.0L)*a[43]*u24*v22 -
-            1.0L/3.0L*a[44]*u1*v23 + (1.0L/3.0L)*a[44]*u2*v23 - 1.0L/6.0L*a[45]*u12*v23 + (1.0L/6.0L)*a[45]*u22*v23 -
-            1.0L/9.0L*a[46]*u13*v23 + (1.0L/9.0L)*a[46]*u23*v23 - 1.0L/12.0L*a[47]*u14*v23 + (1.0L/12.0L)*a[47]*u24*v23)
-            - w12 *
-            (-1.0L/2.0L*a[16]*u1 + (1.0L/2.0L)*a[16]*u2 - 1.0L/4.0L*a[17]*u12 + (1.0L/4.0L)*a[17]*u22 -
-            1.0L/6.0L*a[18]*u13 + (1.0L/6.0L)*a[18]*u23 - 1.0L/8.0L*a[19]*u14 + (1.0L/8.0L)*a[19]*u24 -
-            1.0L/2.0L*a[20]*u1*v2 + (1.0L/2.0L)*a[20]*u2*v2 - 1.0L/4.0L*a[21]*u12*v2 + (1.0L/4.0L)*a[21]*u22*v2 -
-            1.0L/6.0L*a[22]*u13*v2 + (1.0L/6.0L)*a[22]*u23*v2 - 1.0L/8.0L*a[23]*u14*v2 + (1.0L/8.0L)*a[23]*u24*v2 -
-            1.0L/2.0L*a[24]*u1*v22 + (1.0L/2.0L)*a[24]*u2*v22 - 1.0L/4.0L*a[25]*u12*v22 + (1.0L/4.0L)*a[25]*u22*v22 -
-            1.0L/6.0L*a[26]*u13*v22 + (1.0L/6.0L)*a[26]*u23*v22 - 1.0L/8.0L*a[27]*u14*v22 + (1.0L/8.0L)*a[27]*u24*v22 -
-            1.0L/2.0L*a[28]*u1*v23 + (1.0L/2.0L)*a[28]*u2*v23 - 1.0L/4.0L*a[29]*u12*v23 + (1.0L/4.0L)*a[29]*u22*v23 -
-            1.0L/6.0L*a[30]*u13*v23 + (1.0L/6.0L)*a[30]*u23*v23 - 1.0L/8.0L*a[31]*u14*v23 + (1.0L/8.0L)*a[31]*u24*v23)
-            - w1 *
-            (-a[0]*u1 + a[0]*u2 - 1.0L/2.0L*a[1]*u12 + (1.0L/2.0L)*a[1]*u22 -
-            1.0L/3.0L*a[10]*u13*v22 + (1.0L/3.0L)*a[10]*u23*v22 - 1.0L/4.0L*a[11]*u14*v22 + (1.0L/4.0L)*a[11]*u24*v22 -
-            a[12]*u1*v23 + a[12]*u2*v23 - 1.0L/2.0L*a[13]*u12*v23 + (1.0L/2.0L)*a[13]*u22*v23 -
-            1.0L/3.0L*a[14]*u13*v23 + (1.0L/3.0L)*a[14]*u23*v23 - 1.0L/4.0L*a[15]*u14*v23 + (1.0L/4.0L)*a[15]*u24*v23 -
-            1.0L/3.0L*a[2]*u13 + (1.0L/3.0L)*a[2]*u23 - 1.0L/4.0L*a[3]*u14 + (1.0L/4.0L)*a[3]*u24 -
-            a[4]*u1*v2 + a[4]*u2*v2 -  1.0L/2.0L*a[5]*u12*v2 + (1.0L/2.0L)*a[5]*u22*v2 -
-            1.0L/3.0L*a[6]*u13*v2 + (1.0L/3.0L)*a[6]*u23*v2 - 1.0L/4.0L*a[7]*u14*v2 + (1.0L/4.0L)*a[7]*u24*v2 -
-            a[8]*u1*v22 + a[8]*u2*v22 - 1.0L/2.0L*a[9]*u12*v22 + (1.0L/2.0L)*a[9]*u22*v22)
-            + w24 *
-            (-1.0L/4.0L*a[48]*u1 + (1.0L/4.0L)*a[48]*u2 - 1.0L/8.0L*a[49]*u12 + (1.0L/8.0L)*a[49]*u22 -
-            1.0L/12.0L*a[50]*u13 + (1.0L/12.0L)*a[50]*u23 - 1.0L/16.0L*a[51]*u14 + (1.0L/16.0L)*a[51]*u24 -
-            1.0L/4.0L*a[52]*u1*v2 + (1.0L/4.0L)*a[52]*u2*v2 - 1.0L/8.0L*a[53]*u12*v2 + (1.0L/8.0L)*a[53]*u22*v2 -
-            1.0L/12.0L*a[54]*u13*v2 + (1.0L/12.0L)*a[54]*u23*v2 - 1.0L/16.0L*a[55]*u14*v2 + (1.0L/16.0L)*a[55]*u24*v2 -
-            1.0L/4.0L*a[56]*u1*v22 + (1.0L/4.0L)*a[56]*u2*v22 - 1.0L/8.0L*a[57]*u12*v22 + (1.0L/8.0L)*a[57]*u22*v22 -
-            1.0L/12.0L*a[58]*u13*v22 + (1.0L/12.0L)*a[58]*u23*v22 - 1.0L/16.0L*a[59]*u14*v22 + (1.0L/16.0L)*a[59]*u24*v22 -
-            1.0L/4.0L*a[60]*u1*v23 + (1.0L/4.0L)*a[60]*u2*v23 - 1.0L/8.0L*a[61]*u12*v23 + (1.0L/8.0L)*a[61]*u22*v23 -
-            1.0L/12.0L*a[62]*u13*v23 + (1.0L/12.0L)*a[62]*u23*v23 - 1.0L/16.0L*a[63]*u14*v23 + (1.0L/16.0L)*a[63]*u24*v23)
-            + w23 *
-            (-1.0L/3.0L*a[32]*u1 + (1.0L/3.0L)*a[32]*u2 - 1.0L/6.0L*a[33]*u12 + (1.0L/6.0L)*a[33]*u22 -
-            1.0L/9.0L*a[34]*u13 + (1.0L/9.0L)*a[34]*u23 - 1.0L/12.0L*a[35]*u14 + (1.0L/12.0L)*a[35]*u24 -
-            1.0L/3.0L*a[36]*u1*v2 + (1.0L/3.0L)*a[36]*u2*v2 - 1.0L/6.0L*a[37]*u12*v2 + (1.0L/6.0L)*a[37]*u22*v2 -
-            1.0L/9.0L*a[38]*u13*v2 + (1.0L/9.0L)*a[38]*u23*v2 - 1.0L/12.0L*a[39]*u14*v2 + (1.0L/12.0L)*a[39]*u24*v2 -
-            1.0L/3.0L*a[40]*u1*v22 + (1.0L/3.0L)*a[40]*u2*v22 - 1.0L/6.0L*a[41]*u12*v22 + (1.0L/6.0L)*a[41]*u22*v22 -
-            1.0L/9.0L*a[42]*u13*v22 + (1.0L/9.0L)*a[42]*u23*v22 - 1.0L/12.0L*a[43]*u14*v22 + (1.0L/12.0L)*a[43]*u24*v22 -
-            1.0L/3.0L*a[44]*u1*v23 + (1.0L/3.0L)*a[44]*u2*v23 - 1.0L/6.0L*a[45]*u12*v23 + (1.0L/6.0L)*a[45]*u22*v23 -
-            1.0L/9.0L*a[46]*u13*v23 + (1.0L/9.0L)*a[46]*u23*v23 - 1.0L/12.0L*a[47]*u14*v23 + (1.0L/12.0L)*a[47]*u24*v23)
-            + w22 *
-            (-1.0L/2.0L*a[16]*u1 + (1.0L/2.0L)*a[16]*u2 - 1.0L/4.0L*a[17]*u12 + (1.0L/4.0L)*a[17]*u22 -
-            1.0L/6.0L*a[18]*u13 + (1.0L/6.0L)*a[18]*u23 - 1.0L/8.0L*a[19]*u14 + (1.0L/8.0L)*a[19]*u24 -
-            1.0L/2.0L*a[20]*u1*v2 + (1.0L/2.0L)*a[20]*u2*v2 - 1.0L/4.0L*a[21]*u12*v2 + (1.0L/4.0L)*a[21]*u22*v2 -
-            1.0L/6.0L*a[22]*u13*v2 + (1.0L/6.0L)*a[22]*u23*v2 - 1.0L/8.0L*a[23]*u14*v2 + (1.0L/8.0L)*a[23]*u24*v2 -
-            1.0L/2.0L*a[24]*u1*v22 + (1.0L/2.0L)*a[24]*u2*v22 - 1.0L/4.0L*a[25]*u12*v22 + (1.0L/4.0L)*a[25]*u22*v22 -
-            1.0L/6.0L*a[26]*u13*v22 + (1.0L/6.0L)*a[26]*u23*v22 - 1.0L/8.0L*a[27]*u14*v22 + (1.0L/8.0L)*a[27]*u24*v22 -
-            1.0L/2.0L*a[28]*u1*v23 + (1.0L/2.0L)*a[28]*u2*v23 - 1.0L/4.0L*a[29]*u12*v23 + (1.0L/4.0L)*a[29]*u22*v23 -
-            1.0L/6.0L*a[30]*u13*v23 + (1.0L/6.0L)*a[30]*u23*v23 - 1.0L/8.0L*a[31]*u14*v23 + (1.0L/8.0L)*a[31]*u24*v23)
-            + w2 *
-            (-a[0]*u1 + a[0]*u2 - 1.0L/2.0L*a[1]*u12 + (1.0L/2.0L)*a[1]*u22 -
-            1.0L/3.0L*a[10]*u13*v22 + (1.0L/3.0L)*a[10]*u23*v22 - 1.0L/4.0L*a[11]*u14*v22 + (1.0L/4.0L)*a[11]*u24*v22 -
-            a[12]*u1*v23 + a[12]*u2*v23 - 1.0L/2.0L*a[13]*u12*v23 + (1.0L/2.0L)*a[13]*u22*v23 -
-            1.0L/3.0L*a[14]*u13*v23 + (1.0L/3.0L)*a[14]*u23*v23 - 1.0L/4.0L*a[15]*u14*v23 + (1.0L/4.0L)*a[15]*u24*v23 -
-            1.0L/3.0L*a[2]*u13 + (1.0L/3.0L)*a[2]*u23 - 1.0L/4.0L*a[3]*u14 + (1.0L/4.0L)*a[3]*u24
-            - a[4]*u1*v2 + a[4]*u2*v2 - 1.0L/2.0L*a[5]*u12*v2 + (1.0L/2.0L)*a[5]*u22*v2 -
-            1.0L/3.0L*a[6]*u13*v2 + (1.0L/3.0L)*a[6]*u23*v2 - 1.0L/4.0L*a[7]*u14*v2 + (1.0L/4.0L)*a[7]*u24*v2 -
-            a[8]*u1*v22 + a[8]*u2*v22 - 1.0L/2.0L*a[9]*u12*v22 + (1.0L/2.0L)*a[9]*u22*v22);
-    return G_result;
+    double x[4], y[4], z[4];
+    TricubicKernel::moments(x, u1, u2);
+    TricubicKernel::powers(y, v2);
+    TricubicKernel::moments(z, w1, w2);
+    return TricubicKernel::contract(a, x, y, z);
 }
 
 double Energy::gradientZMaxComponent(const gridreal*& a, double u1, double v1, double u2, double v2, double w2) {
-    double u12 = u1*u1; double u13 = u12*u1; double u14 = u13*u1;
-    double v12 = v1*v1; double v13 = v12*v1; double v14 = v13*v1;
-    double u22 = u2*u2; double u23 = u22*u2; double u24 = u23*u2;
-    double v22 = v2*v2; double v23 = v22*v2; double v24 = v23*v2;
-    double w22 = w2*w2; double w23 = w22*w2;
-    double G_result;
-    G_result =
-            a[0]*u1*v1 - a[0]*u1*v2 - a[0]*u2*v1 + a[0]*u2*v2 +
-            (1.0L/2.0L)*a[1]*u12*v1 - 1.0L/2.0L*a[1]*u12*v2 - 1.0L/2.0L*a[1]*u22*v1 + (1.0L/2.0L)*a[1]*u22*v2 +
-            (1.0L/9.0L)*a[10]*u13*v13 - 1.0L/9.0L*a[10]*u13*v23 - 1.0L/9.0L*a[10]*u23*v13 + (1.0L/9.0L)*a[10]*u23*v23 +
-            (1.0L/12.0L)*a[11]*u14*v13 - 1.0L/12.0L*a[11]*u14*v23 - 1.0L/12.0L*a[11]*u24*v13 + (1.0L/12.0L)*a[11]*u24*v23 +
-            (1.0L/4.0L)*a[12]*u1*v14 - 1.0L/4.0L*a[12]*u1*v24 - 1.0L/4.0L*a[12]*u2*v14 + (1.0L/4.0L)*a[12]*u2*v24 +
-            (1.0L/8.0L)*a[13]*u12*v14 - 1.0L/8.0L*a[13]*u12*v24 - 1.0L/8.0L*a[13]*u22*v14 + (1.0L/8.0L)*a[13]*u22*v24 +
-            (1.0L/12.0L)*a[14]*u13*v14 - 1.0L/12.0L*a[14]*u13*v24 - 1.0L/12.0L*a[14]*u23*v14 + (1.0L/12.0L)*a[14]*u23*v24 +
-            (1.0L/16.0L)*a[15]*u14*v14 - 1.0L/16.0L*a[15]*u14*v24 - 1.0L/16.0L*a[15]*u24*v14 + (1.0L/16.0L)*a[15]*u24*v24 +
-            (1.0L/3.0L)*a[2]*u13*v1 - 1.0L/3.0L*a[2]*u13*v2 - 1.0L/3.0L*a[2]*u23*v1 + (1.0L/3.0L)*a[2]*u23*v2 +
-            (1.0L/4.0L)*a[3]*u14*v1 - 1.0L/4.0L*a[3]*u14*v2 - 1.0L/4.0L*a[3]*u24*v1 + (1.0L/4.0L)*a[3]*u24*v2 +
-            (1.0L/2.0L)*a[4]*u1*v12 - 1.0L/2.0L*a[4]*u1*v22 - 1.0L/2.0L*a[4]*u2*v12 + (1.0L/2.0L)*a[4]*u2*v22 +
-            (1.0L/4.0L)*a[5]*u12*v12 - 1.0L/4.0L*a[5]*u12*v22 - 1.0L/4.0L*a[5]*u22*v12 + (1.0L/4.0L)*a[5]*u22*v22 +
-            (1.0L/6.0L)*a[6]*u13*v12 - 1.0L/6.0L*a[6]*u13*v22 - 1.0L/6.0L*a[6]*u23*v12 + (1.0L/6.0L)*a[6]*u23*v22 +
-            (1.0L/8.0L)*a[7]*u14*v12 - 1.0L/8.0L*a[7]*u14*v22 - 1.0L/8.0L*a[7]*u24*v12 + (1.0L/8.0L)*a[7]*u24*v22 +
-            (1.0L/3.0L)*a[8]*u1*v13 - 1.0L/3.0L*a[8]*u1*v23 - 1.0L/3.0L*a[8]*u2*v13 + (1.0L/3.0L)*a[8]*u2*v23 +
-            (1.0L/6.0L)*a[9]*u12*v13 - 1.0L/6.0L*a[9]*u12*v23 - 1.0L/6.0L*a[9]*u22*v13 + (1.0L/6.0L)*a[9]*u22*v23 +
-            4*w23 *
-            ((1.0L/4.0L)*a[48]*u1*v1 - 1.0L/4.0L*a[48]*u1*v2 - 1.0L/4.0L*a[48]*u2*v1 + (1.0L/4.0L)*a[48]*u2*v2 +
-            (1.0L/8.0L)*a[49]*u12*v1 - 1.0L/8.0L*a[49]*u12*v2 - 1.0L/8.0L*a[49]*u22*v1 + (1.0L/8.0L)*a[49]*u22*v2 +
-            (1.0L/12.0L)*a[50]*u13*v1 - 1.0L/12.0L*a[50]*u13*v2 - 1.0L/12.0L*a[50]*u23*v1 + (1.0L/12.0L)*a[50]*u23*v2 +
-            (1.0L/16.0L)*a[51]*u14*v1 - 1.0L/16.0L*a[51]*u14*v2 - 1.0L/16.0L*a[51]*u24*v1 + (1.0L/16.0L)*a[51]*u24*v2 +
-            (1.0L/8.0L)*a[52]*u1*v12 - 1.0L/8.0L*a[52]*u1*v22 - 1.0L/8.0L*a[52]*u2*v12 + (1.0L/8.0L)*a[52]*u2*v22 +
-            (1.0L/16.0L)*a[53]*u12*v12 - 1.0L/16.0L*a[53]*u12*v22 - 1.0L/16.0L*a[53]*u22*v12 + (1.0L/16.0L)*a[53]*u22*v22 +
-            (1.0L/24.0L)*a[54]*u13*v12 - 1.0L/24.0L*a[54]*u13*v22 - 1.0L/24.0L*a[54]*u23*v12 + (1.0L/24.0L)*a[54]*u23*v22 +
-            (1.0L/32.0L)*a[55]*u14*v12 - 1.0L/32.0L*a[55]*u14*v22 - 1.0L/32.0L*a[55]*u24*v12 + (1.0L/32.0L)*a[55]*u24*v22 +
-            (1.0L/12.0L)*a[56]*u1*v13 - 1.0L/12.0L*a[56]*u1*v23 - 1.0L/12.0L*a[56]*u2*v13 + (1.0L/12.0L)*a[56]*u2*v23 +
-            (1.0L/24.0L)*a[57]*u12*v13 - 1.0L/24.0L*a[57]*u12*v23 - 1.0L/24.0L*a[57]*u22*v13 + (1.0L/24.0L)*a[57]*u22*v23 +
-            (1.0L/36.0L)*a[58]*u13*v13 - 1.0L/36.0L*a[58]*u13*v23 - 1.0L/36.0L*a[58]*u23*v13 + (1.0L/36.0L)*a[58]*u23*v23 +
-            (1.0L/48.0L)*a[59]*u14*v13 - 1.0L/48.0L*a[59]*u14*v23 - 1.0L/48.0L*a[59]*u24*v13 + (1.0L/48.0L)*a[59]*u24*v23 +
-            (1.0L/16.0L)*a[60]*u1*v14 - 1.0L/16.0L*a[60]*u1*v24 - 1.0L/16.0L*a[60]*u2*v14 + (1.0L/16.0L)*a[60]*u2*v24 +
-            (1.0L/32.0L)*a[61]*u12*v14 - 1.0L/32.0L*a[61]*u12*v24 - 1.0L/32.0L*a[61]*u22*v14 + (1.0L/32.0L)*a[61]*u22*v24 +
-            (1.0L/48.0L)*a[62]*u13*v14 - 1.0L/48.0L*a[62]*u13*v24 - 1.0L/48.0L*a[62]*u23*v14 + (1.0L/48.0L)*a[62]*u23*v24 +
-            (1.0L/64.0L)*a[63]*u14*v14 - 1.0L/64.0L*a[63]*u14*v24 - 1.0L/64.0L*a[63]*u24*v14 + (1.0L/64.0L)*a[63]*u24*v24)
-            + 3*w22 *
-            ((1.0L/3.0L)*a[32]*u1*v1 - 1.0L/3.0L*a[32]*u1*v2 - 1.0L/3.0L*a[32]*u2*v1 + (1.0L/3.0L)*a[32]*u2*v2 +
-            (1.0L/6.0L)*a[33]*u12*v1 - 1.0L/6.0L*a[33]*u12*v2 - 1.0L/6.0L*a[33]*u22*v1 + (1.0L/6.0L)*a[33]*u22*v2 +
-            (1.0L/9.0L)*a[34]*u13*v1 - 1.0L/9.0L*a[34]*u13*v2 - 1.0L/9.0L*a[34]*u23*v1 + (1.0L/9.0L)*a[34]*u23*v2 +
-            (1.0L/12.0L)*a[35]*u14*v1 - 1.0L/12.0L*a[35]*u14*v2 - 1.0L/12.0L*a[35]*u24*v1 + (1.0L/12.0L)*a[35]*u24*v2 +
-            (1.0L/6.0L)*a[36]*u1*v12 - 1.0L/6.0L*a[36]*u1*v22 - 1.0L/6.0L*a[36]*u2*v12 + (1.0L/6.0L)*a[36]*u2*v22 +
-            (1.0L/12.0L)*a[37]*u12*v12 - 1.0L/12.0L*a[37]*u12*v22 - 1.0L/12.0L*a[37]*u22*v12 + (1.0L/12.0L)*a[37]*u22*v22 +
-            (1.0L/18.0L)*a[38]*u13*v12 - 1.0L/18.0L*a[38]*u13*v22 - 1.0L/18.0L*a[38]*u23*v12 + (1.0L/18.0L)*a[38]*u23*v22 +
-            (1.0L/24.0L)*a[39]*u14*v12 - 1.0L/24.0L*a[39]*u14*v22 - 1.0L/24.0L*a[39]*u24*v12 + (1.0L/24.0L)*a[39]*u24*v22 +
-            (1.0L/9.0L)*a[40]*u1*v13 - 1.0L/9.0L*a[40]*u1*v23 - 1.0L/9.0L*a[40]*u2*v13 + (1.0L/9.0L)*a[40]*u2*v23 +
-            (1.0L/18.0L)*a[41]*u12*v13 - 1.0L/18.0L*a[41]*u12*v23 - 1.0L/18.0L*a[41]*u22*v13 + (1.0L/18.0L)*a[41]*u22*v23 +
-            (1.0L/27.0L)*a[42]*u13*v13 - 1.0L/27.0L*a[42]*u13*v23 - 1.0L/27.0L*a[42]*u23*v13 + (1.0L/27.0L)*a[42]*u23*v23 +
-            (1.0L/36.0L)*a[43]*u14*v13 - 1.0L/36.0L*a[43]*u14*v23 - 1.0L/36.0L*a[43]*u24*v13 + (1.0L/36.0L)*a[43]*u24*v23 +
-            (1.0L/12.0L)*a[44]*u1*v14 - 1.0L/12.0L*a[44]*u1*v24 - 1.0L/12.0L*a[44]*u2*v14 + (1.0L/12.0L)*a[44]*u2*v24 +
-            (1.0L/24.0L)*a[45]*u12*v14 - 1.0L/24.0L*a[45]*u12*v24 - 1.0L/24.0L*a[45]*u22*v14 + (1.0L/24.0L)*a[45]*u22*v24 +
-            (1.0L/36.0L)*a[46]*u13*v14 - 1.0L/36.0L*a[46]*u13*v24 - 1.0L/36.0L*a[46]*u23*v14 + (1.0L/36.0L)*a[46]*u23*v24 +
-            (1.0L/48.0L)*a[47]*u14*v14 - 1.0L/48.0L*a[47]*u14*v24 - 1.0L/48.0L*a[47]*u24*v14 + (1.0L/48.0L)*a[47]*u24*v24)
-            + 2*w2 *
-            ((1.0L/2.0L)*a[16]*u1*v1 - 1.0L/2.0L*a[16]*u1*v2 - 1.0L/2.0L*a[16]*u2*v1 + (1.0L/2.0L)*a[16]*u2*v2 +
-            (1.0L/4.0L)*a[17]*u12*v1 - 1.0L/4.0L*a[17]*u12*v2 - 1.0L/4.0L*a[17]*u22*v1 + (1.0L/4.0L)*a[17]*u22*v2 +
-            (1.0L/6.0L)*a[18]*u13*v1 - 1.0L/6.0L*a[18]*u13*v2 - 1.0L/6.0L*a[18]*u23*v1 + (1.0L/6.0L)*a[18]*u23*v2 +
-            (1.0L/8.0L)*a[19]*u14*v1 - 1.0L/8.0L*a[19]*u14*v2 - 1.0L/8.0L*a[19]*u24*v1 + (1.0L/8.0L)*a[19]*u24*v2 +
-            (1.0L/4.0L)*a[20]*u1*v12 - 1.0L/4.0L*a[20]*u1*v22 - 1.0L/4.0L*a[20]*u2*v12 + (1.0L/4.0L)*a[20]*u2*v22 +
-            (1.0L/8.0L)*a[21]*u12*v12 - 1.0L/8.0L*a[21]*u12*v22 - 1.0L/8.0L*a[21]*u22*v12 + (1.0L/8.0L)*a[21]*u22*v22 +
-            (1.0L/12.0L)*a[22]*u13*v12 - 1.0L/12.0L*a[22]*u13*v22 - 1.0L/12.0L*a[22]*u23*v12 + (1.0L/12.0L)*a[22]*u23*v22 +
-            (1.0L/16.0L)*a[23]*u14*v12 - 1.0L/16.0L*a[23]*u14*v22 - 1.0L/16.0L*a[23]*u24*v12 + (1.0L/16.0L)*a[23]*u24*v22 +
-            (1.0L/6.0L)*a[24]*u1*v13 - 1.0L/6.0L*a[24]*u1*v23 - 1.0L/6.0L*a[24]*u2*v13 + (1.0L/6.0L)*a[24]*u2*v23 +
-            (1.0L/12.0L)*a[25]*u12*v13 - 1.0L/12.0L*a[25]*u12*v23 - 1.0L/12.0L*a[25]*u22*v13 + (1.0L/12.0L)*a[25]*u22*v23 +
-            (1.0L/18.0L)*a[26]*u13*v13 - 1.0L/18.0L*a[26]*u13*v23 - 1.0L/18.0L*a[26]*u23*v13 + (1.0L/18.0L)*a[26]*u23*v23 +
-            (1.0L/24.0L)*a[27]*u14*v13 - 1.0L/24.0L*a[27]*u14*v23 - 1.0L/24.0L*a[27]*u24*v13 + (1.0L/24.0L)*a[27]*u24*v23 +
-            (1.0L/8.0L)*a[28]*u1*v14 - 1.0L/8.0L*a[28]*u1*v24 - 1.0L/8.0L*a[28]*u2*v14 + (1.0L/8.0L)*a[28]*u2*v24 +
-            (1.0L/16.0L)*a[29]*u12*v14 - 1.0L/16.0L*a[29]*u12*v24 - 1.0L/16.0L*a[29]*u22*v14 + (1.0L/16.0L)*a[29]*u22*v24 +
-            (1.0L/24.0L)*a[30]*u13*v14 - 1.0L/24.0L*a[30]*u13*v24 - 1.0L/24.0L*a[30]*u23*v14 + (1.0L/24.0L)*a[30]*u23*v24 +
-            (1.0L/32.0L)*a[31]*u14*v14 - 1.0L/32.0L*a[31]*u14*v24 - 1.0L/32.0L*a[31]*u24*v14 + (1.0L/32.0L)*a[31]*u24*v24);
-    return G_result;
+    double x[4], y[4], z[4];
+    TricubicKernel::moments(x, u1, u2);
+    TricubicKernel::moments(y, v1, v2);
+    TricubicKernel::powers(z, w2);
+    return TricubicKernel::contract(a, x, y, z);
 }
 
 double Energy::gradientEvaluateXMinComponent(const Eigen::VectorXd &x) const {
-    double unit = g->getUnit();
-
-	Point3d min, max;
-    initializeMinMax(min, max, x);
-
-    double firstX = min.x()-unit, firstY = min.y()-unit, firstZ = min.z()-unit, lastY = max.y()+unit, lastZ = max.z()+unit;
-
-    double minbx = x(0), minby = x(1), minbz = x(2);
-    double maxbx = x(3), maxby = x(4), maxbz = x(5);
-    double energy = 0;
-
-    double x1, y1, z1;
-    //fissare x1
-    x1 = firstX;
-    while (x1 <= minbx){
-        x1+=unit;
-    }
-    double x2 = x1;
-    x1-=unit;
-    for (y1 = firstY; y1 <= lastY; y1+=unit){
-        double y2 = y1 + unit;
-        for (z1 = firstZ; z1<=lastZ; z1+=unit){
-            double z2 = z1 + unit;
-
-            if (maxbx <= x1 || minbx >= x2 ||
-                maxby <= y1 || minby >= y2 ||
-                maxbz <= z1 || minbz >= z2 ) // not contained
-                energy += 0;
-            else {
-                const gridreal* coeffs;
-				g->getCoefficients(coeffs, Point3d(x1,y1,z1));
-
-                double u1 = minbx < x1 ? x1 : minbx;
-                double v1 = minby < y1 ? y1 : minby;
-                double w1 = minbz < z1 ? z1 : minbz;
-                double v2 = maxby > y2 ? y2 : maxby;
-                double w2 = maxbz > z2 ? z2 : maxbz;
-				//g->addCube(BoundingBox3(Point3d(u1,v1,w1), Point3d(u2,v2,w2)));
-                u1 = (u1-x1)/unit;
-                v1 = (v1-y1)/unit;
-                v2 = (v2-y1)/unit;
-                w1 = (w1-z1)/unit;
-                w2 = (w2-z1)/unit;
-                energy += gradientXMinComponent(coeffs, u1,v1,w1,v2,w2);
-            }
-
-        }
-    }
-
-    return energy;
+    return gradientEvaluateComponent(x, 0);
 }
 
 double Energy::gradientEvaluateYMinComponent(const Eigen::VectorXd &x) const {
-    double unit = g->getUnit();
-
-	Point3d min, max;
-    initializeMinMax(min, max, x);
-
-    double firstX = min.x()-unit, firstY = min.y()-unit, firstZ = min.z()-unit, lastX = max.x()+unit, lastZ = max.z()+unit;
-
-    double minbx = x(0), minby = x(1), minbz = x(2);
-    double maxbx = x(3), maxby = x(4), maxbz = x(5);
-    double energy = 0;
-
-    double x1, y1, z1;
-
-    //fissare y1
-    y1 = firstY;
-    while (y1 <= minby){
-        y1+=unit;
-    }
-    double y2 = y1;
-    y1-=unit;
-
-    for (x1 = firstX; x1 <= lastX; x1+=unit){
-        double x2 = x1 + unit;
-        for (z1 = firstZ; z1<=lastZ; z1+=unit){
-            double z2 = z1 + unit;
-
-            if (maxbx <= x1 || minbx >= x2 ||
-                    maxby <= y1 || minby >= y2 ||
-                    maxbz <= z1 || minbz >= z2 ) // not contained
-                energy += 0;
-            else {
-                const gridreal* coeffs;
-				g->getCoefficients(coeffs, Point3d(x1,y1,z1));
-
-                double u1 = minbx < x1 ? x1 : minbx;
-                double v1 = minby < y1 ? y1 : minby;
-                double w1 = minbz < z1 ? z1 : minbz;
-                double u2 = maxbx > x2 ? x2 : maxbx;
-                double w2 = maxbz > z2 ? z2 : maxbz;
-				//g->addCube(BoundingBox3(Point3d(u1,v1,w1), Point3d(u2,v2,w2)));
-                u1 = (u1-x1)/unit;
-                u2 = (u2-x1)/unit;
-                v1 = (v1-y1)/unit;
-                w1 = (w1-z1)/unit;
-                w2 = (w2-z1)/unit;
-                energy += gradientYMinComponent(coeffs, u1,v1,w1,u2,w2);
-            }
-        }
-    }
-
-    return energy;
+    return gradientEvaluateComponent(x, 1);
 }
 
 double Energy::gradientEvaluateZMinComponent(const Eigen::VectorXd& x) const {
-    double unit = g->getUnit();
-
-	Point3d min, max;
-    initializeMinMax(min, max, x);
-
-    double firstX = min.x()-unit, firstY = min.y()-unit, firstZ = min.z()-unit, lastX = max.x()+unit, lastY = max.y()+unit;
-
-    double minbx = x(0), minby = x(1), minbz = x(2);
-    double maxbx = x(3), maxby = x(4), maxbz = x(5);
-    double energy = 0;
-
-    double x1, y1, z1;
-
-    //fissare z1
-    z1 = firstZ;
-    while (z1 <= minbz){
-        z1+=unit;
-    }
-    double z2 = z1;
-    z1-=unit;
-
-    for (x1 = firstX; x1 <= lastX; x1+=unit){
-        double x2 = x1 + unit;
-        for (y1 = firstY; y1<=lastY; y1+=unit){
-            double y2 = y1 + unit;
-
-            if (maxbx <= x1 || minbx >= x2 ||
-                    maxby <= y1 || minby >= y2 ||
-                    maxbz <= z1 || minbz >= z2 ) // not contained
-                energy += 0;
-            else {
-                const gridreal* coeffs;
-				g->getCoefficients(coeffs, Point3d(x1,y1,z1));
-
-                double u1 = minbx < x1 ? x1 : minbx;
-                double v1 = minby < y1 ? y1 : minby;
-                double w1 = minbz < z1 ? z1 : minbz;
-                double u2 = maxbx > x2 ? x2 : maxbx;
-                double v2 = maxby > y2 ? y2 : maxby;
-				//g->addCube(BoundingBox3(Point3d(u1,v1,w1), Point3d(u2,v2,w2)));
-                u1 = (u1-x1)/unit;
-                u2 = (u2-x1)/unit;
-                v1 = (v1-y1)/unit;
-                v2 = (v2-y1)/unit;
-                w1 = (w1-z1)/unit;
-                energy += gradientZMinComponent(coeffs, u1,v1,w1,u2,v2);
-            }
-        }
-    }
-
-    return energy;
+    return gradientEvaluateComponent(x, 2);
 }
 
 double Energy::gradientEvaluateXMaxComponent(const Eigen::VectorXd &x) const {
-    double unit = g->getUnit();
-
-	Point3d min, max;
-    initializeMinMax(min, max, x);
-
-    double firstY = min.y()-unit, firstZ = min.z()-unit, lastX = max.x()+unit, lastY = max.y()+unit, lastZ = max.z()+unit;
-
-    double minbx = x(0), minby = x(1), minbz = x(2);
-    double maxbx = x(3), maxby = x(4), maxbz = x(5);
-    double energy = 0;
-
-    double x1, y1, z1;
-    //fissare x1
-    x1 = lastX;
-    while (x1 >= maxbx){
-        x1-=unit;
-    }
-    double x2 = x1+unit;
-
-    for (y1 = firstY; y1 <= lastY; y1+=unit){
-        double y2 = y1 + unit;
-        for (z1 = firstZ; z1<=lastZ; z1+=unit){
-            double z2 = z1 + unit;
-
-            if (maxbx <= x1 || minbx >= x2 ||
-                maxby <= y1 || minby >= y2 ||
-                maxbz <= z1 || minbz >= z2 ) // not contained
-                energy += 0;
-            else {
-                const gridreal* coeffs;
-				g->getCoefficients(coeffs, Point3d(x1,y1,z1));
-
-                double v1 = minby < y1 ? y1 : minby;
-                double w1 = minbz < z1 ? z1 : minbz;
-                double u2 = maxbx > x2 ? x2 : maxbx;
-                double v2 = maxby > y2 ? y2 : maxby;
-                double w2 = maxbz > z2 ? z2 : maxbz;
-				//g->addCube(BoundingBox3(Point3d(u1,v1,w1), Point3d(u2,v2,w2)));
-                u2 = (u2-x1)/unit;
-                v1 = (v1-y1)/unit;
-                v2 = (v2-y1)/unit;
-                w1 = (w1-z1)/unit;
-                w2 = (w2-z1)/unit;
-                energy += gradientXMaxComponent(coeffs,v1,w1,u2,v2,w2);
-            }
-
-        }
-    }
-
-    return energy;
+    return gradientEvaluateComponent(x, 3);
 }
 
 double Energy::gradientEvaluateYMaxComponent(const Eigen::VectorXd& x) const {
-    double unit = g->getUnit();
-
-	Point3d min, max;
-    initializeMinMax(min, max, x);
-
-    double firstX = min.x()-unit, firstZ = min.z()-unit, lastX = max.x()+unit, lastY = max.y()+unit, lastZ = max.z()+unit;
-
-    double minbx = x(0), minby = x(1), minbz = x(2);
-    double maxbx = x(3), maxby = x(4), maxbz = x(5);
-    double energy = 0;
-
-    double x1, y1, z1;
-
-    //fissare y1
-    y1 = lastY;
-    while (y1 >= maxby){
-        y1-=unit;
-    }
-    double y2 = y1+unit;
-
-    for (x1 = firstX; x1 <= lastX; x1+=unit){
-        double x2 = x1 + unit;
-        for (z1 = firstZ; z1<=lastZ; z1+=unit){
-            double z2 = z1 + unit;
-
-            if (maxbx <= x1 || minbx >= x2 ||
-                    maxby <= y1 || minby >= y2 ||
-                    maxbz <= z1 || minbz >= z2 ) // not contained
-                energy += 0;
-            else {
-                const gridreal* coeffs;
-				g->getCoefficients(coeffs, Point3d(x1,y1,z1));
-
-                double u1 = minbx < x1 ? x1 : minbx;
-                double w1 = minbz < z1 ? z1 : minbz;
-                double u2 = maxbx > x2 ? x2 : maxbx;
-                double v2 = maxby > y2 ? y2 : maxby;
-                double w2 = maxbz > z2 ? z2 : maxbz;
-				//g->addCube(BoundingBox3(Point3d(u1,v1,w1), Point3d(u2,v2,w2)));
-                u1 = (u1-x1)/unit;
-                u2 = (u2-x1)/unit;
-                v2 = (v2-y1)/unit;
-                w1 = (w1-z1)/unit;
-                w2 = (w2-z1)/unit;
-                energy += gradientYMaxComponent(coeffs, u1,w1,u2,v2,w2);
-            }
-        }
-    }
-
-    return energy;
+    return gradientEvaluateComponent(x, 4);
 }
 
 double Energy::gradientEvaluateZMaxComponent(const Eigen::VectorXd &x) const {
+    return gradientEvaluateComponent(x, 5);
+}
+
+/**
+ * @brief Energy::gradientEvaluateComponent
+ *
+ * Computes the component of the gradient of the integral relative to one face
+ * of the box (0: xmin, 1: ymin, 2: zmin, 3: xmax, 4: ymax, 5: zmax),
+ * visiting only the slab of cells which contains the face.
+ * As for the other legacy gradients, the component is the derivative with respect
+ * to the normalized coordinates of the cells (see integralAndGradientTricubicInterpolationEnergy).
+ */
+double Energy::gradientEvaluateComponent(const Eigen::VectorXd& x, unsigned int face) const {
+    assert(face < 6);
     double unit = g->getUnit();
-
-	Point3d min, max;
-    initializeMinMax(min, max, x);
-
-    double firstX = min.x()-unit, firstY = min.y()-unit, lastX = max.x()+unit, lastY = max.y()+unit, lastZ = max.z()+unit;
-
-    double minbx = x(0), minby = x(1), minbz = x(2);
-    double maxbx = x(3), maxby = x(4), maxbz = x(5);
-    double energy = 0;
-
-    double x1, y1, z1;
-
-    //fissare z1
-    z1 = lastZ;
-    while (z1 >= maxbz){
-        z1-=unit;
-    }
-    double z2 = z1+unit;
-
-    for (x1 = firstX; x1 <= lastX; x1+=unit){
-        double x2 = x1 + unit;
-        for (y1 = firstY; y1<=lastY; y1+=unit){
-            double y2 = y1 + unit;
-
-            if (maxbx <= x1 || minbx >= x2 ||
-                    maxby <= y1 || minby >= y2 ||
-                    maxbz <= z1 || minbz >= z2 ) // not contained
-                energy += 0;
-            else {
-                const gridreal* coeffs;
-				g->getCoefficients(coeffs, Point3d(x1,y1,z1));
-
-                double u1 = minbx < x1 ? x1 : minbx;
-                double v1 = minby < y1 ? y1 : minby;
-                double u2 = maxbx > x2 ? x2 : maxbx;
-                double v2 = maxby > y2 ? y2 : maxby;
-                double w2 = maxbz > z2 ? z2 : maxbz;
-				//g->addCube(BoundingBox3(Point3d(u1,v1,w1), Point3d(u2,v2,w2)));
-                u1 = (u1-x1)/unit;
-                u2 = (u2-x1)/unit;
-                v1 = (v1-y1)/unit;
-                v2 = (v2-y1)/unit;
-                w2 = (w2-z1)/unit;
-                energy += gradientZMaxComponent(coeffs, u1,v1,u2,v2,w2);
+    unsigned int axis = face % 3;
+    Point3i first, last;
+    g->getCellRange(first, last, Point3d(x(0), x(1), x(2)), Point3d(x(3), x(4), x(5)));
+    //the slab of cells which contains the face
+    if (face < 3)
+        last[axis] = first[axis];
+    else
+        first[axis] = last[axis];
+
+    double sum = 0;
+    for (int i = first.x(); i <= last.x(); i++){
+        for (int j = first.y(); j <= last.y(); j++){
+            for (int k = first.z(); k <= last.z(); k++){
+                const gridreal* coeffs = g->getCellCoefficients(i, j, k);
+                Point3d c = g->getCellMin(i, j, k);
+                double f[3][4];
+                for (unsigned int a = 0; a < 3; a++){
+                    double t1 = x(a) < c[a] ? 0 : (x(a)-c[a])/unit;
+                    double t2 = x(a+3) > c[a]+unit ? 1 : (x(a+3)-c[a])/unit;
+                    if (a != axis)
+                        TricubicKernel::moments(f[a], t1, t2);
+                    else
+                        TricubicKernel::powers(f[a], face < 3 ? t1 : t2);
+                }
+                sum += TricubicKernel::contract(coeffs, f[0], f[1], f[2], precision);
             }
         }
     }
-
-    return energy;
+    return face < 3 ? -sum : sum;
 }
 
 void Energy::gradientEnergy(Eigen::VectorXd& gradient, const Eigen::VectorXd& x, const Point3d& c1, const Point3d& c2, const Point3d& c3) const {
@@ -1119,229 +477,206 @@ void Energy::gradientEnergyFiniteDifference(Eigen::VectorXd& gradient, const Eig
 
 //sia i coefficienti che la sotto-box integrata devono essere nell'intervallo 0-1
 double Energy::integralTricubicInterpolation(const gridreal*& a, double u1, double v1, double w1, double u2, double v2, double w2) {
-    //Simpy generated code
-    double u12 = u1*u1; double u13 = u12*u1; double u14 = u13*u1;
-    double v12 = v1*v1; double v13 = v12*v1; double v14 = v13*v1;
-    double w12 = w1*w1; double w13 = w12*w1; double w14 = w13*w1;
-    double u22 = u2*u2; double u23 = u22*u2; double u24 = u23*u2;
-    double v22 = v2*v2; double v23 = v22*v2; double v24 = v23*v2;
-    double w22 = w2*w2; double w23 = w22*w2; double w24 = w23*w2;
-
-    double C_result;
-    C_result = - w14 *
-                   ((1.0L/4.0L)*a[48]*u1*v1 - 1.0L/4.0L*a[48]*u1*v2 - 1.0L/4.0L*a[48]*u2*v1 + (1.0L/4.0L)*a[48]*u2*v2 +
-                    (1.0L/8.0L)*a[49]*u12*v1 - 1.0L/8.0L*a[49]*u12*v2 - 1.0L/8.0L*a[49]*u22*v1 + (1.0L/8.0L)*a[49]*u22*v2 +
-                    (1.0L/12.0L)*a[50]*u13*v1 - 1.0L/12.0L*a[50]*u13*v2 - 1.0L/12.0L*a[50]*u23*v1 + (1.0L/12.0L)*a[50]*u23*v2 +
-                    (1.0L/16.0L)*a[51]*u14*v1 - 1.0L/16.0L*a[51]*u14*v2 - 1.0L/16.0L*a[51]*u24*v1 + (1.0L/16.0L)*a[51]*u24*v2 +
-                    (1.0L/8.0L)*a[52]*u1*v12 - 1.0L/8.0L*a[52]*u1*v22 - 1.0L/8.0L*a[52]*u2*v12 + (1.0L/8.0L)*a[52]*u2*v22 +
-                    (1.0L/16.0L)*a[53]*u12*v12 - 1.0L/16.0L*a[53]*u12*v22 - 1.0L/16.0L*a[53]*u22*v12 + (1.0L/16.0L)*a[53]*u22*v22 +
-                    (1.0L/24.0L)*a[54]*u13*v12 - 1.0L/24.0L*a[54]*u13*v22 - 1.0L/24.0L*a[54]*u23*v12 + (1.0L/24.0L)*a[54]*u23*v22 +
-                    (1.0L/32.0L)*a[55]*u14*v12 - 1.0L/32.0L*a[55]*u14*v22 - 1.0L/32.0L*a[55]*u24*v12 + (1.0L/32.0L)*a[55]*u24*v22 +
-                    (1.0L/12.0L)*a[56]*u1*v13 - 1.0L/12.0L*a[56]*u1*v23 - 1.0L/12.0L*a[56]*u2*v13 + (1.0L/12.0L)*a[56]*u2*v23 +
-                    (1.0L/24.0L)*a[57]*u12*v13 - 1.0L/24.0L*a[57]*u12*v23 - 1.0L/24.0L*a[57]*u22*v13 + (1.0L/24.0L)*a[57]*u22*v23 +
-                    (1.0L/36.0L)*a[58]*u13*v13 - 1.0L/36.0L*a[58]*u13*v23 - 1.0L/36.0L*a[58]*u23*v13 + (1.0L/36.0L)*a[58]*u23*v23 +
-                    (1.0L/48.0L)*a[59]*u14*v13 - 1.0L/48.0L*a[59]*u14*v23 - 1.0L/48.0L*a[59]*u24*v13 + (1.0L/48.0L)*a[59]*u24*v23 +
-                    (1.0L/16.0L)*a[60]*u1*v14 - 1.0L/16.0L*a[60]*u1*v24 - 1.0L/16.0L*a[60]*u2*v14 + (1.0L/16.0L)*a[60]*u2*v24 +
-                    (1.0L/32.0L)*a[61]*u12*v14 - 1.0L/32.0L*a[61]*u12*v24 - 1.0L/32.0L*a[61]*u22*v14 + (1.0L/32.0L)*a[61]*u22*v24 +
-                    (1.0L/48.0L)*a[62]*u13*v14 - 1.0L/48.0L*a[62]*u13*v24 - 1.0L/48.0L*a[62]*u23*v14 + (1.0L/48.0L)*a[62]*u23*v24 +
-                    (1.0L/64.0L)*a[63]*u14*v14 - 1.0L/64.0L*a[63]*u14*v24 - 1.0L/64.0L*a[63]*u24*v14 + (1.0L/64.0L)*a[63]*u24*v24)
-                   - w13 *
-                   ((1.0L/3.0L)*a[32]*u1*v1 - 1.0L/3.0L*a[32]*u1*v2 - 1.0L/3.0L*a[32]*u2*v1 + (1.0L/3.0L)*a[32]*u2*v2 +
-                    (1.0L/6.0L)*a[33]*u12*v1 - 1.0L/6.0L*a[33]*u12*v2 - 1.0L/6.0L*a[33]*u22*v1 + (1.0L/6.0L)*a[33]*u22*v2 +
-                    (1.0L/9.0L)*a[34]*u13*v1 - 1.0L/9.0L*a[34]*u13*v2 - 1.0L/9.0L*a[34]*u23*v1 + (1.0L/9.0L)*a[34]*u23*v2 +
-                    (1.0L/12.0L)*a[35]*u14*v1 - 1.0L/12.0L*a[35]*u14*v2 - 1.0L/12.0L*a[35]*u24*v1 + (1.0L/12.0L)*a[35]*u24*v2 +
-                    (1.0L/6.0L)*a[36]*u1*v12 - 1.0L/6.0L*a[36]*u1*v22 - 1.0L/6.0L*a[36]*u2*v12 + (1.0L/6.0L)*a[36]*u2*v22 +
-                    (1.0L/12.0L)*a[37]*u12*v12 - 1.0L/12.0L*a[37]*u12*v22 - 1.0L/12.0L*a[37]*u22*v12 + (1.0L/12.0L)*a[37]*u22*v22 +
-                    (1.0L/18.0L)*a[38]*u13*v12 - 1.0L/18.0L*a[38]*u13*v22 - 1.0L/18.0L*a[38]*u23*v12 + (1.0L/18.0L)*a[38]*u23*v22 +
-                    (1.0L/24.0L)*a[39]*u14*v12 - 1.0L/24.0L*a[39]*u14*v22 - 1.0L/24.0L*a[39]*u24*v12 + (1.0L/24.0L)*a[39]*u24*v22 +
-                    (1.0L/9.0L)*a[40]*u1*v13 - 1.0L/9.0L*a[40]*u1*v23 - 1.0L/9.0L*a[40]*u2*v13 + (1.0L/9.0L)*a[40]*u2*v23 +
-                    (1.0L/18.0L)*a[41]*u12*v13 - 1.0L/18.0L*a[41]*u12*v23 - 1.0L/18.0L*a[41]*u22*v13 + (1.0L/18.0L)*a[41]*u22*v23 +
-                    (1.0L/27.0L)*a[42]*u13*v13 - 1.0L/27.0L*a[42]*u13*v23 - 1.0L/27.0L*a[42]*u23*v13 + (1.0L/27.0L)*a[42]*u23*v23 +
-                    (1.0L/36.0L)*a[43]*u14*v13 - 1.0L/36.0L*a[43]*u14*v23 - 1.0L/36.0L*a[43]*u24*v13 + (1.0L/36.0L)*a[43]*u24*v23 +
-                    (1.0L/12.0L)*a[44]*u1*v14 - 1.0L/12.0L*a[44]*u1*v24 - 1.0L/12.0L*a[44]*u2*v14 + (1.0L/12.0L)*a[44]*u2*v24 +
-                    (1.0L/24.0L)*a[45]*u12*v14 - 1.0L/24.0L*a[45]*u12*v24 - 1.0L/24.0L*a[45]*u22*v14 + (1.0L/24.0L)*a[45]*u22*v24 +
-                    (1.0L/36.0L)*a[46]*u13*v14 - 1.0L/36.0L*a[46]*u13*v24 - 1.0L/36.0L*a[46]*u23*v14 + (1.0L/36.0L)*a[46]*u23*v24 +
-                    (1.0L/48.0L)*a[47]*u14*v14 - 1.0L/48.0L*a[47]*u14*v24 - 1.0L/48.0L*a[47]*u24*v14 + (1.0L/48.0L)*a[47]*u24*v24)
-                   - w12 *
-                   ((1.0L/2.0L)*a[16]*u1*v1 - 1.0L/2.0L*a[16]*u1*v2 - 1.0L/2.0L*a[16]*u2*v1 + (1.0L/2.0L)*a[16]*u2*v2 +
-                    (1.0L/4.0L)*a[17]*u12*v1 - 1.0L/4.0L*a[17]*u12*v2 - 1.0L/4.0L*a[17]*u22*v1 + (1.0L/4.0L)*a[17]*u22*v2 +
-                    (1.0L/6.0L)*a[18]*u13*v1 - 1.0L/6.0L*a[18]*u13*v2 - 1.0L/6.0L*a[18]*u23*v1 + (1.0L/6.0L)*a[18]*u23*v2 +
-                    (1.0L/8.0L)*a[19]*u14*v1 - 1.0L/8.0L*a[19]*u14*v2 - 1.0L/8.0L*a[19]*u24*v1 + (1.0L/8.0L)*a[19]*u24*v2 +
-                    (1.0L/4.0L)*a[20]*u1*v12 - 1.0L/4.0L*a[20]*u1*v22 - 1.0L/4.0L*a[20]*u2*v12 + (1.0L/4.0L)*a[20]*u2*v22 +
-                    (1.0L/8.0L)*a[21]*u12*v12 - 1.0L/8.0L*a[21]*u12*v22 - 1.0L/8.0L*a[21]*u22*v12 + (1.0L/8.0L)*a[21]*u22*v22 +
-                    (1.0L/12.0L)*a[22]*u13*v12 - 1.0L/12.0L*a[22]*u13*v22 - 1.0L/12.0L*a[22]*u23*v12 + (1.0L/12.0L)*a[22]*u23*v22 +
-                    (1.0L/16.0L)*a[23]*u14*v12 - 1.0L/16.0L*a[23]*u14*v22 - 1.0L/16.0L*a[23]*u24*v12 + (1.0L/16.0L)*a[23]*u24*v22 +
-                    (1.0L/6.0L)*a[24]*u1*v13 - 1.0L/6.0L*a[24]*u1*v23 - 1.0L/6.0L*a[24]*u2*v13 + (1.0L/6.0L)*a[24]*u2*v23 +
-                    (1.0L/12.0L)*a[25]*u12*v13 - 1.0L/12.0L*a[25]*u12*v23 - 1.0L/12.0L*a[25]*u22*v13 + (1.0L/12.0L)*a[25]*u22*v23 +
-                    (1.0L/18.0L)*a[26]*u13*v13 - 1.0L/18.0L*a[26]*u13*v23 - 1.0L/18.0L*a[26]*u23*v13 + (1.0L/18.0L)*a[26]*u23*v23 +
-                    (1.0L/24.0L)*a[27]*u14*v13 - 1.0L/24.0L*a[27]*u14*v23 - 1.0L/24.0L*a[27]*u24*v13 + (1.0L/24.0L)*a[27]*u24*v23 +
-                    (1.0L/8.0L)*a[28]*u1*v14 - 1.0L/8.0L*a[28]*u1*v24 - 1.0L/8.0L*a[28]*u2*v14 + (1.0L/8.0L)*a[28]*u2*v24 +
-                    (1.0L/16.0L)*a[29]*u12*v14 - 1.0L/16.0L*a[29]*u12*v24 - 1.0L/16.0L*a[29]*u22*v14 + (1.0L/16.0L)*a[29]*u22*v24 +
-                    (1.0L/24.0L)*a[30]*u13*v14 - 1.0L/24.0L*a[30]*u13*v24 - 1.0L/24.0L*a[30]*u23*v14 + (1.0L/24.0L)*a[30]*u23*v24 +
-                    (1.0L/32.0L)*a[31]*u14*v14 - 1.0L/32.0L*a[31]*u14*v24 - 1.0L/32.0L*a[31]*u24*v14 + (1.0L/32.0L)*a[31]*u24*v24)
-                   - w1 *
-                   (a[0]*u1*v1 - a[0]*u1*v2 - a[0]*u2*v1 + a[0]*u2*v2 +
-                    (1.0L/2.0L)*a[1]*u12*v1 - 1.0L/2.0L*a[1]*u12*v2 - 1.0L/2.0L*a[1]*u22*v1 + (1.0L/2.0L)*a[1]*u22*v2 +
-                    (1.0L/9.0L)*a[10]*u13*v13 - 1.0L/9.0L*a[10]*u13*v23 - 1.0L/9.0L*a[10]*u23*v13 + (1.0L/9.0L)*a[10]*u23*v23 +
-                    (1.0L/12.0L)*a[11]*u14*v13 - 1.0L/12.0L*a[11]*u14*v23 - 1.0L/12.0L*a[11]*u24*v13 + (1.0L/12.0L)*a[11]*u24*v23 +
-                    (1.0L/4.0L)*a[12]*u1*v14 - 1.0L/4.0L*a[12]*u1*v24 - 1.0L/4.0L*a[12]*u2*v14 + (1.0L/4.0L)*a[12]*u2*v24 +
-                    (1.0L/8.0L)*a[13]*u12*v14 - 1.0L/8.0L*a[13]*u12*v24 - 1.0L/8.0L*a[13]*u22*v14 + (1.0L/8.0L)*a[13]*u22*v24 +
-                    (1.0L/12.0L)*a[14]*u13*v14 - 1.0L/12.0L*a[14]*u13*v24 - 1.0L/12.0L*a[14]*u23*v14 + (1.0L/12.0L)*a[14]*u23*v24 +
-                    (1.0L/16.0L)*a[15]*u14*v14 - 1.0L/16.0L*a[15]*u14*v24 - 1.0L/16.0L*a[15]*u24*v14 + (1.0L/16.0L)*a[15]*u24*v24 +
-                    (1.0L/3.0L)*a[2]*u13*v1 - 1.0L/3.0L*a[2]*u13*v2 - 1.0L/3.0L*a[2]*u23*v1 + (1.0L/3.0L)*a[2]*u23*v2 +
-                    (1.0L/4.0L)*a[3]*u14*v1 - 1.0L/4.0L*a[3]*u14*v2 - 1.0L/4.0L*a[3]*u24*v1 + (1.0L/4.0L)*a[3]*u24*v2 +
-                    (1.0L/2.0L)*a[4]*u1*v12 - 1.0L/2.0L*a[4]*u1*v22 - 1.0L/2.0L*a[4]*u2*v12 + (1.0L/2.0L)*a[4]*u2*v22 +
-                    (1.0L/4.0L)*a[5]*u12*v12 - 1.0L/4.0L*a[5]*u12*v22 - 1.0L/4.0L*a[5]*u22*v12 + (1.0L/4.0L)*a[5]*u22*v22 +
-                    (1.0L/6.0L)*a[6]*u13*v12 - 1.0L/6.0L*a[6]*u13*v22 - 1.0L/6.0L*a[6]*u23*v12 + (1.0L/6.0L)*a[6]*u23*v22 +
-                    (1.0L/8.0L)*a[7]*u14*v12 - 1.0L/8.0L*a[7]*u14*v22 - 1.0L/8.0L*a[7]*u24*v12 + (1.0L/8.0L)*a[7]*u24*v22 +
-                    (1.0L/3.0L)*a[8]*u1*v13 - 1.0L/3.0L*a[8]*u1*v23 - 1.0L/3.0L*a[8]*u2*v13 + (1.0L/3.0L)*a[8]*u2*v23 +
-                    (1.0L/6.0L)*a[9]*u12*v13 - 1.0L/6.0L*a[9]*u12*v23 - 1.0L/6.0L*a[9]*u22*v13 + (1.0L/6.0L)*a[9]*u22*v23)
-                   + w24 *
-                   ((1.0L/4.0L)*a[48]*u1*v1 - 1.0L/4.0L*a[48]*u1*v2 - 1.0L/4.0L*a[48]*u2*v1 + (1.0L/4.0L)*a[48]*u2*v2 +
-                    (1.0L/8.0L)*a[49]*u12*v1 - 1.0L/8.0L*a[49]*u12*v2 - 1.0L/8.0L*a[49]*u22*v1 + (1.0L/8.0L)*a[49]*u22*v2 +
-                    (1.0L/12.0L)*a[50]*u13*v1 - 1.0L/12.0L*a[50]*u13*v2 - 1.0L/12.0L*a[50]*u23*v1 + (1.0L/12.0L)*a[50]*u23*v2 +
-                    (1.0L/16.0L)*a[51]*u14*v1 - 1.0L/16.0L*a[51]*u14*v2 - 1.0L/16.0L*a[51]*u24*v1 + (1.0L/16.0L)*a[51]*u24*v2 +
-                    (1.0L/8.0L)*a[52]*u1*v12 - 1.0L/8.0L*a[52]*u1*v22 - 1.0L/8.0L*a[52]*u2*v12 + (1.0L/8.0L)*a[52]*u2*v22 +
-                    (1.0L/16.0L)*a[53]*u12*v12 - 1.0L/16.0L*a[53]*u12*v22 - 1.0L/16.0L*a[53]*u22*v12 + (1.0L/16.0L)*a[53]*u22*v22 +
-                    (1.0L/24.0L)*a[54]*u13*v12 - 1.0L/24.0L*a[54]*u13*v22 - 1.0L/24.0L*a[54]*u23*v12 + (1.0L/24.0L)*a[54]*u23*v22 +
-                    (1.0L/32.0L)*a[55]*u14*v12 - 1.0L/32.0L*a[55]*u14*v22 - 1.0L/32.0L*a[55]*u24*v12 + (1.0L/32.0L)*a[55]*u24*v22 +
-                    (1.0L/12.0L)*a[56]*u1*v13 - 1.0L/12.0L*a[56]*u1*v23 - 1.0L/12.0L*a[56]*u2*v13 + (1.0L/12.0L)*a[56]*u2*v23 +
-                    (1.0L/24.0L)*a[57]*u12*v13 - 1.0L/24.0L*a[57]*u12*v23 - 1.0L/24.0L*a[57]*u22*v13 + (1.0L/24.0L)*a[57]*u22*v23 +
-                    (1.0L/36.0L)*a[58]*u13*v13 - 1.0L/36.0L*a[58]*u13*v23 - 1.0L/36.0L*a[58]*u23*v13 + (1.0L/36.0L)*a[58]*u23*v23 +
-                    (1.0L/48.0L)*a[59]*u14*v13 - 1.0L/48.0L*a[59]*u14*v23 - 1.0L/48.0L*a[59]*u24*v13 + (1.0L/48.0L)*a[59]*u24*v23 +
-                    (1.0L/16.0L)*a[60]*u1*v14 - 1.0L/16.0L*a[60]*u1*v24 - 1.0L/16.0L*a[60]*u2*v14 + (1.0L/16.0L)*a[60]*u2*v24 +
-                    (1.0L/32.0L)*a[61]*u12*v14 - 1.0L/32.0L*a[61]*u12*v24 - 1.0L/32.0L*a[61]*u22*v14 + (1.0L/32.0L)*a[61]*u22*v24 +
-                    (1.0L/48.0L)*a[62]*u13*v14 - 1.0L/48.0L*a[62]*u13*v24 - 1.0L/48.0L*a[62]*u23*v14 + (1.0L/48.0L)*a[62]*u23*v24 +
-                    (1.0L/64.0L)*a[63]*u14*v14 - 1.0L/64.0L*a[63]*u14*v24 - 1.0L/64.0L*a[63]*u24*v14 + (1.0L/64.0L)*a[63]*u24*v24)
-                   + w23 *
-                   ((1.0L/3.0L)*a[32]*u1*v1 - 1.0L/3.0L*a[32]*u1*v2 - 1.0L/3.0L*a[32]*u2*v1 + (1.0L/3.0L)*a[32]*u2*v2 +
-                    (1.0L/6.0L)*a[33]*u12*v1 - 1.0L/6.0L*a[33]*u12*v2 - 1.0L/6.0L*a[33]*u22*v1 + (1.0L/6.0L)*a[33]*u22*v2 +
-                    (1.0L/9.0L)*a[34]*u13*v1 - 1.0L/9.0L*a[34]*u13*v2 - 1.0L/9.0L*a[34]*u23*v1 + (1.0L/9.0L)*a[34]*u23*v2 +
-                    (1.0L/12.0L)*a[35]*u14*v1 - 1.0L/12.0L*a[35]*u14*v2 - 1.0L/12.0L*a[35]*u24*v1 + (1.0L/12.0L)*a[35]*u24*v2 +
-                    (1.0L/6.0L)*a[36]*u1*v12 - 1.0L/6.0L*a[36]*u1*v22 - 1.0L/6.0L*a[36]*u2*v12 + (1.0L/6.0L)*a[36]*u2*v22 +
-                    (1.0L/12.0L)*a[37]*u12*v12 - 1.0L/12.0L*a[37]*u12*v22 - 1.0L/12.0L*a[37]*u22*v12 + (1.0L/12.0L)*a[37]*u22*v22 +
-                    (1.0L/18.0L)*a[38]*u13*v12 - 1.0L/18.0L*a[38]*u13*v22 - 1.0L/18.0L*a[38]*u23*v12 + (1.0L/18.0L)*a[38]*u23*v22 +
-                    (1.0L/24.0L)*a[39]*u14*v12 - 1.0L/24.0L*a[39]*u14*v22 - 1.0L/24.0L*a[39]*u24*v12 + (1.0L/24.0L)*a[39]*u24*v22 +
-                    (1.0L/9.0L)*a[40]*u1*v13 - 1.0L/9.0L*a[40]*u1*v23 - 1.0L/9.0L*a[40]*u2*v13 + (1.0L/9.0L)*a[40]*u2*v23 +
-                    (1.0L/18.0L)*a[41]*u12*v13 - 1.0L/18.0L*a[41]*u12*v23 - 1.0L/18.0L*a[41]*u22*v13 + (1.0L/18.0L)*a[41]*u22*v23 +
-                    (1.0L/27.0L)*a[42]*u13*v13 - 1.0L/27.0L*a[42]*u13*v23 - 1.0L/27.0L*a[42]*u23*v13 + (1.0L/27.0L)*a[42]*u23*v23 +
-                    (1.0L/36.0L)*a[43]*u14*v13 - 1.0L/36.0L*a[43]*u14*v23 - 1.0L/36.0L*a[43]*u24*v13 + (1.0L/36.0L)*a[43]*u24*v23 +
-                    (1.0L/12.0L)*a[44]*u1*v14 - 1.0L/12.0L*a[44]*u1*v24 - 1.0L/12.0L*a[44]*u2*v14 + (1.0L/12.0L)*a[44]*u2*v24 +
-                    (1.0L/24.0L)*a[45]*u12*v14 - 1.0L/24.0L*a[45]*u12*v24 - 1.0L/24.0L*a[45]*u22*v14 + (1.0L/24.0L)*a[45]*u22*v24 +
-                    (1.0L/36.0L)*a[46]*u13*v14 - 1.0L/36.0L*a[46]*u13*v24 - 1.0L/36.0L*a[46]*u23*v14 + (1.0L/36.0L)*a[46]*u23*v24 +
-                    (1.0L/48.0L)*a[47]*u14*v14 - 1.0L/48.0L*a[47]*u14*v24 - 1.0L/48.0L*a[47]*u24*v14 + (1.0L/48.0L)*a[47]*u24*v24)
-                   + w22 *
-                   ((1.0L/2.0L)*a[16]*u1*v1 - 1.0L/2.0L*a[16]*u1*v2 - 1.0L/2.0L*a[16]*u2*v1 + (1.0L/2.0L)*a[16]*u2*v2 +
-                    (1.0L/4.0L)*a[17]*u12*v1 - 1.0L/4.0L*a[17]*u12*v2 - 1.0L/4.0L*a[17]*u22*v1 + (1.0L/4.0L)*a[17]*u22*v2 +
-                    (1.0L/6.0L)*a[18]*u13*v1 - 1.0L/6.0L*a[18]*u13*v2 - 1.0L/6.0L*a[18]*u23*v1 + (1.0L/6.0L)*a[18]*u23*v2 +
-                    (1.0L/8.0L)*a[19]*u14*v1 - 1.0L/8.0L*a[19]*u14*v2 - 1.0L/8.0L*a[19]*u24*v1 + (1.0L/8.0L)*a[19]*u24*v2 +
-                    (1.0L/4.0L)*a[20]*u1*v12 - 1.0L/4.0L*a[20]*u1*v22 - 1.0L/4.0L*a[20]*u2*v12 + (1.0L/4.0L)*a[20]*u2*v22 +
-                    (1.0L/8.0L)*a[21]*u12*v12 - 1.0L/8.0L*a[21]*u12*v22 - 1.0L/8.0L*a[21]*u22*v12 + (1.0L/8.0L)*a[21]*u22*v22 +
-                    (1.0L/12.0L)*a[22]*u13*v12 - 1.0L/12.0L*a[22]*u13*v22 - 1.0L/12.0L*a[22]*u23*v12 + (1.0L/12.0L)*a[22]*u23*v22 +
-                    (1.0L/16.0L)*a[23]*u14*v12 - 1.0L/16.0L*a[23]*u14*v22 - 1.0L/16.0L*a[23]*u24*v12 + (1.0L/16.0L)*a[23]*u24*v22 +
-                    (1.0L/6.0L)*a[24]*u1*v13 - 1.0L/6.0L*a[24]*u1*v23 - 1.0L/6.0L*a[24]*u2*v13 + (1.0L/6.0L)*a[24]*u2*v23 +
-                    (1.0L/12.0L)*a[25]*u12*v13 - 1.0L/12.0L*a[25]*u12*v23 - 1.0L/12.0L*a[25]*u22*v13 + (1.0L/12.0L)*a[25]*u22*v23 +
-                    (1.0L/18.0L)*a[26]*u13*v13 - 1.0L/18.0L*a[26]*u13*v23 - 1.0L/18.0L*a[26]*u23*v13 + (1.0L/18.0L)*a[26]*u23*v23 +
-                    (1.0L/24.0L)*a[27]*u14*v13 - 1.0L/24.0L*a[27]*u14*v23 - 1.0L/24.0L*a[27]*u24*v13 + (1.0L/24.0L)*a[27]*u24*v23 +
-                    (1.0L/8.0L)*a[28]*u1*v14 - 1.0L/8.0L*a[28]*u1*v24 - 1.0L/8.0L*a[28]*u2*v14 + (1.0L/8.0L)*a[28]*u2*v24 +
-                    (1.0L/16.0L)*a[29]*u12*v14 - 1.0L/16.0L*a[29]*u12*v24 - 1.0L/16.0L*a[29]*u22*v14 + (1.0L/16.0L)*a[29]*u22*v24 +
-                    (1.0L/24.0L)*a[30]*u13*v14 - 1.0L/24.0L*a[30]*u13*v24 - 1.0L/24.0L*a[30]*u23*v14 + (1.0L/24.0L)*a[30]*u23*v24 +
-                    (1.0L/32.0L)*a[31]*u14*v14 - 1.0L/32.0L*a[31]*u14*v24 - 1.0L/32.0L*a[31]*u24*v14 + (1.0L/32.0L)*a[31]*u24*v24)
-                   + w2 *
-                   (a[0]*u1*v1 - a[0]*u1*v2 - a[0]*u2*v1 + a[0]*u2*v2 +
-                    (1.0L/2.0L)*a[1]*u12*v1 - 1.0L/2.0L*a[1]*u12*v2 - 1.0L/2.0L*a[1]*u22*v1 + (1.0L/2.0L)*a[1]*u22*v2 +
-                    (1.0L/9.0L)*a[10]*u13*v13 - 1.0L/9.0L*a[10]*u13*v23 - 1.0L/9.0L*a[10]*u23*v13 + (1.0L/9.0L)*a[10]*u23*v23 +
-                    (1.0L/12.0L)*a[11]*u14*v13 - 1.0L/12.0L*a[11]*u14*v23 - 1.0L/12.0L*a[11]*u24*v13 + (1.0L/12.0L)*a[11]*u24*v23 +
-                    (1.0L/4.0L)*a[12]*u1*v14 - 1.0L/4.0L*a[12]*u1*v24 - 1.0L/4.0L*a[12]*u2*v14 + (1.0L/4.0L)*a[12]*u2*v24 +
-                    (1.0L/8.0L)*a[13]*u12*v14 - 1.0L/8.0L*a[13]*u12*v24 - 1.0L/8.0L*a[13]*u22*v14 + (1.0L/8.0L)*a[13]*u22*v24 +
-                    (1.0L/12.0L)*a[14]*u13*v14 - 1.0L/12.0L*a[14]*u13*v24 - 1.0L/12.0L*a[14]*u23*v14 + (1.0L/12.0L)*a[14]*u23*v24 +
-                    (1.0L/16.0L)*a[15]*u14*v14 - 1.0L/16.0L*a[15]*u14*v24 - 1.0L/16.0L*a[15]*u24*v14 + (1.0L/16.0L)*a[15]*u24*v24 +
-                    (1.0L/3.0L)*a[2]*u13*v1 - 1.0L/3.0L*a[2]*u13*v2 - 1.0L/3.0L*a[2]*u23*v1 + (1.0L/3.0L)*a[2]*u23*v2 +
-                    (1.0L/4.0L)*a[3]*u14*v1 - 1.0L/4.0L*a[3]*u14*v2 - 1.0L/4.0L*a[3]*u24*v1 + (1.0L/4.0L)*a[3]*u24*v2 +
-                    (1.0L/2.0L)*a[4]*u1*v12 - 1.0L/2.0L*a[4]*u1*v22 - 1.0L/2.0L*a[4]*u2*v12 + (1.0L/2.0L)*a[4]*u2*v22 +
-                    (1.0L/4.0L)*a[5]*u12*v12 - 1.0L/4.0L*a[5]*u12*v22 - 1.0L/4.0L*a[5]*u22*v12 + (1.0L/4.0L)*a[5]*u22*v22 +
-                    (1.0L/6.0L)*a[6]*u13*v12 - 1.0L/6.0L*a[6]*u13*v22 - 1.0L/6.0L*a[6]*u23*v12 + (1.0L/6.0L)*a[6]*u23*v22 +
-                    (1.0L/8.0L)*a[7]*u14*v12 - 1.0L/8.0L*a[7]*u14*v22 - 1.0L/8.0L*a[7]*u24*v12 + (1.0L/8.0L)*a[7]*u24*v22 +
-                    (1.0L/3.0L)*a[8]*u1*v13 - 1.0L/3.0L*a[8]*u1*v23 - 1.0L/3.0L*a[8]*u2*v13 + (1.0L/3.0L)*a[8]*u2*v23 +
-                    (1.0L/6.0L)*a[9]*u12*v13 - 1.0L/6.0L*a[9]*u12*v23 - 1.0L/6.0L*a[9]*u22*v13 + (1.0L/6.0L)*a[9]*u22*v23);
-    return C_result;
+    return TricubicKernel::integral(a, u1, v1, w1, u2, v2, w2);
 }
 
 double Energy::integralTricubicInterpolationEnergy(const Point3d& bmin, const Point3d& bmax) const {
-    Eigen::VectorXd x(6);
+    Vector6d x;
     x << bmin.x(), bmin.y(), bmin.z(), bmax.x(), bmax.y(), bmax.z();
     return integralTricubicInterpolationEnergy(x);
 
 }
 
-double Energy::integralTricubicInterpolationEnergy(const Eigen::VectorXd& x) const {
-    //g->deleteCubes();
+/**
+ * @brief Energy::integralTricubicInterpolationEnergy
+ *
+ * The cells strictly inside the range of cells touched by the box are completely
+ * contained in the box: their contribution is taken from the summed-volume table
+ * of the grid, and only the shell of the range is visited.
+ */
+double Energy::integralTricubicInterpolationEnergy(const Vector6d& x) const {
     double unit = g->getUnit();
+    BoundingBox3 bb = g->getBoundingBox();
 
-	Point3d min, max;
-    initializeMinMax(min, max, x);
+    double minbx = x(0), minby = x(1), minbz = x(2);
+    double maxbx = x(3), maxby = x(4), maxbz = x(5);
+    Point3i first, last;
+    g->getCellRange(first, last, Point3d(minbx, minby, minbz), Point3d(maxbx, maxby, maxbz));
+
+    double energy = g->getFullBoxValuesSum(first.x()+1, first.y()+1, first.z()+1, last.x(), last.y(), last.z());
+    static thread_local TricubicKernel::Batch batch;
+    batch.clear();
+
+    for (int i = first.x(); i <= last.x(); i++){
+        double x1 = bb.minX() + i*unit, x2 = x1 + unit;
+        bool xShell = i == first.x() || i == last.x();
+        for (int j = first.y(); j <= last.y(); j++){
+            double y1 = bb.minY() + j*unit, y2 = y1 + unit;
+            bool yShell = j == first.y() || j == last.y();
+            int kStep = xShell || yShell || last.z() == first.z() ? 1 : last.z() - first.z();
+            for (int k = first.z(); k <= last.z(); k += kStep){
+                double z1 = bb.minZ() + k*unit, z2 = z1 + unit;
+                if (minbx <= x1 && maxbx >= x2 &&
+                    minby <= y1 && maxby >= y2 &&
+                    minbz <= z1 && maxbz >= z2 ) { // completly contained
+                    energy += g->getCellFullBoxValue(i, j, k);
+                }
+                else { //partially contained
+                    const gridreal* coeffs = g->getCellCoefficients(i, j, k);
+                    double u1 = minbx < x1 ? x1 : minbx;
+                    double v1 = minby < y1 ? y1 : minby;
+                    double w1 = minbz < z1 ? z1 : minbz;
+                    double u2 = maxbx > x2 ? x2 : maxbx;
+                    double v2 = maxby > y2 ? y2 : maxby;
+                    double w2 = maxbz > z2 ? z2 : maxbz;
+                    u1 = (u1-x1)/unit;
+                    u2 = (u2-x1)/unit;
+                    v1 = (v1-y1)/unit;
+                    v2 = (v2-y1)/unit;
+                    w1 = (w1-z1)/unit;
+                    w2 = (w2-z1)/unit;
+                    double mu[4], mv[4], mw[4];
+                    TricubicKernel::moments(mu, u1, u2);
+                    TricubicKernel::moments(mv, v1, v2);
+                    TricubicKernel::moments(mw, w1, w2);
+                    batch.add(coeffs, mu, mv, mw, 0);
+                }
+            }
+        }
+    }
 
-    /*
-	const Point3d &c = bb.min();
-	Point3d d = c-Point3d(x(0), x(1), x(2));
-	Point3d nu = d / g->getUnit();
-    Pointi ni = Pointi(nu.x(), nu.y(), nu.z());
-    Pointi di = ni * g->getUnit();
-	Point3d min = c - Point3d(di.x(), di.y(), di.z());
-	d = c-Point3d(x(3), x(4), x(5));
-    nu = d / g->getUnit();
-    ni = Pointi(nu.x(), nu.y(), nu.z());
-    di = ni * g->getUnit();
-	Point3d max = c - Point3d(di.x(), di.y(), di.z());*/
+    batch.evaluate(&energy, precision);
+    return energy;
+}
 
+/**
+ * @brief Energy::integralAndGradientTricubicInterpolationEnergy
+ *
+ * Computes the integral of the interpolant on the box x and its gradient
+ * with a single walk on the shell of the cells touched by the box.
+ * Unlike gradientTricubicInterpolationEnergy, the gradient is divided by the unit
+ * of the grid, so that it is the derivative of the returned energy with respect to x
+ * as required by the line search of the BoxMinimizer (the only user of this path).
+ * @param gradient: output gradient of the integral
+ * @param x: box as (minx, miny, minz, maxx, maxy, maxz)
+ * @return the integral of the interpolant on the box
+ */
+double Energy::integralAndGradientTricubicInterpolationEnergy(Vector6d& gradient, const Vector6d& x) const {
+    double sums[7] = {0, 0, 0, 0, 0, 0, 0}; //integral of partial cells and gradient
+    static thread_local TricubicKernel::Batch batch;
+    batch.clear();
+    double energy = addIntegralAndGradientContractions(batch, x, 0);
+    batch.evaluate(sums, precision);
+    gradient << sums[1], sums[2], sums[3], sums[4], sums[5], sums[6];
+    gradient /= g->getUnit();
+    return energy + sums[0];
+}
+
+/**
+ * @brief Energy::energyAndGradient
+ *
+ * Evaluates energy and gradient of many boxes (one for every column of xs)
+ * with a single batch of contractions. Columns with a null state are skipped.
+ */
+void Energy::energyAndGradient(double* values, BoxLanes& gradients, const BoxLanes& xs, const std::vector<const BoxState*>& states) const {
+    unsigned int n = (unsigned int)xs.cols();
+    static thread_local TricubicKernel::Batch batch;
+    static thread_local std::vector<double> sums;
+    batch.clear();
+    sums.assign(7*n, 0);
+    for (unsigned int l = 0; l < n; l++){
+        if (states[l] != nullptr)
+            values[l] = addIntegralAndGradientContractions(batch, xs.col(l), 7*l);
+    }
+    batch.evaluate(sums.data(), precision);
+    for (unsigned int l = 0; l < n; l++){
+        if (states[l] == nullptr)
+            continue;
+        const BoxState& state = *states[l];
+        Vector6d x = xs.col(l), gradient, gBarrier;
+        gradient << sums[7*l+1], sums[7*l+2], sums[7*l+3], sums[7*l+4], sums[7*l+5], sums[7*l+6];
+        gradient /= g->getUnit();
+        double e = values[l] + sums[7*l];
+        if (!state.constraintsAsBounds){
+            gradientBarrier(gBarrier, x, state.c1, state.c2, state.c3);
+            gradient += gBarrier;
+            e += barrierEnergyStrict(x, state.c1, state.c2, state.c3);
+        }
+        if (state.hasLimits){
+            gradientBarrierLimits(gBarrier, x, state.limits);
+            gradient += gBarrier;
+            e += barrierLimitsEnergyStrict(x, state.limits);
+        }
+        gradients.col(l) = gradient;
+        values[l] = e;
+    }
+}
 
-    double firstX = min.x()-unit, firstY = min.y()-unit, firstZ = min.z()-unit, lastX = max.x()+unit, lastY = max.y()+unit, lastZ = max.z()+unit;
+/**
+ * @brief Energy::addIntegralAndGradientContractions
+ *
+ * Walks the shell of the cells touched by the box x. The shell is made exactly
+ * by the cells which contain a face of the box (the same slabs visited by
+ * gradientEvaluateComponent), while the cells inside the shell are taken from
+ * the summed-volume table of the grid.
+ * The contractions of the partially contained cells are added to batch on the
+ * slot firstSlot, the ones of the gradient on the slots firstSlot+1 .. firstSlot+6.
+ * @return the integral on the cells completely contained in the box
+ */
+double Energy::addIntegralAndGradientContractions(TricubicKernel::Batch& batch, const Vector6d& x, unsigned int firstSlot) const {
+    double unit = g->getUnit();
+    BoundingBox3 bb = g->getBoundingBox();
 
     double minbx = x(0), minby = x(1), minbz = x(2);
     double maxbx = x(3), maxby = x(4), maxbz = x(5);
-    double energy = 0;
-
-    double x1, y1, z1;
-    for (x1 = firstX; x1 <= lastX; x1+=unit){
-        double x2 = x1 + unit;
-        for (y1 = firstY; y1 <= lastY; y1+=unit){
-            double y2 = y1 + unit;
-            for (z1 = firstZ; z1<=lastZ; z1+=unit){
-                double z2 = z1 + unit;
-
-                if (maxbx <= x1 || minbx >= x2 ||
-                    maxby <= y1 || minby >= y2 ||
-                    maxbz <= z1 || minbz >= z2 ) // not contained
-                    energy += 0;
-                else {
-                    const gridreal* coeffs;
-					//g->getCoefficients(coeffs, Point3d(x1,y1,z1));
-                    if (minbx <= x1 && maxbx >= x2 &&
-                        minby <= y1 && maxby >= y2 &&
-                        minbz <= z1 && maxbz >= z2 ) { // completly contained
-						energy += g->getFullBoxValue(Point3d(x1,y1,z1));
-                        //energy += integralTricubicInterpolation(coeffs, 0,0,0,1,1,1);
-						//g->addCube(BoundingBox3(Point3d(x1,y1,z1), Point3d(x2,y2,z2)));
-                    }
-                    else { //partially contained
-						g->getCoefficients(coeffs, Point3d(x1,y1,z1));
-                        double u1 = minbx < x1 ? x1 : minbx;
-                        double v1 = minby < y1 ? y1 : minby;
-                        double w1 = minbz < z1 ? z1 : minbz;
-                        double u2 = maxbx > x2 ? x2 : maxbx;
-                        double v2 = maxby > y2 ? y2 : maxby;
-                        double w2 = maxbz > z2 ? z2 : maxbz;
-						//g->addCube(BoundingBox3(Point3d(u1,v1,w1), Point3d(u2,v2,w2)));
-                        u1 = (u1-x1)/unit;
-                        u2 = (u2-x1)/unit;
-                        v1 = (v1-y1)/unit;
-                        v2 = (v2-y1)/unit;
-                        w1 = (w1-z1)/unit;
-                        w2 = (w2-z1)/unit;
-                        energy += integralTricubicInterpolation(coeffs, u1,v1,w1,u2,v2,w2);
-                    }
-                }
-
+    Point3i first, last;
+    g->getCellRange(first, last, Point3d(minbx, minby, minbz), Point3d(maxbx, maxby, maxbz));
+
+    double energy = g->getFullBoxValuesSum(first.x()+1, first.y()+1, first.z()+1, last.x(), last.y(), last.z());
+
+    for (int i = first.x(); i <= last.x(); i++){
+        double x1 = bb.minX() + i*unit, x2 = x1 + unit;
+        bool xMinSlab = i == first.x();
+        bool xMaxSlab = i == last.x();
+        for (int j = first.y(); j <= last.y(); j++){
+            double y1 = bb.minY() + j*unit, y2 = y1 + unit;
+            bool yMinSlab = j == first.y();
+            bool yMaxSlab = j == last.y();
+            int kStep = xMinSlab || xMaxSlab || yMinSlab || yMaxSlab || last.z() == first.z() ? 1 : last.z() - first.z();
+            for (int k = first.z(); k <= last.z(); k += kStep){
+                double z1 = bb.minZ() + k*unit, z2 = z1 + unit;
+                bool zMinSlab = k == first.z();
+                bool zMaxSlab = k == last.z();
+
+                const gridreal* coeffs = g->getCellCoefficients(i, j, k);
+                double u1 = minbx < x1 ? x1 : minbx;
+                double v1 = minby < y1 ? y1 : minby;
+                double w1 = minbz < z1 ? z1 : minbz;
+                double u2 = maxbx > x2 ? x2 : maxbx;
+                double v2 = maxby > y2 ? y2 : maxby;
+                double w2 = maxbz > z2 ? z2 : maxbz;
+                u1 = (u1-x1)/unit;
+                u2 = (u2-x1)/unit;
+                v1 = (v1-y1)/unit;
+                v2 = (v2-y1)/unit;
+                w1 = (w1-z1)/unit;
+                w2 = (w2-z1)/unit;
+                double mu[4], mv[4], mw[4], p[4];
+                TricubicKernel::moments(mu, u1, u2);
+                TricubicKernel::moments(mv, v1, v2);
+                TricubicKernel::moments(mw, w1, w2);
+                if (minbx <= x1 && maxbx >= x2 &&
+                    minby <= y1 && maxby >= y2 &&
+                    minbz <= z1 && maxbz >= z2 ) // completely contained
+                    energy += g->getCellFullBoxValue(i, j, k);
+                else //partially contained
+                    batch.add(coeffs, mu, mv, mw, firstSlot);
+                if (xMinSlab) { TricubicKernel::powers(p, u1); batch.add(coeffs, p, mv, mw, firstSlot+1, -1); }
+                if (yMinSlab) { TricubicKernel::powers(p, v1); batch.add(coeffs, mu, p, mw, firstSlot+2, -1); }
+                if (zMinSlab) { TricubicKernel::powers(p, w1); batch.add(coeffs, mu, mv, p, firstSlot+3, -1); }
+                if (xMaxSlab) { TricubicKernel::powers(p, u2); batch.add(coeffs, p, mv, mw, firstSlot+4); }
+                if (yMaxSlab) { TricubicKernel::powers(p, v2); batch.add(coeffs, mu, p, mw, firstSlot+5); }
+                if (zMaxSlab) { TricubicKernel::powers(p, w2); batch.add(coeffs, mu, mv, p, firstSlot+6); }
             }
         }
     }
@@ -3,14 +3,36 @@
 
 #include "lib/grid/drawablegrid.h"
 #include "boxlist.h"
+#include "tricubickernel.h"
+#include "boxminimizer.h"
 
 #define EPSILON_GRAD 1e-8
 #define S_BARRIER 0.2
+#define LOCKSTEP_LANES 8
+#define COARSE_LEVELS_TOLERANCE 1e-6 //the minimizations on the coarse levels of the grid only need to be approximate
+#define COARSE_LEVELS_MIN_CELLS 8 //a box with limits uses a coarse level only if its limits span at least this number of cells of the level
+
+/**
+ * @brief The BoxQueue class
+ *
+ * Source of the boxes minimized by Energy::lockstepBFGS: a lane takes the next box
+ * when it is free, and gives it back when it is minimized.
+ */
+class BoxQueue {
+    public:
+        virtual ~BoxQueue() {}
+        virtual BoxState* next() = 0; //nullptr if there are no more boxes
+        virtual void finished(BoxState* state) = 0;
+};
 
 class Energy{
     public:
         Energy();
-        Energy(const Grid& g);
+        Energy(const Grid& g, TricubicKernel::Precision precision = TricubicKernel::DOUBLE_PRECISION);
+
+        TricubicKernel::Precision getPrecision() const;
+        void setPrecision(TricubicKernel::Precision precision);
+        double getTolerance() const;
 
         bool isInside(const Eigen::VectorXd &x) const;
         void calculateFullBoxValues(Grid& g) const;
@@ -28,13 +50,18 @@ class Energy{
 		int BFGS(Box3D &b, const cg3::Point3d &limits) const;
         int BFGS(Box3D &b, BoxList& iterations, bool saveIt = true) const;
 		int BFGS(Box3D &b, const cg3::Point3d& limits, BoxList& iterations, bool saveIt = true) const;
+        int BFGS(BoxState& state, int maxIterations, Box3D& b, BoxList& iterations, bool saveIt) const;
+        void lockstepBFGS(std::vector<BoxState>& states, unsigned int lanes = LOCKSTEP_LANES) const;
+        void lockstepBFGS(BoxQueue& queue, unsigned int lanes = LOCKSTEP_LANES) const;
 
         //Gradient Barrier
         double derivateGBarrier(double x, double s) const;
         double derivateFi(double x, double s) const;
 		void gradientBarrier(Eigen::VectorXd &gBarrier, const Eigen::VectorXd &x, const cg3::Point3d& c1, const cg3::Point3d& c2, const cg3::Point3d& c3, double s = S_BARRIER) const;
+        void gradientBarrier(Vector6d &gBarrier, const Vector6d &x, const cg3::Point3d& c1, const cg3::Point3d& c2, const cg3::Point3d& c3, double s = S_BARRIER) const;
         void gradientBarrier(Eigen::VectorXd& gBarrier, const Box3D& b, double s = S_BARRIER) const;
 		void gradientBarrierLimits(Eigen::VectorXd& gBarrier, const Eigen::VectorXd &x, const cg3::Point3d& l, double s = S_BARRIER) const;
+        void gradientBarrierLimits(Vector6d& gBarrier, const Vector6d &x, const cg3::Point3d& l, double s = S_BARRIER) const;
 		void gradientBarrierLimits(Eigen::VectorXd& gBarrier, const cg3::BoundingBox3& b, const cg3::Point3d& l, double s = S_BARRIER) const;
 
         // Gradient
@@ -51,6 +78,7 @@ class Energy{
         double gradientEvaluateXMaxComponent(const Eigen::VectorXd& x) const;
         double gradientEvaluateYMaxComponent(const Eigen::VectorXd &x) const;
         double gradientEvaluateZMaxComponent(const Eigen::VectorXd& x) const;
+        double gradientEvaluateComponent(const Eigen::VectorXd& x, unsigned int face) const;
 		void gradientTricubicInterpolationEnergy(Eigen::VectorXd &gradient, const cg3::Point3d& min, const cg3::Point3d& max) const;
         void gradientTricubicInterpolationEnergy(Eigen::VectorXd &gradient, const Eigen::VectorXd& x) const;
 		void gradientEnergy(Eigen::VectorXd &gradient, const Eigen::VectorXd& x, const cg3::Point3d& c1, const cg3::Point3d& c2, const cg3::Point3d& c3) const;
@@ -64,14 +92,19 @@ class Energy{
 
         double gBarrier(double x, double s) const;
         double fi(double x, double s) const;
+        double fiStrict(double x, double s) const;
 
         double barrierEnergy(const Box3D &b, double s = S_BARRIER) const;
+		double barrierEnergy(const Vector6d &x, const cg3::Point3d& c1, const cg3::Point3d& c2, const cg3::Point3d& c3, double s = S_BARRIER) const;
 		double barrierLimitsEnergy(const cg3::BoundingBox3& b, const cg3::Point3d& limits, double s = S_BARRIER) const;
+		double barrierLimitsEnergy(const Vector6d &x, const cg3::Point3d& limits, double s = S_BARRIER) const;
+        double barrierEnergyStrict(const Vector6d &x, const cg3::Point3d& c1, const cg3::Point3d& c2, const cg3::Point3d& c3, double s = S_BARRIER) const;
+        double barrierLimitsEnergyStrict(const Vector6d &x, const cg3::Point3d& limits, double s = S_BARRIER) const;
 
         // Integral
         static double integralTricubicInterpolation(const gridreal*& a, double u1, double v1, double w1, double u2, double v2, double w2);
 		double integralTricubicInterpolationEnergy(const cg3::Point3d& min, const cg3::Point3d& max) const;
-        double integralTricubicInterpolationEnergy(const Eigen::VectorXd &x) const;
+        double integralTricubicInterpolationEnergy(const Vector6d &x) const;
 
         // Total Energy
         double energy(const Box3D& b) const;
@@ -81,14 +114,61 @@ class Energy{
 		double energy(const Eigen::VectorXd& x, const cg3::Point3d& c1, const cg3::Point3d& c2, const cg3::Point3d& c3, const cg3::Point3d &limits) const;
 		double energy(double minx, double miny, double minz, double maxx, double maxy, double maxz, const cg3::Point3d& c1, const cg3::Point3d& c2, const cg3::Point3d& c3, const cg3::Point3d &limits) const;
 
+        // Fused Energy and Gradient
+        double integralAndGradientTricubicInterpolationEnergy(Vector6d &gradient, const Vector6d& x) const;
+		double energyAndGradient(Vector6d &gradient, const Vector6d& x, const cg3::Point3d& c1, const cg3::Point3d& c2, const cg3::Point3d& c3) const;
+		double energyAndGradient(Vector6d &gradient, const Vector6d& x, const cg3::Point3d& c1, const cg3::Point3d& c2, const cg3::Point3d& c3, const cg3::Point3d &limits) const;
+        double energyAndGradient(Vector6d &gradient, const Vector6d& x, const BoxState& state) const;
+        void energyAndGradient(double* values, BoxLanes& gradients, const BoxLanes& xs, const std::vector<const BoxState*>& states) const;
+
     private:
-		void initializeMinMax(cg3::Point3d& min, cg3::Point3d& max, const Eigen::VectorXd &x) const;
+        double addIntegralAndGradientContractions(TricubicKernel::Batch& batch, const Vector6d& x, unsigned int firstSlot) const;
+        bool isCoarseLevelUsed(const BoxState& state, const Grid& level) const;
+        unsigned int getFirstLevel(const BoxState& state, unsigned int level) const;
+        void minimize(BoxState& state, int maxIterations, const cg3::BoundingBox3& bb, double tolerance, Box3D& b, BoxList& iterations, bool saveIt) const;
         double volumeOfBox(const Eigen::VectorXd &x) const;
 
         const Grid* g;
+        TricubicKernel::Precision precision; //compute scalar of the cells, sums are always in double
 
 };
 
+inline TricubicKernel::Precision Energy::getPrecision() const {
+    return precision;
+}
+
+inline void Energy::setPrecision(TricubicKernel::Precision precision) {
+    this->precision = precision;
+}
+
+/**
+ * @brief Energy::getTolerance
+ * @return the relative decrease of the energy under which the minimizations stop
+ */
+inline double Energy::getTolerance() const {
+    return precision == TricubicKernel::SINGLE_PRECISION ? 1e-6 : 1e-12;
+}
+
+/**
+ * @brief Energy::isCoarseLevelUsed
+ * @return false if the box has limits too small to be minimized on the given coarse level
+ */
+inline bool Energy::isCoarseLevelUsed(const BoxState& state, const Grid& level) const {
+    return !state.hasLimits || std::max(std::max(state.limits.x(), state.limits.y()), state.limits.z()) >= COARSE_LEVELS_MIN_CELLS * level.getUnit();
+}
+
+/**
+ * @brief Energy::getFirstLevel
+ * @return the coarsest level of the pyramid, not coarser than level, on which the box is minimized
+ * (0 is the grid of this energy)
+ */
+inline unsigned int Energy::getFirstLevel(const BoxState& state, unsigned int level) const {
+    for (; level > 0; level--)
+        if (isCoarseLevelUsed(state, g->getCoarseLevel(level)))
+            return level;
+    return 0;
+}
+
 inline bool Energy::isInside(const Eigen::VectorXd& x) const {
 	return g->getBoundingBox().isIntern(cg3::Point3d(x(0), x(1), x(2))) && g->getBoundingBox().isIntern(cg3::Point3d(x(3), x(4), x(5)));
 }
@@ -157,17 +237,51 @@ inline double Energy::fi(double x, double s) const {
                         0 : (1 / gBarrier(x, s) - 1);
 }
 
+/**
+ * @brief Energy::fiStrict
+ * @return infinity outside the constraint (x <= 0), so that the line search
+ * of the BoxMinimizer rejects the step as a non finite value (derivateFi is 0 there).
+ * Used only by energyAndGradient, the other energies keep fi.
+ */
+inline double Energy::fiStrict(double x, double s) const {
+    return x <= 0 ? std::numeric_limits<double>::infinity() : fi(x, s);
+}
+
 inline double Energy::barrierEnergy(const Box3D& b, double s) const {
 	cg3::Point3d c1 = b.getConstraint1(), c2 = b.getConstraint2(), c3 = b.getConstraint3();
 	cg3::Point3d min = b.min(), max = b.max();
     return lowConstraint(min, c1, s) + lowConstraint(min, c2, s) + lowConstraint(min, c3, s) + highConstraint(max, c1, s) + highConstraint(max, c2, s) + highConstraint(max, c3, s);
 }
 
+inline double Energy::barrierEnergy(const Vector6d& x, const cg3::Point3d& c1, const cg3::Point3d& c2, const cg3::Point3d& c3, double s) const {
+    cg3::Point3d min(x(0), x(1), x(2)), max(x(3), x(4), x(5));
+    return lowConstraint(min, c1, s) + lowConstraint(min, c2, s) + lowConstraint(min, c3, s) + highConstraint(max, c1, s) + highConstraint(max, c2, s) + highConstraint(max, c3, s);
+}
+
 inline double Energy::barrierLimitsEnergy(const cg3::BoundingBox3& b, const cg3::Point3d& limits, double s) const {
 	cg3::Point3d bl(b.lengthX(), b.lengthY(), b.lengthZ());
     return lowConstraint(bl, limits, s);
 }
 
+inline double Energy::barrierLimitsEnergy(const Vector6d& x, const cg3::Point3d& limits, double s) const {
+    cg3::Point3d bl(x(3)-x(0), x(4)-x(1), x(5)-x(2));
+    return lowConstraint(bl, limits, s);
+}
+
+inline double Energy::barrierEnergyStrict(const Vector6d& x, const cg3::Point3d& c1, const cg3::Point3d& c2, const cg3::Point3d& c3, double s) const {
+    const cg3::Point3d* c[3] = {&c1, &c2, &c3};
+    double e = 0;
+    for (unsigned int i = 0; i < 3; i++)
+        e += fiStrict((*c[i]).x()-x(0), s) + fiStrict((*c[i]).y()-x(1), s) + fiStrict((*c[i]).z()-x(2), s);
+    for (unsigned int i = 0; i < 3; i++)
+        e += fiStrict(x(3)-(*c[i]).x(), s) + fiStrict(x(4)-(*c[i]).y(), s) + fiStrict(x(5)-(*c[i]).z(), s);
+    return e;
+}
+
+inline double Energy::barrierLimitsEnergyStrict(const Vector6d& x, const cg3::Point3d& limits, double s) const {
+    return fiStrict(limits.x()-(x(3)-x(0)), s) + fiStrict(limits.y()-(x(4)-x(1)), s) + fiStrict(limits.z()-(x(5)-x(2)), s);
+}
+
 
 
 inline double Energy::energy(const Box3D& b) const {
@@ -176,14 +290,14 @@ inline double Energy::energy(const Box3D& b) const {
 
 inline double Energy::energy(const Eigen::VectorXd &x, const cg3::Point3d& c1, const cg3::Point3d& c2, const cg3::Point3d& c3) const {
     assert(x.rows() == 6);
-	cg3::Point3d min(x(0), x(1), x(2)), max(x(3), x(4), x(5));
-    Box3D b(min, max, c1, c2, c3);
-    return integralTricubicInterpolationEnergy(x) + barrierEnergy(b);
+    Vector6d x6 = x;
+    return integralTricubicInterpolationEnergy(x6) + barrierEnergy(x6, c1, c2, c3);
 }
 
 inline double Energy::energy(double minx, double miny, double minz, double maxx, double maxy, double maxz, const cg3::Point3d& c1, const cg3::Point3d& c2, const cg3::Point3d& c3) const {
-	Box3D b(cg3::Point3d(minx, miny, minz), cg3::Point3d(maxx, maxy, maxz), c1, c2, c3);
-	return integralTricubicInterpolationEnergy(b.min(), b.max()) + barrierEnergy(b);
+    Vector6d x;
+    x << minx, miny, minz, maxx, maxy, maxz;
+    return integralTricubicInterpolationEnergy(x) + barrierEnergy(x, c1, c2, c3);
 }
 
 inline double Energy::energy(const Box3D& b, const cg3::Point3d &limits) const {
@@ -192,41 +306,47 @@ inline double Energy::energy(const Box3D& b, const cg3::Point3d &limits) const {
 
 inline double Energy::energy(const Eigen::VectorXd &x, const cg3::Point3d& c1, const cg3::Point3d& c2, const cg3::Point3d& c3, const cg3::Point3d &limits) const {
     assert(x.rows() == 6);
-	cg3::Point3d min(x(0), x(1), x(2)), max(x(3), x(4), x(5));
-    Box3D b(min, max, c1, c2, c3);
-    return integralTricubicInterpolationEnergy(x) + barrierEnergy(b) + barrierLimitsEnergy(b,limits);
+    Vector6d x6 = x;
+    return integralTricubicInterpolationEnergy(x6) + barrierEnergy(x6, c1, c2, c3) + barrierLimitsEnergy(x6, limits);
 }
 
 inline double Energy::energy(double minx, double miny, double minz, double maxx, double maxy, double maxz, const cg3::Point3d& c1, const cg3::Point3d& c2, const cg3::Point3d& c3, const cg3::Point3d &limits) const {
-	Box3D b(cg3::Point3d(minx, miny, minz), cg3::Point3d(maxx, maxy, maxz), c1, c2, c3);
-	return integralTricubicInterpolationEnergy(b.min(), b.max()) + barrierEnergy(b) + barrierLimitsEnergy(b,limits);
+    Vector6d x;
+    x << minx, miny, minz, maxx, maxy, maxz;
+    return integralTricubicInterpolationEnergy(x) + barrierEnergy(x, c1, c2, c3) + barrierLimitsEnergy(x, limits);
 }
 
-inline void Energy::initializeMinMax(cg3::Point3d& min, cg3::Point3d& max, const Eigen::VectorXd& x) const{
-    double unit = g->getUnit();
-	const cg3::BoundingBox3 &bb = g->getBoundingBox();
-    if (bb.isStrictlyIntern(x(0), x(1), x(2))){
-		min = g->getNearestGridPoint(cg3::Point3d(x(0), x(1), x(2)));
-    }
-    else {
-		const cg3::Point3d &c = bb.min();
-		cg3::Point3d d = c-cg3::Point3d(x(0), x(1), x(2));
-		cg3::Point3d nu = d / unit;
-		cg3::Point3i ni = cg3::Point3i(nu.x(), nu.y(), nu.z());
-		cg3::Point3i di = ni * unit;
-		min = c - cg3::Point3d(di.x(), di.y(), di.z());
-    }
-    if ((bb.isStrictlyIntern(x(3), x(4), x(5)))){
-		max = g->getNearestGridPoint(cg3::Point3d(x(3), x(4), x(5)));
-    }
-    else {
-		const cg3::Point3d &c = bb.min();
-		cg3::Point3d d = c-cg3::Point3d(x(3), x(4), x(5));
-		cg3::Point3d nu = d / unit;
-		cg3::Point3i ni = cg3::Point3i(nu.x(), nu.y(), nu.z());
-		cg3::Point3i di = ni * unit;
-		max = c - cg3::Point3d(di.x(), di.y(), di.z());
+inline double Energy::energyAndGradient(Vector6d& gradient, const Vector6d& x, const cg3::Point3d& c1, const cg3::Point3d& c2, const cg3::Point3d& c3) const {
+    double e = integralAndGradientTricubicInterpolationEnergy(gradient, x);
+    Vector6d gBarrier;
+    gradientBarrier(gBarrier, x, c1, c2, c3);
+    gradient += gBarrier;
+    return e + barrierEnergyStrict(x, c1, c2, c3);
+}
+
+inline double Energy::energyAndGradient(Vector6d& gradient, const Vector6d& x, const cg3::Point3d& c1, const cg3::Point3d& c2, const cg3::Point3d& c3, const cg3::Point3d& limits) const {
+    double e = energyAndGradient(gradient, x, c1, c2, c3);
+    Vector6d gBarrier;
+    gradientBarrierLimits(gBarrier, x, limits);
+    gradient += gBarrier;
+    return e + barrierLimitsEnergyStrict(x, limits);
+}
+
+inline double Energy::energyAndGradient(Vector6d& gradient, const Vector6d& x, const BoxState& state) const {
+    if (state.constraintsAsBounds){ //the constraint points are bounds of the minimizer, no barrier
+        double e = integralAndGradientTricubicInterpolationEnergy(gradient, x);
+        if (state.hasLimits){
+            Vector6d gBarrier;
+            gradientBarrierLimits(gBarrier, x, state.limits);
+            gradient += gBarrier;
+            e += barrierLimitsEnergyStrict(x, state.limits);
+        }
+        return e;
     }
+    if (state.hasLimits)
+        return energyAndGradient(gradient, x, state.c1, state.c2, state.c3, state.limits);
+    else
+        return energyAndGradient(gradient, x, state.c1, state.c2, state.c3);
 }
 
 inline double Energy::volumeOfBox(const Eigen::VectorXd& x) const {
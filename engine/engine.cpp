@@ -3,7 +3,6 @@
 #include <cg3/meshes/dcel/algorithms/dcel_algorithms.h>
 #include <cg3/geometry/transformations3.h>
 #include <cg3/utilities/set.h>
-#include <cg3/libigl/decimate.h>
 #include <cg3/libigl/booleans.h>
 #include <cg3/libigl/mesh_adjacencies.h>
 #include <cg3/libigl/connected_components.h>
@@ -15,12 +14,18 @@
 
 #include <cg3/cgal/polyhedron.h>
 #include "unsigned_distances.h"
+#include "voxelization.h"
+#include "distancefield.h"
+#include "progressivemesh.h"
+#include "setcover.h"
 #include <CGAL/mesh_segmentation.h>
 #include <CGAL/property_map.h>
 
 #include "splitting.h"
 #include "reconstruction.h"
 #include <cg3/algorithms/global_optimal_rotation_matrix.h>
+#include <chrono>
+#include <iomanip>
 
 using namespace cg3;
 
@@ -144,16 +149,19 @@ void Engine::getFlippedFaces(std::set<const Dcel::Face*> &flippedFaces, std::set
     }
 }
 
-void Engine::generateGridAndDistanceField(Array3D<Point3d> &grid, Array3D<gridreal> &distanceField, const SimpleEigenMesh &m, bool generateDistanceField, double gridUnit, bool integer){
-    assert(gridUnit > 0);
+/**
+ * @brief getGridBounds
+ *
+ * Bounding box (nGmin, nGmax) of the grid generated by generateGridAndDistanceField for the mesh m.
+ * @return the resolution of the grid
+ */
+static Point3i getGridBounds(Eigen::RowVector3d& nGmin, Eigen::RowVector3d& nGmax, const SimpleEigenMesh& m, double& gridUnit, bool integer) {
     // Bounding Box
     Eigen::RowVector3d Vmin, Vmax;
 	m.boundingBox(Vmin, Vmax);
 
     // create grid GV
     Eigen::RowVector3d border((int)gridUnit*5, (int)gridUnit*5, (int)gridUnit*5);
-    Eigen::RowVector3d nGmin;
-    Eigen::RowVector3d nGmax;
     if (integer) {
         Eigen::RowVector3i Gmini = (Vmin).cast<int>() - border.cast<int>();
         Eigen::RowVector3i Gmaxi = (Vmax).cast<int>() + border.cast<int>();
@@ -167,7 +175,15 @@ void Engine::generateGridAndDistanceField(Array3D<Point3d> &grid, Array3D<gridre
         nGmax = Vmax + border; //bounding box of the Grid
     }
     Eigen::RowVector3i res = (nGmax.cast<int>() - nGmin.cast<int>())/2;
-    unsigned int sizeX = res(0)+1, sizeY = res(1)+1, sizeZ = res(2)+1;
+    return Point3i(res(0)+1, res(1)+1, res(2)+1);
+}
+
+void Engine::generateGridAndDistanceField(Array3D<Point3d> &grid, Array3D<gridreal> &distanceField, const SimpleEigenMesh &m, bool generateDistanceField, double gridUnit, bool integer, DistanceFieldMode distanceFieldMode){
+    assert(gridUnit > 0);
+    Eigen::RowVector3d nGmin;
+    Eigen::RowVector3d nGmax;
+    Point3i res = getGridBounds(nGmin, nGmax, m, gridUnit, integer);
+    unsigned int sizeX = res.x(), sizeY = res.y(), sizeZ = res.z();
     std::vector<double> distances;
     Array3D<int> mapping(sizeX, sizeY, sizeZ, -1);
 	std::vector<Point3d> insidePoints;
@@ -178,9 +194,6 @@ void Engine::generateGridAndDistanceField(Array3D<Point3d> &grid, Array3D<gridre
         distanceField.resize(sizeX, sizeY, sizeZ);
         distanceField.fill(1);
     }
-	cgal::AABBTree3 tree(m, true);
-    Array3D<unsigned char> isInside(sizeX, sizeY, sizeZ);
-    isInside.fill(false);
 
     int xi = nGmin(0), yi = nGmin(1), zi = nGmin(2);
     for (unsigned int i = 0; i < sizeX; ++i){
@@ -196,8 +209,12 @@ void Engine::generateGridAndDistanceField(Array3D<Point3d> &grid, Array3D<gridre
         xi += gridUnit;
     }
 
-    if (generateDistanceField){
+    if (generateDistanceField && distanceFieldMode != NO_DISTANCE_FIELD){
         unsigned int rr =  sizeX * sizeY * sizeZ;
+        cgal::AABBTree3 tree(m, true);
+        Array3D<unsigned char> isInside(sizeX, sizeY, sizeZ);
+
+        getInsideGridPoints(isInside, m, grid(0,0,0), gridUnit);
 
         #pragma omp parallel for
         for (unsigned int n = 0; n < rr; n++){
@@ -205,35 +222,61 @@ void Engine::generateGridAndDistanceField(Array3D<Point3d> &grid, Array3D<gridre
             unsigned int j = ((n-k)/sizeZ)%sizeY;
             unsigned int i = ((n-k)/sizeZ - j)/sizeY;
             ///
-            isInside(i,j,k) = tree.isInside(grid(i,j,k), 3);
+            if (isInside(i,j,k) == VOXEL_UNKNOWN)
+                isInside(i,j,k) = tree.isInside(grid(i,j,k), 3);
             //isInside(i,j,k) = tree.isInsidePseudoRandom(grid(i,j,k), 3);
             ///
         }
 
-        for (unsigned int i = 0; i < sizeX; i++){
-            for (unsigned int j = 0; j < sizeY; j++){
-                for (unsigned int k = 0; k < sizeZ; k++){
-                    if (isInside(i,j,k)){
-                        insidePoints.push_back(grid(i,j,k));
-                        mapping(i,j,k) = inside;
-                        inside++;
+        if (distanceFieldMode == NARROW_BAND_DISTANCE_FIELD){
+            // exact distances near the surface, eikonal solution in the interior
+            std::vector<Point3i> band = getNarrowBand(isInside);
+            for (const Point3i& p : band)
+                insidePoints.push_back(grid(p.x(), p.y(), p.z()));
+            distances = getUnsignedDistances(insidePoints, tree);
+
+            Array3D<double> euclideanDistances(sizeX, sizeY, sizeZ, 0);
+            for (unsigned int i = 0; i < sizeX; i++)
+                for (unsigned int j = 0; j < sizeY; j++)
+                    for (unsigned int k = 0; k < sizeZ; k++)
+                        if (isInside(i,j,k))
+                            euclideanDistances(i,j,k) = std::numeric_limits<double>::infinity();
+            for (unsigned int n = 0; n < band.size(); n++)
+                euclideanDistances(band[n].x(), band[n].y(), band[n].z()) = std::sqrt(distances[n]);
+            fastSweeping(euclideanDistances, isInside, gridUnit);
+
+            for (unsigned int i = 0; i < sizeX; i++)
+                for (unsigned int j = 0; j < sizeY; j++)
+                    for (unsigned int k = 0; k < sizeZ; k++)
+                        if (isInside(i,j,k))
+                            distanceField(i,j,k) = -euclideanDistances(i,j,k)*euclideanDistances(i,j,k);
+        }
+        else {
+            for (unsigned int i = 0; i < sizeX; i++){
+                for (unsigned int j = 0; j < sizeY; j++){
+                    for (unsigned int k = 0; k < sizeZ; k++){
+                        if (isInside(i,j,k)){
+                            insidePoints.push_back(grid(i,j,k));
+                            mapping(i,j,k) = inside;
+                            inside++;
+                        }
                     }
                 }
             }
-        }
 
 
-        // compute values
-        //Eigen::VectorXd S = m.getSignedDistance(GV);
+            // compute values
+            //Eigen::VectorXd S = m.getSignedDistance(GV);
 
-		distances = getUnsignedDistances(insidePoints, tree);
+            distances = getUnsignedDistances(insidePoints, tree);
 
-        for (unsigned int i = 0; i < sizeX; i++){
-            for (unsigned int j = 0; j < sizeY; j++){
-                for (unsigned int k = 0; k < sizeZ; k++){
-                    if (isInside(i,j,k)){
-                        assert(mapping(i,j,k) >= 0);
-                        distanceField(i,j,k) = -distances[mapping(i,j,k)];
+            for (unsigned int i = 0; i < sizeX; i++){
+                for (unsigned int j = 0; j < sizeY; j++){
+                    for (unsigned int k = 0; k < sizeZ; k++){
+                        if (isInside(i,j,k)){
+                            assert(mapping(i,j,k) >= 0);
+                            distanceField(i,j,k) = -distances[mapping(i,j,k)];
+                        }
                     }
                 }
             }
@@ -242,14 +285,36 @@ void Engine::generateGridAndDistanceField(Array3D<Point3d> &grid, Array3D<gridre
 }
 
 void Engine::calculateGridWeights(Grid& g, const Array3D<Point3d> &grid, const Array3D<gridreal> &distanceField, const Dcel& d, double kernelDistance, bool tolerance, const Vec3d &target, std::set<const Dcel::Face*>& savedFaces){
+    CellFaces cellFaces;
+    calculateCellFaces(cellFaces, grid, distanceField, d);
+    calculateGridWeights(g, grid, distanceField, cellFaces, kernelDistance, tolerance, target, savedFaces);
+}
+
+/**
+ * @brief Engine::calculateGridWeights
+ * @param cellFaces: faces contained in the cells of the grid (see calculateCellFaces),
+ * shared by the grids of all the targets
+ * @param lazy: the cells of the grid are computed only when touched (see Grid::setLazy)
+ * @param coarseLevels: the pyramid of the grid is built, for the coarse-to-fine growth of the boxes
+ */
+void Engine::calculateGridWeights(Grid& g, const Array3D<Point3d> &grid, const Array3D<gridreal> &distanceField, const CellFaces& cellFaces, double kernelDistance, bool tolerance, const Vec3d &target, std::set<const Dcel::Face*>& savedFaces, bool lazy, bool coarseLevels){
 	Point3i res(grid.sizeX(), grid.sizeY(), grid.sizeZ());
 	Point3d nGmin(grid(0,0,0));
 	Point3d nGmax(grid(res.x()-1, res.y()-1, res.z()-1));
     g = Grid(res, grid, distanceField, nGmin, nGmax);
     g.setTarget(target);
-    g.calculateWeightsAndFreezeKernel(d, kernelDistance, tolerance, savedFaces);
+    g.setLazy(lazy);
+    g.calculateWeightsAndFreezeKernel(cellFaces, kernelDistance, tolerance, savedFaces);
     Energy e(g);
     e.calculateFullBoxValues(g);
+    if (coarseLevels)
+        g.calculatePyramid();
+}
+
+void Engine::calculateCellFaces(CellFaces& cellFaces, const Array3D<Point3d>& grid, const Array3D<gridreal>& distanceField, const Dcel& d) {
+	Point3i res(grid.sizeX(), grid.sizeY(), grid.sizeZ());
+    Grid g(res, grid, distanceField, grid(0,0,0), grid(res.x()-1, res.y()-1, res.z()-1));
+    g.calculateCellFaces(cellFaces, d);
 }
 
 Array3D<gridreal> Engine::generateGrid(Grid& g, const Dcel& d, double kernelDistance, bool tolerance, const Vec3d &target, std::set<const Dcel::Face*>& savedFaces) {
@@ -323,10 +388,10 @@ void Engine::addBox(BoxList& boxList, const Vec3d target, const Dcel::Face* f, c
         boxList.addBox(box);
 }
 
-void Engine::calculateDecimatedBoxes(BoxList& boxList, const Dcel& d, const Eigen::VectorXi &mapping, const std::set<int>& coveredFaces, const Eigen::Matrix3d& rot, int orientation, bool onlyTarget, const Vec3d& target) {
+void Engine::calculateDecimatedBoxes(BoxList& boxList, const Dcel& d, const Eigen::VectorXi &mapping, const AtomicBitset& coveredFaces, const Eigen::Matrix3d& rot, int orientation, bool onlyTarget, const Vec3d& target) {
     std::vector<int> facesToCover;
     for (unsigned int i = 0; i < mapping.size(); i++){
-        if (coveredFaces.find(mapping(i)) == coveredFaces.end()){
+        if (!coveredFaces.test(mapping(i))){
             facesToCover.push_back(mapping(i));
         }
     }
@@ -354,46 +419,416 @@ void Engine::calculateInitialBoxes(BoxList& boxList, const Dcel& d, const Eigen:
     }
 }
 
-void Engine::expandBoxes(BoxList& boxList, const Grid& g, bool limit, const Point3d& limits, bool printTimes) {
-    Energy e(g);
-    Timer total("Boxlist expanding");
-    int np = boxList.getNumberBoxes();
-    Timer t("");
-    #pragma omp parallel for schedule(dynamic, 2)
-    for (int i = 0; i < np; i++){
-        Box3D b = boxList.getBox(i);
-        if (printTimes){
-            std::cerr << "Minimization " << i << " box.\n";
-            t = Timer("");
-        }
-        //e.gradientDiscend(b);
-        if (!limit)
-            e.BFGS(b);
-        else{
-			//put the Z limit to the milling direction of the box b
-			//the other two directions will have X and Y accordingly
-			//they can be switched at will
-			Point3d actualLimits(std::min(limits.x(), limits.y()), std::min(limits.x(), limits.y()), std::min(limits.x(), limits.y())); //all the limits set to min(X, Y)
-            bool find = false;
-            for (unsigned int i = 0; i < 3 && !find; i++){
-                if (XYZ[i] == b.getTarget() || XYZ[i+3] == b.getTarget()){
-					actualLimits[i] = limits.z(); //the proper one is set to Z
-                    find = true;
-					actualLimits[(i+1)%3] = std::max(limits.x(), limits.y()); //one of the other two is set to max(X, Y)
-                }
-            }
-            assert(find);
-            e.BFGS(b,actualLimits);
+/**
+ * @brief getBoxLimits
+ *
+ * Puts the Z limit to the milling direction of the box b,
+ * the other two directions will have X and Y accordingly
+ * (they can be switched at will)
+ */
+static Point3d getBoxLimits(const Box3D& b, const Point3d& limits) {
+    Point3d actualLimits(std::min(limits.x(), limits.y()), std::min(limits.x(), limits.y()), std::min(limits.x(), limits.y())); //all the limits set to min(X, Y)
+    bool find = false;
+    for (unsigned int i = 0; i < 3 && !find; i++){
+        if (XYZ[i] == b.getTarget() || XYZ[i+3] == b.getTarget()){
+            actualLimits[i] = limits.z(); //the proper one is set to Z
+            find = true;
+            actualLimits[(i+1)%3] = std::max(limits.x(), limits.y()); //one of the other two is set to max(X, Y)
+        }
+    }
+    assert(find);
+    return actualLimits;
+}
+
+void Engine::expandBoxes(BoxList& boxList, const Grid& g, bool limit, const Point3d& limits, bool printTimes, BoxOptimizer optimizer, TricubicKernel::Precision precision) {
+    std::vector<BoxList*> boxLists(1, &boxList);
+    std::vector<const Grid*> grids(1, &g);
+    expandBoxes(boxLists, grids, limit, limits, printTimes, optimizer, precision);
+}
+
+namespace {
+
+/**
+ * @brief The GrowthTask struct
+ *
+ * Boxes [first, end) of a box list, grown together by a thread.
+ * The tasks with the greatest estimate are taken first.
+ */
+struct GrowthTask {
+    double estimate;
+    unsigned int list;
+    int first, end;
+
+    bool operator<(const GrowthTask& other) const {
+        if (estimate != other.estimate)
+            return estimate > other.estimate;
+        if (list != other.list)
+            return list < other.list;
+        return first < other.first;
+    }
+};
+
+/**
+ * @brief The FinishedBoxes class
+ *
+ * Boxes already grown on a grid, in a uniform grid of buckets covering the bounding box
+ * of the grid: every box is stored in all the buckets it intersects, so the boxes
+ * which may contain a point are the ones in its bucket. Thread safe.
+ * Every bucket is a list to which the boxes are only prepended: a box is published by
+ * an atomic write of the head after being written, so the lookups read the lists without
+ * locks and never exclude each other; the insertions in a bucket are serialized by its lock.
+ */
+class FinishedBoxes {
+    public:
+        FinishedBoxes();
+        ~FinishedBoxes();
+
+        void setBoundingBox(const BoundingBox3& bb);
+        void addBox(const Box3D& b);
+        bool containsSeed(const Box3D& b) const;
+
+    private:
+        struct Node {
+            BoundingBox3 box;
+            const Node* next;
+        };
+
+        FinishedBoxes(const FinishedBoxes&);
+        FinishedBoxes& operator=(const FinishedBoxes&);
+
+        int getBucket(double x, unsigned int axis) const;
+
+        static const int N_BUCKETS = 16; //per axis
+        BoundingBox3 bb;
+        std::vector<const Node*> heads;
+        std::vector<omp_lock_t> locks;
+};
+
+FinishedBoxes::FinishedBoxes() : heads(N_BUCKETS*N_BUCKETS*N_BUCKETS, nullptr), locks(N_BUCKETS*N_BUCKETS*N_BUCKETS) {
+    for (omp_lock_t& lock : locks)
+        omp_init_lock(&lock);
+}
+
+FinishedBoxes::~FinishedBoxes() {
+    for (unsigned int i = 0; i < heads.size(); i++){
+        while (heads[i] != nullptr){
+            const Node* next = heads[i]->next;
+            delete heads[i];
+            heads[i] = next;
         }
-        if (printTimes){
-            t.stop();
-            std::cerr << "Box: " << i << "Time: " << t.delay() << "\n";
+        omp_destroy_lock(&locks[i]);
+    }
+}
+
+void FinishedBoxes::setBoundingBox(const BoundingBox3& bb) {
+    this->bb = bb;
+}
+
+void FinishedBoxes::addBox(const Box3D& b) {
+    int i1 = getBucket(b.min().x(), 0), j1 = getBucket(b.min().y(), 1), k1 = getBucket(b.min().z(), 2);
+    int i2 = getBucket(b.max().x(), 0), j2 = getBucket(b.max().y(), 1), k2 = getBucket(b.max().z(), 2);
+    for (int i = i1; i <= i2; i++){
+        for (int j = j1; j <= j2; j++){
+            for (int k = k1; k <= k2; k++){
+                int bucket = (i*N_BUCKETS + j)*N_BUCKETS + k;
+                Node* node = new Node;
+                node->box = BoundingBox3(b.min(), b.max());
+                omp_set_lock(&locks[bucket]);
+                node->next = heads[bucket];
+                #pragma omp atomic write seq_cst
+                heads[bucket] = node;
+                omp_unset_lock(&locks[bucket]);
+            }
         }
-        boxList.setBox(i, b);
+    }
+}
+
+/**
+ * @brief FinishedBoxes::containsSeed
+ * @return true if the seed triangle of b is inside one of the boxes
+ */
+bool FinishedBoxes::containsSeed(const Box3D& b) const {
+    const Point3d& c1 = b.getConstraint1();
+    int bucket = (getBucket(c1.x(), 0)*N_BUCKETS + getBucket(c1.y(), 1))*N_BUCKETS + getBucket(c1.z(), 2);
+    const Node* node;
+    #pragma omp atomic read seq_cst
+    node = heads[bucket];
+    for (; node != nullptr; node = node->next)
+        if (node->box.isIntern(c1) && node->box.isIntern(b.getConstraint2()) && node->box.isIntern(b.getConstraint3()))
+            return true;
+    return false;
+}
+
+int FinishedBoxes::getBucket(double x, unsigned int axis) const {
+    double length = bb.max()[axis] - bb.min()[axis];
+    if (length <= 0)
+        return 0;
+    int bucket = (int)((x - bb.min()[axis]) / length * N_BUCKETS);
+    return std::max(0, std::min(N_BUCKETS-1, bucket));
+}
+
+}
+
+/**
+ * @brief getSeedArea
+ *
+ * Doubled area of the seed triangle of the box, an estimate of the
+ * time needed to grow it.
+ */
+static double getSeedArea(const Box3D& b) {
+    return (b.getConstraint2() - b.getConstraint1()).cross(b.getConstraint3() - b.getConstraint1()).length();
+}
+
+/**
+ * @brief addCoveredFaces
+ *
+ * Adds to the coverage the faces completely contained in the box b of the list l.
+ * The trees must have their search structures already built (see buildAABBTree).
+ */
+static void addCoveredFaces(Engine::FaceCoverage& coverage, unsigned int l, const Box3D& b) {
+    std::list<const Dcel::Face*> list;
+    coverage.trees[l]->completelyContainedDcelFaces(list, b);
+    unsigned int n = 0;
+    for (const Dcel::Face* f : list)
+        if (coverage.faces.set(f->id()))
+            n++;
+    #pragma omp atomic update
+    coverage.newFaces[l] += n;
+}
+
+namespace {
+
+/**
+ * @brief The SeedQueue class
+ *
+ * The seeds of a box list, in order, shared by all the threads growing them with
+ * Energy::lockstepBFGS: every lane takes the next seed of the list as soon as it is free.
+ * Every thread has its own SeedQueue, the position in the list is shared.
+ * The grown boxes are stored in the list (and added to the finished boxes and to the coverage).
+ */
+class SeedQueue : public BoxQueue {
+    public:
+        SeedQueue(BoxList& boxList, unsigned int list, const std::vector<int>& order, int& position, bool limit, const Point3d& limits, FinishedBoxes* finishedBoxes, std::vector<unsigned char>& pruned, Engine::FaceCoverage* coverage);
+        BoxState* next();
+        void finished(BoxState* state);
+
+        long long nIterations, nEnergyEvaluations, nGradientEvaluations;
+        int nPruned;
+
+    private:
+        BoxList& boxList;
+        unsigned int list;
+        const std::vector<int>& order; //indices of the seeds in the list
+        int& position; //next element of order, shared by the threads
+        bool limit;
+        Point3d limits;
+        FinishedBoxes* finishedBoxes; //nullptr if the seeds inside the grown boxes are not pruned
+        std::vector<unsigned char>& pruned;
+        Engine::FaceCoverage* coverage;
+        BoxState states[LOCKSTEP_LANES]; //of the boxes in the lanes
+        int indices[LOCKSTEP_LANES];
+        std::vector<unsigned int> freeStates;
+};
+
+SeedQueue::SeedQueue(BoxList& boxList, unsigned int list, const std::vector<int>& order, int& position, bool limit, const Point3d& limits, FinishedBoxes* finishedBoxes, std::vector<unsigned char>& pruned, Engine::FaceCoverage* coverage) :
+    nIterations(0), nEnergyEvaluations(0), nGradientEvaluations(0), nPruned(0), boxList(boxList), list(list), order(order), position(position),
+    limit(limit), limits(limits), finishedBoxes(finishedBoxes), pruned(pruned), coverage(coverage) {
+    for (unsigned int s = 0; s < LOCKSTEP_LANES; s++)
+        freeStates.push_back(s);
+}
 
+BoxState* SeedQueue::next() {
+    assert(!freeStates.empty());
+    int p;
+    do {
+        #pragma omp atomic capture
+        p = position++;
+        if (p >= (int)order.size())
+            return nullptr;
+        Box3D b = boxList.getBox(order[p]);
+        if (finishedBoxes != nullptr && finishedBoxes->containsSeed(b)){
+            pruned[order[p]] = true;
+            nPruned++;
+            continue;
+        }
+        unsigned int s = freeStates.back();
+        freeStates.pop_back();
+        states[s] = limit ? BoxState(b, getBoxLimits(b, limits)) : BoxState(b);
+        indices[s] = order[p];
+        return &states[s];
+    } while (true);
+}
+
+void SeedQueue::finished(BoxState* state) {
+    unsigned int s = state - states;
+    Box3D b = boxList.getBox(indices[s]);
+    state->setTo(b);
+    boxList.setBox(indices[s], b);
+    if (finishedBoxes != nullptr)
+        finishedBoxes->addBox(b);
+    if (coverage != nullptr)
+        addCoveredFaces(*coverage, list, b);
+    nIterations += state->nIterations;
+    nEnergyEvaluations += state->nEnergyEvaluations;
+    nGradientEvaluations += state->nGradientEvaluations;
+    freeStates.push_back(s);
+}
+
+}
+
+/**
+ * @brief Engine::expandBoxes
+ *
+ * Grows the boxes of all the lists, every list on its grid: the boxes of all the lists
+ * are put in a single pool of tasks, taken by the threads longest expected first,
+ * so the threads do not wait for the last boxes of a list before starting the next one.
+ * With LOCKSTEP_BFGS the lanes of a thread can only grow boxes of the same grid:
+ * the threads start on different lists, and every lane takes the next seed of the list
+ * (longest expected first) as soon as it is free (see SeedQueue); a thread moves on the
+ * next list when all the seeds of its list have been taken.
+ * @param pruneCoveredSeeds: if true, a box whose seed triangle is inside a box of the
+ * same list which has already been grown is not grown, and it is removed from its list
+ * (which boxes are removed depends on the order in which the threads finish them)
+ * @param coverage: if not null, the faces covered by every box are added to it when the box is grown
+ */
+void Engine::expandBoxes(const std::vector<BoxList*>& boxLists, const std::vector<const Grid*>& grids, bool limit, const Point3d& limits, bool printTimes, BoxOptimizer optimizer, TricubicKernel::Precision precision, bool pruneCoveredSeeds, FaceCoverage* coverage) {
+    assert(boxLists.size() == grids.size());
+    std::vector<Energy> energies(grids.size());
+    for (unsigned int l = 0; l < grids.size(); l++)
+        energies[l] = Energy(*grids[l], precision);
+    Timer total("Boxlist expanding");
+    std::vector<GrowthTask> tasks;
+    int np = 0;
+    for (unsigned int l = 0; l < boxLists.size(); l++){
+        int n = boxLists[l]->getNumberBoxes();
+        np += n;
+        for (int i = 0; i < n; i++){
+            GrowthTask task;
+            task.estimate = getSeedArea(boxLists[l]->getBox(i));
+            task.list = l;
+            task.first = i;
+            task.end = i + 1;
+            tasks.push_back(task);
+        }
+    }
+    std::sort(tasks.begin(), tasks.end());
+    std::vector<FinishedBoxes> finishedBoxes(pruneCoveredSeeds ? boxLists.size() : 0);
+    std::vector<std::vector<unsigned char> > pruned(boxLists.size());
+    if (pruneCoveredSeeds){
+        for (unsigned int l = 0; l < boxLists.size(); l++){
+            finishedBoxes[l].setBoundingBox(grids[l]->getBoundingBox());
+            pruned[l].resize(boxLists[l]->getNumberBoxes(), false);
+        }
+    }
+
+    long long nIterations = 0, nEnergyEvaluations = 0, nGradientEvaluations = 0;
+    int nPruned = 0;
+    if (optimizer == LOCKSTEP_BFGS){
+        //the seeds of every list, longest expected first
+        std::vector<std::vector<int> > orders(boxLists.size());
+        for (const GrowthTask& task : tasks)
+            orders[task.list].push_back(task.first);
+        std::vector<int> positions(boxLists.size(), 0);
+        #pragma omp parallel reduction(+:nIterations, nEnergyEvaluations, nGradientEvaluations, nPruned)
+        {
+            unsigned int firstList = omp_get_thread_num();
+            for (unsigned int k = 0; k < boxLists.size(); k++){
+                unsigned int l = (firstList + k) % boxLists.size();
+                SeedQueue queue(*boxLists[l], l, orders[l], positions[l], limit, limits, pruneCoveredSeeds ? &finishedBoxes[l] : nullptr, pruned[l], coverage);
+                energies[l].lockstepBFGS(queue);
+                nIterations += queue.nIterations;
+                nEnergyEvaluations += queue.nEnergyEvaluations;
+                nGradientEvaluations += queue.nGradientEvaluations;
+                nPruned += queue.nPruned;
+            }
+        }
+    }
+    else {
+        #pragma omp parallel for schedule(dynamic, 1) reduction(+:nIterations, nEnergyEvaluations, nGradientEvaluations, nPruned)
+        for (int t = 0; t < (int)tasks.size(); t++){
+            unsigned int l = tasks[t].list;
+            BoxList& boxList = *boxLists[l];
+            const Energy& e = energies[l];
+            int i = tasks[t].first;
+            Box3D b = boxList.getBox(i);
+            if (pruneCoveredSeeds && finishedBoxes[l].containsSeed(b)){
+                pruned[l][i] = true;
+                nPruned++;
+                continue;
+            }
+            BoxList dummy;
+            Timer timer("");
+            if (printTimes)
+                std::cerr << "Minimization " << i << " box.\n";
+            //e.gradientDiscend(b);
+            BoxState state = limit ? BoxState(b, getBoxLimits(b, limits)) : BoxState(b);
+            state.constraintsAsBounds = optimizer == BOUNDED_BFGS;
+            e.BFGS(state, limit ? MAX_BFGS_LIMITS_ITERATIONS : MAX_BFGS_ITERATIONS, b, dummy, false);
+            if (printTimes){
+                timer.stop();
+                std::cerr << "Box: " << i << "Time: " << timer.delay() << "\n";
+            }
+            boxList.setBox(i, b);
+            if (pruneCoveredSeeds)
+                finishedBoxes[l].addBox(b);
+            if (coverage != nullptr)
+                addCoveredFaces(*coverage, l, b);
+            nIterations += state.nIterations;
+            nEnergyEvaluations += state.nEnergyEvaluations;
+            nGradientEvaluations += state.nGradientEvaluations;
+        }
+    }
+    //the pruned seeds have not been grown
+    for (unsigned int l = 0; l < pruned.size() && pruneCoveredSeeds; l++){
+        BoxList& boxList = *boxLists[l];
+        unsigned int n = 0;
+        for (unsigned int i = 0; i < pruned[l].size(); i++)
+            if (!pruned[l][i])
+                boxList.setBox(n++, boxList.getBox(i));
+        while (boxList.getNumberBoxes() > n)
+            boxList.removeBox(boxList.getNumberBoxes()-1);
     }
     total.stopAndPrint();
     std::cerr << "Number Boxes: " << np << "\n";
+    if (pruneCoveredSeeds)
+        std::cerr << "Seeds inside grown boxes (minimizations avoided): " << nPruned << "\n";
+    std::cerr << "Iterations: " << nIterations << "; Energy evaluations: " << nEnergyEvaluations << "; Gradient evaluations: " << nGradientEvaluations << "\n";
+}
+
+/**
+ * @brief Engine::comparePrecisions
+ *
+ * Grows the same boxes on g with the energy evaluated in double and in single
+ * precision, and prints the differences between the resulting boxes
+ * and between their energies (always evaluated in double).
+ * @return the maximum difference between the coordinates of the boxes
+ */
+double Engine::comparePrecisions(const BoxList& boxList, const Grid& g, bool limit, const Point3d& limits, BoxOptimizer optimizer) {
+    BoxList doubleList = boxList, floatList = boxList;
+    Timer tDouble("Double precision");
+    expandBoxes(doubleList, g, limit, limits, false, optimizer, TricubicKernel::DOUBLE_PRECISION);
+    tDouble.stop();
+    Timer tFloat("Single precision");
+    expandBoxes(floatList, g, limit, limits, false, optimizer, TricubicKernel::SINGLE_PRECISION);
+    tFloat.stop();
+
+    Energy e(g);
+    double maxDistance = 0, sumDistance = 0, doubleEnergy = 0, floatEnergy = 0;
+    int np = boxList.getNumberBoxes();
+    for (int i = 0; i < np; i++){
+        const Box3D& bd = doubleList.getBox(i);
+        const Box3D& bf = floatList.getBox(i);
+        double distance = std::max((bd.min() - bf.min()).length(), (bd.max() - bf.max()).length());
+        maxDistance = std::max(maxDistance, distance);
+        sumDistance += distance;
+        doubleEnergy += e.energy(bd);
+        floatEnergy += e.energy(bf);
+    }
+    std::cerr << "Precision comparison on " << np << " boxes (" << TricubicKernel::instructionSet() << "):\n";
+    std::cerr << "\tTime: double " << tDouble.delay() << "; single " << tFloat.delay() << "\n";
+    std::cerr << "\tCorner distance: max " << maxDistance << "; avg " << (np > 0 ? sumDistance / np : 0) << "\n";
+    std::cerr << "\tTotal energy: double " << doubleEnergy << "; single " << floatEnergy << "\n";
+    return maxDistance;
 }
 
 void Engine::createVectorTriples(std::vector< std::tuple<int, Box3D, std::vector<bool> > > &vectorTriples, const BoxList& boxList, const Dcel& d) {
@@ -582,6 +1017,53 @@ int Engine::minimalCoveringNonOptimal(BoxList& boxList, const Dcel& d) {
 }
 
 
+#ifndef GUROBI_DEFINED
+/**
+ * @brief lagrangianMinimalCovering
+ *
+ * Removes from boxList the boxes which are not needed to cover the faces of d (solveSetCover),
+ * the faces covered by the boxes of fixedList do not need to be covered.
+ * @return true if some faces are covered neither by boxList nor by fixedList
+ */
+static bool lagrangianMinimalCovering(BoxList& boxList, const BoxList& fixedList, const Dcel& d) {
+    unsigned int nBoxes = boxList.getNumberBoxes();
+	cgal::AABBTree3 aabb = buildAABBTree(d);
+    std::vector<unsigned char> covered(d.numberFaces(), false);
+    for (unsigned int i = 0; i < fixedList.getNumberBoxes(); i++){
+		std::list<const Dcel::Face*> containedFaces = aabb.completelyContainedDcelFaces(fixedList.getBox(i));
+        for (const Dcel::Face* f : containedFaces)
+            covered[f->id()] = true;
+    }
+    //the faces of every box which are not covered by fixedList
+    std::vector<std::vector<unsigned int> > sets(nBoxes);
+    #pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < (int)nBoxes; i++){
+		std::list<const Dcel::Face*> containedFaces = aabb.completelyContainedDcelFaces(boxList.getBox(i));
+        for (const Dcel::Face* f : containedFaces)
+            if (!covered[f->id()])
+                sets[i].push_back(f->id());
+    }
+    for (unsigned int i = 0; i < nBoxes; i++)
+        for (unsigned int f : sets[i])
+            covered[f] = true;
+    bool bb = std::find(covered.begin(), covered.end(), false) != covered.end();
+    if (bb)
+        std::cerr << "WARNING: Uncovered triangles.\n";
+
+    Timer tSetCover("Set cover");
+    std::vector<bool> selected;
+    unsigned int lowerBound;
+    unsigned int nSelected = solveSetCover(sets, d.numberFaces(), selected, lowerBound);
+    tSetCover.stopAndPrint();
+    for (int i = nBoxes-1; i >= 0; i--)
+        if (!selected[i])
+            boxList.removeBox(i);
+    std::cerr << "N survived boxes: " << nSelected << "; Lower bound: " << lowerBound
+              << "; Gap: " << (nSelected > 0 ? 100.0 * ((double)nSelected - lowerBound) / nSelected : 0) << "%\n";
+    return bb;
+}
+#endif
+
 bool Engine::minimalCovering(BoxList& boxList, const Dcel& d) {
     #ifdef GUROBI_DEFINED
     unsigned int nBoxes = boxList.getNumberBoxes();
@@ -656,7 +1138,7 @@ bool Engine::minimalCovering(BoxList& boxList, const Dcel& d) {
         throw std::runtime_error("Optimization failed.");
     }
     #else
-    return deleteBoxesNonOptimal(boxList, d);
+    return lagrangianMinimalCovering(boxList, BoxList(), d);
     #endif
 }
 
@@ -744,7 +1226,7 @@ bool Engine::secondMinimalCovering(BoxList& bestList, BoxList& boxList, const Dc
         throw std::runtime_error("Optimization failed.");
     }
     #else
-    return deleteBoxesNonOptimal(boxList, d);
+    return lagrangianMinimalCovering(boxList, bestList, d);
     #endif
 }
 
@@ -797,7 +1279,125 @@ int Engine::deleteBoxesGSC(BoxList& boxList, const Dcel& d) {
 }
 
 
-double Engine::optimize(BoxList& solutions, Dcel& d, double kernelDistance, bool limit, Point3d limits, bool tolerance, bool onlyNearestTarget, double areaTolerance, double angleTolerance, bool file, bool decimate) {
+/**
+ * @brief printGeneratedGrid
+ *
+ * Prints how many cells of the grid share their coefficients with other cells
+ * without computing them (see TricubicInterpolator::getCoefficients) and, for
+ * a lazy grid, the fraction of the cells touched until now.
+ */
+static void printGeneratedGrid(const Grid& g, unsigned int orientation, unsigned int target) {
+    TricubicInterpolator::CoefficientsStatistics cs = g.getCoefficientsStatistics();
+    std::stringstream ss;
+    ss << "Generated grid or " << orientation << " t " << target << ": " << g.getNumberCoefficients() << " distinct coefficients, "
+       << cs.nConstantCells + cs.nRepeatedCells << " of " << cs.nConstantCells + cs.nRepeatedCells + cs.nComputedCells
+       << " cells deduplicated (" << cs.nConstantCells << " constant, " << cs.nRepeatedCells << " repeated)";
+    if (g.isLazy())
+        ss << ", " << 100 * g.getTouchedCellsFraction() << "% of the cells touched";
+    ss << "\n";
+    std::cerr << ss.str();
+}
+
+/**
+ * @brief hashBytes
+ *
+ * Accumulates size bytes in the FNV-1a hash h.
+ */
+static void hashBytes(unsigned long long int& h, const void* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++)
+        h = (h ^ bytes[i]) * 1099511628211ULL;
+}
+
+static void hashDcel(unsigned long long int& h, const Dcel& d) {
+    for (const Dcel::Face* f : d.faceIterator()){
+        const Dcel::Vertex* vertices[3] = {f->vertex1(), f->vertex2(), f->vertex3()};
+        for (const Dcel::Vertex* v : vertices){
+            double c[3] = {v->coordinate().x(), v->coordinate().y(), v->coordinate().z()};
+            hashBytes(h, c, sizeof(c));
+        }
+        int flag = f->flag();
+        hashBytes(h, &flag, sizeof(int));
+    }
+}
+
+/**
+ * @brief getGridCacheFilename
+ *
+ * Returns the file of the cache directory where the grid of a target is stored:
+ * its name is the hash of everything the grid depends on (the scaled and rotated mesh,
+ * with the flags of its faces, the kernel, the tolerance, the target, the tolerances of
+ * the flipped faces, the distance field and the pyramid), so a file is reused only by the runs
+ * which would generate the same grid.
+ * @param scaled: mesh used for the grid and the flipped faces
+ * @param d: mesh used for the faces contained in the cells
+ */
+static std::string getGridCacheFilename(const std::string& cacheDirectory, const Dcel& scaled, const Dcel& d, double kernelDistance, bool tolerance, unsigned int target,
+                                        double areaTolerance, double angleTolerance, Engine::DistanceFieldMode distanceFieldMode, bool coarseLevels) {
+    unsigned long long int h = 14695981039346656037ULL;
+    int version[2] = {GRID_CACHE_VERSION, (int)sizeof(gridreal)};
+    hashBytes(h, version, sizeof(version));
+    hashDcel(h, scaled);
+    hashDcel(h, d);
+    double parameters[3] = {kernelDistance, areaTolerance, angleTolerance};
+    hashBytes(h, parameters, sizeof(parameters));
+    int options[4] = {tolerance, (int)target, (int)distanceFieldMode, coarseLevels};
+    hashBytes(h, options, sizeof(options));
+    std::stringstream ss;
+    ss << cacheDirectory;
+    if (!cacheDirectory.empty() && cacheDirectory.back() != '/')
+        ss << "/";
+    ss << "grid_" << std::hex << std::setw(16) << std::setfill('0') << h << ".bin";
+    return ss.str();
+}
+
+/**
+ * @brief mapCachedGrid
+ *
+ * Maps the cached grid of the file, only if its header has the resolution of the
+ * grid generated for the mesh, the kernel distance and the target: the name of
+ * the file is just a hash (see getGridCacheFilename), which may collide.
+ * @param resolution: resolution of the grid generated for the mesh (see getGridBounds)
+ */
+static bool mapCachedGrid(Grid& g, const std::string& filename, const Point3i& resolution, double kernelDistance, const Vec3d& target) {
+    if (!g.mapFile(filename))
+        return false;
+    if (g.getResX() == (unsigned int)resolution.x() && g.getResY() == (unsigned int)resolution.y() && g.getResZ() == (unsigned int)resolution.z() &&
+            g.getKernelDistance() == kernelDistance && g.getTarget() == target)
+        return true;
+    std::cerr << "WARNING: the grid cache " << filename << " belongs to another mesh or kernel, it is overwritten\n";
+    g = Grid();
+    return false;
+}
+
+/**
+ * @brief writeCachedGrid
+ *
+ * Writes the grid in the cache, through a temporary file: the runs which map
+ * the same file concurrently never see it incomplete.
+ */
+static void writeCachedGrid(const Grid& g, const std::string& filename) {
+    std::stringstream tmp;
+    tmp << filename << "." << std::chrono::steady_clock::now().time_since_epoch().count() << "." << omp_get_thread_num() << ".tmp";
+    if (!g.writeMappedFile(tmp.str()) || std::rename(tmp.str().c_str(), filename.c_str()) != 0){
+        std::cerr << "WARNING: cannot write the grid cache " << filename << "\n";
+        std::remove(tmp.str().c_str());
+    }
+}
+
+/**
+ * @brief Engine::optimize
+ *
+ * The seeds inside a box already grown with the same target are not grown (see expandBoxes):
+ * which seeds are skipped depends on the order in which the threads finish the boxes, so the
+ * output boxes are not reproducible across runs or numbers of threads.
+ * The energy is always evaluated in double precision: the single precision is only compared
+ * to it, defining COMPARE_PRECISIONS (see comparePrecisions).
+ * @param cacheDirectory: if not empty, directory where the grids are cached between
+ * the runs (see getGridCacheFilename): the grids found there are mapped instead of generated
+ * @param coarseLevels: the boxes are grown coarse to fine, on the pyramids of the grids
+ */
+double Engine::optimize(BoxList& solutions, Dcel& d, double kernelDistance, bool limit, Point3d limits, bool tolerance, bool onlyNearestTarget, double areaTolerance, double angleTolerance, bool file, bool decimate, BoxOptimizer optimizer, DistanceFieldMode distanceFieldMode, const std::string& cacheDirectory, bool coarseLevels) {
     assert(kernelDistance >= 0 && kernelDistance <= 1);
     solutions.clearBoxes();
     Dcel scaled[ORIENTATIONS];
@@ -815,8 +1415,12 @@ double Engine::optimize(BoxList& solutions, Dcel& d, double kernelDistance, bool
 
     Grid g[ORIENTATIONS][TARGETS];
     BoxList bl[ORIENTATIONS][TARGETS];
-    std::set<int> coveredFaces;
+    FaceCoverage coverage;
+    coverage.faces = AtomicBitset(d.numberFaces());
+    AtomicBitset& coveredFaces = coverage.faces;
     int factor = 1024;
+    if (kernelDistance == 0) //no point is under the kernel threshold, distances are useless
+        distanceFieldMode = NO_DISTANCE_FIELD;
 
 	unsigned int numberFaces = d.numberFaces();
     if (decimate){
@@ -825,42 +1429,72 @@ double Engine::optimize(BoxList& solutions, Dcel& d, double kernelDistance, bool
         numberFaces/=factor;
     }
 	cgal::AABBTree3 aabb[ORIENTATIONS];
+    for (unsigned int i = 0; i < ORIENTATIONS; i++){
+        //the threads growing the boxes query the trees concurrently (see addCoveredFaces)
+		aabb[i] = buildAABBTree(scaled[i]);
+    }
+    //the seeds of every round are the faces surviving the decimation to numberFaces faces:
+    //the decimation is computed once, down to the faces of the first round
+    ProgressiveMesh progressiveMeshes[ORIENTATIONS];
     for (unsigned int i = 0; i < ORIENTATIONS; i++)
-		aabb[i] = cgal::AABBTree3(scaled[i]);
+        progressiveMeshes[i] = ProgressiveMesh(EigenMesh(scaled[i]), numberFaces);
+
+    //files of the grids in file mode, or of the cached grids
+    bool cache = !cacheDirectory.empty();
+    std::string gridFiles[ORIENTATIONS][TARGETS];
+    Point3i gridResolutions[ORIENTATIONS];
+    for (unsigned int i = 0; i < ORIENTATIONS; ++i){
+        if (cache){
+            Eigen::RowVector3d nGmin, nGmax;
+            double gridUnit = 2;
+            gridResolutions[i] = getGridBounds(nGmin, nGmax, SimpleEigenMesh(scaled[i]), gridUnit, true);
+        }
+        for (unsigned int j = 0; j < TARGETS; ++j){
+            if (cache)
+                gridFiles[i][j] = getGridCacheFilename(cacheDirectory, scaled[i], d, kernelDistance, tolerance, j, areaTolerance, angleTolerance, distanceFieldMode, coarseLevels);
+            else {
+                std::stringstream ss ;
+                ss << "grid" << i << "_" << j << ".bin";
+                gridFiles[i][j] = ss.str();
+            }
+        }
+    }
+
     for (unsigned int i = 0; i < ORIENTATIONS; ++i){
         bool first = true;
         if (file) {
             double totalTimeGG = 0;
 			Array3D<Point3d> grid;
             Array3D<gridreal> distanceField;
+            CellFaces cellFaces;
             for (unsigned int j = 0; j < TARGETS; ++j) {
                 #ifdef USE_2D_ONLY
                 if (j != 1 && j != 4){
                 #endif
+                    Grid g;
+                    if (cache && mapCachedGrid(g, gridFiles[i][j], gridResolutions[i], kernelDistance, XYZ[j])){
+                        std::cerr << "Grid or " << i << " t " << j << " found in the cache\n";
+                        continue;
+                    }
                     std::set<const Dcel::Face*> flippedFaces, savedFaces;
                     Engine::getFlippedFaces(flippedFaces, savedFaces, scaled[i], XYZ[j], angleTolerance, areaTolerance);
-                    Grid g;
                     Timer gg("Generating Grid");
                     //distanceField = Engine::generateGrid(g, scaled[i], kernelDistance, tolerance, XYZ[j], savedFaces);
                     if (first) {
                         SimpleEigenMesh m(scaled[i]);
-                        Engine::generateGridAndDistanceField(grid, distanceField, m);
-                        calculateGridWeights(g, grid, distanceField, d, kernelDistance, tolerance, XYZ[j], savedFaces);
+                        Engine::generateGridAndDistanceField(grid, distanceField, m, true, 2, true, distanceFieldMode);
+                        Engine::calculateCellFaces(cellFaces, grid, distanceField, d);
                         first = false;
                     }
-                    else {
-                        Engine::calculateGridWeights(g, grid, distanceField, d, kernelDistance, tolerance, XYZ[j], savedFaces);
-                    }
+                    Engine::calculateGridWeights(g, grid, distanceField, cellFaces, kernelDistance, tolerance, XYZ[j], savedFaces, false, coarseLevels);
                     gg.stopAndPrint();
                     totalTimeGG += gg.delay();
                     g.resetSignedDistances();
-                    std::stringstream ss ;
-                    ss << "grid" << i << "_" << j << ".bin";
-                    std::ofstream myfile;
-                    myfile.open (ss.str(), std::ios::out | std::ios::binary);
-                    g.serialize(myfile);
-                    myfile.close();
-                    std::cerr << "Generated grid or " << i << " t " << j << "\n";
+                    if (cache)
+                        writeCachedGrid(g, gridFiles[i][j]);
+                    else if (!g.writeMappedFile(gridFiles[i][j]))
+                        std::cerr << "ERROR: cannot write " << gridFiles[i][j] << "\n";
+                    printGeneratedGrid(g, i, j);
                 #ifdef USE_2D_ONLY
                 }
                 #endif
@@ -868,36 +1502,67 @@ double Engine::optimize(BoxList& solutions, Dcel& d, double kernelDistance, bool
             std::cerr << "Total time generating Grids: " << totalTimeGG << "\n";
         }
         else {
-			Array3D<Point3d> grid;
-            Array3D<gridreal> distanceField;
-            SimpleEigenMesh m(scaled[i]);
-            Engine::generateGridAndDistanceField(grid, distanceField, m);
-            # pragma omp parallel for
-            for (unsigned int j = 0; j < TARGETS; ++j) {
+            bool generate = false;
+            bool cached[TARGETS];
+            for (unsigned int j = 0; j < TARGETS; ++j){
                 #ifdef USE_2D_ONLY
                 if (j != 1 && j != 4){
-                #endif
-                    std::set<const Dcel::Face*> flippedFaces, savedFaces;
-                    Engine::getFlippedFaces(flippedFaces, savedFaces, scaled[i], XYZ[j], angleTolerance, areaTolerance);
-                    Engine::calculateGridWeights(g[i][j], grid, distanceField, d, kernelDistance, tolerance, XYZ[j], savedFaces);
-                    g[i][j].resetSignedDistances();
-                    std::cerr << "Generated grid or " << i << " t " << j << "\n";
-                #ifdef USE_2D_ONLY
+                    cached[j] = true;
+                    continue;
                 }
                 #endif
+                cached[j] = cache && mapCachedGrid(g[i][j], gridFiles[i][j], gridResolutions[i], kernelDistance, XYZ[j]);
+                if (cached[j])
+                    std::cerr << "Grid or " << i << " t " << j << " found in the cache\n";
+                else
+                    generate = true;
+            }
+            if (generate){
+                Array3D<Point3d> grid;
+                Array3D<gridreal> distanceField;
+                SimpleEigenMesh m(scaled[i]);
+                Engine::generateGridAndDistanceField(grid, distanceField, m, true, 2, true, distanceFieldMode);
+                CellFaces cellFaces;
+                Engine::calculateCellFaces(cellFaces, grid, distanceField, d);
+                # pragma omp parallel for
+                for (unsigned int j = 0; j < TARGETS; ++j) {
+                    #ifdef USE_2D_ONLY
+                    if (j != 1 && j != 4){
+                    #endif
+                        if (cached[j])
+                            continue;
+                        std::set<const Dcel::Face*> flippedFaces, savedFaces;
+                        Engine::getFlippedFaces(flippedFaces, savedFaces, scaled[i], XYZ[j], angleTolerance, areaTolerance);
+                        #ifdef LAZY_GRIDS
+                        //a cached grid is written complete, lazy grids would be computed twice
+                        Engine::calculateGridWeights(g[i][j], grid, distanceField, cellFaces, kernelDistance, tolerance, XYZ[j], savedFaces, !cache, coarseLevels);
+                        #else
+                        Engine::calculateGridWeights(g[i][j], grid, distanceField, cellFaces, kernelDistance, tolerance, XYZ[j], savedFaces, false, coarseLevels);
+                        printGeneratedGrid(g[i][j], i, j);
+                        #endif
+                        g[i][j].resetSignedDistances();
+                        if (cache)
+                            writeCachedGrid(g[i][j], gridFiles[i][j]);
+                    #ifdef USE_2D_ONLY
+                    }
+                    #endif
+                }
             }
         }
     }
     bool end = false;
 
     double totalTbg = 0;
-	while (coveredFaces.size() < scaled[0].numberFaces() && !end){
+	while (coveredFaces.count() < scaled[0].numberFaces() && !end){
         BoxList tmp[ORIENTATIONS][TARGETS];
+        Grid mappedGrids[ORIENTATIONS][TARGETS]; //used in file mode
+        std::vector<BoxList*> boxLists;
+        std::vector<const Grid*> grids;
+        std::vector<std::pair<unsigned int, unsigned int> > listTargets; //orientation and target of every box list
+        unsigned int coveredBefore = coveredFaces.count();
         Eigen::VectorXi faces[ORIENTATIONS];
-        for (unsigned int i = 0; i < ORIENTATIONS; i++){
-            EigenMesh m(scaled[i]);
-            libigl::decimateMesh(m, numberFaces, faces[i]);
-        }
+        for (unsigned int i = 0; i < ORIENTATIONS; i++)
+            progressiveMeshes[i].getFaces(numberFaces, faces[i]);
         for (unsigned int i = 0; i < ORIENTATIONS; ++i){
             for (unsigned int j = 0; j < TARGETS; ++j){
                 #ifdef USE_2D_ONLY
@@ -913,30 +1578,23 @@ double Engine::optimize(BoxList& solutions, Dcel& d, double kernelDistance, bool
                         Engine::calculateDecimatedBoxes(tmp[i][j],scaled[i], faces[i], coveredFaces, m[i], -1, onlyNearestTarget, XYZ[j]);
                         //Engine::calculateDecimatedBoxes(tmp[i][j],scaled[i], faces[i], coveredFaces, m[i], -1, false);
                     if (tmp[i][j].getNumberBoxes() > 0){
-
+                        const Grid* grid = &g[i][j];
                         if (file) {
-                            Grid g;
-                            std::stringstream ss ;
-                            ss << "grid" << i << "_" << j << ".bin";
-                            std::ifstream myfile;
-                            myfile.open (ss.str(), std::ios::in | std::ios::binary);
-                            g.deserialize(myfile);
-                            myfile.close();
-                            std::cerr << "Starting boxes growth\n";
-                            Timer tt("Boxes Growth");
-                            Engine::expandBoxes(tmp[i][j], g, limit, limits);
-                            tt.stop();
-                            totalTbg += tt.delay();
-                            std::cerr << "Orientation: " << i << " Target: " << j << " completed.\n";
-                        }
-                        else {
-                            std::cerr << "Starting boxes growth\n";
-                            Timer tt("Boxes Growth");
-                            Engine::expandBoxes(tmp[i][j], g[i][j], limit, limits);
-                            tt.stop();
-                            totalTbg += tt.delay();
-                            std::cerr << "Orientation: " << i << " Target: " << j << " completed.\n";
+                            //the grid is served directly from the file, whose pages are shared
+                            //by the rounds (and by the processes) using it
+                            if (!mappedGrids[i][j].mapFile(gridFiles[i][j])){
+                                std::cerr << "ERROR: cannot map " << gridFiles[i][j] << "\n";
+                                tmp[i][j].clearBoxes();
+                                continue;
+                            }
+                            grid = &mappedGrids[i][j];
                         }
+                        #ifdef COMPARE_PRECISIONS
+                        Engine::comparePrecisions(tmp[i][j], *grid, limit, limits, optimizer);
+                        #endif
+                        boxLists.push_back(&tmp[i][j]);
+                        grids.push_back(grid);
+                        listTargets.push_back(std::make_pair(i, j));
                     }
                     else {
                         std::cerr << "Orientation: " << i << " Target: " << j << " no boxes to expand.\n";
@@ -946,24 +1604,25 @@ double Engine::optimize(BoxList& solutions, Dcel& d, double kernelDistance, bool
                 #endif
             }
         }
+        //the boxes of all the targets are grown together, the faces they cover
+        //are added to coveredFaces as soon as every box is grown
+        if (boxLists.size() > 0){
+            coverage.trees.clear();
+            for (unsigned int l = 0; l < listTargets.size(); l++)
+                coverage.trees.push_back(&aabb[listTargets[l].first]);
+            coverage.newFaces.assign(boxLists.size(), 0);
+            std::cerr << "Starting boxes growth\n";
+            Timer tt("Boxes Growth");
+            Engine::expandBoxes(boxLists, grids, limit, limits, false, optimizer, TricubicKernel::DOUBLE_PRECISION, true, &coverage);
+            tt.stop();
+            totalTbg += tt.delay();
+            std::cerr << "Boxes of " << boxLists.size() << " targets completed.\n";
+            for (unsigned int l = 0; l < listTargets.size(); l++)
+                std::cerr << "Orientation: " << listTargets[l].first << " Target: " << listTargets[l].second << " boxes: " << boxLists[l]->getNumberBoxes()
+                          << "; newly covered faces: " << coverage.newFaces[l] << "\n";
+        }
+        std::cerr << "Faces covered in this round: " << coveredFaces.count() - coveredBefore << "\n";
 
-        for (unsigned int i = 0; i < ORIENTATIONS; ++i){
-            for (unsigned int j = 0; j < TARGETS; ++j){
-                #ifdef USE_2D_ONLY
-                if (j != 1 && j != 4){
-                #endif
-                    for (unsigned int k = 0; k < tmp[i][j].getNumberBoxes(); ++k){
-                        std::list<const Dcel::Face*> list;
-						aabb[i].completelyContainedDcelFaces(list, tmp[i][j].getBox(k));
-                        for (std::list<const Dcel::Face*>::iterator it = list.begin(); it != list.end(); ++it){
-							coveredFaces.insert((*it)->id());
-                        }
-                    }
-                #ifdef USE_2D_ONLY
-                }
-                #endif
-            }
-        }
         for (unsigned int i = 0; i < ORIENTATIONS; ++i){
             for (unsigned int j = 0; j < TARGETS; ++j){
                 #ifdef USE_2D_ONLY
@@ -977,15 +1636,15 @@ double Engine::optimize(BoxList& solutions, Dcel& d, double kernelDistance, bool
             }
         }
 
-        std::cerr << "Starting Number Faces: " << numberFaces << "; Total Covered Faces: " << coveredFaces.size() << "\n";
+        std::cerr << "Starting Number Faces: " << numberFaces << "; Total Covered Faces: " << coveredFaces.count() << "\n";
 		std::cerr << "Target: " << scaled[0].numberFaces() << "\n";
 		if (numberFaces == scaled[0].numberFaces()) {
             end = true;
-			if (coveredFaces.size() != scaled[0].numberFaces()){
+			if (coveredFaces.count() != scaled[0].numberFaces()){
                 std::cerr << "WARNING: Not every face has been covered by a box.\n";
-				std::cerr << "Number uncovered faces: " << scaled[0].numberFaces() - coveredFaces.size() << "\n";
+				std::cerr << "Number uncovered faces: " << scaled[0].numberFaces() - coveredFaces.count() << "\n";
                 for (Dcel::Face* f : d.faceIterator()){
-					if (coveredFaces.find(f->id()) == coveredFaces.end()){
+					if (!coveredFaces.test(f->id())){
 						std::cerr << "Uncovered face id: " << f->id() << "\n";
                         f->setColor(Color(0,0,0));
                     }
@@ -997,16 +1656,29 @@ double Engine::optimize(BoxList& solutions, Dcel& d, double kernelDistance, bool
 			numberFaces = scaled[0].numberFaces();
     }
     std::cerr << "Total time Boxes Growth: " << totalTbg << "\n";
+    #ifdef LAZY_GRIDS
+    if (!file){
+        for (unsigned int i = 0; i < ORIENTATIONS; ++i){
+            for (unsigned int j = 0; j < TARGETS; ++j){
+                #ifdef USE_2D_ONLY
+                if (j != 1 && j != 4){
+                #endif
+                    printGeneratedGrid(g[i][j], i, j);
+                #ifdef USE_2D_ONLY
+                }
+                #endif
+            }
+        }
+    }
+    #endif
 
-    if (file){
+    if (file && !cache){
         for (unsigned int i = 0; i < ORIENTATIONS; ++i){
             for (unsigned int j = 0; j < TARGETS; ++j){
                 #ifdef USE_2D_ONLY
                 if (j != 1 && j != 4){
                 #endif
-                    std::stringstream ss ;
-                    ss << "grid" << i << "_" << j << ".bin";
-                    std::remove(ss.str().c_str());
+                    std::remove(gridFiles[i][j].c_str());
                 #ifdef USE_2D_ONLY
                 }
                 #endif
@@ -13,14 +13,49 @@
 #include "energy.h"
 #include <cg3/cgal/cgal.h>
 #include "heightfieldslist.h"
+#include "atomicbitset.h"
 
 #define ORIENTATIONS 1
 #define TARGETS 6
 #define STARTING_NUMBER_FACES 600
+#define GRID_CACHE_VERSION 3 //to be increased when the grids (or their file format) change, invalidates the cached grids
 
 #define BOOL_DEBUG
+//#define COMPARE_PRECISIONS //optimize compares single and double precision box growth on every grid
+#define LAZY_GRIDS //the grids kept in memory by optimize compute their cells only when the boxes touch them
 
 namespace Engine {
+    /**
+     * @brief Optimizer used to grow the boxes:
+     * SCALAR_BFGS minimizes every box independently,
+     * LOCKSTEP_BFGS advances LOCKSTEP_LANES boxes of the same grid in lockstep,
+     * evaluating their energies as a single batch (same results of SCALAR_BFGS);
+     * BOUNDED_BFGS minimizes every box independently, treating the constraint
+     * points as bounds of the variables instead of using the barrier.
+     */
+    enum BoxOptimizer {SCALAR_BFGS, LOCKSTEP_BFGS, BOUNDED_BFGS};
+
+    /**
+     * @brief Distance field computed on the inside points of the grid:
+     * EXACT_DISTANCE_FIELD computes the distance from the surface of every point,
+     * NARROW_BAND_DISTANCE_FIELD computes it only near the surface (NARROW_BAND_WIDTH)
+     * and approximates it in the interior with the fast sweeping method,
+     * NO_DISTANCE_FIELD does not compute it (the kernel is not used, kernelDistance = 0).
+     */
+    enum DistanceFieldMode {EXACT_DISTANCE_FIELD, NARROW_BAND_DISTANCE_FIELD, NO_DISTANCE_FIELD};
+
+    /**
+     * @brief Faces of the mesh covered by (completely contained in) the grown boxes,
+     * updated by expandBoxes as soon as every box is grown: trees[l] is the tree of the
+     * mesh of the box list l, newFaces[l] counts the faces covered for the first time
+     * by the boxes of the list l.
+     */
+    struct FaceCoverage {
+        AtomicBitset faces;
+        std::vector<const cg3::cgal::AABBTree3*> trees;
+        std::vector<unsigned int> newFaces;
+    };
+
     Eigen::Matrix3d findOptimalOrientation(cg3::Dcel& d, cg3::EigenMesh& originalMesh);
 
 	cg3::Vec3d getClosestTarget(const cg3::Vec3d &n);
@@ -33,21 +68,29 @@ namespace Engine {
 
     void setTrianglesTargets(cg3::Dcel scaled[]);
 
-	void generateGridAndDistanceField(cg3::Array3D<cg3::Point3d> &grid, cg3::Array3D<gridreal> &distanceField, const cg3::SimpleEigenMesh& m, bool generateDistanceField = true, double gridUnit = 2, bool integer = true);
+	void generateGridAndDistanceField(cg3::Array3D<cg3::Point3d> &grid, cg3::Array3D<gridreal> &distanceField, const cg3::SimpleEigenMesh& m, bool generateDistanceField = true, double gridUnit = 2, bool integer = true, DistanceFieldMode distanceFieldMode = EXACT_DISTANCE_FIELD);
 
 	void calculateGridWeights(Grid& g, const cg3::Array3D<cg3::Point3d> &grid, const cg3::Array3D<gridreal> &distanceField, const cg3::Dcel& d, double kernelDistance, bool tolerance, const cg3::Vec3d &target, std::set<const cg3::Dcel::Face*>& savedFaces);
 
+	void calculateGridWeights(Grid& g, const cg3::Array3D<cg3::Point3d> &grid, const cg3::Array3D<gridreal> &distanceField, const CellFaces& cellFaces, double kernelDistance, bool tolerance, const cg3::Vec3d &target, std::set<const cg3::Dcel::Face*>& savedFaces, bool lazy = false, bool coarseLevels = false);
+
+	void calculateCellFaces(CellFaces& cellFaces, const cg3::Array3D<cg3::Point3d> &grid, const cg3::Array3D<gridreal> &distanceField, const cg3::Dcel& d);
+
     static std::set<const cg3::Dcel::Face*> dummy;
     static cg3::Array3D<gridreal> ddf;
 	cg3::Array3D<gridreal> generateGrid(Grid &g, const cg3::Dcel &d, double kernelDistance = 6, bool tolerance = false, const cg3::Vec3d& target = cg3::Vec3d(), std::set<const cg3::Dcel::Face*> &savedFaces = dummy);
 
 	void addBox(BoxList& boxList, const cg3::Vec3d target, const cg3::Dcel::Face* f, const Eigen::Matrix3d& rot);
 
-	void calculateDecimatedBoxes(BoxList &boxList, const cg3::Dcel &d, const Eigen::VectorXi& mapping, const std::set<int> &coveredFaces, const Eigen::Matrix3d& rot = Eigen::Matrix3d::Identity(), int orientation = -1,  bool onlyTarget = false, const cg3::Vec3d& target = cg3::Vec3d());
+	void calculateDecimatedBoxes(BoxList &boxList, const cg3::Dcel &d, const Eigen::VectorXi& mapping, const AtomicBitset& coveredFaces, const Eigen::Matrix3d& rot = Eigen::Matrix3d::Identity(), int orientation = -1,  bool onlyTarget = false, const cg3::Vec3d& target = cg3::Vec3d());
 
 	void calculateInitialBoxes(BoxList &boxList, const cg3::Dcel &d, const Eigen::Matrix3d& rot = Eigen::Matrix3d::Identity(), bool onlyTarget = false, const cg3::Vec3d& target = cg3::Vec3d());
 
-	void expandBoxes(BoxList &boxList, const Grid &g, bool limit, const cg3::Point3d& limits, bool printTimes = false);
+	void expandBoxes(BoxList &boxList, const Grid &g, bool limit, const cg3::Point3d& limits, bool printTimes = false, BoxOptimizer optimizer = SCALAR_BFGS, TricubicKernel::Precision precision = TricubicKernel::DOUBLE_PRECISION);
+
+	void expandBoxes(const std::vector<BoxList*>& boxLists, const std::vector<const Grid*>& grids, bool limit, const cg3::Point3d& limits, bool printTimes = false, BoxOptimizer optimizer = SCALAR_BFGS, TricubicKernel::Precision precision = TricubicKernel::DOUBLE_PRECISION, bool pruneCoveredSeeds = false, FaceCoverage* coverage = nullptr);
+
+    double comparePrecisions(const BoxList& boxList, const Grid& g, bool limit, const cg3::Point3d& limits, BoxOptimizer optimizer = SCALAR_BFGS);
 
     void createVectorTriples(std::vector<std::tuple<int, Box3D, std::vector<bool> > >& vectorTriples, const BoxList& boxList, const cg3::Dcel &d);
 
@@ -62,7 +105,7 @@ namespace Engine {
     int deleteBoxesGSC(BoxList& boxList, const cg3::Dcel &d);
 
     static BoxList dummy2;
-	double optimize(BoxList &solutions, cg3::Dcel& d, double kernelDistance, bool limit, cg3::Point3d limits = cg3::Point3d(), bool tolerance = true, bool onlyNearestTarget = true, double areaTolerance = 0, double angleTolerance = 0, bool file = false, bool decimate = true);
+	double optimize(BoxList &solutions, cg3::Dcel& d, double kernelDistance, bool limit, cg3::Point3d limits = cg3::Point3d(), bool tolerance = true, bool onlyNearestTarget = true, double areaTolerance = 0, double angleTolerance = 0, bool file = false, bool decimate = true, BoxOptimizer optimizer = SCALAR_BFGS, DistanceFieldMode distanceFieldMode = EXACT_DISTANCE_FIELD, const std::string& cacheDirectory = "", bool coarseLevels = false);
 
 	void optimizeAndDeleteBoxes(BoxList &solutions, cg3::Dcel& d, double kernelDistance, bool limit, cg3::Point3d limits = cg3::Point3d(), bool heightfields = true, bool onlyNearestTarget = true, double areaTolerance = 0, double angleTolerance = 0, bool file = false, bool decimate = true, BoxList& allSolutions = dummy2);
 
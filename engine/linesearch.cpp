@@ -0,0 +1,121 @@
+#include "linesearch.h"
+
+#include <cmath>
+#include <algorithm>
+
+LineSearch::LineSearch(double c1, double c2, unsigned int maxEvaluations) :
+    c1(c1), c2(c2), maxEvaluations(maxEvaluations), nEvaluations(0),
+    value0(0), slope0(0), maxStep(0), alpha(0), zoom(false),
+    alphaPrev(0), valuePrev(0), slopePrev(0),
+    alphaLo(0), valueLo(0), slopeLo(0),
+    alphaHi(0), valueHi(0), slopeHi(0) {
+}
+
+/**
+ * @brief LineSearch::start
+ * @param value: phi(0)
+ * @param slope: phi'(0), must be negative
+ * @param initialStep: first step to be evaluated
+ * @param maxStep: steps are never greater than maxStep
+ */
+void LineSearch::start(double value, double slope, double initialStep, double maxStep) {
+    value0 = value;
+    slope0 = slope;
+    this->maxStep = maxStep;
+    alpha = std::min(initialStep, maxStep);
+    zoom = false;
+    nEvaluations = 0;
+    alphaPrev = 0;
+    valuePrev = value;
+    slopePrev = slope;
+}
+
+/**
+ * @brief LineSearch::update
+ * @param value: phi(getStep())
+ * @param slope: phi'(getStep())
+ * @return EVALUATE if phi must be evaluated on the new getStep(),
+ * CONVERGED if getStep() satisfies the strong Wolfe conditions
+ * (or the sufficient decrease on maxStep), FAILED otherwise.
+ */
+LineSearch::Status LineSearch::update(double value, double slope) {
+    nEvaluations++;
+    bool sufficientDecrease = std::isfinite(value) && value <= value0 + c1*alpha*slope0;
+    if (!zoom){
+        if (!sufficientDecrease || (nEvaluations > 1 && value >= valuePrev))
+            startZoom(alphaPrev, valuePrev, slopePrev, alpha, value, slope);
+        else if (std::abs(slope) <= -c2*slope0)
+            return CONVERGED;
+        else if (slope >= 0)
+            startZoom(alpha, value, slope, alphaPrev, valuePrev, slopePrev);
+        else if (alpha >= maxStep || nEvaluations >= maxEvaluations)
+            return CONVERGED;
+        else {
+            alphaPrev = alpha;
+            valuePrev = value;
+            slopePrev = slope;
+            alpha = std::min(2*alpha, maxStep);
+            return EVALUATE;
+        }
+    }
+    else {
+        if (!sufficientDecrease || value >= valueLo){
+            alphaHi = alpha;
+            valueHi = value;
+            slopeHi = slope;
+        }
+        else {
+            if (std::abs(slope) <= -c2*slope0)
+                return CONVERGED;
+            if (slope*(alphaHi-alphaLo) >= 0){
+                alphaHi = alphaLo;
+                valueHi = valueLo;
+                slopeHi = slopeLo;
+            }
+            alphaLo = alpha;
+            valueLo = value;
+            slopeLo = slope;
+        }
+    }
+    if (nEvaluations >= maxEvaluations || std::abs(alphaHi-alphaLo) <= 1e-12 * std::max(1.0, alphaLo))
+        return FAILED;
+    alpha = interpolate();
+    return EVALUATE;
+}
+
+void LineSearch::startZoom(double alphaLo, double valueLo, double slopeLo, double alphaHi, double valueHi, double slopeHi) {
+    zoom = true;
+    this->alphaLo = alphaLo;
+    this->valueLo = valueLo;
+    this->slopeLo = slopeLo;
+    this->alphaHi = alphaHi;
+    this->valueHi = valueHi;
+    this->slopeHi = slopeHi;
+}
+
+/**
+ * @brief LineSearch::interpolate
+ *
+ * Minimizer of the cubic interpolating phi and phi' on alphaLo and alphaHi,
+ * kept far from the extremes of the interval; bisection when the cubic
+ * is not defined.
+ */
+double LineSearch::interpolate() const {
+    double a = std::min(alphaLo, alphaHi), b = std::max(alphaLo, alphaHi);
+    double margin = 0.1*(b-a);
+    double bisection = (alphaLo + alphaHi) / 2;
+    if (!std::isfinite(valueLo) || !std::isfinite(valueHi) || !std::isfinite(slopeLo) || !std::isfinite(slopeHi))
+        return bisection;
+    double d1 = slopeLo + slopeHi - 3*(valueLo-valueHi)/(alphaLo-alphaHi);
+    double disc = d1*d1 - slopeLo*slopeHi;
+    if (disc < 0)
+        return bisection;
+    double d2 = (alphaHi > alphaLo ? 1 : -1) * std::sqrt(disc);
+    double den = slopeHi - slopeLo + 2*d2;
+    if (den == 0)
+        return bisection;
+    double alphaC = alphaHi - (alphaHi-alphaLo)*(slopeHi+d2-d1)/den;
+    if (!std::isfinite(alphaC))
+        return bisection;
+    return std::min(std::max(alphaC, a+margin), b-margin);
+}
@@ -0,0 +1,43 @@
+#ifndef LINESEARCH_H
+#define LINESEARCH_H
+
+/**
+ * @brief The LineSearch class
+ *
+ * Line search for the strong Wolfe conditions on phi(alpha) = f(x + alpha*p),
+ * with bracketing and zoom phases (Nocedal and Wright, Algorithms 3.5 and 3.6)
+ * and safeguarded cubic interpolation.
+ * It is written in reverse communication: the caller evaluates phi and phi'
+ * at getStep() and passes them to update(), until update() returns CONVERGED
+ * (getStep() is accepted) or FAILED.
+ * Infinite values (e.g. out of a barrier) are handled as non acceptable steps.
+ */
+class LineSearch {
+    public:
+        enum Status {EVALUATE, CONVERGED, FAILED};
+
+        LineSearch(double c1 = 1e-4, double c2 = 0.9, unsigned int maxEvaluations = 20);
+
+        void start(double value, double slope, double initialStep, double maxStep);
+        Status update(double value, double slope);
+        double getStep() const;
+
+    private:
+        void startZoom(double alphaLo, double valueLo, double slopeLo, double alphaHi, double valueHi, double slopeHi);
+        double interpolate() const;
+
+        double c1, c2;
+        unsigned int maxEvaluations, nEvaluations;
+        double value0, slope0, maxStep;
+        double alpha;
+        bool zoom;
+        double alphaPrev, valuePrev, slopePrev;
+        double alphaLo, valueLo, slopeLo;
+        double alphaHi, valueHi, slopeHi;
+};
+
+inline double LineSearch::getStep() const {
+    return alpha;
+}
+
+#endif // LINESEARCH_H
@@ -0,0 +1,150 @@
+#include "progressivemesh.h"
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <queue>
+
+namespace {
+
+struct Collapse {
+    double cost;
+    int v1, v2;
+    unsigned int version1, version2; //versions of the vertices when the collapse has been computed
+
+    bool operator>(const Collapse& other) const {
+        return cost > other.cost;
+    }
+};
+
+}
+
+/**
+ * @brief getNeighbours
+ * @return the vertices adjacent to v, sorted
+ */
+static std::vector<int> getNeighbours(int v, const std::vector<std::vector<int> >& vertexFaces, const std::vector<std::array<int, 3> >& faces) {
+    std::vector<int> neighbours;
+    for (int f : vertexFaces[v])
+        for (unsigned int i = 0; i < 3; i++)
+            if (faces[f][i] != v)
+                neighbours.push_back(faces[f][i]);
+    std::sort(neighbours.begin(), neighbours.end());
+    neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+    return neighbours;
+}
+
+ProgressiveMesh::ProgressiveMesh() {
+}
+
+/**
+ * @brief ProgressiveMesh::ProgressiveMesh
+ *
+ * Collapses the edges of m in order of length, as the default decimation of libigl,
+ * until the mesh has at most minNumberFaces faces. An edge is collapsed only if it is
+ * shared by two faces and satisfies the link condition (the vertices adjacent to both
+ * its endpoints are the opposite ones of its two faces), so the mesh stays manifold:
+ * boundary edges are never collapsed.
+ * The costs are updated lazily: a collapse in the queue is discarded when one of
+ * its vertices has been moved after its computation.
+ */
+ProgressiveMesh::ProgressiveMesh(const cg3::SimpleEigenMesh& m, unsigned int minNumberFaces) {
+    unsigned int nFaces = m.numberFaces();
+    std::vector<cg3::Point3d> vertices(m.numberVertices());
+    for (unsigned int v = 0; v < vertices.size(); v++)
+        vertices[v] = m.vertex(v);
+    std::vector<std::array<int, 3> > faces(nFaces);
+    std::vector<std::vector<int> > vertexFaces(vertices.size());
+    for (unsigned int f = 0; f < nFaces; f++){
+        cg3::Point3i face = m.face(f);
+        faces[f] = {face.x(), face.y(), face.z()};
+        for (unsigned int i = 0; i < 3; i++)
+            vertexFaces[faces[f][i]].push_back(f);
+    }
+    std::vector<unsigned int> removedAt(nFaces, 0);
+    std::vector<unsigned int> versions(vertices.size(), 0);
+
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse> > queue;
+    for (unsigned int f = 0; f < nFaces; f++){
+        for (unsigned int i = 0; i < 3; i++){
+            int v1 = faces[f][i], v2 = faces[f][(i+1)%3];
+            if (v1 < v2)
+                queue.push(Collapse{(vertices[v1] - vertices[v2]).lengthSquared(), v1, v2, 0, 0});
+        }
+    }
+
+    unsigned int nAliveFaces = nFaces;
+    while (nAliveFaces > minNumberFaces && nAliveFaces > 4 && !queue.empty()){
+        Collapse c = queue.top();
+        queue.pop();
+        int v1 = c.v1, v2 = c.v2;
+        if (versions[v1] != c.version1 || versions[v2] != c.version2 || vertexFaces[v1].empty() || vertexFaces[v2].empty())
+            continue;
+        std::vector<int> shared;
+        for (int f : vertexFaces[v2])
+            if (faces[f][0] == v1 || faces[f][1] == v1 || faces[f][2] == v1)
+                shared.push_back(f);
+        if (shared.size() != 2)
+            continue;
+        std::vector<int> n1 = getNeighbours(v1, vertexFaces, faces), n2 = getNeighbours(v2, vertexFaces, faces), common;
+        std::set_intersection(n1.begin(), n1.end(), n2.begin(), n2.end(), std::back_inserter(common));
+        if (common.size() != 2)
+            continue;
+
+        //v2 is collapsed on v1, moved on the midpoint of the edge
+        vertices[v1] = (vertices[v1] + vertices[v2]) / 2;
+        for (int f : shared){
+            removedAt[f] = nAliveFaces;
+            for (unsigned int i = 0; i < 3; i++){
+                std::vector<int>& vf = vertexFaces[faces[f][i]];
+                if (faces[f][i] != v2)
+                    vf.erase(std::find(vf.begin(), vf.end(), f));
+            }
+        }
+        for (int f : vertexFaces[v2]){
+            if (f == shared[0] || f == shared[1])
+                continue;
+            for (unsigned int i = 0; i < 3; i++)
+                if (faces[f][i] == v2)
+                    faces[f][i] = v1;
+            vertexFaces[v1].push_back(f);
+        }
+        std::vector<int>().swap(vertexFaces[v2]);
+        nAliveFaces -= 2;
+        versions[v1]++;
+        for (int n : getNeighbours(v1, vertexFaces, faces)){
+            if (v1 < n)
+                queue.push(Collapse{(vertices[v1] - vertices[n]).lengthSquared(), v1, n, versions[v1], versions[n]});
+            else
+                queue.push(Collapse{(vertices[v1] - vertices[n]).lengthSquared(), n, v1, versions[n], versions[v1]});
+        }
+    }
+
+    //faces never removed first, then in reverse order of removal
+    std::vector<std::pair<unsigned int, int> > order(nFaces);
+    for (unsigned int f = 0; f < nFaces; f++)
+        order[f] = std::make_pair(removedAt[f], f);
+    std::sort(order.begin(), order.end());
+    sortedFaces.resize(nFaces);
+    removals.resize(nFaces);
+    for (unsigned int i = 0; i < nFaces; i++){
+        removals[i] = order[i].first;
+        sortedFaces[i] = order[i].second;
+    }
+}
+
+/**
+ * @brief ProgressiveMesh::getFaces
+ *
+ * Gets the faces of the input mesh which survive the simplification to numberFaces faces
+ * (all of them if numberFaces is greater or equal than the faces of the mesh).
+ * @param faces: indices of the faces in the input mesh, sorted
+ */
+void ProgressiveMesh::getFaces(unsigned int numberFaces, Eigen::VectorXi& faces) const {
+    unsigned int n = std::upper_bound(removals.begin(), removals.end(), numberFaces) - removals.begin();
+    std::vector<int> prefix(sortedFaces.begin(), sortedFaces.begin() + n);
+    std::sort(prefix.begin(), prefix.end());
+    faces.resize(n);
+    for (unsigned int i = 0; i < n; i++)
+        faces(i) = prefix[i];
+}
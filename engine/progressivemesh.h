@@ -0,0 +1,33 @@
+#ifndef PROGRESSIVEMESH_H
+#define PROGRESSIVEMESH_H
+
+#include <cg3/meshes/eigenmesh/eigenmesh.h>
+#include <vector>
+
+/**
+ * @brief The ProgressiveMesh class
+ *
+ * Records once the simplification of a mesh by edge collapses (shortest edge first,
+ * collapsed on its midpoint), down to a minimum number of faces: every face of the
+ * input mesh stores the number of faces of the mesh when it has been removed.
+ * The faces which survive the simplification to any number of faces (greater or equal
+ * than the minimum) are then a prefix of the faces sorted by removal.
+ */
+class ProgressiveMesh {
+    public:
+        ProgressiveMesh();
+        ProgressiveMesh(const cg3::SimpleEigenMesh& m, unsigned int minNumberFaces);
+
+        unsigned int numberFaces() const;
+        void getFaces(unsigned int numberFaces, Eigen::VectorXi& faces) const;
+
+    private:
+        std::vector<int> sortedFaces; //faces of the input mesh, in reverse order of removal
+        std::vector<unsigned int> removals; //number of faces of the mesh when sortedFaces[i] has been removed (0 if never), non decreasing
+};
+
+inline unsigned int ProgressiveMesh::numberFaces() const {
+    return sortedFaces.size();
+}
+
+#endif // PROGRESSIVEMESH_H
@@ -0,0 +1,476 @@
+#include "setcover.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <queue>
+#include <tuple>
+#include <omp.h>
+
+namespace {
+
+/**
+ * @brief The SetCover class
+ *
+ * Unicost set cover instance restricted to the elements which are not covered
+ * by the sets forced in every solution (the only ones covering some element).
+ */
+class SetCover {
+    public:
+        SetCover(const std::vector<std::vector<unsigned int> >& sets, unsigned int nElements);
+
+        unsigned int numberSets() const;
+        bool isFixed(unsigned int s) const;
+        unsigned int numberFixed() const;
+
+        void greedy(std::vector<unsigned int>& solution) const;
+        void complete(std::vector<unsigned int>& solution, const std::vector<double>& costs) const;
+        void removeRedundant(std::vector<unsigned int>& solution, const std::vector<double>& costs) const;
+        void localSearch(std::vector<unsigned int>& solution, const std::vector<double>& costs, double timeLimit) const;
+        bool isImprovingMove(unsigned int k, const std::vector<unsigned int>& count, const std::vector<unsigned char>& inSolution, std::vector<int>& offset, std::vector<unsigned int>& stamp, unsigned int& currentStamp) const;
+        bool applyMove(unsigned int k, std::vector<unsigned int>& count, std::vector<unsigned char>& inSolution, std::vector<unsigned int>& stamp, unsigned int& currentStamp) const;
+
+        void initialMultipliers(std::vector<double>& multipliers) const;
+        double lagrangianBound(const std::vector<double>& multipliers, std::vector<double>& reducedCosts) const;
+        double subgradient(const std::vector<double>& reducedCosts, std::vector<double>& gradient) const;
+
+    private:
+        std::vector<std::vector<unsigned int> > sets; //elements of the free sets not covered by the fixed ones
+        std::vector<std::vector<unsigned int> > elementSets; //free sets containing every element
+        std::vector<unsigned char> fixed;
+        unsigned int nFixed;
+};
+
+SetCover::SetCover(const std::vector<std::vector<unsigned int> >& allSets, unsigned int nElements) : sets(allSets.size()), elementSets(nElements), fixed(allSets.size(), false), nFixed(0) {
+    std::vector<unsigned int> nSets(nElements, 0), lastSet(nElements, 0);
+    for (unsigned int s = 0; s < allSets.size(); s++){
+        for (unsigned int e : allSets[s]){
+            nSets[e]++;
+            lastSet[e] = s;
+        }
+    }
+    for (unsigned int e = 0; e < nElements; e++){
+        if (nSets[e] == 1 && !fixed[lastSet[e]]){
+            fixed[lastSet[e]] = true;
+            nFixed++;
+        }
+    }
+    std::vector<unsigned char> covered(nElements, false);
+    for (unsigned int s = 0; s < allSets.size(); s++)
+        if (fixed[s])
+            for (unsigned int e : allSets[s])
+                covered[e] = true;
+    for (unsigned int s = 0; s < allSets.size(); s++){
+        if (fixed[s])
+            continue;
+        for (unsigned int e : allSets[s]){
+            if (!covered[e]){
+                sets[s].push_back(e);
+                elementSets[e].push_back(s);
+            }
+        }
+    }
+}
+
+inline unsigned int SetCover::numberSets() const {
+    return sets.size();
+}
+
+inline bool SetCover::isFixed(unsigned int s) const {
+    return fixed[s];
+}
+
+inline unsigned int SetCover::numberFixed() const {
+    return nFixed;
+}
+
+/**
+ * @brief SetCover::greedy
+ *
+ * Chvatal's greedy: takes the free set covering most uncovered elements until
+ * all the elements are covered (lazy priority queue on the number of uncovered elements).
+ * The stale scores on the top of the queue are recomputed in parallel, one set for every
+ * thread; a set is taken when its score is up to date and on the top of the queue,
+ * so the solution does not depend on the number of threads.
+ */
+void SetCover::greedy(std::vector<unsigned int>& solution) const {
+    solution.clear();
+    std::vector<unsigned char> covered(elementSets.size(), false);
+    //(score, set, size of the solution when the score was computed)
+    typedef std::tuple<unsigned int, unsigned int, unsigned int> Candidate;
+    std::priority_queue<Candidate> queue;
+    for (unsigned int s = 0; s < sets.size(); s++)
+        if (sets[s].size() > 0)
+            queue.push(Candidate((unsigned int)sets[s].size(), s, 0));
+    unsigned int nThreads = omp_get_max_threads();
+    std::vector<Candidate> stale;
+    while (!queue.empty()){
+        Candidate top = queue.top();
+        if (std::get<2>(top) == solution.size()){ //up to date: no other set covers more elements
+            queue.pop();
+            solution.push_back(std::get<1>(top));
+            for (unsigned int e : sets[std::get<1>(top)])
+                covered[e] = true;
+            continue;
+        }
+        stale.clear();
+        while (!queue.empty() && stale.size() < nThreads && std::get<2>(queue.top()) != solution.size()){
+            stale.push_back(queue.top());
+            queue.pop();
+        }
+        #pragma omp parallel for if(stale.size() > 1)
+        for (int i = 0; i < (int)stale.size(); i++){
+            unsigned int n = 0;
+            for (unsigned int e : sets[std::get<1>(stale[i])])
+                if (!covered[e])
+                    n++;
+            stale[i] = Candidate(n, std::get<1>(stale[i]), solution.size());
+        }
+        for (const Candidate& c : stale)
+            if (std::get<0>(c) > 0)
+                queue.push(c);
+    }
+}
+
+/**
+ * @brief SetCover::complete
+ *
+ * Adds to the solution, for every uncovered element, its set with the lowest cost.
+ */
+void SetCover::complete(std::vector<unsigned int>& solution, const std::vector<double>& costs) const {
+    std::vector<unsigned char> covered(elementSets.size(), false);
+    for (unsigned int s : solution)
+        for (unsigned int e : sets[s])
+            covered[e] = true;
+    for (unsigned int e = 0; e < elementSets.size(); e++){
+        if (covered[e] || elementSets[e].empty())
+            continue;
+        unsigned int best = elementSets[e][0];
+        for (unsigned int s : elementSets[e])
+            if (costs[s] < costs[best])
+                best = s;
+        solution.push_back(best);
+        for (unsigned int f : sets[best])
+            covered[f] = true;
+    }
+}
+
+/**
+ * @brief SetCover::removeRedundant
+ *
+ * Removes from the solution the sets whose elements are all covered by other sets,
+ * trying first the ones with the highest cost.
+ */
+void SetCover::removeRedundant(std::vector<unsigned int>& solution, const std::vector<double>& costs) const {
+    std::vector<unsigned int> count(elementSets.size(), 0);
+    for (unsigned int s : solution)
+        for (unsigned int e : sets[s])
+            count[e]++;
+    std::vector<std::pair<double, unsigned int> > order;
+    for (unsigned int s : solution)
+        order.push_back(std::make_pair(-costs[s], s));
+    std::sort(order.begin(), order.end());
+    solution.clear();
+    for (const std::pair<double, unsigned int>& p : order){
+        bool redundant = true;
+        for (unsigned int i = 0; i < sets[p.second].size() && redundant; i++)
+            redundant = count[sets[p.second][i]] > 1;
+        if (redundant){
+            for (unsigned int e : sets[p.second])
+                count[e]--;
+        }
+        else
+            solution.push_back(p.second);
+    }
+}
+
+/**
+ * @brief SetCover::localSearch
+ *
+ * Improves the solution by "add one, drop the redundant ones" moves: a set out of the
+ * solution is added (in order of cost), and the sets of the solution sharing elements with it
+ * which become redundant are removed; the move is kept if at least two sets are removed.
+ * The moves of a block of SET_COVER_SEARCH_BLOCK candidates are evaluated in parallel on the
+ * same solution; after the first move applied, the rest of the block is evaluated again serially,
+ * so the result is the one of the serial search.
+ * Stops when no move improves the solution or after timeLimit seconds.
+ */
+void SetCover::localSearch(std::vector<unsigned int>& solution, const std::vector<double>& costs, double timeLimit) const {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<unsigned int> count(elementSets.size(), 0);
+    std::vector<unsigned char> inSolution(sets.size(), false);
+    for (unsigned int s : solution){
+        inSolution[s] = true;
+        for (unsigned int e : sets[s])
+            count[e]++;
+    }
+    std::vector<std::pair<double, unsigned int> > candidates;
+    for (unsigned int s = 0; s < sets.size(); s++)
+        if (sets[s].size() > 0)
+            candidates.push_back(std::make_pair(costs[s], s));
+    std::sort(candidates.begin(), candidates.end());
+
+    std::vector<unsigned int> stamp(sets.size(), 0);
+    unsigned int currentStamp = 0;
+    //buffers of the threads evaluating the moves
+    unsigned int nThreads = omp_get_max_threads();
+    std::vector<std::vector<int> > offsets(nThreads, std::vector<int>(elementSets.size(), 0));
+    std::vector<std::vector<unsigned int> > stamps(nThreads, std::vector<unsigned int>(sets.size(), 0));
+    std::vector<unsigned int> currentStamps(nThreads, 0);
+    std::vector<unsigned char> improving(SET_COVER_SEARCH_BLOCK);
+
+    bool improved = true, timeout = false;
+    while (improved && !timeout){
+        improved = false;
+        for (unsigned int first = 0; first < candidates.size() && !timeout; first += SET_COVER_SEARCH_BLOCK){
+            timeout = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() > timeLimit;
+            if (timeout)
+                continue;
+            unsigned int last = std::min(first + SET_COVER_SEARCH_BLOCK, (unsigned int)candidates.size());
+            #pragma omp parallel for schedule(dynamic)
+            for (int c = first; c < (int)last; c++){
+                unsigned int t = omp_get_thread_num(), k = candidates[c].second;
+                improving[c-first] = !inSolution[k] && isImprovingMove(k, count, inSolution, offsets[t], stamps[t], currentStamps[t]);
+            }
+            bool changed = false;
+            for (unsigned int c = first; c < last; c++){
+                unsigned int k = candidates[c].second;
+                if (inSolution[k] || (!changed && !improving[c-first]))
+                    continue;
+                if (applyMove(k, count, inSolution, stamp, currentStamp))
+                    improved = changed = true;
+            }
+        }
+    }
+    solution.clear();
+    for (unsigned int s = 0; s < sets.size(); s++)
+        if (inSolution[s])
+            solution.push_back(s);
+}
+
+/**
+ * @brief SetCover::isImprovingMove
+ *
+ * True if the move of applyMove adding the set k removes at least two sets.
+ * The solution is not modified: offset (zero for every element) and stamp are
+ * buffers of the calling thread.
+ */
+bool SetCover::isImprovingMove(unsigned int k, const std::vector<unsigned int>& count, const std::vector<unsigned char>& inSolution, std::vector<int>& offset, std::vector<unsigned int>& stamp, unsigned int& currentStamp) const {
+    for (unsigned int e : sets[k])
+        offset[e]++;
+    currentStamp++;
+    unsigned int removed[2], nRemoved = 0;
+    for (unsigned int i = 0; i < sets[k].size() && nRemoved < 2; i++){
+        for (unsigned int j = 0; j < elementSets[sets[k][i]].size() && nRemoved < 2; j++){
+            unsigned int s = elementSets[sets[k][i]][j];
+            if (!inSolution[s] || stamp[s] == currentStamp)
+                continue;
+            stamp[s] = currentStamp;
+            bool redundant = true;
+            for (unsigned int l = 0; l < sets[s].size() && redundant; l++)
+                redundant = (int)count[sets[s][l]] + offset[sets[s][l]] > 1;
+            if (redundant){
+                for (unsigned int f : sets[s])
+                    offset[f]--;
+                removed[nRemoved++] = s;
+            }
+        }
+    }
+    for (unsigned int e : sets[k])
+        offset[e] = 0;
+    for (unsigned int i = 0; i < nRemoved; i++)
+        for (unsigned int f : sets[removed[i]])
+            offset[f] = 0;
+    return nRemoved == 2;
+}
+
+/**
+ * @brief SetCover::applyMove
+ *
+ * Adds the set k to the solution and removes the sets which become redundant,
+ * in the order of the elements of k; the move is undone if less than two sets are removed.
+ * @return true if the move has been applied
+ */
+bool SetCover::applyMove(unsigned int k, std::vector<unsigned int>& count, std::vector<unsigned char>& inSolution, std::vector<unsigned int>& stamp, unsigned int& currentStamp) const {
+    for (unsigned int e : sets[k])
+        count[e]++;
+    currentStamp++;
+    std::vector<unsigned int> removed;
+    for (unsigned int e : sets[k]){
+        for (unsigned int s : elementSets[e]){
+            if (!inSolution[s] || stamp[s] == currentStamp)
+                continue;
+            stamp[s] = currentStamp;
+            bool redundant = true;
+            for (unsigned int i = 0; i < sets[s].size() && redundant; i++)
+                redundant = count[sets[s][i]] > 1;
+            if (redundant){
+                for (unsigned int f : sets[s])
+                    count[f]--;
+                inSolution[s] = false;
+                removed.push_back(s);
+            }
+        }
+    }
+    if (removed.size() >= 2){
+        inSolution[k] = true;
+        return true;
+    }
+    for (unsigned int s : removed){
+        for (unsigned int f : sets[s])
+            count[f]++;
+        inSolution[s] = true;
+    }
+    for (unsigned int e : sets[k])
+        count[e]--;
+    return false;
+}
+
+/**
+ * @brief SetCover::initialMultipliers
+ *
+ * Multiplier of every element: minimum cost per element of its sets.
+ */
+void SetCover::initialMultipliers(std::vector<double>& multipliers) const {
+    multipliers.assign(elementSets.size(), 0);
+    for (unsigned int e = 0; e < elementSets.size(); e++){
+        for (unsigned int i = 0; i < elementSets[e].size(); i++){
+            double u = 1.0 / sets[elementSets[e][i]].size();
+            if (i == 0 || u < multipliers[e])
+                multipliers[e] = u;
+        }
+    }
+}
+
+/**
+ * @brief SetCover::lagrangianBound
+ *
+ * Relaxes the covering constraints with the multipliers.
+ * @param reducedCosts: 1 - sum of the multipliers of the elements of every free set
+ * @return the lower bound of the relaxation (fixed sets excluded)
+ */
+double SetCover::lagrangianBound(const std::vector<double>& multipliers, std::vector<double>& reducedCosts) const {
+    double bound = 0;
+    #pragma omp parallel for schedule(dynamic, 64) reduction(+:bound)
+    for (int s = 0; s < (int)sets.size(); s++){
+        double r = 1;
+        for (unsigned int e : sets[s])
+            r -= multipliers[e];
+        reducedCosts[s] = r;
+        if (sets[s].size() > 0 && r < 0)
+            bound += r;
+    }
+    #pragma omp parallel for reduction(+:bound)
+    for (int e = 0; e < (int)elementSets.size(); e++)
+        if (elementSets[e].size() > 0)
+            bound += multipliers[e];
+    return bound;
+}
+
+/**
+ * @brief SetCover::subgradient
+ *
+ * Subgradient of the relaxation in the solution taking the sets with negative reduced cost.
+ * @return the squared norm of the subgradient
+ */
+double SetCover::subgradient(const std::vector<double>& reducedCosts, std::vector<double>& gradient) const {
+    double norm = 0;
+    #pragma omp parallel for schedule(dynamic, 1024) reduction(+:norm)
+    for (int e = 0; e < (int)elementSets.size(); e++){
+        if (elementSets[e].empty()){
+            gradient[e] = 0;
+            continue;
+        }
+        double g = 1;
+        for (unsigned int s : elementSets[e])
+            if (reducedCosts[s] < 0)
+                g--;
+        gradient[e] = g;
+        norm += g*g;
+    }
+    return norm;
+}
+
+}
+
+/**
+ * @brief solveSetCover
+ *
+ * Unicost set cover: selects the minimum number of sets covering all the elements
+ * (the elements in no set are ignored). Lagrangian heuristic (Beasley 1990):
+ * the covering constraints are relaxed, the multipliers are optimized by subgradient,
+ * and every few iterations the solution of the relaxation is completed and cleaned of
+ * the redundant sets to give an upper bound. The best solution is then improved by
+ * local search. The relaxation, the scores of the greedy and the moves of the
+ * local search are evaluated in parallel.
+ * Stops when the solution is proven optimal, the step becomes negligible or
+ * after timeLimit seconds.
+ * @param lowerBound: lower bound of the number of sets of the optimal solution
+ * @return the number of selected sets
+ */
+unsigned int solveSetCover(
+        const std::vector<std::vector<unsigned int> >& allSets,
+        unsigned int nElements,
+        std::vector<bool>& selected,
+        unsigned int& lowerBound,
+        double timeLimit)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    SetCover sc(allSets, nElements);
+    unsigned int nSets = sc.numberSets(), nFixed = sc.numberFixed();
+
+    std::vector<unsigned int> best, solution;
+    sc.greedy(best);
+    std::vector<double> unitCosts(nSets, 1);
+    sc.removeRedundant(best, unitCosts);
+
+    std::vector<double> multipliers, reducedCosts(nSets, 0), bestReducedCosts(nSets, 0), gradient(nElements, 0);
+    sc.initialMultipliers(multipliers);
+    double bestBound = 0, lambda = 2;
+    unsigned int nNotImproved = 0;
+    for (unsigned int it = 0; it < SET_COVER_MAX_ITERATIONS && lambda > 1e-4; it++){
+        if (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() > timeLimit / 2)
+            break;
+        double bound = sc.lagrangianBound(multipliers, reducedCosts);
+        if (bound > bestBound + 1e-9){
+            bestBound = bound;
+            bestReducedCosts = reducedCosts;
+            nNotImproved = 0;
+        }
+        else if (++nNotImproved >= 20){
+            lambda /= 2;
+            nNotImproved = 0;
+        }
+        double norm = sc.subgradient(reducedCosts, gradient);
+        if (it % 10 == 0 || norm == 0){
+            solution.clear();
+            for (unsigned int s = 0; s < nSets; s++)
+                if (!sc.isFixed(s) && reducedCosts[s] < 0)
+                    solution.push_back(s);
+            sc.complete(solution, reducedCosts);
+            sc.removeRedundant(solution, reducedCosts);
+            if (solution.size() < best.size())
+                best = solution;
+        }
+        if (norm == 0 || std::ceil(bestBound - 1e-6) >= best.size())
+            break;
+        double step = lambda * (1.05 * best.size() - bound) / norm;
+        #pragma omp parallel for
+        for (int e = 0; e < (int)nElements; e++)
+            multipliers[e] = std::max(0.0, multipliers[e] + step * gradient[e]);
+    }
+    lowerBound = nFixed + (unsigned int)std::ceil(bestBound - 1e-6);
+
+    if (lowerBound < nFixed + best.size()){
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        sc.localSearch(best, bestReducedCosts, timeLimit - elapsed);
+    }
+
+    selected.assign(nSets, false);
+    for (unsigned int s = 0; s < nSets; s++)
+        if (sc.isFixed(s))
+            selected[s] = true;
+    for (unsigned int s : best)
+        selected[s] = true;
+    return nFixed + best.size();
+}
@@ -0,0 +1,17 @@
+#ifndef SETCOVER_H
+#define SETCOVER_H
+
+#include <vector>
+
+#define SET_COVER_TIME_LIMIT 60 //seconds
+#define SET_COVER_MAX_ITERATIONS 5000 //subgradient iterations
+#define SET_COVER_SEARCH_BLOCK 256 //moves of the local search evaluated in parallel on the same solution
+
+unsigned int solveSetCover(
+        const std::vector<std::vector<unsigned int> >& sets,
+        unsigned int nElements,
+        std::vector<bool>& selected,
+        unsigned int& lowerBound,
+        double timeLimit = SET_COVER_TIME_LIMIT);
+
+#endif // SETCOVER_H
@@ -1,229 +1,333 @@
 ﻿#include "tricubic.h"
 
+#include <cstring>
+#include <unordered_map>
+
+#define TRICUBIC_TILES_CHUNK 256 //tiles whose coefficients are computed before merging them
+
 using namespace cg3;
 
-void TricubicInterpolator::getCoefficients(std::vector< std::array<gridreal, 64> >& coeffs, Array3D<int>& mapCoeffs, const Array3D<gridreal>& weights) {
-	assert(mapCoeffs.sizeX() == weights.sizeX()-1);
-	assert(mapCoeffs.sizeY() == weights.sizeY()-1);
-	assert(mapCoeffs.sizeZ() == weights.sizeZ()-1);
-    static gridreal temp[64][64] = {
-        { 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        {-3, 3, 0, 0, 0, 0, 0, 0,-2,-1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        { 2,-2, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-3, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-2,-1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2,-2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        {-3, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-2, 0,-1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0,-3, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-2, 0,-1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        { 9,-9,-9, 9, 0, 0, 0, 0, 6, 3,-6,-3, 0, 0, 0, 0, 6,-6, 3,-3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 2, 2, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        {-6, 6, 6,-6, 0, 0, 0, 0,-3,-3, 3, 3, 0, 0, 0, 0,-4, 4,-2, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-2,-2,-1,-1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        { 2, 0,-2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 2, 0,-2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        {-6, 6, 6,-6, 0, 0, 0, 0,-4,-2, 4, 2, 0, 0, 0, 0,-3, 3,-3, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-2,-1,-2,-1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        { 4,-4,-4, 4, 0, 0, 0, 0, 2, 2,-2,-2, 0, 0, 0, 0, 2,-2, 2,-2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-3, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-2,-1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2,-2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-3, 3, 0, 0, 0, 0, 0, 0,-2,-1, 0, 0, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2,-2, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-3, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-2, 0,-1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-3, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-2, 0,-1, 0, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 9,-9,-9, 9, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 6, 3,-6,-3, 0, 0, 0, 0, 6,-6, 3,-3, 0, 0, 0, 0, 4, 2, 2, 1, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-6, 6, 6,-6, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-3,-3, 3, 3, 0, 0, 0, 0,-4, 4,-2, 2, 0, 0, 0, 0,-2,-2,-1,-1, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0,-2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0,-2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-6, 6, 6,-6, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-4,-2, 4, 2, 0, 0, 0, 0,-3, 3,-3, 3, 0, 0, 0, 0,-2,-1,-2,-1, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4,-4,-4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 2,-2,-2, 0, 0, 0, 0, 2,-2, 2,-2, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0},
-        {-3, 0, 0, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-2, 0, 0, 0,-1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0,-3, 0, 0, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-2, 0, 0, 0,-1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        { 9,-9, 0, 0,-9, 9, 0, 0, 6, 3, 0, 0,-6,-3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 6,-6, 0, 0, 3,-3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 2, 0, 0, 2, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        {-6, 6, 0, 0, 6,-6, 0, 0,-3,-3, 0, 0, 3, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-4, 4, 0, 0,-2, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-2,-2, 0, 0,-1,-1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-3, 0, 0, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-2, 0, 0, 0,-1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-3, 0, 0, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-2, 0, 0, 0,-1, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 9,-9, 0, 0,-9, 9, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 6, 3, 0, 0,-6,-3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 6,-6, 0, 0, 3,-3, 0, 0, 4, 2, 0, 0, 2, 1, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-6, 6, 0, 0, 6,-6, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-3,-3, 0, 0, 3, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-4, 4, 0, 0,-2, 2, 0, 0,-2,-2, 0, 0,-1,-1, 0, 0},
-        { 9, 0,-9, 0,-9, 0, 9, 0, 0, 0, 0, 0, 0, 0, 0, 0, 6, 0, 3, 0,-6, 0,-3, 0, 6, 0,-6, 0, 3, 0,-3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 2, 0, 2, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 9, 0,-9, 0,-9, 0, 9, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 6, 0, 3, 0,-6, 0,-3, 0, 6, 0,-6, 0, 3, 0,-3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 2, 0, 2, 0, 1, 0},
-        {-27,27,27,-27,27,-27,-27,27,-18,-9,18, 9,18, 9,-18,-9,-18,18,-9, 9,18,-18, 9,-9,-18,18,18,-18,-9, 9, 9,-9,-12,-6,-6,-3,12, 6, 6, 3,-12,-6,12, 6,-6,-3, 6, 3,-12,12,-6, 6,-6, 6,-3, 3,-8,-4,-4,-2,-4,-2,-2,-1},
-        {18,-18,-18,18,-18,18,18,-18, 9, 9,-9,-9,-9,-9, 9, 9,12,-12, 6,-6,-12,12,-6, 6,12,-12,-12,12, 6,-6,-6, 6, 6, 6, 3, 3,-6,-6,-3,-3, 6, 6,-6,-6, 3, 3,-3,-3, 8,-8, 4,-4, 4,-4, 2,-2, 4, 4, 2, 2, 2, 2, 1, 1},
-        {-6, 0, 6, 0, 6, 0,-6, 0, 0, 0, 0, 0, 0, 0, 0, 0,-3, 0,-3, 0, 3, 0, 3, 0,-4, 0, 4, 0,-2, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-2, 0,-2, 0,-1, 0,-1, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0,-6, 0, 6, 0, 6, 0,-6, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-3, 0,-3, 0, 3, 0, 3, 0,-4, 0, 4, 0,-2, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0,-2, 0,-2, 0,-1, 0,-1, 0},
-        {18,-18,-18,18,-18,18,18,-18,12, 6,-12,-6,-12,-6,12, 6, 9,-9, 9,-9,-9, 9,-9, 9,12,-12,-12,12, 6,-6,-6, 6, 6, 3, 6, 3,-6,-3,-6,-3, 8, 4,-8,-4, 4, 2,-4,-2, 6,-6, 6,-6, 3,-3, 3,-3, 4, 2, 4, 2, 2, 1, 2, 1},
-        {-12,12,12,-12,12,-12,-12,12,-6,-6, 6, 6, 6, 6,-6,-6,-6, 6,-6, 6, 6,-6, 6,-6,-8, 8, 8,-8,-4, 4, 4,-4,-3,-3,-3,-3, 3, 3, 3, 3,-4,-4, 4, 4,-2,-2, 2, 2,-4, 4,-4, 4,-2, 2,-2, 2,-2,-2,-2,-2,-1,-1,-1,-1},
-        { 2, 0, 0, 0,-2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0,-2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        {-6, 6, 0, 0, 6,-6, 0, 0,-4,-2, 0, 0, 4, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-3, 3, 0, 0,-3, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-2,-1, 0, 0,-2,-1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        { 4,-4, 0, 0,-4, 4, 0, 0, 2, 2, 0, 0,-2,-2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2,-2, 0, 0, 2,-2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0,-2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0,-2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-6, 6, 0, 0, 6,-6, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-4,-2, 0, 0, 4, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-3, 3, 0, 0,-3, 3, 0, 0,-2,-1, 0, 0,-2,-1, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4,-4, 0, 0,-4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 0, 0,-2,-2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2,-2, 0, 0, 2,-2, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0},
-        {-6, 0, 6, 0, 6, 0,-6, 0, 0, 0, 0, 0, 0, 0, 0, 0,-4, 0,-2, 0, 4, 0, 2, 0,-3, 0, 3, 0,-3, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-2, 0,-1, 0,-2, 0,-1, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0,-6, 0, 6, 0, 6, 0,-6, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,-4, 0,-2, 0, 4, 0, 2, 0,-3, 0, 3, 0,-3, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0,-2, 0,-1, 0,-2, 0,-1, 0},
-        {18,-18,-18,18,-18,18,18,-18,12, 6,-12,-6,-12,-6,12, 6,12,-12, 6,-6,-12,12,-6, 6, 9,-9,-9, 9, 9,-9,-9, 9, 8, 4, 4, 2,-8,-4,-4,-2, 6, 3,-6,-3, 6, 3,-6,-3, 6,-6, 3,-3, 6,-6, 3,-3, 4, 2, 2, 1, 4, 2, 2, 1},
-        {-12,12,12,-12,12,-12,-12,12,-6,-6, 6, 6, 6, 6,-6,-6,-8, 8,-4, 4, 8,-8, 4,-4,-6, 6, 6,-6,-6, 6, 6,-6,-4,-4,-2,-2, 4, 4, 2, 2,-3,-3, 3, 3,-3,-3, 3, 3,-4, 4,-2, 2,-4, 4,-2, 2,-2,-2,-1,-1,-2,-2,-1,-1},
-        { 4, 0,-4, 0,-4, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 2, 0,-2, 0,-2, 0, 2, 0,-2, 0, 2, 0,-2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-        { 0, 0, 0, 0, 0, 0, 0, 0, 4, 0,-4, 0,-4, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 2, 0,-2, 0,-2, 0, 2, 0,-2, 0, 2, 0,-2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 1, 0, 1, 0},
-        {-12,12,12,-12,12,-12,-12,12,-8,-4, 8, 4, 8, 4,-8,-4,-6, 6,-6, 6, 6,-6, 6,-6,-6, 6, 6,-6,-6, 6, 6,-6,-4,-2,-4,-2, 4, 2, 4, 2,-4,-2, 4, 2,-4,-2, 4, 2,-3, 3,-3, 3,-3, 3,-3, 3,-2,-1,-2,-1,-2,-1,-2,-1},
-        { 8,-8,-8, 8,-8, 8, 8,-8, 4, 4,-4,-4,-4,-4, 4, 4, 4,-4, 4,-4,-4, 4,-4, 4, 4,-4,-4, 4, 4,-4,-4, 4, 2, 2, 2, 2,-2,-2,-2,-2, 2, 2,-2,-2, 2, 2,-2,-2, 2,-2, 2,-2, 2,-2, 2,-2, 1, 1, 1, 1, 1, 1, 1, 1}
-    };
+/**
+ * @brief The CoefficientsHash struct
+ *
+ * FNV-1a hash of 64 values (zeros are hashed as +0, since -0 == 0).
+ */
+struct CoefficientsHash {
+    size_t operator()(const std::array<gridreal, 64>& a) const {
+        unsigned long long int h = 14695981039346656037ULL;
+        for (unsigned int i = 0; i < 64; i++){
+            unsigned int bits = 0;
+            if (a[i] != 0)
+                std::memcpy(&bits, &a[i], sizeof(gridreal));
+            h = (h ^ bits) * 1099511628211ULL;
+        }
+        return (size_t)h;
+    }
+};
 
-    static Eigen::Map<Eigen::Matrix<gridreal,64,64, Eigen::RowMajor>> C(&temp[0][0]);
-    /*for(int i=0;i<64;i++){
-        for(int j=0;j<64;j++){
-            C(i,j) = temp[i][j];
+typedef std::unordered_map<std::array<gridreal, 64>, int, CoefficientsHash> CoefficientsMap;
+
+/**
+ * @brief addCoefficients
+ *
+ * Returns the id of the coefficients arr in coeffs, adding them if they are new.
+ */
+static int addCoefficients(std::vector< std::array<gridreal, 64> >& coeffs, CoefficientsMap& mapping, const std::array<gridreal, 64>& arr) {
+    CoefficientsMap::iterator it = mapping.find(arr);
+    if (it != mapping.end())
+        return it->second;
+    int id = coeffs.size();
+    coeffs.push_back(arr);
+    mapping[arr] = id;
+    return id;
+}
+
+typedef std::unordered_multimap<size_t, int> CoefficientsIndex;
+
+/**
+ * @brief mergeCoefficients
+ *
+ * Same as addCoefficients, with the hash h of arr already computed: coeffs are indexed
+ * by their hashes only, and the coefficients with the same hash are compared.
+ */
+static int mergeCoefficients(std::vector< std::array<gridreal, 64> >& coeffs, CoefficientsIndex& index, const std::array<gridreal, 64>& arr, size_t h) {
+    std::pair<CoefficientsIndex::iterator, CoefficientsIndex::iterator> range = index.equal_range(h);
+    for (CoefficientsIndex::iterator it = range.first; it != range.second; ++it)
+        if (coeffs[it->second] == arr)
+            return it->second;
+    int id = coeffs.size();
+    coeffs.push_back(arr);
+    index.insert(std::make_pair(h, id));
+    return id;
+}
+
+/**
+ * @brief getConstantCoefficients
+ * @return the coefficients of the interpolant of a constant neighbourhood of weights
+ */
+static std::array<gridreal, 64> getConstantCoefficients(gridreal value) {
+    std::array<gridreal, 64> arr;
+    arr[0] = value;
+    for (int i = 1; i < 64; i++) arr[i] = 0;
+    return arr;
+}
+
+
+/**
+ * @brief catmullRom
+ *
+ * Coefficients of the cubic on [0,1] which interpolates w1 and w2, with the central
+ * differences (w2-w0)/2 and (w3-w1)/2 as derivatives (1D Hermite basis applied to the
+ * finite differences). w and a are read and written with the given strides.
+ */
+static inline void catmullRom(const gridreal* w, unsigned int wStride, gridreal* a, unsigned int aStride) {
+    gridreal w0 = w[0], w1 = w[wStride], w2 = w[2*wStride], w3 = w[3*wStride];
+    a[0] = w1;
+    a[aStride] = (gridreal)0.5*(w2 - w0);
+    a[2*aStride] = w0 - (gridreal)2.5*w1 + 2*w2 - (gridreal)0.5*w3;
+    a[3*aStride] = (gridreal)0.5*(w3 - w0) + (gridreal)1.5*(w1 - w2);
+}
+
+/**
+ * @brief getTricubicCoefficients
+ *
+ * With the derivatives estimated by central differences, the 64x64 matrix of the tricubic
+ * interpolation is the Kronecker product of three 4x4 Catmull-Rom matrices: the coefficients
+ * are computed with three passes of catmullRom, along z, y and x (about 500 flops instead
+ * of the 4096 of the product with the 64x64 matrix).
+ * @param n: n[(a*4 + b)*4 + c] is the weight on the point (a-1, b-1, c-1) of the cell
+ * @param coeffs: coeffs[i + 4*j + 16*k] is the coefficient of x^i y^j z^k
+ */
+static void getTricubicCoefficients(const gridreal* n, gridreal* coeffs) {
+    gridreal tz[64], ty[64];
+    //tz[(a*4 + b)*4 + k]
+    for (unsigned int ab = 0; ab < 16; ab++)
+        catmullRom(n + ab*4, 1, tz + ab*4, 1);
+    //ty[(a*4 + j)*4 + k]
+    for (unsigned int a = 0; a < 4; a++)
+        for (unsigned int k = 0; k < 4; k++)
+            catmullRom(tz + a*16 + k, 4, ty + a*16 + k, 4);
+    for (unsigned int j = 0; j < 4; j++)
+        for (unsigned int k = 0; k < 4; k++)
+            catmullRom(ty + j*4 + k, 16, coeffs + j*4 + k*16, 1);
+}
+
+/**
+ * @brief computeTileCoefficients
+ *
+ * Computes the coefficients of the interior cells of the tile t of mapCoeffs
+ * (the cells on the outer layer of mapCoeffs are not modified), and compacts the tile.
+ * @param neighbourhoods: neighbourhoods of weights already computed, with the id of their coefficients
+ */
+static TricubicInterpolator::CoefficientsStatistics computeTileCoefficients(std::vector< std::array<gridreal, 64> >& coeffs, CoefficientsMap& mapping, CoefficientsMap& neighbourhoods,
+                                                                          BlockedArray3D<int>& mapCoeffs, const BlockedArray3D<gridreal>& weights, unsigned int t) {
+    TricubicInterpolator::CoefficientsStatistics statistics = {0, 0, 0};
+    unsigned int ti, tj, tk;
+    mapCoeffs.getTileFirst(t, ti, tj, tk);
+    unsigned int xBegin = std::max(ti, 1u), yBegin = std::max(tj, 1u), zBegin = std::max(tk, 1u);
+    unsigned int xEnd = std::min(ti + BLOCKED_ARRAY_TILE_SIZE, weights.sizeX() - 2);
+    unsigned int yEnd = std::min(tj + BLOCKED_ARRAY_TILE_SIZE, weights.sizeY() - 2);
+    unsigned int zEnd = std::min(tk + BLOCKED_ARRAY_TILE_SIZE, weights.sizeZ() - 2);
+    if (xBegin >= xEnd || yBegin >= yEnd || zBegin >= zEnd)
+        return statistics;
+
+    //weights constant around all the cells of the tile
+    gridreal value;
+    if (weights.isConstant(xBegin-1, yBegin-1, zBegin-1, xEnd+2, yEnd+2, zEnd+2, value)){
+        int id = addCoefficients(coeffs, mapping, getConstantCoefficients(value));
+        statistics.nConstantCells += (unsigned long long int)(xEnd-xBegin) * (yEnd-yBegin) * (zEnd-zBegin);
+        if (xBegin == ti && yBegin == tj && zBegin == tk &&
+                xEnd == ti + BLOCKED_ARRAY_TILE_SIZE && yEnd == tj + BLOCKED_ARRAY_TILE_SIZE && zEnd == tk + BLOCKED_ARRAY_TILE_SIZE)
+            mapCoeffs.setTile(t, id);
+        else {
+            for (unsigned int xi = xBegin; xi < xEnd; xi++)
+                for (unsigned int yi = yBegin; yi < yEnd; yi++)
+                    for (unsigned int zi = zBegin; zi < zEnd; zi++)
+                        mapCoeffs.set(xi, yi, zi, id);
+            mapCoeffs.compactTile(t);
+        }
+        return statistics;
+    }
+
+    //the cells of a row along z are visited sliding the neighbourhood of weights:
+    //every cell reads only the 16 weights of its last layer
+    for (unsigned int xi = xBegin; xi < xEnd; xi++){
+        for (unsigned int yi = yBegin; yi < yEnd; yi++){
+            //n[(a*4 + b)*4 + c] is the weight on (xi-1+a, yi-1+b, zi-1+c)
+            std::array<gridreal, 64> n;
+            for (unsigned int ab = 0; ab < 16; ab++)
+                for (unsigned int c = 0; c < 3; c++)
+                    n[ab*4 + c + 1] = weights(xi-1 + ab/4, yi-1 + ab%4, zBegin-1 + c);
+            for (unsigned int zi = zBegin; zi < zEnd; zi++){
+                for (unsigned int ab = 0; ab < 16; ab++){
+                    n[ab*4] = n[ab*4 + 1];
+                    n[ab*4 + 1] = n[ab*4 + 2];
+                    n[ab*4 + 2] = n[ab*4 + 3];
+                    n[ab*4 + 3] = weights(xi-1 + ab/4, yi-1 + ab%4, zi+2);
+                }
+                bool constant = true;
+                for (unsigned int c = 1; c < 64 && constant; c++)
+                    constant = n[c] == n[0];
+                if (constant){
+                    mapCoeffs.set(xi, yi, zi, addCoefficients(coeffs, mapping, getConstantCoefficients(n[0])));
+                    statistics.nConstantCells++;
+                    continue;
+                }
+                CoefficientsMap::iterator it = neighbourhoods.find(n);
+                if (it != neighbourhoods.end()){
+                    mapCoeffs.set(xi, yi, zi, it->second);
+                    statistics.nRepeatedCells++;
+                    continue;
+                }
+
+                std::array<gridreal, 64> arr;
+                getTricubicCoefficients(n.data(), arr.data());
+                int id = addCoefficients(coeffs, mapping, arr);
+                neighbourhoods[n] = id;
+                mapCoeffs.set(xi, yi, zi, id);
+                statistics.nComputedCells++;
+            }
         }
-    }*/
+    }
+    mapCoeffs.compactTile(t);
+    return statistics;
+}
 
+/**
+ * @brief translateTileIds
+ *
+ * Replaces every id of the tile t of mapCoeffs with ids[id].
+ */
+static void translateTileIds(BlockedArray3D<int>& mapCoeffs, unsigned int t, const std::vector<int>& ids) {
+    if (mapCoeffs.isConstantTile(t)){
+        mapCoeffs.setTile(t, ids[mapCoeffs.getTileValue(t)]);
+        return;
+    }
+    unsigned int ti, tj, tk;
+    mapCoeffs.getTileFirst(t, ti, tj, tk);
+    for (unsigned int i = ti; i < std::min(ti + BLOCKED_ARRAY_TILE_SIZE, mapCoeffs.sizeX()); i++)
+        for (unsigned int j = tj; j < std::min(tj + BLOCKED_ARRAY_TILE_SIZE, mapCoeffs.sizeY()); j++)
+            for (unsigned int k = tk; k < std::min(tk + BLOCKED_ARRAY_TILE_SIZE, mapCoeffs.sizeZ()); k++)
+                mapCoeffs.set(i, j, k, ids[mapCoeffs(i,j,k)]);
+}
+
+/**
+ * @brief TricubicInterpolator::getCoefficients
+ *
+ * Computes the coefficients of the interpolant of every cell (see getTricubicCoefficients),
+ * shared by the cells with the same coefficients. The computation is skipped for the
+ * cells whose 4x4x4 neighbourhood of weights is constant (the interpolant is constant)
+ * or equal to the neighbourhood of an already computed cell of the same tile.
+ * @return the number of cells of every kind
+ */
+TricubicInterpolator::CoefficientsStatistics TricubicInterpolator::getCoefficients(std::vector< std::array<gridreal, 64> >& coeffs, BlockedArray3D<int>& mapCoeffs, const BlockedArray3D<gridreal>& weights) {
+	assert(mapCoeffs.sizeX() == weights.sizeX()-1);
+	assert(mapCoeffs.sizeY() == weights.sizeY()-1);
+	assert(mapCoeffs.sizeZ() == weights.sizeZ()-1);
     // tutti i primi coefficienti delle tricubiche sono pari al valore del primo punto dei pesi. Questo valore dovrebbe essere uguale in tutto il doppio bordo dei pesi.
     // Dopo, tutti i coefficienti dei cubi "interni" verranno calcolati in base ai valori del grigliato
     // rimarranno invariati quindi solo i cofficienti dei cubi sul bordo, dove l'interpolante sarà una funzione costante
-    std::map <std::array<gridreal, 64>, int> mapping;
-    std::array<gridreal, 64> arr;
+    CoefficientsIndex index;
     coeffs.clear();
-    arr[0] = weights(0,0,0);
-    for (int i = 1; i < 64; i++) arr[i] = 0;
-    mapping[arr] = 0;
-    coeffs.push_back(arr);
-    int nCoeffs = 1;
+    std::array<gridreal, 64> border = getConstantCoefficients(weights(0,0,0));
+    mergeCoefficients(coeffs, index, border, CoefficientsHash()(border));
 
     unsigned int i = 0;
 	for (unsigned int j = 0; j < weights.sizeY()-1; j++){
 		for (unsigned int k = 0; k < weights.sizeZ()-1; ++k){
-            mapCoeffs(i,j,k) = 0;
+            mapCoeffs.set(i,j,k, 0);
         }
     }
 	i = weights.sizeX()-2;
 	for (unsigned int j = 0; j < weights.sizeY()-1; j++){
 		for (unsigned int k = 0; k < weights.sizeZ()-1; ++k){
-            mapCoeffs(i,j,k) = 0;
+            mapCoeffs.set(i,j,k, 0);
         }
     }
     unsigned int j = 0;
 	for (unsigned int i = 0; i < weights.sizeX()-1; i++){
 		for (unsigned int k = 0; k < weights.sizeZ()-1; ++k){
-            mapCoeffs(i,j,k) = 0;
+            mapCoeffs.set(i,j,k, 0);
         }
     }
 	j = weights.sizeY()-2;
 	for (unsigned int i = 0; i < weights.sizeX()-1; i++){
 		for (unsigned int k = 0; k < weights.sizeZ()-1; ++k){
-            mapCoeffs(i,j,k) = 0;
+            mapCoeffs.set(i,j,k, 0);
         }
     }
     unsigned int k = 0;
 	for (unsigned int i = 0; i < weights.sizeX()-1; i++){
 		for (unsigned int j = 0; j < weights.sizeY()-1; ++j){
-            mapCoeffs(i,j,k) = 0;
+            mapCoeffs.set(i,j,k, 0);
         }
     }
 	k = weights.sizeZ()-2;
 	for (unsigned int i = 0; i < weights.sizeX()-1; i++){
 		for (unsigned int j = 0; j < weights.sizeY()-1; ++j){
-            mapCoeffs(i,j,k) = 0;
+            mapCoeffs.set(i,j,k, 0);
         }
     }
 
-    #pragma omp parallel for
-	for (unsigned int xi = 1; xi < weights.sizeX() - 2; xi++){
-		for (unsigned int yi = 1; yi < weights.sizeY() - 2; yi++){
-			for (unsigned int zi = 1; zi < weights.sizeZ() - 2; zi++){
-                Eigen::Matrix<gridreal,64,1> x;
-                x <<
-                        // values of f(x,y,z) at each corner.
-                        weights(xi,yi,zi),weights(xi+1,yi,zi),weights(xi,yi+1,zi),
-                        weights(xi+1,yi+1,zi),weights(xi,yi,zi+1),weights(xi+1,yi,zi+1),
-                        weights(xi,yi+1,zi+1),weights(xi+1,yi+1,zi+1),
-                        // values of df/dx at each corner.
-                        0.5*(weights(xi+1,yi,zi)-weights(xi-1,yi,zi)),
-                        0.5*(weights(xi+2,yi,zi)-weights(xi,yi,zi)),
-                        0.5*(weights(xi+1,yi+1,zi)-weights(xi-1,yi+1,zi)),
-                        0.5*(weights(xi+2,yi+1,zi)-weights(xi,yi+1,zi)),
-                        0.5*(weights(xi+1,yi,zi+1)-weights(xi-1,yi,zi+1)),
-                        0.5*(weights(xi+2,yi,zi+1)-weights(xi,yi,zi+1)),
-                        0.5*(weights(xi+1,yi+1,zi+1)-weights(xi-1,yi+1,zi+1)),
-                        0.5*(weights(xi+2,yi+1,zi+1)-weights(xi,yi+1,zi+1)),
-                        // values of df/dy at each corner.
-                        0.5*(weights(xi,yi+1,zi)-weights(xi,yi-1,zi)),
-                        0.5*(weights(xi+1,yi+1,zi)-weights(xi+1,yi-1,zi)),
-                        0.5*(weights(xi,yi+2,zi)-weights(xi,yi,zi)),
-                        0.5*(weights(xi+1,yi+2,zi)-weights(xi+1,yi,zi)),
-                        0.5*(weights(xi,yi+1,zi+1)-weights(xi,yi-1,zi+1)),
-                        0.5*(weights(xi+1,yi+1,zi+1)-weights(xi+1,yi-1,zi+1)),
-                        0.5*(weights(xi,yi+2,zi+1)-weights(xi,yi,zi+1)),
-                        0.5*(weights(xi+1,yi+2,zi+1)-weights(xi+1,yi,zi+1)),
-                        // values of df/dz at each corner.
-                        0.5*(weights(xi,yi,zi+1)-weights(xi,yi,zi-1)),
-                        0.5*(weights(xi+1,yi,zi+1)-weights(xi+1,yi,zi-1)),
-                        0.5*(weights(xi,yi+1,zi+1)-weights(xi,yi+1,zi-1)),
-                        0.5*(weights(xi+1,yi+1,zi+1)-weights(xi+1,yi+1,zi-1)),
-                        0.5*(weights(xi,yi,zi+2)-weights(xi,yi,zi)),
-                        0.5*(weights(xi+1,yi,zi+2)-weights(xi+1,yi,zi)),
-                        0.5*(weights(xi,yi+1,zi+2)-weights(xi,yi+1,zi)),
-                        0.5*(weights(xi+1,yi+1,zi+2)-weights(xi+1,yi+1,zi)),
-                        // values of d2f/dxdy at each corner.
-                        0.25*(weights(xi+1,yi+1,zi)-weights(xi-1,yi+1,zi)-weights(xi+1,yi-1,zi)+weights(xi-1,yi-1,zi)),
-                        0.25*(weights(xi+2,yi+1,zi)-weights(xi,yi+1,zi)-weights(xi+2,yi-1,zi)+weights(xi,yi-1,zi)),
-                        0.25*(weights(xi+1,yi+2,zi)-weights(xi-1,yi+2,zi)-weights(xi+1,yi,zi)+weights(xi-1,yi,zi)),
-                        0.25*(weights(xi+2,yi+2,zi)-weights(xi,yi+2,zi)-weights(xi+2,yi,zi)+weights(xi,yi,zi)),
-                        0.25*(weights(xi+1,yi+1,zi+1)-weights(xi-1,yi+1,zi+1)-weights(xi+1,yi-1,zi+1)+weights(xi-1,yi-1,zi+1)),
-                        0.25*(weights(xi+2,yi+1,zi+1)-weights(xi,yi+1,zi+1)-weights(xi+2,yi-1,zi+1)+weights(xi,yi-1,zi+1)),
-                        0.25*(weights(xi+1,yi+2,zi+1)-weights(xi-1,yi+2,zi+1)-weights(xi+1,yi,zi+1)+weights(xi-1,yi,zi+1)),
-                        0.25*(weights(xi+2,yi+2,zi+1)-weights(xi,yi+2,zi+1)-weights(xi+2,yi,zi+1)+weights(xi,yi,zi+1)),
-                        // values of d2f/dxdz at each corner.
-                        0.25*(weights(xi+1,yi,zi+1)-weights(xi-1,yi,zi+1)-weights(xi+1,yi,zi-1)+weights(xi-1,yi,zi-1)),
-                        0.25*(weights(xi+2,yi,zi+1)-weights(xi,yi,zi+1)-weights(xi+2,yi,zi-1)+weights(xi,yi,zi-1)),
-                        0.25*(weights(xi+1,yi+1,zi+1)-weights(xi-1,yi+1,zi+1)-weights(xi+1,yi+1,zi-1)+weights(xi-1,yi+1,zi-1)),
-                        0.25*(weights(xi+2,yi+1,zi+1)-weights(xi,yi+1,zi+1)-weights(xi+2,yi+1,zi-1)+weights(xi,yi+1,zi-1)),
-                        0.25*(weights(xi+1,yi,zi+2)-weights(xi-1,yi,zi+2)-weights(xi+1,yi,zi)+weights(xi-1,yi,zi)),
-                        0.25*(weights(xi+2,yi,zi+2)-weights(xi,yi,zi+2)-weights(xi+2,yi,zi)+weights(xi,yi,zi)),
-                        0.25*(weights(xi+1,yi+1,zi+2)-weights(xi-1,yi+1,zi+2)-weights(xi+1,yi+1,zi)+weights(xi-1,yi+1,zi)),
-                        0.25*(weights(xi+2,yi+1,zi+2)-weights(xi,yi+1,zi+2)-weights(xi+2,yi+1,zi)+weights(xi,yi+1,zi)),
-                        // values of d2f/dydz at each corner.
-                        0.25*(weights(xi,yi+1,zi+1)-weights(xi,yi-1,zi+1)-weights(xi,yi+1,zi-1)+weights(xi,yi-1,zi-1)),
-                        0.25*(weights(xi+1,yi+1,zi+1)-weights(xi+1,yi-1,zi+1)-weights(xi+1,yi+1,zi-1)+weights(xi+1,yi-1,zi-1)),
-                        0.25*(weights(xi,yi+2,zi+1)-weights(xi,yi,zi+1)-weights(xi,yi+2,zi-1)+weights(xi,yi,zi-1)),
-                        0.25*(weights(xi+1,yi+2,zi+1)-weights(xi+1,yi,zi+1)-weights(xi+1,yi+2,zi-1)+weights(xi+1,yi,zi-1)),
-                        0.25*(weights(xi,yi+1,zi+2)-weights(xi,yi-1,zi+2)-weights(xi,yi+1,zi)+weights(xi,yi-1,zi)),
-                        0.25*(weights(xi+1,yi+1,zi+2)-weights(xi+1,yi-1,zi+2)-weights(xi+1,yi+1,zi)+weights(xi+1,yi-1,zi)),
-                        0.25*(weights(xi,yi+2,zi+2)-weights(xi,yi,zi+2)-weights(xi,yi+2,zi)+weights(xi,yi,zi)),
-                        0.25*(weights(xi+1,yi+2,zi+2)-weights(xi+1,yi,zi+2)-weights(xi+1,yi+2,zi)+weights(xi+1,yi,zi)),
-                        // values of d3f/dxdydz at each corner.
-                        0.125*(weights(xi+1,yi+1,zi+1)-weights(xi-1,yi+1,zi+1)-weights(xi+1,yi-1,zi+1)+weights(xi-1,yi-1,zi+1)-weights(xi+1,yi+1,zi-1)+weights(xi-1,yi+1,zi-1)+weights(xi+1,yi-1,zi-1)-weights(xi-1,yi-1,zi-1)),
-                        0.125*(weights(xi+2,yi+1,zi+1)-weights(xi,yi+1,zi+1)-weights(xi+2,yi-1,zi+1)+weights(xi,yi-1,zi+1)-weights(xi+2,yi+1,zi-1)+weights(xi,yi+1,zi-1)+weights(xi+2,yi-1,zi-1)-weights(xi,yi-1,zi-1)),
-                        0.125*(weights(xi+1,yi+2,zi+1)-weights(xi-1,yi+2,zi+1)-weights(xi+1,yi,zi+1)+weights(xi-1,yi,zi+1)-weights(xi+1,yi+2,zi-1)+weights(xi-1,yi+2,zi-1)+weights(xi+1,yi,zi-1)-weights(xi-1,yi,zi-1)),
-                        0.125*(weights(xi+2,yi+2,zi+1)-weights(xi,yi+2,zi+1)-weights(xi+2,yi,zi+1)+weights(xi,yi,zi+1)-weights(xi+2,yi+2,zi-1)+weights(xi,yi+2,zi-1)+weights(xi+2,yi,zi-1)-weights(xi,yi,zi-1)),
-                        0.125*(weights(xi+1,yi+1,zi+2)-weights(xi-1,yi+1,zi+2)-weights(xi+1,yi-1,zi+2)+weights(xi-1,yi-1,zi+2)-weights(xi+1,yi+1,zi)+weights(xi-1,yi+1,zi)+weights(xi+1,yi-1,zi)-weights(xi-1,yi-1,zi)),
-                        0.125*(weights(xi+2,yi+1,zi+2)-weights(xi,yi+1,zi+2)-weights(xi+2,yi-1,zi+2)+weights(xi,yi-1,zi+2)-weights(xi+2,yi+1,zi)+weights(xi,yi+1,zi)+weights(xi+2,yi-1,zi)-weights(xi,yi-1,zi)),
-                        0.125*(weights(xi+1,yi+2,zi+2)-weights(xi-1,yi+2,zi+2)-weights(xi+1,yi,zi+2)+weights(xi-1,yi,zi+2)-weights(xi+1,yi+2,zi)+weights(xi-1,yi+2,zi)+weights(xi+1,yi,zi)-weights(xi-1,yi,zi)),
-                        0.125*(weights(xi+2,yi+2,zi+2)-weights(xi,yi+2,zi+2)-weights(xi+2,yi,zi+2)+weights(xi,yi,zi+2)-weights(xi+2,yi+2,zi)+weights(xi,yi+2,zi)+weights(xi+2,yi,zi)-weights(xi,yi,zi))
-                        ;
-                Eigen::Matrix<gridreal,64,1> coefs;
-                coefs = C * x;
-                std::array<gridreal, 64> arr;
-                for (unsigned k = 0; k < 64; k++){
-                    arr[k] = coefs(k,0);
-                }
-                std::map<std::array<gridreal, 64>, int>::iterator it = mapping.find(arr);
-                if (it == mapping.end()){
-                    #pragma omp critical
-                    {
-                        coeffs.push_back(arr);
-                        mapping[arr] = nCoeffs;
-                    }
-                    mapCoeffs(xi, yi, zi) = nCoeffs++;
-                }
-                else {
-                    mapCoeffs(xi, yi, zi) = it->second;
-                }
-            }
+    unsigned long long int nConstantCells = 0, nRepeatedCells = 0, nComputedCells = 0;
+
+    //the tiles of mapCoeffs are visited in parallel by chunks, every one with its own coefficients
+    //(see getTileCoefficients), without locks. Then the coefficients of the tiles of the chunk are
+    //merged in coeffs in the order of the tiles, so the ids do not depend on the threads, and the ids
+    //of the tiles are translated
+    const unsigned int nTiles = mapCoeffs.getNumberTiles();
+    std::vector< std::vector< std::array<gridreal, 64> > > tileCoeffs(std::min(nTiles, (unsigned int)TRICUBIC_TILES_CHUNK));
+    std::vector< std::vector<size_t> > tileHashes(tileCoeffs.size());
+    std::vector< std::vector<int> > tileIds(tileCoeffs.size());
+    for (unsigned int first = 0; first < nTiles; first += TRICUBIC_TILES_CHUNK){
+        unsigned int last = std::min(first + TRICUBIC_TILES_CHUNK, nTiles);
+        #pragma omp parallel for schedule(dynamic) reduction(+:nConstantCells,nRepeatedCells,nComputedCells)
+        for (unsigned int t = first; t < last; t++){
+            std::vector< std::array<gridreal, 64> >& c = tileCoeffs[t-first];
+            CoefficientsStatistics tileStatistics = getTileCoefficients(c, mapCoeffs, weights, t);
+            nConstantCells += tileStatistics.nConstantCells;
+            nRepeatedCells += tileStatistics.nRepeatedCells;
+            nComputedCells += tileStatistics.nComputedCells;
+            tileHashes[t-first].resize(c.size());
+            for (unsigned int l = 0; l < c.size(); l++)
+                tileHashes[t-first][l] = CoefficientsHash()(c[l]);
+        }
+        for (unsigned int t = first; t < last; t++){
+            std::vector<int>& ids = tileIds[t-first];
+            ids.resize(tileCoeffs[t-first].size());
+            for (unsigned int l = 0; l < ids.size(); l++)
+                ids[l] = mergeCoefficients(coeffs, index, tileCoeffs[t-first][l], tileHashes[t-first][l]);
         }
+        #pragma omp parallel for schedule(dynamic)
+        for (unsigned int t = first; t < last; t++)
+            translateTileIds(mapCoeffs, t, tileIds[t-first]);
     }
+
+    CoefficientsStatistics statistics;
+    statistics.nConstantCells = nConstantCells;
+    statistics.nRepeatedCells = nRepeatedCells;
+    statistics.nComputedCells = nComputedCells;
+    return statistics;
+}
+
+/**
+ * @brief TricubicInterpolator::getTileCoefficients
+ *
+ * Computes the coefficients of the cells of the tile t of mapCoeffs only: coeffs are
+ * the distinct coefficients of the tile (the first ones are the coefficients of the border),
+ * and the ids of the tile in mapCoeffs refer to them.
+ * It can be called concurrently on different tiles (with different coeffs).
+ * @return the number of cells of every kind
+ */
+TricubicInterpolator::CoefficientsStatistics TricubicInterpolator::getTileCoefficients(std::vector< std::array<gridreal, 64> >& coeffs, BlockedArray3D<int>& mapCoeffs, const BlockedArray3D<gridreal>& weights, unsigned int t) {
+    assert(mapCoeffs.sizeX() == weights.sizeX()-1);
+    assert(mapCoeffs.sizeY() == weights.sizeY()-1);
+    assert(mapCoeffs.sizeZ() == weights.sizeZ()-1);
+    CoefficientsMap mapping, neighbourhoods;
+    coeffs.clear();
+    addCoefficients(coeffs, mapping, getConstantCoefficients(weights(0,0,0)));
+    mapCoeffs.setTile(t, 0);
+    return computeTileCoefficients(coeffs, mapping, neighbourhoods, mapCoeffs, weights, t);
 }
 
 void TricubicInterpolator::getCoefficients(Array4D<gridreal>& coeffs, const Array3D<gridreal>& weights) {
@@ -4,12 +4,26 @@
 #include <Eigen/Core>
 #include "cg3/data_structures/arrays/arrays.h"
 #include "cg3/geometry/point3.h"
+#include "lib/grid/blockedarray3d.h"
 
 typedef float gridreal;
 
 namespace TricubicInterpolator {
 
-    void getCoefficients(std::vector<std::array<gridreal, 64> >& coeffs, cg3::Array3D<int>& mapCoeffs,  const cg3::Array3D<gridreal> &weights);
+    /**
+     * @brief The CoefficientsStatistics struct
+     *
+     * Number of the interior cells for which the coefficients have been computed,
+     * and of the ones which share the coefficients of another cell without computing them.
+     */
+    struct CoefficientsStatistics {
+        unsigned long long int nConstantCells; //constant 4x4x4 neighbourhood of weights
+        unsigned long long int nRepeatedCells; //same neighbourhood of an already computed cell
+        unsigned long long int nComputedCells;
+    };
+
+    CoefficientsStatistics getCoefficients(std::vector<std::array<gridreal, 64> >& coeffs, BlockedArray3D<int>& mapCoeffs,  const BlockedArray3D<gridreal> &weights);
+    CoefficientsStatistics getTileCoefficients(std::vector<std::array<gridreal, 64> >& coeffs, BlockedArray3D<int>& mapCoeffs, const BlockedArray3D<gridreal>& weights, unsigned int t);
 
     void getCoefficients(cg3::Array4D<gridreal>& coeffs, const cg3::Array3D<gridreal> &weights);
 
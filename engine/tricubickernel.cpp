@@ -0,0 +1,206 @@
+#include "tricubickernel.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TRICUBIC_KERNEL_X86
+#include <immintrin.h>
+#endif
+
+namespace TricubicKernel {
+
+typedef void (*ContractBatchFunction)(const gridreal* const*, const double*, double*, unsigned int);
+
+static void contractBatchScalar(const gridreal* const* coeffs, const double* factors, double* results, unsigned int n) {
+    for (unsigned int c = 0; c < n; c++){
+        const double* f = factors + 12*c;
+        results[c] = contract<double>(coeffs[c], f, f+4, f+8);
+    }
+}
+
+static void contractBatchScalarFloat(const gridreal* const* coeffs, const double* factors, double* results, unsigned int n) {
+    for (unsigned int c = 0; c < n; c++){
+        float f[12];
+        for (unsigned int i = 0; i < 12; i++)
+            f[i] = (float)factors[12*c + i];
+        results[c] = contract<float>(coeffs[c], f, f+4, f+8);
+    }
+}
+
+#ifdef TRICUBIC_KERNEL_X86
+/**
+ * @brief contractBatchAVX2
+ *
+ * For every k, the four rows a[16k+4j .. 16k+4j+3] are combined with y[j]
+ * in a 4-wide double register; the result is combined with z[k] and,
+ * at the end, with x.
+ */
+__attribute__((target("avx2,fma")))
+static void contractBatchAVX2(const gridreal* const* coeffs, const double* factors, double* results, unsigned int n) {
+    for (unsigned int c = 0; c < n; c++){
+        const gridreal* a = coeffs[c];
+        const double* f = factors + 12*c;
+        __m256d acc = _mm256_setzero_pd();
+        for (unsigned int k = 0; k < 4; k++){
+            __m256d rk = _mm256_mul_pd(_mm256_cvtps_pd(_mm_loadu_ps(a + 16*k)), _mm256_set1_pd(f[4]));
+            rk = _mm256_fmadd_pd(_mm256_cvtps_pd(_mm_loadu_ps(a + 16*k + 4)), _mm256_set1_pd(f[5]), rk);
+            rk = _mm256_fmadd_pd(_mm256_cvtps_pd(_mm_loadu_ps(a + 16*k + 8)), _mm256_set1_pd(f[6]), rk);
+            rk = _mm256_fmadd_pd(_mm256_cvtps_pd(_mm_loadu_ps(a + 16*k + 12)), _mm256_set1_pd(f[7]), rk);
+            acc = _mm256_fmadd_pd(rk, _mm256_set1_pd(f[8+k]), acc);
+        }
+        acc = _mm256_mul_pd(acc, _mm256_loadu_pd(f));
+        __m128d s = _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+        results[c] = _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+    }
+}
+
+/**
+ * @brief contractBatchAVX512
+ *
+ * Same as contractBatchAVX2, but two rows (j, j+1) are processed
+ * in every 8-wide double register.
+ */
+__attribute__((target("avx512f")))
+static void contractBatchAVX512(const gridreal* const* coeffs, const double* factors, double* results, unsigned int n) {
+    for (unsigned int c = 0; c < n; c++){
+        const gridreal* a = coeffs[c];
+        const double* f = factors + 12*c;
+        __m512d y01 = _mm512_insertf64x4(_mm512_castpd256_pd512(_mm256_set1_pd(f[4])), _mm256_set1_pd(f[5]), 1);
+        __m512d y23 = _mm512_insertf64x4(_mm512_castpd256_pd512(_mm256_set1_pd(f[6])), _mm256_set1_pd(f[7]), 1);
+        __m512d acc = _mm512_setzero_pd();
+        for (unsigned int k = 0; k < 4; k++){
+            __m512d zk = _mm512_set1_pd(f[8+k]);
+            acc = _mm512_fmadd_pd(_mm512_cvtps_pd(_mm256_loadu_ps(a + 16*k)), _mm512_mul_pd(y01, zk), acc);
+            acc = _mm512_fmadd_pd(_mm512_cvtps_pd(_mm256_loadu_ps(a + 16*k + 8)), _mm512_mul_pd(y23, zk), acc);
+        }
+        __m256d r = _mm256_add_pd(_mm512_castpd512_pd256(acc), _mm512_extractf64x4_pd(acc, 1));
+        r = _mm256_mul_pd(r, _mm256_loadu_pd(f));
+        __m128d s = _mm_add_pd(_mm256_castpd256_pd128(r), _mm256_extractf128_pd(r, 1));
+        results[c] = _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+    }
+}
+
+/**
+ * @brief contractBatchAVX2Float
+ *
+ * Single precision version of contractBatchAVX2: the 16 coefficients of every k
+ * are in two 8-wide float registers (rows j, j+1), combined with y[j] and z[k].
+ */
+__attribute__((target("avx2,fma")))
+static void contractBatchAVX2Float(const gridreal* const* coeffs, const double* factors, double* results, unsigned int n) {
+    for (unsigned int c = 0; c < n; c++){
+        const gridreal* a = coeffs[c];
+        const double* f = factors + 12*c;
+        __m256 y01 = _mm256_setr_ps(f[4], f[4], f[4], f[4], f[5], f[5], f[5], f[5]);
+        __m256 y23 = _mm256_setr_ps(f[6], f[6], f[6], f[6], f[7], f[7], f[7], f[7]);
+        __m256 acc = _mm256_setzero_ps();
+        for (unsigned int k = 0; k < 4; k++){
+            __m256 rk = _mm256_mul_ps(_mm256_loadu_ps(a + 16*k), y01);
+            rk = _mm256_fmadd_ps(_mm256_loadu_ps(a + 16*k + 8), y23, rk);
+            acc = _mm256_fmadd_ps(rk, _mm256_set1_ps((float)f[8+k]), acc);
+        }
+        __m128 r = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+        r = _mm_mul_ps(r, _mm_setr_ps(f[0], f[1], f[2], f[3]));
+        r = _mm_add_ps(r, _mm_movehl_ps(r, r));
+        results[c] = _mm_cvtss_f32(_mm_add_ss(r, _mm_shuffle_ps(r, r, 1)));
+    }
+}
+
+/**
+ * @brief contractBatchAVX512Float
+ *
+ * Single precision version of contractBatchAVX512: all the 16 coefficients
+ * of every k are in a single 16-wide float register.
+ */
+__attribute__((target("avx512f")))
+static void contractBatchAVX512Float(const gridreal* const* coeffs, const double* factors, double* results, unsigned int n) {
+    for (unsigned int c = 0; c < n; c++){
+        const gridreal* a = coeffs[c];
+        const double* f = factors + 12*c;
+        __m512 y = _mm512_setr_ps(f[4], f[4], f[4], f[4], f[5], f[5], f[5], f[5], f[6], f[6], f[6], f[6], f[7], f[7], f[7], f[7]);
+        __m512 acc = _mm512_setzero_ps();
+        for (unsigned int k = 0; k < 4; k++)
+            acc = _mm512_fmadd_ps(_mm512_loadu_ps(a + 16*k), _mm512_mul_ps(y, _mm512_set1_ps((float)f[8+k])), acc);
+        __m256 r8 = _mm256_add_ps(_mm512_castps512_ps256(acc), _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(acc), 1)));
+        __m128 r = _mm_add_ps(_mm256_castps256_ps128(r8), _mm256_extractf128_ps(r8, 1));
+        r = _mm_mul_ps(r, _mm_setr_ps(f[0], f[1], f[2], f[3]));
+        r = _mm_add_ps(r, _mm_movehl_ps(r, r));
+        results[c] = _mm_cvtss_f32(_mm_add_ss(r, _mm_shuffle_ps(r, r, 1)));
+    }
+}
+#endif
+
+struct Dispatch {
+    ContractBatchFunction contractBatch;
+    ContractBatchFunction contractBatchFloat;
+    const char* name;
+};
+
+static Dispatch selectDispatch() {
+    #ifdef TRICUBIC_KERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return {contractBatchAVX512, contractBatchAVX512Float, "avx512"};
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return {contractBatchAVX2, contractBatchAVX2Float, "avx2"};
+    #endif
+    return {contractBatchScalar, contractBatchScalarFloat, "scalar"};
+}
+
+static const Dispatch& dispatch() {
+    static const Dispatch d = selectDispatch();
+    return d;
+}
+
+/**
+ * @brief contractBatch
+ *
+ * Evaluates n contractions: the i-th contraction uses the coefficients coeffs[i]
+ * and the factors factors[12i .. 12i+11] (x, y and z).
+ * Every contraction is computed in Scalar and stored in double.
+ */
+template <>
+void contractBatch<double>(const gridreal* const* coeffs, const double* factors, double* results, unsigned int n) {
+    dispatch().contractBatch(coeffs, factors, results, n);
+}
+
+template <>
+void contractBatch<float>(const gridreal* const* coeffs, const double* factors, double* results, unsigned int n) {
+    dispatch().contractBatchFloat(coeffs, factors, results, n);
+}
+
+void contractBatch(const gridreal* const* coeffs, const double* factors, double* results, unsigned int n, Precision precision) {
+    if (precision == SINGLE_PRECISION)
+        contractBatch<float>(coeffs, factors, results, n);
+    else
+        contractBatch<double>(coeffs, factors, results, n);
+}
+
+const char* instructionSet() {
+    return dispatch().name;
+}
+
+Batch::Batch() {
+}
+
+void Batch::clear() {
+    coeffs.clear();
+    factors.clear();
+    slots.clear();
+}
+
+void Batch::add(const gridreal* a, const double x[4], const double y[4], const double z[4], unsigned int slot, double sign) {
+    coeffs.push_back(a);
+    for (unsigned int i = 0; i < 4; i++)
+        factors.push_back(sign*x[i]);
+    factors.insert(factors.end(), y, y+4);
+    factors.insert(factors.end(), z, z+4);
+    slots.push_back(slot);
+}
+
+void Batch::evaluate(double* sums, Precision precision) {
+    results.resize(slots.size());
+    contractBatch(coeffs.data(), factors.data(), results.data(), size(), precision);
+    for (unsigned int i = 0; i < slots.size(); i++)
+        sums[slots[i]] += results[i];
+}
+
+}
@@ -0,0 +1,117 @@
+#ifndef TRICUBICKERNEL_H
+#define TRICUBICKERNEL_H
+
+#include <vector>
+#include "engine/tricubic.h"
+
+/**
+ * Integrals and face integrals of the tricubic interpolant on a cell,
+ * written as separable tensor contractions:
+ *
+ *     sum_ijk a[i + 4j + 16k] * x[i] * y[j] * z[k]
+ *
+ * where x, y, z are per-axis factor vectors: monomial moments on [t1, t2]
+ * for the integrated axes, monomial powers of t for the axis of a face.
+ * The batched contraction is dispatched at runtime on AVX-512, AVX2+FMA or
+ * a scalar fallback.
+ * Contractions are templated on the compute scalar: with float, every cell
+ * is evaluated in single precision (twice the SIMD width) while the sums
+ * over the cells are always accumulated in double.
+ */
+namespace TricubicKernel {
+
+    enum Precision {DOUBLE_PRECISION, SINGLE_PRECISION};
+
+    void moments(double m[4], double t1, double t2);
+    void powers(double p[4], double t);
+
+    template <typename Scalar>
+    Scalar contract(const gridreal* a, const Scalar x[4], const Scalar y[4], const Scalar z[4]);
+    double contract(const gridreal* a, const double x[4], const double y[4], const double z[4], Precision precision);
+
+    template <typename Scalar>
+    void contractBatch(const gridreal* const* coeffs, const double* factors, double* results, unsigned int n);
+    template <>
+    void contractBatch<double>(const gridreal* const* coeffs, const double* factors, double* results, unsigned int n);
+    template <>
+    void contractBatch<float>(const gridreal* const* coeffs, const double* factors, double* results, unsigned int n);
+    void contractBatch(const gridreal* const* coeffs, const double* factors, double* results, unsigned int n, Precision precision);
+
+    double integral(const gridreal* a, double u1, double v1, double w1, double u2, double v2, double w2);
+
+    const char* instructionSet();
+
+    /**
+     * @brief The Batch class
+     *
+     * Collects contractions over many cells and evaluates them with a single
+     * call to contractBatch. Every contraction is accumulated on a slot of
+     * the output array passed to evaluate().
+     */
+    class Batch {
+        public:
+            Batch();
+            void clear();
+            unsigned int size() const;
+            void add(const gridreal* a, const double x[4], const double y[4], const double z[4], unsigned int slot, double sign = 1);
+            void evaluate(double* sums, Precision precision = DOUBLE_PRECISION);
+
+        private:
+            std::vector<const gridreal*> coeffs;
+            std::vector<double> factors; //x, y, z: 12 values for every contraction
+            std::vector<unsigned int> slots;
+            std::vector<double> results;
+    };
+}
+
+inline void TricubicKernel::moments(double m[4], double t1, double t2) {
+    double t12 = t1*t1, t22 = t2*t2;
+    m[0] = t2 - t1;
+    m[1] = (t22 - t12) / 2;
+    m[2] = (t22*t2 - t12*t1) / 3;
+    m[3] = (t22*t22 - t12*t12) / 4;
+}
+
+inline void TricubicKernel::powers(double p[4], double t) {
+    p[0] = 1;
+    p[1] = t;
+    p[2] = t*t;
+    p[3] = p[2]*t;
+}
+
+template <typename Scalar>
+inline Scalar TricubicKernel::contract(const gridreal* a, const Scalar x[4], const Scalar y[4], const Scalar z[4]) {
+    Scalar result = 0;
+    for (unsigned int k = 0; k < 4; k++){
+        Scalar rk = 0;
+        for (unsigned int j = 0; j < 4; j++){
+            const gridreal* row = a + 16*k + 4*j;
+            rk += (row[0]*x[0] + row[1]*x[1] + row[2]*x[2] + row[3]*x[3]) * y[j];
+        }
+        result += rk * z[k];
+    }
+    return result;
+}
+
+inline double TricubicKernel::contract(const gridreal* a, const double x[4], const double y[4], const double z[4], Precision precision) {
+    if (precision == DOUBLE_PRECISION)
+        return contract<double>(a, x, y, z);
+    float xf[4] = {(float)x[0], (float)x[1], (float)x[2], (float)x[3]};
+    float yf[4] = {(float)y[0], (float)y[1], (float)y[2], (float)y[3]};
+    float zf[4] = {(float)z[0], (float)z[1], (float)z[2], (float)z[3]};
+    return contract<float>(a, xf, yf, zf);
+}
+
+inline double TricubicKernel::integral(const gridreal* a, double u1, double v1, double w1, double u2, double v2, double w2) {
+    double x[4], y[4], z[4];
+    moments(x, u1, u2);
+    moments(y, v1, v2);
+    moments(z, w1, w2);
+    return contract<double>(a, x, y, z);
+}
+
+inline unsigned int TricubicKernel::Batch::size() const {
+    return (unsigned int)slots.size();
+}
+
+#endif // TRICUBICKERNEL_H
@@ -0,0 +1,125 @@
+#include "voxelization.h"
+
+#include <algorithm>
+#include <cmath>
+#include <omp.h>
+
+/**
+ * @brief edgeSign
+ *
+ * Sign of the edge function of (a, b) on (x, y) + (eps, eps^2) (simulation of
+ * simplicity: a ray never passes exactly on an edge or a vertex).
+ * The function is always computed with the endpoints in lexicographic order,
+ * so the two triangles sharing an edge get exactly opposite signs.
+ * @return 0 only if the edge is degenerate in the xy plane
+ */
+static int edgeSign(double ax, double ay, double bx, double by, double x, double y) {
+    bool swapped = bx < ax || (bx == ax && by < ay);
+    if (swapped){
+        std::swap(ax, bx);
+        std::swap(ay, by);
+    }
+    double e = (bx-ax)*(y-ay) - (by-ay)*(x-ax);
+    int s;
+    if (e != 0)
+        s = e > 0 ? 1 : -1;
+    else if (by != ay)
+        s = by > ay ? -1 : 1;
+    else if (bx != ax)
+        s = bx > ax ? 1 : -1;
+    else
+        s = 0;
+    return swapped ? -s : s;
+}
+
+/**
+ * @brief getInsideGridPoints
+ *
+ * Classifies all the points of a regular grid as inside or outside the mesh in
+ * one sweep: every triangle is rasterized on the z-columns of the grid whose
+ * (perturbed) ray crosses it, then every column is sorted and a point is inside
+ * if the number of crossings below it is odd.
+ * Columns with an odd number of crossings are marked as VOXEL_UNKNOWN, and must
+ * be classified by the caller with another method.
+ * @param isInside: must be already sized as the grid
+ * @param origin: position of the point (0,0,0) of the grid
+ * @param unit: distance between two adjacent points of the grid
+ */
+void getInsideGridPoints(
+        cg3::Array3D<unsigned char>& isInside,
+        const cg3::SimpleEigenMesh& m,
+        const cg3::Point3d& origin,
+        double unit)
+{
+    const int sizeX = isInside.sizeX(), sizeY = isInside.sizeY(), sizeZ = isInside.sizeZ();
+    const int nFaces = m.numberFaces();
+    std::vector<std::vector<std::pair<int, double> > > threadCrossings(1);
+
+    #pragma omp parallel
+    {
+        #pragma omp single
+        threadCrossings.resize(omp_get_num_threads());
+        std::vector<std::pair<int, double> >& crossings = threadCrossings[omp_get_thread_num()];
+
+        #pragma omp for schedule(dynamic, 256)
+        for (int f = 0; f < nFaces; f++){
+            cg3::Point3i face = m.face(f);
+            cg3::Point3d v0 = m.vertex(face.x()), v1 = m.vertex(face.y()), v2 = m.vertex(face.z());
+            double nz = (v1.x()-v0.x())*(v2.y()-v0.y()) - (v1.y()-v0.y())*(v2.x()-v0.x());
+            if (nz == 0)
+                continue;
+            double nx = (v1.y()-v0.y())*(v2.z()-v0.z()) - (v1.z()-v0.z())*(v2.y()-v0.y());
+            double ny = (v1.z()-v0.z())*(v2.x()-v0.x()) - (v1.x()-v0.x())*(v2.z()-v0.z());
+            int iMin = std::max(0, (int)std::floor((std::min(std::min(v0.x(), v1.x()), v2.x()) - origin.x()) / unit));
+            int iMax = std::min(sizeX-1, (int)std::ceil((std::max(std::max(v0.x(), v1.x()), v2.x()) - origin.x()) / unit));
+            int jMin = std::max(0, (int)std::floor((std::min(std::min(v0.y(), v1.y()), v2.y()) - origin.y()) / unit));
+            int jMax = std::min(sizeY-1, (int)std::ceil((std::max(std::max(v0.y(), v1.y()), v2.y()) - origin.y()) / unit));
+            for (int i = iMin; i <= iMax; i++){
+                double x = origin.x() + i*unit;
+                for (int j = jMin; j <= jMax; j++){
+                    double y = origin.y() + j*unit;
+                    int s0 = edgeSign(v1.x(), v1.y(), v2.x(), v2.y(), x, y);
+                    int s1 = edgeSign(v2.x(), v2.y(), v0.x(), v0.y(), x, y);
+                    int s2 = edgeSign(v0.x(), v0.y(), v1.x(), v1.y(), x, y);
+                    if (s0 != 0 && s0 == s1 && s1 == s2){
+                        double z = v0.z() - (nx*(x-v0.x()) + ny*(y-v0.y())) / nz;
+                        crossings.push_back(std::pair<int, double>(i*sizeY+j, z));
+                    }
+                }
+            }
+        }
+    }
+
+    // crossings grouped by column
+    std::vector<int> offsets(sizeX*sizeY+1, 0);
+    for (const std::vector<std::pair<int, double> >& crossings : threadCrossings)
+        for (const std::pair<int, double>& c : crossings)
+            offsets[c.first+1]++;
+    for (int c = 0; c < sizeX*sizeY; c++)
+        offsets[c+1] += offsets[c];
+    std::vector<double> zs(offsets.back());
+    std::vector<int> next(offsets.begin(), offsets.end()-1);
+    for (const std::vector<std::pair<int, double> >& crossings : threadCrossings)
+        for (const std::pair<int, double>& c : crossings)
+            zs[next[c.first]++] = c.second;
+
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int c = 0; c < sizeX*sizeY; c++){
+        int i = c / sizeY, j = c % sizeY;
+        double* first = zs.data() + offsets[c];
+        double* last = zs.data() + offsets[c+1];
+        if ((last - first) % 2 == 1){
+            for (int k = 0; k < sizeZ; k++)
+                isInside(i,j,k) = VOXEL_UNKNOWN;
+            continue;
+        }
+        std::sort(first, last);
+        double* crossing = first;
+        for (int k = 0; k < sizeZ; k++){
+            double z = origin.z() + k*unit;
+            while (crossing != last && *crossing <= z)
+                crossing++;
+            isInside(i,j,k) = (crossing - first) % 2 == 1 ? VOXEL_INSIDE : VOXEL_OUTSIDE;
+        }
+    }
+}
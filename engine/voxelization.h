@@ -0,0 +1,17 @@
+#ifndef VOXELIZATION_H
+#define VOXELIZATION_H
+
+#include <cg3/meshes/eigenmesh/eigenmesh.h>
+#include <cg3/data_structures/arrays/arrays.h>
+
+#define VOXEL_OUTSIDE 0
+#define VOXEL_INSIDE 1
+#define VOXEL_UNKNOWN 2 //column crossed an odd number of times (mesh not watertight)
+
+void getInsideGridPoints(
+        cg3::Array3D<unsigned char>& isInside,
+        const cg3::SimpleEigenMesh& m,
+        const cg3::Point3d& origin,
+        double unit);
+
+#endif // VOXELIZATION_H
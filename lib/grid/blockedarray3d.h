@@ -0,0 +1,380 @@
+#ifndef BLOCKEDARRAY3D_H
+#define BLOCKEDARRAY3D_H
+
+#include <vector>
+#include <algorithm>
+#include <assert.h>
+#include "cg3/data_structures/arrays/arrays.h"
+
+#define BLOCKED_ARRAY_TILE_BITS 3 //tiles of 8x8x8 elements
+#define BLOCKED_ARRAY_TILE_SIZE (1 << BLOCKED_ARRAY_TILE_BITS)
+#define BLOCKED_ARRAY_TILE_MASK (BLOCKED_ARRAY_TILE_SIZE - 1)
+#define BLOCKED_ARRAY_TILE_VOLUME (BLOCKED_ARRAY_TILE_SIZE * BLOCKED_ARRAY_TILE_SIZE * BLOCKED_ARRAY_TILE_SIZE)
+
+/**
+ * @brief The BlockedArray3D class
+ *
+ * Three dimensional array stored in tiles of 8x8x8 elements. A constant tile
+ * stores only its value, the other ones (dense) store all their elements.
+ * Writing a value different from the value of a constant tile makes the tile dense;
+ * compact() (or compactTile()) makes constant again the dense tiles with all
+ * the elements equal.
+ * Writes on different tiles can be done concurrently.
+ * A read-only view can be built on tiles stored in external memory (e.g. a mapped file):
+ * the memory must outlive the view and its copies.
+ */
+template <class T>
+class BlockedArray3D {
+    public:
+        BlockedArray3D();
+        BlockedArray3D(unsigned int sizeX, unsigned int sizeY, unsigned int sizeZ, const T& value = T());
+        explicit BlockedArray3D(const cg3::Array3D<T>& a);
+        BlockedArray3D(unsigned int sizeX, unsigned int sizeY, unsigned int sizeZ, const T* values, const int* tileIndices, const T* tiles);
+
+        unsigned int sizeX() const;
+        unsigned int sizeY() const;
+        unsigned int sizeZ() const;
+
+        const T& operator()(unsigned int i, unsigned int j, unsigned int k) const;
+        void set(unsigned int i, unsigned int j, unsigned int k, const T& value);
+        void fill(const T& value);
+        void fill(unsigned int i1, unsigned int j1, unsigned int k1, unsigned int i2, unsigned int j2, unsigned int k2, const T& value);
+        void compact();
+        void clear();
+        T min() const;
+        bool isConstant(unsigned int i1, unsigned int j1, unsigned int k1, unsigned int i2, unsigned int j2, unsigned int k2, T& value) const;
+        cg3::Array3D<T> toArray3D() const;
+
+        // Tiles
+        unsigned int getNumberTiles() const;
+        unsigned int getNumberDenseTiles() const;
+        unsigned int getTileIndex(unsigned int i, unsigned int j, unsigned int k) const;
+        void getTileFirst(unsigned int t, unsigned int& i, unsigned int& j, unsigned int& k) const;
+        bool isConstantTile(unsigned int t) const;
+        const T& getTileValue(unsigned int t) const;
+        const T* getTileData(unsigned int t) const;
+        void setTile(unsigned int t, const T& value);
+        void compactTile(unsigned int t);
+        bool isView() const;
+
+    private:
+        unsigned int getTileOffset(unsigned int i, unsigned int j, unsigned int k) const;
+
+        unsigned int nx, ny, nz;
+        unsigned int ntx, nty, ntz;
+        std::vector<T> values; //value of every tile, if constant
+        std::vector< std::vector<T> > tiles; //elements of every tile, empty if constant
+        //read-only view: value of every tile, index of every dense tile in viewTiles (-1 if constant)
+        const T* viewValues;
+        const int* viewTileIndices;
+        const T* viewTiles;
+};
+
+template <class T>
+inline BlockedArray3D<T>::BlockedArray3D() : nx(0), ny(0), nz(0), ntx(0), nty(0), ntz(0), viewValues(nullptr), viewTileIndices(nullptr), viewTiles(nullptr) {
+}
+
+template <class T>
+inline BlockedArray3D<T>::BlockedArray3D(unsigned int sizeX, unsigned int sizeY, unsigned int sizeZ, const T& value) :
+    nx(sizeX), ny(sizeY), nz(sizeZ),
+    ntx((sizeX + BLOCKED_ARRAY_TILE_MASK) >> BLOCKED_ARRAY_TILE_BITS),
+    nty((sizeY + BLOCKED_ARRAY_TILE_MASK) >> BLOCKED_ARRAY_TILE_BITS),
+    ntz((sizeZ + BLOCKED_ARRAY_TILE_MASK) >> BLOCKED_ARRAY_TILE_BITS),
+    values(ntx*nty*ntz, value), tiles(ntx*nty*ntz), viewValues(nullptr), viewTileIndices(nullptr), viewTiles(nullptr) {
+}
+
+/**
+ * @brief BlockedArray3D::BlockedArray3D
+ *
+ * Copies a dense array, keeping constant the uniform tiles.
+ */
+template <class T>
+inline BlockedArray3D<T>::BlockedArray3D(const cg3::Array3D<T>& a) :
+    BlockedArray3D(a.sizeX(), a.sizeY(), a.sizeZ()) {
+    #pragma omp parallel for
+    for (unsigned int t = 0; t < values.size(); t++){
+        unsigned int i1, j1, k1;
+        getTileFirst(t, i1, j1, k1);
+        unsigned int i2 = std::min(i1 + BLOCKED_ARRAY_TILE_SIZE, nx), j2 = std::min(j1 + BLOCKED_ARRAY_TILE_SIZE, ny), k2 = std::min(k1 + BLOCKED_ARRAY_TILE_SIZE, nz);
+        values[t] = a(i1, j1, k1);
+        for (unsigned int i = i1; i < i2; i++)
+            for (unsigned int j = j1; j < j2; j++)
+                for (unsigned int k = k1; k < k2; k++)
+                    set(i, j, k, a(i,j,k));
+    }
+}
+
+/**
+ * @brief BlockedArray3D::BlockedArray3D
+ *
+ * Read-only view on external memory, without copies.
+ * @param values: value of every tile (used for the constant tiles)
+ * @param tileIndices: for every tile, -1 if it is constant, otherwise the index of its elements in tiles
+ * @param tiles: elements of the dense tiles, BLOCKED_ARRAY_TILE_VOLUME for every tile
+ */
+template <class T>
+inline BlockedArray3D<T>::BlockedArray3D(unsigned int sizeX, unsigned int sizeY, unsigned int sizeZ, const T* values, const int* tileIndices, const T* tiles) :
+    nx(sizeX), ny(sizeY), nz(sizeZ),
+    ntx((sizeX + BLOCKED_ARRAY_TILE_MASK) >> BLOCKED_ARRAY_TILE_BITS),
+    nty((sizeY + BLOCKED_ARRAY_TILE_MASK) >> BLOCKED_ARRAY_TILE_BITS),
+    ntz((sizeZ + BLOCKED_ARRAY_TILE_MASK) >> BLOCKED_ARRAY_TILE_BITS),
+    viewValues(values), viewTileIndices(tileIndices), viewTiles(tiles) {
+}
+
+template <class T>
+inline unsigned int BlockedArray3D<T>::sizeX() const {
+    return nx;
+}
+
+template <class T>
+inline unsigned int BlockedArray3D<T>::sizeY() const {
+    return ny;
+}
+
+template <class T>
+inline unsigned int BlockedArray3D<T>::sizeZ() const {
+    return nz;
+}
+
+template <class T>
+inline const T& BlockedArray3D<T>::operator()(unsigned int i, unsigned int j, unsigned int k) const {
+    assert(i < nx && j < ny && k < nz);
+    unsigned int t = getTileIndex(i, j, k);
+    if (viewValues != nullptr){
+        int index = viewTileIndices[t];
+        return index < 0 ? viewValues[t] : viewTiles[(size_t)index * BLOCKED_ARRAY_TILE_VOLUME + getTileOffset(i, j, k)];
+    }
+    const std::vector<T>& tile = tiles[t];
+    return tile.empty() ? values[t] : tile[getTileOffset(i, j, k)];
+}
+
+template <class T>
+inline void BlockedArray3D<T>::set(unsigned int i, unsigned int j, unsigned int k, const T& value) {
+    assert(i < nx && j < ny && k < nz);
+    assert(!isView());
+    unsigned int t = getTileIndex(i, j, k);
+    std::vector<T>& tile = tiles[t];
+    if (tile.empty()){
+        if (values[t] == value)
+            return;
+        tile.assign(BLOCKED_ARRAY_TILE_VOLUME, values[t]);
+    }
+    tile[getTileOffset(i, j, k)] = value;
+}
+
+template <class T>
+inline void BlockedArray3D<T>::fill(const T& value) {
+    assert(!isView());
+    std::fill(values.begin(), values.end(), value);
+    for (std::vector<T>& tile : tiles)
+        std::vector<T>().swap(tile);
+}
+
+/**
+ * @brief BlockedArray3D::fill
+ *
+ * Sets value on the elements in [i1,i2) x [j1,j2) x [k1,k2): the tiles
+ * entirely contained in the box become constant.
+ */
+template <class T>
+inline void BlockedArray3D<T>::fill(unsigned int i1, unsigned int j1, unsigned int k1, unsigned int i2, unsigned int j2, unsigned int k2, const T& value) {
+    assert(!isView());
+    if (i1 >= i2 || j1 >= j2 || k1 >= k2)
+        return;
+    #pragma omp parallel for
+    for (unsigned int t = 0; t < values.size(); t++){
+        unsigned int ti, tj, tk;
+        getTileFirst(t, ti, tj, tk);
+        unsigned int fi1 = std::max(i1, ti), fj1 = std::max(j1, tj), fk1 = std::max(k1, tk);
+        unsigned int fi2 = std::min(i2, std::min(ti + BLOCKED_ARRAY_TILE_SIZE, nx));
+        unsigned int fj2 = std::min(j2, std::min(tj + BLOCKED_ARRAY_TILE_SIZE, ny));
+        unsigned int fk2 = std::min(k2, std::min(tk + BLOCKED_ARRAY_TILE_SIZE, nz));
+        if (fi1 >= fi2 || fj1 >= fj2 || fk1 >= fk2)
+            continue;
+        if (fi1 == ti && fj1 == tj && fk1 == tk &&
+                fi2 == std::min(ti + BLOCKED_ARRAY_TILE_SIZE, nx) &&
+                fj2 == std::min(tj + BLOCKED_ARRAY_TILE_SIZE, ny) &&
+                fk2 == std::min(tk + BLOCKED_ARRAY_TILE_SIZE, nz))
+            setTile(t, value);
+        else {
+            for (unsigned int i = fi1; i < fi2; i++)
+                for (unsigned int j = fj1; j < fj2; j++)
+                    for (unsigned int k = fk1; k < fk2; k++)
+                        set(i, j, k, value);
+        }
+    }
+}
+
+template <class T>
+inline void BlockedArray3D<T>::compact() {
+    assert(!isView());
+    #pragma omp parallel for
+    for (unsigned int t = 0; t < values.size(); t++)
+        compactTile(t);
+}
+
+template <class T>
+inline void BlockedArray3D<T>::clear() {
+    *this = BlockedArray3D<T>();
+}
+
+template <class T>
+inline T BlockedArray3D<T>::min() const {
+    assert(getNumberTiles() > 0);
+    T m = (*this)(0,0,0);
+    for (unsigned int t = 0; t < getNumberTiles(); t++){
+        const T* tile = getTileData(t);
+        if (tile == nullptr)
+            m = std::min(m, getTileValue(t));
+        else {
+            unsigned int i1, j1, k1;
+            getTileFirst(t, i1, j1, k1);
+            unsigned int i2 = std::min(i1 + BLOCKED_ARRAY_TILE_SIZE, nx), j2 = std::min(j1 + BLOCKED_ARRAY_TILE_SIZE, ny), k2 = std::min(k1 + BLOCKED_ARRAY_TILE_SIZE, nz);
+            for (unsigned int i = i1; i < i2; i++)
+                for (unsigned int j = j1; j < j2; j++)
+                    for (unsigned int k = k1; k < k2; k++)
+                        m = std::min(m, tile[getTileOffset(i, j, k)]);
+        }
+    }
+    return m;
+}
+
+/**
+ * @brief BlockedArray3D::isConstant
+ *
+ * Checks if all the elements in [i1,i2) x [j1,j2) x [k1,k2) are equal (the box
+ * must be not empty). A constant tile is checked with a single comparison.
+ * @param value: the value of the elements, if they are all equal
+ */
+template <class T>
+inline bool BlockedArray3D<T>::isConstant(unsigned int i1, unsigned int j1, unsigned int k1, unsigned int i2, unsigned int j2, unsigned int k2, T& value) const {
+    assert(i1 < i2 && j1 < j2 && k1 < k2 && i2 <= nx && j2 <= ny && k2 <= nz);
+    value = (*this)(i1, j1, k1);
+    for (unsigned int ti = i1 >> BLOCKED_ARRAY_TILE_BITS; ti <= (i2-1) >> BLOCKED_ARRAY_TILE_BITS; ti++){
+        for (unsigned int tj = j1 >> BLOCKED_ARRAY_TILE_BITS; tj <= (j2-1) >> BLOCKED_ARRAY_TILE_BITS; tj++){
+            for (unsigned int tk = k1 >> BLOCKED_ARRAY_TILE_BITS; tk <= (k2-1) >> BLOCKED_ARRAY_TILE_BITS; tk++){
+                unsigned int t = (ti*nty + tj)*ntz + tk;
+                const T* tile = getTileData(t);
+                if (tile != nullptr){
+                    unsigned int fi1 = std::max(i1, ti << BLOCKED_ARRAY_TILE_BITS), fi2 = std::min(i2, (ti+1) << BLOCKED_ARRAY_TILE_BITS);
+                    unsigned int fj1 = std::max(j1, tj << BLOCKED_ARRAY_TILE_BITS), fj2 = std::min(j2, (tj+1) << BLOCKED_ARRAY_TILE_BITS);
+                    unsigned int fk1 = std::max(k1, tk << BLOCKED_ARRAY_TILE_BITS), fk2 = std::min(k2, (tk+1) << BLOCKED_ARRAY_TILE_BITS);
+                    for (unsigned int i = fi1; i < fi2; i++)
+                        for (unsigned int j = fj1; j < fj2; j++)
+                            for (unsigned int k = fk1; k < fk2; k++)
+                                if (!(tile[getTileOffset(i, j, k)] == value))
+                                    return false;
+                }
+                else if (!(getTileValue(t) == value))
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+template <class T>
+inline cg3::Array3D<T> BlockedArray3D<T>::toArray3D() const {
+    cg3::Array3D<T> a(nx, ny, nz);
+    #pragma omp parallel for
+    for (unsigned int i = 0; i < nx; i++)
+        for (unsigned int j = 0; j < ny; j++)
+            for (unsigned int k = 0; k < nz; k++)
+                a(i,j,k) = (*this)(i,j,k);
+    return a;
+}
+
+template <class T>
+inline unsigned int BlockedArray3D<T>::getNumberTiles() const {
+    return ntx*nty*ntz;
+}
+
+template <class T>
+inline unsigned int BlockedArray3D<T>::getNumberDenseTiles() const {
+    unsigned int n = 0;
+    for (unsigned int t = 0; t < getNumberTiles(); t++)
+        if (getTileData(t) != nullptr)
+            n++;
+    return n;
+}
+
+template <class T>
+inline unsigned int BlockedArray3D<T>::getTileIndex(unsigned int i, unsigned int j, unsigned int k) const {
+    return ((i >> BLOCKED_ARRAY_TILE_BITS)*nty + (j >> BLOCKED_ARRAY_TILE_BITS))*ntz + (k >> BLOCKED_ARRAY_TILE_BITS);
+}
+
+/**
+ * @brief BlockedArray3D::getTileFirst
+ *
+ * Returns the indices of the first element of the tile t.
+ */
+template <class T>
+inline void BlockedArray3D<T>::getTileFirst(unsigned int t, unsigned int& i, unsigned int& j, unsigned int& k) const {
+    k = (t % ntz) << BLOCKED_ARRAY_TILE_BITS;
+    j = ((t / ntz) % nty) << BLOCKED_ARRAY_TILE_BITS;
+    i = (t / (ntz*nty)) << BLOCKED_ARRAY_TILE_BITS;
+}
+
+template <class T>
+inline bool BlockedArray3D<T>::isConstantTile(unsigned int t) const {
+    return getTileData(t) == nullptr;
+}
+
+template <class T>
+inline const T& BlockedArray3D<T>::getTileValue(unsigned int t) const {
+    assert(isConstantTile(t));
+    return viewValues != nullptr ? viewValues[t] : values[t];
+}
+
+/**
+ * @brief BlockedArray3D::getTileData
+ * @return the elements of the tile t (the element (i,j,k) is in position
+ * ((i%8)*8 + j%8)*8 + k%8), nullptr if the tile is constant
+ */
+template <class T>
+inline const T* BlockedArray3D<T>::getTileData(unsigned int t) const {
+    if (viewValues != nullptr)
+        return viewTileIndices[t] < 0 ? nullptr : viewTiles + (size_t)viewTileIndices[t] * BLOCKED_ARRAY_TILE_VOLUME;
+    return tiles[t].empty() ? nullptr : tiles[t].data();
+}
+
+template <class T>
+inline void BlockedArray3D<T>::setTile(unsigned int t, const T& value) {
+    assert(!isView());
+    values[t] = value;
+    std::vector<T>().swap(tiles[t]);
+}
+
+/**
+ * @brief BlockedArray3D::compactTile
+ *
+ * Makes the tile t constant if all its elements are equal.
+ */
+template <class T>
+inline void BlockedArray3D<T>::compactTile(unsigned int t) {
+    assert(!isView());
+    if (tiles[t].empty())
+        return;
+    unsigned int i1, j1, k1;
+    getTileFirst(t, i1, j1, k1);
+    unsigned int i2 = std::min(i1 + BLOCKED_ARRAY_TILE_SIZE, nx), j2 = std::min(j1 + BLOCKED_ARRAY_TILE_SIZE, ny), k2 = std::min(k1 + BLOCKED_ARRAY_TILE_SIZE, nz);
+    T value = tiles[t][0];
+    for (unsigned int i = i1; i < i2; i++)
+        for (unsigned int j = j1; j < j2; j++)
+            for (unsigned int k = k1; k < k2; k++)
+                if (!(tiles[t][getTileOffset(i, j, k)] == value))
+                    return;
+    setTile(t, value);
+}
+
+template <class T>
+inline bool BlockedArray3D<T>::isView() const {
+    return viewValues != nullptr;
+}
+
+template <class T>
+inline unsigned int BlockedArray3D<T>::getTileOffset(unsigned int i, unsigned int j, unsigned int k) const {
+    return ((i & BLOCKED_ARRAY_TILE_MASK) << (2*BLOCKED_ARRAY_TILE_BITS)) | ((j & BLOCKED_ARRAY_TILE_MASK) << BLOCKED_ARRAY_TILE_BITS) | (k & BLOCKED_ARRAY_TILE_MASK);
+}
+
+#endif // BLOCKEDARRAY3D_H
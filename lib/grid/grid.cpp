@@ -1,49 +1,54 @@
 #include "grid.h"
 
+#include "engine/tricubickernel.h"
+
+#include <cstring>
+
 //#define CUBE_CENTROID 1
 
+#define MAPPED_GRID_MAGIC "HFDGRID3"
+#define MAPPED_GRID_ALIGNMENT 64 //of every section of a mapped grid file
+
 using namespace cg3;
 
-Grid::Grid() {
+Grid::Grid() : kernelDistance(0), coefficientsStatistics(), lazy(false), integralTricubicInterpolation(nullptr), mappedCoeffs(nullptr), nMappedCoeffs(0) {
 }
 
 Grid::Grid(const Point3i& resolution, const Array3D<Point3d>& gridCoordinates, const Array3D<gridreal>& signedDistances, const Point3d& gMin, const Point3d& gMax) :
-    signedDistances(signedDistances), target(0,0,0) {
+    signedDistances(signedDistances), target(0,0,0), kernelDistance(0), coefficientsStatistics(), lazy(false), integralTricubicInterpolation(nullptr), mappedCoeffs(nullptr), nMappedCoeffs(0) {
     unit = gridCoordinates(1,0,0).x() - gridCoordinates(0,0,0).x();
     bb.setMin(gMin);
     bb.setMax(gMax);
     resX = resolution.x();
     resY = resolution.y();
     resZ = resolution.z();
-    weights = Array3D<gridreal>(resX,resY,resZ, BORDER_PAY);
-    for (unsigned int i = 2; i < resX-2; i++){
-        for (unsigned int j = 2; j < resY-2; j++){
-            for (unsigned int k = 2; k < resZ-2; ++k){
-                weights(i,j,k) = STD_PAY;
-            }
-        }
-    }
+    weights = BlockedArray3D<gridreal>(resX,resY,resZ, BORDER_PAY);
+    weights.fill(2, 2, 2, resX-2, resY-2, resZ-2, STD_PAY);
     coeffs = std::vector<std::array<gridreal, 64> >(1);
-    mapCoeffs = Array3D<int>((resX-1),(resY-1),(resZ-1), 0);
+    mapCoeffs = BlockedArray3D<int>((resX-1),(resY-1),(resZ-1), 0);
     //coeffs = Array4D<gridreal>((resX-1),(resY-1),(resZ-1),64, 0);
 }
 
 /**
- * @brief Grid::calculateWeights
+ * @brief Grid::calculateCellFaces
  *
- * Calcola i pesi per gli heightfieltds rispetto alla normale target
- * @param d
+ * Computes the faces of d contained in every cell of the grid (see CellFaces).
+ * The slabs of cells with the same i are visited in parallel, and their faces
+ * are concatenated in order.
  */
-void Grid::calculateBorderWeights(const Dcel& d, bool tolerance, std::set<const Dcel::Face*>& savedFaces) {
-	cgal::AABBTree3 aabb(d);
+void Grid::calculateCellFaces(CellFaces& cellFaces, const Dcel& d) const {
+	cgal::AABBTree3 aabb = buildAABBTree(d);
     double unit = getUnit();
-	std::vector<Point3i> flipped;
-	std::vector<Point3i> notFlipped;
+    const unsigned int slabSize = (resY-1)*(resZ-1);
+    std::vector<std::vector<const Dcel::Face*> > slabFaces(resX-1);
+    cellFaces.offsets.assign((resX-1)*slabSize+1, 0);
+
+    #pragma omp parallel for schedule(dynamic)
     for (unsigned int i = 0; i < resX-1; i++){
+        unsigned int c = i*slabSize;
         for (unsigned int j = 0; j < resY-1; j++){
-            for (unsigned int k = 0; k < resZ-1; k++){
+            for (unsigned int k = 0; k < resZ-1; k++, c++){
                 #ifdef CUBE_CENTROID
-                CG3_SUPPRESS_WARNING(tolerance);
 				Point3d bbmin = getPoint(i,j,k) - (unit/2);
 				Point3d bbmax = getPoint(i,j,k) + (unit/2);
                 #else
@@ -53,10 +58,59 @@ void Grid::calculateBorderWeights(const Dcel& d, bool tolerance, std::set<const
 				BoundingBox3 bb(bbmin, bbmax);
                 std::list<const Dcel::Face*> l;
 				aabb.containedDcelFaces(l, bb);
-                if (l.size() != 0){
+                slabFaces[i].insert(slabFaces[i].end(), l.begin(), l.end());
+                cellFaces.offsets[c+1] = l.size();
+            }
+        }
+    }
+
+    for (unsigned int c = 0; c < (resX-1)*slabSize; c++)
+        cellFaces.offsets[c+1] += cellFaces.offsets[c];
+    cellFaces.faces.clear();
+    cellFaces.faces.reserve(cellFaces.offsets.back());
+    for (unsigned int i = 0; i < resX-1; i++)
+        cellFaces.faces.insert(cellFaces.faces.end(), slabFaces[i].begin(), slabFaces[i].end());
+}
+
+/**
+ * @brief Grid::calculateWeights
+ *
+ * Calcola i pesi per gli heightfieltds rispetto alla normale target
+ * @param d
+ */
+void Grid::calculateBorderWeights(const Dcel& d, bool tolerance, std::set<const Dcel::Face*>& savedFaces) {
+    CellFaces cellFaces;
+    calculateCellFaces(cellFaces, d);
+    calculateBorderWeights(cellFaces, tolerance, savedFaces);
+}
+
+/**
+ * @brief Grid::calculateBorderWeights
+ *
+ * Sets the weights of the cells containing the faces of the mesh, depending on
+ * the orientation of the faces with respect to the target.
+ * @param cellFaces: faces contained in every cell, computed by calculateCellFaces
+ * on a grid with the same geometry
+ */
+void Grid::calculateBorderWeights(const CellFaces& cellFaces, bool tolerance, std::set<const Dcel::Face*>& savedFaces) {
+    assert(cellFaces.offsets.size() == (resX-1)*(resY-1)*(resZ-1)+1);
+    //the slabs of cells with the same i are visited in parallel, every one with its own buffers;
+    //the buffers are merged in order, so flipped and notFlipped are the same of a serial visit
+    std::vector<std::vector<Point3i> > slabFlipped(resX-1), slabNotFlipped(resX-1);
+    #pragma omp parallel for schedule(dynamic)
+    for (unsigned int i = 0; i < resX-1; i++){
+        std::vector<Point3i>& flipped = slabFlipped[i];
+        std::vector<Point3i>& notFlipped = slabNotFlipped[i];
+        unsigned int c = i*(resY-1)*(resZ-1);
+        for (unsigned int j = 0; j < resY-1; j++){
+            for (unsigned int k = 0; k < resZ-1; k++, c++){
+                #ifdef CUBE_CENTROID
+                CG3_SUPPRESS_WARNING(tolerance);
+                #endif
+                if (cellFaces.offsets[c+1] != cellFaces.offsets[c]){
                     bool b = true;
-                    for (std::list<const Dcel::Face*>::iterator it = l.begin(); it != l.end(); ++it) {
-                        const Dcel::Face* f = *it;
+                    for (unsigned int it = cellFaces.offsets[c]; it < cellFaces.offsets[c+1]; ++it) {
+                        const Dcel::Face* f = cellFaces.faces[it];
 						Point3i p(i,j,k);
 						if (f->normal().dot(target) < FLIP_ANGLE && f->flag() != 1 && savedFaces.find(f) == savedFaces.end()){
                              flipped.push_back(p);
@@ -68,23 +122,25 @@ void Grid::calculateBorderWeights(const Dcel& d, bool tolerance, std::set<const
                         }
                         ///
                     }
-                    if (b){
-                        #ifdef CUBE_CENTROID
-                        weights(i,j,k) = MIN_PAY;
-                        #else
-                        setWeightOnCube(i,j,k, MIN_PAY);
-                        #endif
-                    }
-                    #ifdef CUBE_CENTROID
-                    else {
-                        weights(i,j,k) = MAX_PAY;
-                    }
-                    #endif
+                    //cubes with only not flipped faces are in notFlipped, their weights are set below
+                    CG3_SUPPRESS_WARNING(b);
                 }
             }
         }
     }
-    #ifndef CUBE_CENTROID
+	std::vector<Point3i> flipped;
+	std::vector<Point3i> notFlipped;
+    for (unsigned int i = 0; i < resX-1; i++){
+        flipped.insert(flipped.end(), slabFlipped[i].begin(), slabFlipped[i].end());
+        notFlipped.insert(notFlipped.end(), slabNotFlipped[i].begin(), slabNotFlipped[i].end());
+    }
+    #ifdef CUBE_CENTROID
+    //a point is MAX_PAY if its cube contains at least a flipped face
+    for (unsigned int i = 0; i < notFlipped.size(); ++i)
+        weights.set(notFlipped[i].x(), notFlipped[i].y(), notFlipped[i].z(), MIN_PAY);
+    for (unsigned int i = 0; i < flipped.size(); ++i)
+        weights.set(flipped[i].x(), flipped[i].y(), flipped[i].z(), MAX_PAY);
+    #else
     if (tolerance){
         for (unsigned int i = 0; i < flipped.size(); ++i){
             setWeightOnCube(flipped[i].x(),flipped[i].y(),flipped[i].z(), MAX_PAY);
@@ -115,50 +171,449 @@ void Grid::calculateBorderWeights(const Dcel& d, bool tolerance, std::set<const
  * @param value should be a number between 0 and 1
  */
 void Grid::calculateWeightsAndFreezeKernel(const Dcel& d, double value, bool tolerance, std::set<const Dcel::Face*>& savedFaces) {
+    CellFaces cellFaces;
+    calculateCellFaces(cellFaces, d);
+    calculateWeightsAndFreezeKernel(cellFaces, value, tolerance, savedFaces);
+}
+
+void Grid::calculateWeightsAndFreezeKernel(const CellFaces& cellFaces, double value, bool tolerance, std::set<const Dcel::Face*>& savedFaces) {
     assert(value >= 0 && value <= 1);
+    kernelDistance = value;
     // grid border and rest
     weights.fill(BORDER_PAY);
-    for (unsigned int i = 2; i < resX-2; i++){
-        for (unsigned int j = 2; j < resY-2; j++){
-            for (unsigned int k = 2; k < resZ-2; ++k){
-                weights(i,j,k) = STD_PAY;
-            }
-        }
-    }
+    weights.fill(2, 2, 2, resX-2, resY-2, resZ-2, STD_PAY);
 
     //mesh border
-    calculateBorderWeights(d, tolerance, savedFaces);
+    calculateBorderWeights(cellFaces, tolerance, savedFaces);
 
     double minValue = signedDistances.min();
     value = 1 - value;
     value *= minValue;
     value = std::abs(value);
 
-    //kernel
-    for (unsigned int i = 0; i < getResX(); ++i){
-        for (unsigned int j = 0; j < getResY(); ++j){
-            for (unsigned int k = 0; k < getResZ(); ++k){
-                if (getSignedDistance(i,j,k) < -value){
-                    weights(i,j,k) = MAX_PAY;
+    //kernel, every tile of the weights is compacted as soon as it is complete
+    #pragma omp parallel for schedule(dynamic)
+    for (unsigned int t = 0; t < weights.getNumberTiles(); t++){
+        unsigned int ti, tj, tk;
+        weights.getTileFirst(t, ti, tj, tk);
+        for (unsigned int i = ti; i < std::min(ti + BLOCKED_ARRAY_TILE_SIZE, resX); ++i){
+            for (unsigned int j = tj; j < std::min(tj + BLOCKED_ARRAY_TILE_SIZE, resY); ++j){
+                for (unsigned int k = tk; k < std::min(tk + BLOCKED_ARRAY_TILE_SIZE, resZ); ++k){
+                    if (getSignedDistance(i,j,k) < -value){
+                        weights.set(i,j,k, MAX_PAY);
+                    }
                 }
             }
         }
+        weights.compactTile(t);
     }
-    TricubicInterpolator::getCoefficients(coeffs, mapCoeffs, weights);
+    if (lazy)
+        resetLazyTiles();
+    else
+        coefficientsStatistics = TricubicInterpolator::getCoefficients(coeffs, mapCoeffs, weights);
 }
 
+/**
+ * @brief Grid::calculateFullBoxValues
+ *
+ * Computes the integral of every cell and the summed-volume table of the integrals.
+ * In lazy mode, the integrals are computed with the coefficients, when the cells are touched.
+ * The pyramid of coarser levels is not built (see calculatePyramid).
+ */
 void Grid::calculateFullBoxValues(double (*integralTricubicInterpolation)(const gridreal *&, double, double, double, double, double, double)) {
-    fullBoxValues = Array3D<gridreal>(getResX()-1, getResY()-1, getResZ()-1);
+    this->integralTricubicInterpolation = integralTricubicInterpolation;
+    if (!lazy){
+        calculateCellValues(integralTricubicInterpolation);
+        calculateFullBoxValuesSums();
+    }
+    coarseLevels.clear();
+}
+
+/**
+ * @brief Grid::calculateCellValues
+ *
+ * Computes the integral of every cell. fullBoxValues has the same tiles of mapCoeffs:
+ * the constant tiles of mapCoeffs are integrated only once.
+ */
+void Grid::calculateCellValues(double (*integralTricubicInterpolation)(const gridreal *&, double, double, double, double, double, double)) {
+    this->integralTricubicInterpolation = integralTricubicInterpolation;
+    fullBoxValues = BlockedArray3D<gridreal>(getResX()-1, getResY()-1, getResZ()-1);
+    #pragma omp parallel for schedule(dynamic)
+    for (unsigned int t = 0; t < mapCoeffs.getNumberTiles(); t++)
+        calculateTileValues(t, coeffs);
+}
+
+/**
+ * @brief Grid::calculateTileValues
+ *
+ * Computes the integrals of the cells of the tile t, whose ids in mapCoeffs refer to coeffs.
+ */
+void Grid::calculateTileValues(unsigned int t, const std::vector< std::array<gridreal, 64> >& coeffs) const {
+    if (mapCoeffs.isConstantTile(t)){
+        const gridreal * c = coeffs[mapCoeffs.getTileValue(t)].data();
+        fullBoxValues.setTile(t, integralTricubicInterpolation(c, 0,0,0,1,1,1));
+        return;
+    }
+    unsigned int ti, tj, tk;
+    mapCoeffs.getTileFirst(t, ti, tj, tk);
+    for (unsigned int i = ti; i < std::min(ti + BLOCKED_ARRAY_TILE_SIZE, fullBoxValues.sizeX()); ++i){
+        for (unsigned int j = tj; j < std::min(tj + BLOCKED_ARRAY_TILE_SIZE, fullBoxValues.sizeY()); ++j){
+            for (unsigned int k = tk; k < std::min(tk + BLOCKED_ARRAY_TILE_SIZE, fullBoxValues.sizeZ()); ++k){
+                const gridreal * c = coeffs[mapCoeffs(i,j,k)].data();
+                fullBoxValues.set(i,j,k, integralTricubicInterpolation(c, 0,0,0,1,1,1));
+            }
+        }
+    }
+    fullBoxValues.compactTile(t);
+}
+
+/**
+ * @brief Grid::getFullBoxValuesSum
+ *
+ * Returns the sum of the full box values of the cells in [i1,i2) x [j1,j2) x [k1,k2).
+ * The tiles of fullBoxValues entirely contained in the box are summed with a constant
+ * number of lookups in the summed-volume table of the tiles, the other ones
+ * (on the border of the box) with a constant number of lookups each.
+ * Cells outside the grid have the value of the (constant) border.
+ * In lazy mode the table of the tiles is not available: every tile is summed
+ * with its own table, after touching it.
+ */
+double Grid::getFullBoxValuesSum(int i1, int j1, int k1, int i2, int j2, int k2) const {
+    if (i1 >= i2 || j1 >= j2 || k1 >= k2)
+        return 0;
+    const int S = BLOCKED_ARRAY_TILE_SIZE;
+    int nx = fullBoxValues.sizeX(), ny = fullBoxValues.sizeY(), nz = fullBoxValues.sizeZ();
+    int ci1 = std::max(i1, 0), cj1 = std::max(j1, 0), ck1 = std::max(k1, 0);
+    int ci2 = std::min(i2, nx), cj2 = std::min(j2, ny), ck2 = std::min(k2, nz);
+    double sum = 0;
+    long long int nInside = 0;
+    if (ci1 < ci2 && cj1 < cj2 && ck1 < ck2){
+        //tiles entirely contained in the box (the last tile of an axis may be shorter)
+        int fi1 = (ci1 + S - 1) / S, fj1 = (cj1 + S - 1) / S, fk1 = (ck1 + S - 1) / S;
+        int fi2 = ci2 == nx ? (int)tileSums.sizeX()-1 : ci2 / S;
+        int fj2 = cj2 == ny ? (int)tileSums.sizeY()-1 : cj2 / S;
+        int fk2 = ck2 == nz ? (int)tileSums.sizeZ()-1 : ck2 / S;
+        if (!lazy && fi1 < fi2 && fj1 < fj2 && fk1 < fk2){
+            sum = tileSums(fi2,fj2,fk2) - tileSums(fi1,fj2,fk2) - tileSums(fi2,fj1,fk2) - tileSums(fi2,fj2,fk1)
+                + tileSums(fi1,fj1,fk2) + tileSums(fi1,fj2,fk1) + tileSums(fi2,fj1,fk1) - tileSums(fi1,fj1,fk1);
+        }
+        else
+            fk2 = fk1;
+        //tiles partially contained in the box
+        for (int ti = ci1 / S; ti <= (ci2-1) / S; ti++){
+            bool xFull = ti >= fi1 && ti < fi2;
+            for (int tj = cj1 / S; tj <= (cj2-1) / S; tj++){
+                bool yFull = tj >= fj1 && tj < fj2;
+                for (int tk = ck1 / S; tk <= (ck2-1) / S; tk++){
+                    if (xFull && yFull && tk == fk1 && fk1 < fk2){
+                        tk = fk2-1;
+                        continue;
+                    }
+                    unsigned int t = fullBoxValues.getTileIndex(ti*S, tj*S, tk*S);
+                    if (lazy)
+                        touchTile(t);
+                    sum += getTileFullBoxValuesSum(t, std::max(ci1, ti*S), std::max(cj1, tj*S), std::max(ck1, tk*S),
+                                                   std::min(ci2, (ti+1)*S), std::min(cj2, (tj+1)*S), std::min(ck2, (tk+1)*S));
+                }
+            }
+        }
+        nInside = (long long int)(ci2-ci1) * (cj2-cj1) * (ck2-ck1);
+    }
+    long long int nOutside = (long long int)(i2-i1) * (j2-j1) * (k2-k1) - nInside;
+    if (nOutside > 0)
+        sum += nOutside * getCellFullBoxValue(0,0,0);
+    return sum;
+}
+
+static inline double getTileCellSum(const BlockedArray3D<gridreal>& tileCellSums, int i, int j, int k, int ti, int tj, int tk) {
+    return i < ti || j < tj || k < tk ? 0 : tileCellSums(i,j,k);
+}
+
+/**
+ * @brief Grid::getTileFullBoxValuesSum
+ *
+ * Returns the sum of the full box values of the cells in [i1,i2) x [j1,j2) x [k1,k2),
+ * which must be inside the tile t.
+ */
+double Grid::getTileFullBoxValuesSum(unsigned int t, int i1, int j1, int k1, int i2, int j2, int k2) const {
+    if (fullBoxValues.isConstantTile(t))
+        return (double)fullBoxValues.getTileValue(t) * (i2-i1) * (j2-j1) * (k2-k1);
+    unsigned int ti, tj, tk;
+    fullBoxValues.getTileFirst(t, ti, tj, tk);
+    i1--; j1--; k1--; i2--; j2--; k2--;
+    return getTileCellSum(tileCellSums, i2,j2,k2, ti,tj,tk) - getTileCellSum(tileCellSums, i1,j2,k2, ti,tj,tk)
+         - getTileCellSum(tileCellSums, i2,j1,k2, ti,tj,tk) - getTileCellSum(tileCellSums, i2,j2,k1, ti,tj,tk)
+         + getTileCellSum(tileCellSums, i1,j1,k2, ti,tj,tk) + getTileCellSum(tileCellSums, i1,j2,k1, ti,tj,tk)
+         + getTileCellSum(tileCellSums, i2,j1,k1, ti,tj,tk) - getTileCellSum(tileCellSums, i1,j1,k1, ti,tj,tk);
+}
+
+/**
+ * @brief Grid::calculateFullBoxValuesSums
+ *
+ * Computes the summed-volume tables of fullBoxValues:
+ * - tileSums(ti,tj,tk) is the sum of the full box values of the tiles in [0,ti) x [0,tj) x [0,tk);
+ * - for every dense tile, tileCellSums(i,j,k) is the sum of the full box values of the
+ *   cells of the tile in [first.x(), i] x [first.y(), j] x [first.z(), k], where first
+ *   is the first cell of the tile (constant tiles do not need it).
+ */
+void Grid::calculateFullBoxValuesSums() {
+    const unsigned int S = BLOCKED_ARRAY_TILE_SIZE;
+    unsigned int nx = fullBoxValues.sizeX(), ny = fullBoxValues.sizeY(), nz = fullBoxValues.sizeZ();
+    unsigned int ntx = (nx + S - 1) / S, nty = (ny + S - 1) / S, ntz = (nz + S - 1) / S;
+    tileSums = Array3D<double>(ntx+1, nty+1, ntz+1, 0);
+    tileCellSums = BlockedArray3D<gridreal>(nx, ny, nz, 0);
+    #pragma omp parallel for schedule(dynamic)
+    for (unsigned int t = 0; t < fullBoxValues.getNumberTiles(); t++){
+        unsigned int ti, tj, tk;
+        fullBoxValues.getTileFirst(t, ti, tj, tk);
+        tileSums(ti/S+1, tj/S+1, tk/S+1) = calculateTileSums(t);
+    }
+    for (unsigned int i = 1; i <= ntx; ++i)
+        for (unsigned int j = 1; j <= nty; ++j)
+            for (unsigned int k = 2; k <= ntz; ++k)
+                tileSums(i,j,k) += tileSums(i,j,k-1);
+    for (unsigned int i = 1; i <= ntx; ++i)
+        for (unsigned int j = 2; j <= nty; ++j)
+            for (unsigned int k = 1; k <= ntz; ++k)
+                tileSums(i,j,k) += tileSums(i,j-1,k);
+    for (unsigned int i = 2; i <= ntx; ++i)
+        for (unsigned int j = 1; j <= nty; ++j)
+            for (unsigned int k = 1; k <= ntz; ++k)
+                tileSums(i,j,k) += tileSums(i-1,j,k);
+}
+
+/**
+ * @brief Grid::calculateTileSums
+ *
+ * Computes the summed-volume table of the tile t of fullBoxValues in tileCellSums
+ * (only if the tile is dense).
+ * @return the sum of the full box values of the tile
+ */
+double Grid::calculateTileSums(unsigned int t) const {
+    const unsigned int S = BLOCKED_ARRAY_TILE_SIZE;
+    unsigned int ti, tj, tk;
+    fullBoxValues.getTileFirst(t, ti, tj, tk);
+    unsigned int ti2 = std::min(ti + S, fullBoxValues.sizeX()), tj2 = std::min(tj + S, fullBoxValues.sizeY()), tk2 = std::min(tk + S, fullBoxValues.sizeZ());
+    if (fullBoxValues.isConstantTile(t))
+        return (double)fullBoxValues.getTileValue(t) * (ti2-ti) * (tj2-tj) * (tk2-tk);
+    //the table is accumulated in double, and stored in gridreal: the sums are on 512 cells at most
+    double sums[S][S][S];
+    for (unsigned int i = 0; i < ti2-ti; ++i)
+        for (unsigned int j = 0; j < tj2-tj; ++j)
+            for (unsigned int k = 0; k < tk2-tk; ++k)
+                sums[i][j][k] = fullBoxValues(ti+i,tj+j,tk+k) + (k > 0 ? sums[i][j][k-1] : 0);
+    for (unsigned int i = 0; i < ti2-ti; ++i)
+        for (unsigned int j = 1; j < tj2-tj; ++j)
+            for (unsigned int k = 0; k < tk2-tk; ++k)
+                sums[i][j][k] += sums[i][j-1][k];
+    for (unsigned int i = 1; i < ti2-ti; ++i)
+        for (unsigned int j = 0; j < tj2-tj; ++j)
+            for (unsigned int k = 0; k < tk2-tk; ++k)
+                sums[i][j][k] += sums[i-1][j][k];
+    for (unsigned int i = 0; i < ti2-ti; ++i)
+        for (unsigned int j = 0; j < tj2-tj; ++j)
+            for (unsigned int k = 0; k < tk2-tk; ++k)
+                tileCellSums.set(ti+i,tj+j,tk+k, sums[i][j][k]);
+    return sums[ti2-ti-1][tj2-tj-1][tk2-tk-1];
+}
+
+/**
+ * @brief Grid::setLazy
+ *
+ * In lazy mode the coefficients, the full box values and their summed-volume tables
+ * are not computed for the whole grid: every tile of cells is computed the first time
+ * one of its cells is touched, and can be shared by concurrent threads (see calculateLazyTile).
+ * The coefficients are deduplicated only inside every tile.
+ * It must be called before calculateWeightsAndFreezeKernel.
+ */
+void Grid::setLazy(bool lazy) {
+    this->lazy = lazy;
+}
+
+/**
+ * @brief Grid::resetLazyTiles
+ *
+ * Lazy mode: marks all the tiles of the cells as not computed.
+ */
+void Grid::resetLazyTiles() {
+    unsigned int nTiles = mapCoeffs.getNumberTiles();
+    coeffs.clear();
+    tileCoeffs.assign(nTiles, std::vector< std::array<gridreal, 64> >());
+    tileStatistics.assign(nTiles, TricubicInterpolator::CoefficientsStatistics());
+    tileStates.assign(nTiles, 0);
+    tileLocks.assign(nTiles);
+    fullBoxValues = BlockedArray3D<gridreal>(resX-1, resY-1, resZ-1);
+    tileSums = Array3D<double>();
+    tileCellSums = BlockedArray3D<gridreal>(resX-1, resY-1, resZ-1, 0);
+    coefficientsStatistics = TricubicInterpolator::CoefficientsStatistics();
+}
+
+/**
+ * @brief Grid::calculateLazyTile
+ *
+ * Lazy mode: computes the coefficients, the full box values and the summed-volume
+ * table of the tile t. The tile is computed by the first thread which takes its lock,
+ * and published (GRID_TILE_READY) only when it is complete: the other threads touching
+ * it in the meantime are blocked on the lock, and find it ready.
+ */
+void Grid::calculateLazyTile(unsigned int t) const {
+    assert(lazy && integralTricubicInterpolation != nullptr);
+    tileLocks.set(t);
+    unsigned char state;
+    #pragma omp atomic read seq_cst
+    state = tileStates[t];
+    if (!(state & GRID_TILE_READY)){
+        tileStatistics[t] = TricubicInterpolator::getTileCoefficients(tileCoeffs[t], mapCoeffs, weights, t);
+        calculateTileValues(t, tileCoeffs[t]);
+        calculateTileSums(t);
+        #pragma omp atomic write seq_cst
+        tileStates[t] = GRID_TILE_READY;
+    }
+    tileLocks.unset(t);
+}
+
+/**
+ * @brief Grid::getTouchedCellsFraction
+ * @return the fraction of the cells computed in lazy mode (1 if the grid is not lazy)
+ */
+double Grid::getTouchedCellsFraction() const {
+    if (!lazy)
+        return 1;
+    unsigned long long int nTouched = 0;
+    for (unsigned int t = 0; t < tileStates.size(); t++){
+        unsigned char state;
+        #pragma omp atomic read seq_cst
+        state = tileStates[t];
+        if (state & GRID_TILE_READY){
+            unsigned int ti, tj, tk;
+            mapCoeffs.getTileFirst(t, ti, tj, tk);
+            nTouched += (unsigned long long int)(std::min(ti + BLOCKED_ARRAY_TILE_SIZE, resX-1) - ti) *
+                    (std::min(tj + BLOCKED_ARRAY_TILE_SIZE, resY-1) - tj) * (std::min(tk + BLOCKED_ARRAY_TILE_SIZE, resZ-1) - tk);
+        }
+    }
+    return (double)nTouched / ((unsigned long long int)(resX-1) * (resY-1) * (resZ-1));
+}
+
+/**
+ * @brief Grid::getNumberCoefficients
+ * @return the number of distinct coefficients (in lazy mode, the sum on the touched tiles)
+ */
+unsigned int Grid::getNumberCoefficients() const {
+    if (mappedCoeffs != nullptr)
+        return nMappedCoeffs;
+    if (!lazy)
+        return (unsigned int)coeffs.size();
+    unsigned int n = 0;
+    for (unsigned int t = 0; t < tileStates.size(); t++){
+        unsigned char state;
+        #pragma omp atomic read seq_cst
+        state = tileStates[t];
+        if (state & GRID_TILE_READY)
+            n += (unsigned int)tileCoeffs[t].size();
+    }
+    return n;
+}
+
+/**
+ * @brief Grid::getCoefficientsStatistics
+ * @return the statistics of the last computation of the coefficients
+ * (in lazy mode, of the touched tiles)
+ */
+TricubicInterpolator::CoefficientsStatistics Grid::getCoefficientsStatistics() const {
+    if (!lazy)
+        return coefficientsStatistics;
+    TricubicInterpolator::CoefficientsStatistics statistics = {0, 0, 0};
+    for (unsigned int t = 0; t < tileStates.size(); t++){
+        unsigned char state;
+        #pragma omp atomic read seq_cst
+        state = tileStates[t];
+        if (state & GRID_TILE_READY){
+            statistics.nConstantCells += tileStatistics[t].nConstantCells;
+            statistics.nRepeatedCells += tileStatistics[t].nRepeatedCells;
+            statistics.nComputedCells += tileStatistics[t].nComputedCells;
+        }
+    }
+    return statistics;
+}
+
+/**
+ * @brief Grid::calculatePyramid
+ *
+ * Builds up to nLevels coarser levels of the grid, every one with twice the unit
+ * of the previous one (see coarsen). Levels with less than GRID_PYRAMID_MIN_RESOLUTION
+ * vertices along an axis are not built.
+ * The levels are used only by the coarse-to-fine growth of the boxes (see Energy::BFGS),
+ * so they are built only on request, after calculateFullBoxValues.
+ */
+void Grid::calculatePyramid(unsigned int nLevels) {
+    coarseLevels.clear();
+    coarseLevels.reserve(nLevels);
+    const Grid* finer = this;
+    for (unsigned int l = 0; l < nLevels; l++){
+        if (std::min(std::min(finer->resX, finer->resY), finer->resZ)/2 + 1 < GRID_PYRAMID_MIN_RESOLUTION)
+            break;
+        coarseLevels.push_back(finer->coarsen());
+        finer = &coarseLevels.back();
+    }
+}
+
+static double cellIntegral(const gridreal*& a, double u1, double v1, double w1, double u2, double v2, double w2) {
+    return TricubicKernel::integral(a, u1, v1, w1, u2, v2, w2);
+}
+
+/**
+ * @brief Grid::coarsen
+ *
+ * Returns the grid with twice the unit: every weight is the full-weighting
+ * average (1/4, 1/2, 1/4 on every axis) of the weights around the same point
+ * of this grid, multiplied by 8 (the ratio between the volumes of the cells),
+ * so that the integrals on the two grids have the same scale.
+ * The two outer layers of vertices are border, like in this grid.
+ * The level is lazy if this grid is lazy.
+ */
+Grid Grid::coarsen() const {
+    Grid c;
+    c.resX = resX/2 + 1;
+    c.resY = resY/2 + 1;
+    c.resZ = resZ/2 + 1;
+    c.unit = 2*unit;
+    c.target = target;
+    c.bb.setMin(bb.min());
+    c.bb.setMax(bb.min() + Point3d((c.resX-1)*c.unit, (c.resY-1)*c.unit, (c.resZ-1)*c.unit));
+    Array3D<gridreal> coarseWeights(c.resX, c.resY, c.resZ, 8*BORDER_PAY);
+    const double w[3] = {0.25, 0.5, 0.25};
     #pragma omp parallel for
-	for (unsigned int i = 0; i < fullBoxValues.sizeX(); ++i){
-		for (unsigned int j = 0; j < fullBoxValues.sizeY(); ++j){
-			for (unsigned int k = 0; k < fullBoxValues.sizeZ(); ++k){
-                const gridreal * coeffs;
-                getCoefficients(coeffs, i, j, k);
-                fullBoxValues(i,j,k) = integralTricubicInterpolation(coeffs, 0,0,0,1,1,1);
+    for (unsigned int i = 2; i < c.resX-2; i++){
+        for (unsigned int j = 2; j < c.resY-2; j++){
+            for (unsigned int k = 2; k < c.resZ-2; k++){
+                double sum = 0;
+                for (int di = -1; di <= 1; di++){
+                    unsigned int fi = std::min(2*i+di, resX-1);
+                    for (int dj = -1; dj <= 1; dj++){
+                        unsigned int fj = std::min(2*j+dj, resY-1);
+                        for (int dk = -1; dk <= 1; dk++){
+                            unsigned int fk = std::min(2*k+dk, resZ-1);
+                            sum += w[di+1]*w[dj+1]*w[dk+1]*weights(fi,fj,fk);
+                        }
+                    }
+                }
+                coarseWeights(i,j,k) = 8*sum;
             }
         }
     }
+    c.weights = BlockedArray3D<gridreal>(coarseWeights);
+    c.coeffs = std::vector<std::array<gridreal, 64> >(1);
+    c.mapCoeffs = BlockedArray3D<int>(c.resX-1, c.resY-1, c.resZ-1, 0);
+    c.lazy = lazy;
+    c.integralTricubicInterpolation = cellIntegral;
+    if (lazy){
+        c.resetLazyTiles();
+        return c;
+    }
+    c.coefficientsStatistics = TricubicInterpolator::getCoefficients(c.coeffs, c.mapCoeffs, c.weights);
+    c.calculateCellValues(cellIntegral);
+    c.calculateFullBoxValuesSums();
+    return c;
 }
 
 double Grid::getValue(const Point3d& p) const {
@@ -169,8 +624,7 @@ double Grid::getValue(const Point3d& p) const {
         return weights(xi,yi,zi);
     else{
         n = (p - n) / getUnit(); // n ora è un punto nell'intervallo 0 - 1
-        int id = mapCoeffs(xi, yi, zi);
-        const gridreal* coef = coeffs[id].data();
+        const gridreal* coef = getCellCoefficients(xi, yi, zi);
         return TricubicInterpolator::getValue(n, coef);
     }
 }
@@ -192,16 +646,309 @@ void Grid::getMinAndMax(double& min, double& max) {
     }
 }
 
+/**
+ * @brief Grid::serialize
+ *
+ * The arrays are written dense, so the format of the file does not depend on the tiles.
+ * A lazy grid is written as the same grid with all the cells computed.
+ */
 void Grid::serialize(std::ofstream& binaryFile) const {
+    if (lazy){
+        getComputedGrid().serialize(binaryFile);
+        return;
+    }
+    std::vector< std::array<gridreal, 64> > coeffs = this->coeffs;
+    if (mappedCoeffs != nullptr){
+        coeffs.resize(nMappedCoeffs);
+        std::memcpy(coeffs.data(), mappedCoeffs, nMappedCoeffs * sizeof(std::array<gridreal, 64>));
+    }
     serializeObjectAttributes("Grid", binaryFile, bb, resX, resY, resZ,
-                                          signedDistances, weights, coeffs, mapCoeffs,
-                                          fullBoxValues, target, unit);
+                                          signedDistances.toArray3D(), weights.toArray3D(), coeffs, mapCoeffs.toArray3D(),
+                                          fullBoxValues.toArray3D(), target, unit);
 }
 
 void Grid::deserialize(std::ifstream& binaryFile) {
+    Array3D<gridreal> signedDistances, weights, fullBoxValues;
+    Array3D<int> mapCoeffs;
+    lazy = false;
+    mappedCoeffs = nullptr;
+    nMappedCoeffs = 0;
+    mappedFile.reset();
     deserializeObjectAttributes("Grid", binaryFile, bb, resX, resY, resZ,
                                           signedDistances, weights, coeffs, mapCoeffs,
                                           fullBoxValues, target, unit);
+    this->signedDistances = BlockedArray3D<gridreal>(signedDistances);
+    this->weights = BlockedArray3D<gridreal>(weights);
+    this->mapCoeffs = BlockedArray3D<int>(mapCoeffs);
+    this->fullBoxValues = BlockedArray3D<gridreal>(fullBoxValues);
+    calculateFullBoxValuesSums();
+    coarseLevels.clear();
+}
+
+
+
+/**
+ * @brief Grid::getComputedGrid
+ * @return a copy of this lazy grid, with all the cells (and the pyramid, if built) computed
+ */
+Grid Grid::getComputedGrid() const {
+    assert(lazy && integralTricubicInterpolation != nullptr);
+    Grid g(*this);
+    g.lazy = false;
+    g.tileCoeffs.clear();
+    g.tileStatistics.clear();
+    g.tileStates.clear();
+    g.tileLocks.assign(0);
+    g.coefficientsStatistics = TricubicInterpolator::getCoefficients(g.coeffs, g.mapCoeffs, g.weights);
+    g.calculateFullBoxValues(integralTricubicInterpolation);
+    if (!coarseLevels.empty())
+        g.calculatePyramid(coarseLevels.size());
+    return g;
+}
+
+/**
+ * @brief The MappedGridHeader struct
+ *
+ * Header of a mapped grid file: the file contains the grid and the levels of its pyramid,
+ * every one described by a MappedGridLevel, and the kernel distance of the weights.
+ * All the offsets are from the beginning of the file, and every section is aligned to
+ * MAPPED_GRID_ALIGNMENT bytes. The values are stored in the native representation of the machine.
+ */
+struct MappedGridHeader {
+        char magic[8];
+        unsigned int gridrealSize;
+        unsigned int nLevels;
+        double kernelDistance;
+        unsigned long long int levels[GRID_PYRAMID_LEVELS+1];
+};
+
+/**
+ * @brief The MappedBlockedArray struct
+ *
+ * A BlockedArray3D in a mapped grid file: the value of every tile, the index of every
+ * tile in the dense tiles (-1 if constant) and the elements of the dense tiles.
+ */
+struct MappedBlockedArray {
+        unsigned int size[3];
+        unsigned int nDenseTiles;
+        unsigned long long int values, tileIndices, tiles;
+};
+
+struct MappedGridLevel {
+        double min[3], max[3], target[3], unit;
+        unsigned int res[3];
+        unsigned int nCoefficients;
+        unsigned long long int coefficients;
+        MappedBlockedArray weights, mapCoeffs, fullBoxValues, tileCellSums;
+        unsigned int tileSumsSize[3];
+        unsigned int padding;
+        unsigned long long int tileSums;
+};
+
+/**
+ * @brief writeAligned
+ *
+ * Writes size bytes of data after the padding needed to align them.
+ * @return the offset of the data in the file
+ */
+static unsigned long long int writeAligned(std::ofstream& file, const void* data, size_t size) {
+    static const char zeros[MAPPED_GRID_ALIGNMENT] = {0};
+    unsigned long long int offset = file.tellp();
+    unsigned long long int padding = (MAPPED_GRID_ALIGNMENT - offset % MAPPED_GRID_ALIGNMENT) % MAPPED_GRID_ALIGNMENT;
+    file.write(zeros, padding);
+    if (size > 0)
+        file.write((const char*)data, size);
+    return offset + padding;
+}
+
+template <class T>
+static MappedBlockedArray writeBlockedArray(std::ofstream& file, const BlockedArray3D<T>& a) {
+    MappedBlockedArray m;
+    m.size[0] = a.sizeX();
+    m.size[1] = a.sizeY();
+    m.size[2] = a.sizeZ();
+    m.nDenseTiles = 0;
+    std::vector<T> values(a.getNumberTiles(), T());
+    std::vector<int> tileIndices(a.getNumberTiles(), -1);
+    for (unsigned int t = 0; t < a.getNumberTiles(); t++){
+        if (a.isConstantTile(t))
+            values[t] = a.getTileValue(t);
+        else
+            tileIndices[t] = m.nDenseTiles++;
+    }
+    m.values = writeAligned(file, values.data(), values.size() * sizeof(T));
+    m.tileIndices = writeAligned(file, tileIndices.data(), tileIndices.size() * sizeof(int));
+    m.tiles = writeAligned(file, nullptr, 0);
+    for (unsigned int t = 0; t < a.getNumberTiles(); t++)
+        if (!a.isConstantTile(t))
+            file.write((const char*)a.getTileData(t), BLOCKED_ARRAY_TILE_VOLUME * sizeof(T));
+    return m;
+}
+
+static bool isInFile(const MappedFile& file, unsigned long long int offset, unsigned long long int size) {
+    return offset % MAPPED_GRID_ALIGNMENT == 0 && offset <= file.size() && size <= file.size() - offset;
+}
+
+template <class T>
+static bool mapBlockedArray(BlockedArray3D<T>& a, const MappedBlockedArray& m, const MappedFile& file) {
+    unsigned long long int nTiles = (unsigned long long int)((m.size[0] + BLOCKED_ARRAY_TILE_MASK) >> BLOCKED_ARRAY_TILE_BITS) *
+            ((m.size[1] + BLOCKED_ARRAY_TILE_MASK) >> BLOCKED_ARRAY_TILE_BITS) * ((m.size[2] + BLOCKED_ARRAY_TILE_MASK) >> BLOCKED_ARRAY_TILE_BITS);
+    if (!isInFile(file, m.values, nTiles * sizeof(T)) || !isInFile(file, m.tileIndices, nTiles * sizeof(int)) ||
+            !isInFile(file, m.tiles, (unsigned long long int)m.nDenseTiles * BLOCKED_ARRAY_TILE_VOLUME * sizeof(T)))
+        return false;
+    const int* tileIndices = (const int*)(file.data() + m.tileIndices);
+    for (unsigned long long int t = 0; t < nTiles; t++)
+        if (tileIndices[t] < -1 || tileIndices[t] >= (long long int)m.nDenseTiles)
+            return false;
+    a = BlockedArray3D<T>(m.size[0], m.size[1], m.size[2], (const T*)(file.data() + m.values),
+                          tileIndices, (const T*)(file.data() + m.tiles));
+    return true;
 }
 
+/**
+ * @brief areValidIds
+ * @return true if all the elements of a are in [0, n)
+ */
+static bool areValidIds(const BlockedArray3D<int>& a, unsigned int n) {
+    for (unsigned int t = 0; t < a.getNumberTiles(); t++){
+        if (a.isConstantTile(t)){
+            if (a.getTileValue(t) < 0 || a.getTileValue(t) >= (int)n)
+                return false;
+            continue;
+        }
+        unsigned int ti, tj, tk;
+        a.getTileFirst(t, ti, tj, tk);
+        for (unsigned int i = ti; i < std::min(ti + BLOCKED_ARRAY_TILE_SIZE, a.sizeX()); i++)
+            for (unsigned int j = tj; j < std::min(tj + BLOCKED_ARRAY_TILE_SIZE, a.sizeY()); j++)
+                for (unsigned int k = tk; k < std::min(tk + BLOCKED_ARRAY_TILE_SIZE, a.sizeZ()); k++)
+                    if (a(i,j,k) < 0 || a(i,j,k) >= (int)n)
+                        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Grid::writeMappedFile
+ *
+ * Writes the grid and its pyramid (if built) in a file which can be mapped by mapFile.
+ * The signed distances are not written.
+ * @return false if the file cannot be written
+ */
+bool Grid::writeMappedFile(const std::string& filename) const {
+    if (lazy)
+        return getComputedGrid().writeMappedFile(filename);
+    std::ofstream file(filename.c_str(), std::ios::out | std::ios::binary);
+    if (!file.is_open())
+        return false;
+    MappedGridHeader header;
+    std::memset(&header, 0, sizeof(MappedGridHeader));
+    std::memcpy(header.magic, MAPPED_GRID_MAGIC, sizeof(header.magic));
+    header.gridrealSize = sizeof(gridreal);
+    header.nLevels = 1 + coarseLevels.size();
+    header.kernelDistance = kernelDistance;
+    file.write((const char*)&header, sizeof(MappedGridHeader));
+    for (unsigned int l = 0; l < header.nLevels; l++)
+        header.levels[l] = (l == 0 ? *this : coarseLevels[l-1]).writeMappedLevel(file);
+    file.seekp(0);
+    file.write((const char*)&header, sizeof(MappedGridHeader));
+    return file.good();
+}
 
+/**
+ * @brief Grid::writeMappedLevel
+ *
+ * Writes the arrays of this grid (not of its pyramid), then their description.
+ * @return the offset of the MappedGridLevel in the file
+ */
+unsigned long long int Grid::writeMappedLevel(std::ofstream& file) const {
+    MappedGridLevel level;
+    std::memset(&level, 0, sizeof(MappedGridLevel));
+    for (unsigned int a = 0; a < 3; a++){
+        level.min[a] = bb.min()[a];
+        level.max[a] = bb.max()[a];
+        level.target[a] = target[a];
+    }
+    level.unit = unit;
+    level.res[0] = resX;
+    level.res[1] = resY;
+    level.res[2] = resZ;
+    level.nCoefficients = getNumberCoefficients();
+    level.coefficients = writeAligned(file, mappedCoeffs != nullptr ? mappedCoeffs : (const gridreal*)coeffs.data(),
+                                      (size_t)level.nCoefficients * sizeof(std::array<gridreal, 64>));
+    level.weights = writeBlockedArray(file, weights);
+    level.mapCoeffs = writeBlockedArray(file, mapCoeffs);
+    level.fullBoxValues = writeBlockedArray(file, fullBoxValues);
+    level.tileCellSums = writeBlockedArray(file, tileCellSums);
+    level.tileSumsSize[0] = tileSums.sizeX();
+    level.tileSumsSize[1] = tileSums.sizeY();
+    level.tileSumsSize[2] = tileSums.sizeZ();
+    std::vector<double> sums;
+    sums.reserve(tileSums.sizeX() * tileSums.sizeY() * tileSums.sizeZ());
+    for (unsigned int i = 0; i < tileSums.sizeX(); i++)
+        for (unsigned int j = 0; j < tileSums.sizeY(); j++)
+            for (unsigned int k = 0; k < tileSums.sizeZ(); k++)
+                sums.push_back(tileSums(i,j,k));
+    level.tileSums = writeAligned(file, sums.data(), sums.size() * sizeof(double));
+    return writeAligned(file, &level, sizeof(MappedGridLevel));
+}
+
+/**
+ * @brief Grid::mapFile
+ *
+ * Maps read-only a file written by writeMappedFile: the arrays of the grid and of its
+ * pyramid are read directly from the file (only the small table of the sums of the tiles
+ * is copied), and their pages are loaded when they are touched.
+ * The grid cannot be modified, and has no signed distances.
+ * The ids of the coefficients of the cells are checked once, when the file is mapped.
+ * @return false if the file cannot be mapped or is not a mapped grid file; the grid is not modified
+ */
+bool Grid::mapFile(const std::string& filename) {
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    if (!file->open(filename) || file->size() < sizeof(MappedGridHeader))
+        return false;
+    const MappedGridHeader* header = (const MappedGridHeader*)file->data();
+    if (std::memcmp(header->magic, MAPPED_GRID_MAGIC, sizeof(header->magic)) != 0 ||
+            header->gridrealSize != sizeof(gridreal) || header->nLevels == 0 || header->nLevels > GRID_PYRAMID_LEVELS+1)
+        return false;
+    Grid g;
+    g.coarseLevels.resize(header->nLevels-1);
+    for (unsigned int l = 0; l < header->nLevels; l++)
+        if (!(l == 0 ? g : g.coarseLevels[l-1]).mapLevel(file, header->levels[l]))
+            return false;
+    g.kernelDistance = header->kernelDistance;
+    *this = g;
+    return true;
+}
+
+bool Grid::mapLevel(const std::shared_ptr<MappedFile>& file, unsigned long long int offset) {
+    if (!isInFile(*file, offset, sizeof(MappedGridLevel)))
+        return false;
+    const MappedGridLevel& level = *(const MappedGridLevel*)(file->data() + offset);
+    if (!isInFile(*file, level.coefficients, (unsigned long long int)level.nCoefficients * sizeof(std::array<gridreal, 64>)) ||
+            !isInFile(*file, level.tileSums, (unsigned long long int)level.tileSumsSize[0] * level.tileSumsSize[1] * level.tileSumsSize[2] * sizeof(double)) ||
+            !mapBlockedArray(weights, level.weights, *file) || !mapBlockedArray(mapCoeffs, level.mapCoeffs, *file) ||
+            !mapBlockedArray(fullBoxValues, level.fullBoxValues, *file) || !mapBlockedArray(tileCellSums, level.tileCellSums, *file) ||
+            !areValidIds(mapCoeffs, level.nCoefficients))
+        return false;
+    for (unsigned int c = 0; c < 3; c++)
+        if (level.mapCoeffs.size[c] + 1 != level.res[c])
+            return false;
+    bb.setMin(Point3d(level.min[0], level.min[1], level.min[2]));
+    bb.setMax(Point3d(level.max[0], level.max[1], level.max[2]));
+    target = Vec3d(level.target[0], level.target[1], level.target[2]);
+    unit = level.unit;
+    resX = level.res[0];
+    resY = level.res[1];
+    resZ = level.res[2];
+    coeffs.clear();
+    mappedCoeffs = (const gridreal*)(file->data() + level.coefficients);
+    nMappedCoeffs = level.nCoefficients;
+    const double* sums = (const double*)(file->data() + level.tileSums);
+    tileSums = Array3D<double>(level.tileSumsSize[0], level.tileSumsSize[1], level.tileSumsSize[2]);
+    for (unsigned int i = 0; i < tileSums.sizeX(); i++)
+        for (unsigned int j = 0; j < tileSums.sizeY(); j++)
+            for (unsigned int k = 0; k < tileSums.sizeZ(); k++)
+                tileSums(i,j,k) = *(sums++);
+    mappedFile = file;
+    return true;
+}
@@ -5,10 +5,66 @@
 #include "cg3/data_structures/arrays/arrays.h"
 #include "cg3/meshes/dcel/dcel.h"
 #include "engine/tricubic.h"
+#include "blockedarray3d.h"
+#include "mappedfile.h"
 #include "common.h"
 
+#include <memory>
+#include <omp.h>
+
 #include "cg3/cgal/aabb_tree3.h"
 
+#define GRID_PYRAMID_LEVELS 2 //number of coarser levels (2x, 4x) of the grid
+#define GRID_PYRAMID_MIN_RESOLUTION 16 //a level is not built if it would have less vertices than this along an axis
+
+#define GRID_TILE_READY 1 //lazy mode: the tile has been computed and can be read
+
+/**
+ * @brief The CellFaces struct
+ *
+ * Faces of a mesh contained in every cell of a grid, in CSR format: the faces of the
+ * cell c = (i*(resY-1) + j)*(resZ-1) + k are faces[offsets[c]], ..., faces[offsets[c+1]-1].
+ * They do not depend on the target, and can be shared by the grids of all the targets.
+ */
+struct CellFaces {
+        std::vector<unsigned int> offsets;
+        std::vector<const cg3::Dcel::Face*> faces;
+};
+
+/**
+ * @brief buildAABBTree
+ *
+ * AABB tree of the faces of d whose search structures are built explicitly
+ * (AABB_tree::build and accelerate_distance_queries, requested through the
+ * forDistanceQueries flag of the tree) instead of lazily by the first query,
+ * so that the tree can be queried concurrently by many threads.
+ */
+inline cg3::cgal::AABBTree3 buildAABBTree(const cg3::Dcel& d) {
+    return cg3::cgal::AABBTree3(d, true);
+}
+
+/**
+ * @brief The TileLocks class
+ *
+ * An OpenMP lock for every tile of a lazy grid. The copies have their own locks.
+ */
+class TileLocks {
+    public:
+        TileLocks();
+        TileLocks(const TileLocks& other);
+        TileLocks& operator=(const TileLocks& other);
+        ~TileLocks();
+
+        void assign(unsigned int n);
+        void set(unsigned int t);
+        void unset(unsigned int t);
+
+    private:
+        void destroy();
+
+        std::vector<omp_lock_t> locks;
+};
+
 class Grid : cg3::SerializableObject{
     public:
 
@@ -24,23 +80,51 @@ class Grid : cg3::SerializableObject{
 
 		cg3::Vec3d getTarget() const;
 		void setTarget(const cg3::Vec3d& value);
+        double getKernelDistance() const;
 
+        void calculateCellFaces(CellFaces& cellFaces, const cg3::Dcel& d) const;
         void calculateBorderWeights(const cg3::Dcel &d, bool tolerance = false, std::set<const cg3::Dcel::Face*>& savedFaces = Grid::dummy);
+        void calculateBorderWeights(const CellFaces& cellFaces, bool tolerance = false, std::set<const cg3::Dcel::Face*>& savedFaces = Grid::dummy);
         void calculateWeightsAndFreezeKernel(const cg3::Dcel& d, double value, bool tolerance = false, std::set<const cg3::Dcel::Face*>& savedFaces = Grid::dummy);
+        void calculateWeightsAndFreezeKernel(const CellFaces& cellFaces, double value, bool tolerance = false, std::set<const cg3::Dcel::Face*>& savedFaces = Grid::dummy);
         void calculateFullBoxValues(double (*integralTricubicInterpolation)(const gridreal *&, double, double, double, double, double, double));
 
 		double getValue(const cg3::Point3d &p) const;
         double getUnit() const;
         void getMinAndMax(double &min, double &max);
+        unsigned int getNumberCoefficients() const;
+        TricubicInterpolator::CoefficientsStatistics getCoefficientsStatistics() const;
+
+        // Lazy computation of the cells
+        void setLazy(bool lazy);
+        bool isLazy() const;
+        double getTouchedCellsFraction() const;
 
 		cg3::Point3d getNearestGridPoint(const cg3::Point3d& p) const;
 		void getCoefficients(const gridreal*& coeffs, const cg3::Point3d& p) const;
 		double getFullBoxValue(const cg3::Point3d&p) const;
 
+        // Index-space traversal of the cells
+        void getCellRange(cg3::Point3i& first, cg3::Point3i& last, const cg3::Point3d& min, const cg3::Point3d& max) const;
+        cg3::Point3d getCellMin(int i, int j, int k) const;
+        const gridreal* getCellCoefficients(int i, int j, int k) const;
+        double getCellFullBoxValue(int i, int j, int k) const;
+        double getFullBoxValuesSum(int i1, int j1, int k1, int i2, int j2, int k2) const;
+
+        // Multi-resolution pyramid
+        void calculatePyramid(unsigned int nLevels = GRID_PYRAMID_LEVELS);
+        unsigned int getNumberCoarseLevels() const;
+        const Grid& getCoarseLevel(unsigned int level) const;
+
         // SerializableObject interface
         void serialize(std::ofstream& binaryFile) const;
         void deserialize(std::ifstream& binaryFile);
 
+        // Mapped file
+        bool writeMappedFile(const std::string& filename) const;
+        bool mapFile(const std::string& filename);
+        bool isMapped() const;
+
         void resetSignedDistances();
 
 
@@ -53,23 +137,90 @@ class Grid : cg3::SerializableObject{
         int getIndexOfCoordinateY(double y) const;
         int getIndexOfCoordinateZ(double z) const;
 
-        void getCoefficients(const gridreal*& coeffs, unsigned int i, unsigned int j, unsigned int k) const;
+        int clampCell(int i, unsigned int res) const;
+        double getTileFullBoxValuesSum(unsigned int t, int i1, int j1, int k1, int i2, int j2, int k2) const;
 
         void setWeightOnCube(unsigned int i, unsigned int j, unsigned int k, double w);
+        void calculateCellValues(double (*integralTricubicInterpolation)(const gridreal *&, double, double, double, double, double, double));
+        void calculateTileValues(unsigned int t, const std::vector< std::array<gridreal, 64> >& coeffs) const;
+        void calculateFullBoxValuesSums();
+        double calculateTileSums(unsigned int t) const;
+        Grid coarsen() const;
+
+        void resetLazyTiles();
+        void touchTile(unsigned int t) const;
+        void calculateLazyTile(unsigned int t) const;
+        Grid getComputedGrid() const;
+
+        unsigned long long int writeMappedLevel(std::ofstream& file) const;
+        bool mapLevel(const std::shared_ptr<MappedFile>& file, unsigned long long int offset);
 
 		cg3::BoundingBox3 bb;
         unsigned int resX, resY, resZ;
-        cg3::Array3D<gridreal> signedDistances;
-        cg3::Array3D<gridreal> weights;
+        BlockedArray3D<gridreal> signedDistances;
+        BlockedArray3D<gridreal> weights;
         std::vector< std::array<gridreal, 64> > coeffs;
-        cg3::Array3D<int> mapCoeffs;
-        cg3::Array3D<gridreal> fullBoxValues;
+        //the tiles of mapCoeffs, fullBoxValues and tileCellSums are written when touched in lazy mode
+        mutable BlockedArray3D<int> mapCoeffs;
+        mutable BlockedArray3D<gridreal> fullBoxValues;
+        cg3::Array3D<double> tileSums; //summed-volume table of the sums of the tiles of fullBoxValues, not used in lazy mode
+        mutable BlockedArray3D<gridreal> tileCellSums; //summed-volume table of fullBoxValues inside every dense tile (relative to the tile)
 		cg3::Vec3d target;
         double unit;
+        double kernelDistance; //value of the last calculateWeightsAndFreezeKernel, written in the mapped files, not serialized
+        std::vector<Grid> coarseLevels; //coarseLevels[l-1] has unit 2^l * unit, not serialized
+        TricubicInterpolator::CoefficientsStatistics coefficientsStatistics; //of the last computation of the coefficients, not serialized
+        bool lazy; //the cells are computed by tiles, when touched (see setLazy)
+        double (*integralTricubicInterpolation)(const gridreal *&, double, double, double, double, double, double);
+        mutable std::vector< std::vector< std::array<gridreal, 64> > > tileCoeffs; //lazy mode: coefficients of every tile, referred by mapCoeffs
+        mutable std::vector<TricubicInterpolator::CoefficientsStatistics> tileStatistics; //lazy mode
+        mutable std::vector<unsigned char> tileStates; //lazy mode: GRID_TILE_READY or 0, accessed atomically
+        mutable TileLocks tileLocks; //lazy mode: held by the thread computing the tile
+        const gridreal* mappedCoeffs; //coefficients in the mapped file (64 for every id), nullptr if the grid is not mapped
+        unsigned int nMappedCoeffs;
+        std::shared_ptr<MappedFile> mappedFile; //shared by the levels and the copies of a mapped grid
 
         static std::set<const cg3::Dcel::Face*> dummy;
 };
 
+inline TileLocks::TileLocks() {
+}
+
+inline TileLocks::TileLocks(const TileLocks& other) {
+    assign(other.locks.size());
+}
+
+inline TileLocks& TileLocks::operator=(const TileLocks& other) {
+    if (this != &other)
+        assign(other.locks.size());
+    return *this;
+}
+
+inline TileLocks::~TileLocks() {
+    destroy();
+}
+
+inline void TileLocks::assign(unsigned int n) {
+    destroy();
+    locks.resize(n);
+    for (omp_lock_t& lock : locks)
+        omp_init_lock(&lock);
+}
+
+inline void TileLocks::set(unsigned int t) {
+    omp_set_lock(&locks[t]);
+}
+
+inline void TileLocks::unset(unsigned int t) {
+    omp_unset_lock(&locks[t]);
+}
+
+inline void TileLocks::destroy() {
+    for (omp_lock_t& lock : locks)
+        omp_destroy_lock(&lock);
+    locks.clear();
+}
+
 inline unsigned int Grid::getResZ() const {
     return resZ;
 }
@@ -94,49 +245,121 @@ inline void Grid::setTarget(const cg3::Vec3d& value) {
     target = value;
 }
 
+inline double Grid::getKernelDistance() const {
+    return kernelDistance;
+}
+
 inline double Grid::getUnit() const {
     return unit;
 }
 
-inline cg3::Point3d Grid::getNearestGridPoint(const cg3::Point3d& p) const{
-	return cg3::Point3d(bb.minX() + getIndexOfCoordinateX(p.x())*unit, bb.minY() + getIndexOfCoordinateY(p.y())*unit, bb.minZ() + getIndexOfCoordinateZ(p.z())*unit);
+inline bool Grid::isLazy() const {
+    return lazy;
 }
 
-inline void Grid::getCoefficients(const gridreal* &coeffs, unsigned int i, unsigned int j, unsigned int k) const {
-    int id = mapCoeffs(i,j,k);
-    coeffs = this->coeffs[id].data();
+inline bool Grid::isMapped() const {
+    return mappedCoeffs != nullptr;
+}
+
+inline cg3::Point3d Grid::getNearestGridPoint(const cg3::Point3d& p) const{
+	return cg3::Point3d(bb.minX() + getIndexOfCoordinateX(p.x())*unit, bb.minY() + getIndexOfCoordinateY(p.y())*unit, bb.minZ() + getIndexOfCoordinateZ(p.z())*unit);
 }
 
 inline void Grid::setWeightOnCube(unsigned int i, unsigned int j, unsigned int k, double w) {
     assert(i+1 < resX);
     assert(j+1 < resY);
     assert(k+1 < resZ);
-    weights(i  ,j  ,k  ) = w;
-    weights(i  ,j  ,k+1) = w;
-    weights(i  ,j+1,k  ) = w;
-    weights(i  ,j+1,k+1) = w;
-    weights(i+1,j  ,k  ) = w;
-    weights(i+1,j  ,k+1) = w;
-    weights(i+1,j+1,k  ) = w;
-    weights(i+1,j+1,k+1) = w;
+    weights.set(i  ,j  ,k  , w);
+    weights.set(i  ,j  ,k+1, w);
+    weights.set(i  ,j+1,k  , w);
+    weights.set(i  ,j+1,k+1, w);
+    weights.set(i+1,j  ,k  , w);
+    weights.set(i+1,j  ,k+1, w);
+    weights.set(i+1,j+1,k  , w);
+    weights.set(i+1,j+1,k+1, w);
 }
 
 inline void Grid::getCoefficients(const gridreal*& coeffs, const cg3::Point3d& p) const {
-    if(bb.isStrictlyIntern(p)){
-        int id = mapCoeffs(getIndexOfCoordinateX(p.x()), getIndexOfCoordinateY(p.y()), getIndexOfCoordinateZ(p.z()));
-        coeffs = this->coeffs[id].data();
-    }
-    else coeffs = this->coeffs[0].data();
+    if(bb.isStrictlyIntern(p))
+        coeffs = getCellCoefficients(getIndexOfCoordinateX(p.x()), getIndexOfCoordinateY(p.y()), getIndexOfCoordinateZ(p.z()));
+    else coeffs = getCellCoefficients(0,0,0);
 }
 
 inline double Grid::getFullBoxValue(const cg3::Point3d& p) const {
     if(bb.isStrictlyIntern(p))
-        return fullBoxValues(getIndexOfCoordinateX(p.x()), getIndexOfCoordinateY(p.y()), getIndexOfCoordinateZ(p.z()));
-    else return fullBoxValues(0,0,0);
+        return getCellFullBoxValue(getIndexOfCoordinateX(p.x()), getIndexOfCoordinateY(p.y()), getIndexOfCoordinateZ(p.z()));
+    else return getCellFullBoxValue(0,0,0);
+}
+
+/**
+ * @brief Grid::getCellRange
+ *
+ * Returns the indices of the first and the last cell (inclusive) intersected
+ * by the open box (min, max). Indices may be outside the grid.
+ */
+inline void Grid::getCellRange(cg3::Point3i& first, cg3::Point3i& last, const cg3::Point3d& min, const cg3::Point3d& max) const {
+    first = cg3::Point3i(std::floor((min.x() - bb.minX()) / unit), std::floor((min.y() - bb.minY()) / unit), std::floor((min.z() - bb.minZ()) / unit));
+    last = cg3::Point3i(std::ceil((max.x() - bb.minX()) / unit) - 1, std::ceil((max.y() - bb.minY()) / unit) - 1, std::ceil((max.z() - bb.minZ()) / unit) - 1);
+}
+
+/**
+ * @brief Grid::getCellMin
+ *
+ * Returns the minimum corner of the cell (i,j,k), computed without accumulating
+ * rounding errors along the grid.
+ */
+inline cg3::Point3d Grid::getCellMin(int i, int j, int k) const {
+    return cg3::Point3d(bb.minX() + i*unit, bb.minY() + j*unit, bb.minZ() + k*unit);
+}
+
+/**
+ * @brief Grid::getCellCoefficients
+ *
+ * Returns the coefficients of the cell (i,j,k). Cells outside the grid are clamped
+ * on the last layer of cells of the grid, which has the constant coefficients of the border.
+ */
+inline const gridreal* Grid::getCellCoefficients(int i, int j, int k) const {
+    i = clampCell(i, resX);
+    j = clampCell(j, resY);
+    k = clampCell(k, resZ);
+    if (lazy){
+        unsigned int t = mapCoeffs.getTileIndex(i, j, k);
+        touchTile(t);
+        return tileCoeffs[t][mapCoeffs(i,j,k)].data();
+    }
+    int id = mapCoeffs(i,j,k);
+    return mappedCoeffs != nullptr ? mappedCoeffs + 64*id : coeffs[id].data();
+}
+
+/**
+ * @brief Grid::getCellFullBoxValue
+ *
+ * Same as getCellCoefficients, on the full box values of the cells.
+ */
+inline double Grid::getCellFullBoxValue(int i, int j, int k) const {
+    i = clampCell(i, resX);
+    j = clampCell(j, resY);
+    k = clampCell(k, resZ);
+    if (lazy)
+        touchTile(fullBoxValues.getTileIndex(i, j, k));
+    return fullBoxValues(i,j,k);
+}
+
+inline unsigned int Grid::getNumberCoarseLevels() const {
+    return (unsigned int)coarseLevels.size();
+}
+
+/**
+ * @brief Grid::getCoarseLevel
+ * @param level: from 1 (unit 2x) to getNumberCoarseLevels()
+ */
+inline const Grid& Grid::getCoarseLevel(unsigned int level) const {
+    assert(level > 0 && level <= coarseLevels.size());
+    return coarseLevels[level-1];
 }
 
 inline void Grid::resetSignedDistances() {
-    signedDistances.resize(0,0,0);
+    signedDistances.clear();
 }
 
 inline cg3::Point3d Grid::getPoint(unsigned int i, unsigned int j, unsigned int k) const {
@@ -150,6 +373,23 @@ inline unsigned int Grid::getIndex(unsigned int i, unsigned int j, unsigned int
     return k+resZ*(j + resY*i);
 }
 
+inline int Grid::clampCell(int i, unsigned int res) const {
+    return i < 0 ? 0 : (i > (int)res-2 ? (int)res-2 : i);
+}
+
+/**
+ * @brief Grid::touchTile
+ *
+ * Lazy mode: computes the tile t of the cells, if it has not been computed yet.
+ */
+inline void Grid::touchTile(unsigned int t) const {
+    unsigned char state;
+    #pragma omp atomic read seq_cst
+    state = tileStates[t];
+    if (!(state & GRID_TILE_READY))
+        calculateLazyTile(t);
+}
+
 inline double Grid::getSignedDistance(unsigned int i, unsigned int j, unsigned int k) const {
     return signedDistances(i,j,k);
 }
@@ -0,0 +1,64 @@
+#include "mappedfile.h"
+
+#include <fstream>
+
+#ifdef __unix__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() : begin(nullptr), length(0) {
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+/**
+ * @brief MappedFile::open
+ * @return false if the file cannot be opened or is empty
+ */
+bool MappedFile::open(const std::string& filename) {
+    close();
+    #ifdef __unix__
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0){
+        ::close(fd);
+        return false;
+    }
+    void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+        return false;
+    begin = (const char*)p;
+    length = st.st_size;
+    #else
+    std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+    if (!file.is_open() || file.tellg() <= 0)
+        return false;
+    length = file.tellg();
+    buffer.resize((length + sizeof(double) - 1) / sizeof(double));
+    file.seekg(0);
+    if (!file.read((char*)buffer.data(), length)){
+        close();
+        return false;
+    }
+    begin = (const char*)buffer.data();
+    #endif
+    return true;
+}
+
+void MappedFile::close() {
+    #ifdef __unix__
+    if (begin != nullptr)
+        munmap((void*)begin, length);
+    #endif
+    std::vector<double>().swap(buffer);
+    begin = nullptr;
+    length = 0;
+}
@@ -0,0 +1,42 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief The MappedFile class
+ *
+ * File mapped read-only in memory: pages are loaded on demand and shared with
+ * the other processes mapping the same file. The data is aligned to the page size.
+ * Where mmap is not available, the file is read in memory.
+ */
+class MappedFile {
+    public:
+        MappedFile();
+        ~MappedFile();
+
+        bool open(const std::string& filename);
+        void close();
+
+        const char* data() const;
+        size_t size() const;
+
+    private:
+        MappedFile(const MappedFile&);
+        MappedFile& operator=(const MappedFile&);
+
+        const char* begin;
+        size_t length;
+        std::vector<double> buffer; //used only if the file is not mapped (double for the alignment)
+};
+
+inline const char* MappedFile::data() const {
+    return begin;
+}
+
+inline size_t MappedFile::size() const {
+    return length;
+}
+
+#endif // MAPPEDFILE_H
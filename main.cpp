@@ -8,6 +8,7 @@
 #include "GUI/managers/enginemanager.h"
 #include "common.h"
 #include <QApplication>
+#include <QDir>
 //#include "common/comparators.h"
 #include "engine/engine.h"
 //#include "trimesh/gui/trimeshmanager.h"
@@ -73,6 +74,15 @@ int main(int argc, char *argv[]) {
 	 * [-x], [-y], [-z] = <value> (double [0, 1...], default=2): maximum block sizes constraints wrt the diagonal of the bounding box. For no limit, use a value
 	 *   greater than 1.
 	 *
+	 * [-n, -narrowband]=<value> (t/f, default=f): true if the distances from the surface used by the kernel are computed exactly only near
+	 *   the surface, and approximated in the interior (fast sweeping). With -k=0 distances are never computed.
+	 *
+	 * [-l, -levels]=<value> (t/f, default=f): true if the boxes are grown coarse to fine, first on grids with 4x and 2x the unit of the grid
+	 *   (the coarser grids are built only in this case).
+	 *
+	 * [-cache]=<directory> (default=none): directory where the grids are stored between the runs. A grid is reused by the runs with the same
+	 *   input mesh (after the preprocessing), precision, kernel, conservative and narrow band options, and generated again otherwise.
+	 *
 	 * Example of calls:
 	 *   ./HeightFieldDecomposition cube_spike.obj
 	 *   ./HeightFieldDecomposition cube_spike.obj -s=cssmooth.obj -k=0.1 -p=1.1 -z=0.2
@@ -89,6 +99,9 @@ int main(int argc, char *argv[]) {
 	bool smoothed = false, optimal_orientation = true, conservative = false;
 	double precision = 1, kernel = 0, snapStep = 2;
 	double lx = 2, ly = 2, lz = 2; //size constraints
+	Engine::DistanceFieldMode distanceFieldMode = Engine::EXACT_DISTANCE_FIELD;
+	std::string cacheDirectory;
+	bool coarseLevels = false;
 
 	/**** Argument Management */
 	//input mesh
@@ -186,6 +199,34 @@ int main(int argc, char *argv[]) {
 		lz = std::stod(argManager.value("z"));
 	}
 
+	//narrow band distance field
+	if (argManager.exists("n") || argManager.exists("narrowband")){
+		bool narrowBand;
+		if (argManager.exists("n"))
+			narrowBand = argManager.value("n") == "t";
+		else
+			narrowBand = argManager.value("narrowband") == "t";
+		if (narrowBand)
+			distanceFieldMode = Engine::NARROW_BAND_DISTANCE_FIELD;
+	}
+
+	//coarse to fine box growth
+	if (argManager.exists("l") || argManager.exists("levels")){
+		if (argManager.exists("l"))
+			coarseLevels = argManager.value("l") == "t";
+		else
+			coarseLevels = argManager.value("levels") == "t";
+	}
+
+	//grid cache
+	if (argManager.exists("cache")){
+		cacheDirectory = argManager.value("cache");
+		if (cacheDirectory != "" && !QDir().mkpath(QString::fromStdString(cacheDirectory))){
+			std::cerr << "WARNING: cannot create the cache directory " << cacheDirectory << ", the grids are not cached\n";
+			cacheDirectory = "";
+		}
+	}
+
 
 
 	//actual algorithm ...
@@ -227,6 +268,7 @@ int main(int argc, char *argv[]) {
 	logFile << "Parameters: \n\tPrecision: " << precision << "\n\tKernel: " << kernel << "\n\tSnapping: " << snapStep << "\n";
 
 	logFile << "\tSize X limit: " << lx << "\n\tSize Y limit: " << ly << "\n\tSize Z limit: " << lz << "\n";
+	logFile << "\tDistance field: " << (distanceFieldMode == Engine::NARROW_BAND_DISTANCE_FIELD ? "narrow band" : "exact") << "\n";
 	logFile.flush();
 
 	//scaling meshes
@@ -250,9 +292,9 @@ int main(int argc, char *argv[]) {
 	//solutions
 	BoxList solutions;
 
-	//grow boxes                              //boxes    mesh  kernel       limit  limit     toler           only  areatol  angletol  fileus  decim
+	//grow boxes                              //boxes    mesh  kernel       limit  limit     toler           only  areatol  angletol  fileus  decim  optimizer            distances
 	//double timerBoxGrowing = Engine::optimize(solutions, d, kernelDistance, false, Pointd(), !conservative,  true, 0,       0,        false,  true);
-	double timerBoxGrowing = Engine::optimize(solutions, d, kernel, true, getCustomLimits(d, lx, ly, lz), !conservative,  true, 0,       0,        false,  true);
+	double timerBoxGrowing = Engine::optimize(solutions, d, kernel, true, getCustomLimits(d, lx, ly, lz), !conservative,  true, 0,       0,        false,  true,  Engine::SCALAR_BFGS, distanceFieldMode, cacheDirectory, coarseLevels);
 
 	logFile << timerBoxGrowing << ": Box Growing\n";
 	logFile.flush();
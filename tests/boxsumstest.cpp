@@ -0,0 +1,48 @@
+#include "tests.h"
+#include "testgrid.h"
+
+#include <cmath>
+#include <iostream>
+
+/**
+ * @brief bruteForceSum
+ * @return the sum of the full box values of the cells in [i1,i2) x [j1,j2) x [k1,k2), one by one
+ */
+static double bruteForceSum(const Grid& g, int i1, int j1, int k1, int i2, int j2, int k2) {
+    double sum = 0;
+    for (int i = i1; i < i2; i++)
+        for (int j = j1; j < j2; j++)
+            for (int k = k1; k < k2; k++)
+                sum += g.getCellFullBoxValue(i,j,k);
+    return sum;
+}
+
+/**
+ * @brief testBoxSums
+ *
+ * Grid::getFullBoxValuesSum must be the sum of the cells of the box, on eager and lazy grids,
+ * for random boxes (empty, inside a tile, across the tiles and partly outside the grid).
+ */
+bool testBoxSums() {
+    bool ok = true;
+    TestGrid eager(45, 7);
+    TestGrid lazy(45, 7, true);
+    const Grid* grids[2] = {&eager, &lazy};
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> index(-4, 47);
+    for (const Grid* g : grids){
+        for (unsigned int b = 0; b < 500; b++){
+            int i1 = index(rng), j1 = index(rng), k1 = index(rng);
+            int i2 = std::max(i1, index(rng)), j2 = std::max(j1, index(rng)), k2 = std::max(k1, index(rng));
+            double sum = g->getFullBoxValuesSum(i1, j1, k1, i2, j2, k2);
+            double expected = bruteForceSum(*g, i1, j1, k1, i2, j2, k2);
+            if (std::abs(sum - expected) > 1e-6 * std::max(1.0, std::abs(expected))){
+                std::cerr << (g->isLazy() ? "Lazy" : "Eager") << " grid, box " << i1 << " " << j1 << " " << k1 << " - "
+                          << i2 << " " << j2 << " " << k2 << ": " << sum << " instead of " << expected << "\n";
+                ok = false;
+                break;
+            }
+        }
+    }
+    return ok;
+}
@@ -0,0 +1,25 @@
+#include "tests.h"
+
+#include <iostream>
+
+int main() {
+    struct Test {
+        const char* name;
+        bool (*run)();
+    };
+    const Test tests[] = {
+        {"mapped grid", testMappedGrid},
+        {"box sums", testBoxSums},
+        {"set cover", testSetCover}
+    };
+
+    int nFailed = 0;
+    for (const Test& test : tests){
+        bool ok = test.run();
+        std::cerr << (ok ? "PASSED: " : "FAILED: ") << test.name << "\n";
+        if (!ok)
+            nFailed++;
+    }
+    std::cerr << nFailed << " tests failed\n";
+    return nFailed;
+}
@@ -0,0 +1,91 @@
+#include "tests.h"
+#include "testgrid.h"
+
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+#define MAPPED_GRID_TEST_FILE "tests_grid.map"
+
+/**
+ * @brief isSameGrid
+ *
+ * Compares the cells of a mapped grid with the cells of the grid it has been written from.
+ */
+static bool isSameGrid(const Grid& mapped, const Grid& g) {
+    if (mapped.getResX() != g.getResX() || mapped.getResY() != g.getResY() || mapped.getResZ() != g.getResZ() ||
+            mapped.getUnit() != g.getUnit() || mapped.getBoundingBox().min() != g.getBoundingBox().min() ||
+            mapped.getBoundingBox().max() != g.getBoundingBox().max() || mapped.getTarget() != g.getTarget() ||
+            mapped.getNumberCoefficients() != g.getNumberCoefficients()){
+        std::cerr << "Different resolution, bounding box, target or coefficients\n";
+        return false;
+    }
+    for (unsigned int i = 0; i < g.getResX()-1; i++){
+        for (unsigned int j = 0; j < g.getResY()-1; j++){
+            for (unsigned int k = 0; k < g.getResZ()-1; k++){
+                const gridreal* mc = mapped.getCellCoefficients(i,j,k);
+                const gridreal* c = g.getCellCoefficients(i,j,k);
+                for (unsigned int c64 = 0; c64 < 64; c64++){
+                    if (mc[c64] != c[c64]){
+                        std::cerr << "Different coefficients in the cell " << i << " " << j << " " << k << "\n";
+                        return false;
+                    }
+                }
+                if (mapped.getCellFullBoxValue(i,j,k) != g.getCellFullBoxValue(i,j,k)){
+                    std::cerr << "Different integral of the cell " << i << " " << j << " " << k << "\n";
+                    return false;
+                }
+            }
+        }
+    }
+    //boxes across the tiles, partly outside the grid
+    for (int a = -3; a < (int)g.getResX(); a += 5){
+        int b = a + 11;
+        double ms = mapped.getFullBoxValuesSum(a, a/2, 1, b, b, b+a);
+        double s = g.getFullBoxValuesSum(a, a/2, 1, b, b, b+a);
+        if (std::abs(ms - s) > 1e-9 * std::max(1.0, std::abs(s))){
+            std::cerr << "Different sum of the cells from " << a << ": " << ms << " " << s << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief testMappedGrid
+ *
+ * A lazy grid written in a mapped file and mapped again must have the cells
+ * of the same grid computed (Grid::getComputedGrid); a file with a cell referring
+ * to coefficients not in the file must be rejected by Grid::mapFile.
+ */
+bool testMappedGrid() {
+    bool ok = true;
+    TestGrid lazy(37, 19, true);
+    lazy.setTarget(cg3::Vec3d(0,0,1));
+    Grid computed = lazy.getComputedGrid();
+    Grid mapped;
+    if (!lazy.writeMappedFile(MAPPED_GRID_TEST_FILE) || !mapped.mapFile(MAPPED_GRID_TEST_FILE)){
+        std::cerr << "Cannot write or map " << MAPPED_GRID_TEST_FILE << "\n";
+        ok = false;
+    }
+    else if (!mapped.isMapped() || !isSameGrid(mapped, computed))
+        ok = false;
+
+    TestGrid g(21, 19);
+    int ids[2] = {-1, (int)g.getNumberCoefficients()};
+    for (int id : ids){
+        TestGrid wrong(g);
+        wrong.setCoefficientsId(7, 9, 11, id);
+        Grid mappedWrong;
+        if (!wrong.writeMappedFile(MAPPED_GRID_TEST_FILE)){
+            std::cerr << "Cannot write " << MAPPED_GRID_TEST_FILE << "\n";
+            ok = false;
+        }
+        else if (mappedWrong.mapFile(MAPPED_GRID_TEST_FILE)){
+            std::cerr << "Mapped a grid with the coefficients id " << id << " out of range\n";
+            ok = false;
+        }
+    }
+    std::remove(MAPPED_GRID_TEST_FILE);
+    return ok;
+}
@@ -0,0 +1,121 @@
+#include "tests.h"
+#include "engine/setcover.h"
+
+#include <iostream>
+#include <random>
+
+#define SET_COVER_TEST_TIME_LIMIT 5 //seconds, for every instance
+
+/**
+ * @brief randomSets
+ *
+ * nSets random sets of elements in [0, nElements): the last elements are in no set.
+ */
+static std::vector<std::vector<unsigned int> > randomSets(unsigned int nSets, unsigned int nElements, unsigned int maxSize, unsigned int seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<unsigned int> element(0, nElements - 1 - nElements/10), size(1, maxSize);
+    std::vector<std::vector<unsigned int> > sets(nSets);
+    for (std::vector<unsigned int>& set : sets){
+        std::vector<bool> in(nElements, false);
+        for (unsigned int n = size(rng); n > 0; n--){
+            unsigned int e = element(rng);
+            if (!in[e]){
+                in[e] = true;
+                set.push_back(e);
+            }
+        }
+    }
+    return sets;
+}
+
+/**
+ * @brief minimumCover
+ * @return the number of sets of the minimum cover, enumerating all the subsets of the sets
+ */
+static unsigned int minimumCover(const std::vector<std::vector<unsigned int> >& sets, unsigned int nElements) {
+    std::vector<bool> coverable(nElements, false);
+    for (const std::vector<unsigned int>& set : sets)
+        for (unsigned int e : set)
+            coverable[e] = true;
+    unsigned int best = sets.size();
+    for (unsigned long long int subset = 0; subset < (1ull << sets.size()); subset++){
+        unsigned int n = __builtin_popcountll(subset);
+        if (n >= best)
+            continue;
+        std::vector<bool> covered(nElements, false);
+        for (unsigned int s = 0; s < sets.size(); s++)
+            if (subset & (1ull << s))
+                for (unsigned int e : sets[s])
+                    covered[e] = true;
+        if (covered == coverable)
+            best = n;
+    }
+    return best;
+}
+
+/**
+ * @brief isValidCover
+ *
+ * Checks that the n selected sets cover every element which is in at least a set,
+ * and that the lower bound is not greater than n.
+ */
+static bool isValidCover(const std::vector<std::vector<unsigned int> >& sets, unsigned int nElements, const std::vector<bool>& selected, unsigned int n, unsigned int lowerBound) {
+    if (selected.size() != sets.size()){
+        std::cerr << selected.size() << " selection flags for " << sets.size() << " sets\n";
+        return false;
+    }
+    std::vector<bool> coverable(nElements, false), covered(nElements, false);
+    unsigned int nSelected = 0;
+    for (unsigned int s = 0; s < sets.size(); s++){
+        if (selected[s])
+            nSelected++;
+        for (unsigned int e : sets[s]){
+            coverable[e] = true;
+            if (selected[s])
+                covered[e] = true;
+        }
+    }
+    if (nSelected != n || lowerBound > n){
+        std::cerr << nSelected << " sets selected, " << n << " returned, lower bound " << lowerBound << "\n";
+        return false;
+    }
+    for (unsigned int e = 0; e < nElements; e++){
+        if (coverable[e] && !covered[e]){
+            std::cerr << "Element " << e << " not covered\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief testSetCover
+ *
+ * solveSetCover must return a valid cover, on small instances (compared with the
+ * minimum cover) and on instances of the size of the covers of optimize.
+ */
+bool testSetCover() {
+    bool ok = true;
+    for (unsigned int seed = 0; seed < 20 && ok; seed++){
+        std::vector<std::vector<unsigned int> > sets = randomSets(14, 30, 8, seed);
+        std::vector<bool> selected;
+        unsigned int lowerBound;
+        unsigned int n = solveSetCover(sets, 30, selected, lowerBound, SET_COVER_TEST_TIME_LIMIT);
+        unsigned int minimum = minimumCover(sets, 30);
+        if (!isValidCover(sets, 30, selected, n, lowerBound))
+            ok = false;
+        else if (n < minimum || lowerBound > minimum){
+            std::cerr << "Instance " << seed << ": " << n << " sets, lower bound " << lowerBound << ", minimum " << minimum << "\n";
+            ok = false;
+        }
+    }
+    for (unsigned int seed = 0; seed < 3 && ok; seed++){
+        std::vector<std::vector<unsigned int> > sets = randomSets(3000, 20000, 200, seed);
+        std::vector<bool> selected;
+        unsigned int lowerBound;
+        unsigned int n = solveSetCover(sets, 20000, selected, lowerBound, SET_COVER_TEST_TIME_LIMIT);
+        if (!isValidCover(sets, 20000, selected, n, lowerBound))
+            ok = false;
+    }
+    return ok;
+}
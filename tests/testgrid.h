@@ -0,0 +1,61 @@
+#ifndef TESTGRID_H
+#define TESTGRID_H
+
+#include "lib/grid/grid.h"
+#include "engine/energy.h"
+#include <random>
+
+/**
+ * @brief The TestGrid class
+ *
+ * Grid of n^3 points with unit 2, whose interior weights are random (MIN_PAY, STD_PAY or MAX_PAY),
+ * with the coefficients and the integrals of the cells computed (when touched, if lazy).
+ * Exposes the protected members needed by the tests.
+ */
+class TestGrid : public Grid {
+    public:
+        TestGrid(unsigned int n, unsigned int seed, bool lazy = false);
+
+        using Grid::getComputedGrid;
+        void setCoefficientsId(unsigned int i, unsigned int j, unsigned int k, int id);
+};
+
+inline TestGrid::TestGrid(unsigned int n, unsigned int seed, bool lazy) {
+    cg3::Array3D<cg3::Point3d> gridCoordinates(n, n, n);
+    for (unsigned int i = 0; i < n; i++)
+        for (unsigned int j = 0; j < n; j++)
+            for (unsigned int k = 0; k < n; k++)
+                gridCoordinates(i,j,k) = cg3::Point3d(2*i, 2*j, 2*k);
+    cg3::Array3D<gridreal> signedDistances(n, n, n, 1);
+    Grid::operator=(Grid(cg3::Point3i(n, n, n), gridCoordinates, signedDistances, cg3::Point3d(0,0,0), cg3::Point3d(2*(n-1), 2*(n-1), 2*(n-1))));
+
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> pay(0, 9);
+    for (unsigned int i = 2; i < n-2; i++){
+        for (unsigned int j = 2; j < n-2; j++){
+            for (unsigned int k = 2; k < n-2; k++){
+                int r = pay(rng);
+                weights.set(i, j, k, r < 2 ? MIN_PAY : r < 3 ? MAX_PAY : STD_PAY);
+            }
+        }
+    }
+    weights.compact();
+    setLazy(lazy);
+    if (lazy)
+        resetLazyTiles();
+    else
+        coefficientsStatistics = TricubicInterpolator::getCoefficients(coeffs, mapCoeffs, weights);
+    Energy e(*this);
+    e.calculateFullBoxValues(*this);
+}
+
+/**
+ * @brief TestGrid::setCoefficientsId
+ *
+ * Makes the cell (i,j,k) refer to the coefficients id (which may not exist).
+ */
+inline void TestGrid::setCoefficientsId(unsigned int i, unsigned int j, unsigned int k, int id) {
+    mapCoeffs.set(i, j, k, id);
+}
+
+#endif // TESTGRID_H
@@ -0,0 +1,13 @@
+#ifndef TESTS_H
+#define TESTS_H
+
+/*
+ * Every test prints the reason of its failures on std::cerr
+ * and returns false if it fails.
+ */
+
+bool testMappedGrid();
+bool testBoxSums();
+bool testSetCover();
+
+#endif // TESTS_H
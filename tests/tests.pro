@@ -0,0 +1,39 @@
+# Tests of the grid, energy and set cover code which do not need a mesh:
+# qmake && make && ./tests (the exit code is the number of failed tests)
+
+TEMPLATE = app
+TARGET = tests
+CONFIG += console
+CONFIG -= app_bundle
+
+CONFIG += CG3_CORE CG3_DATA_STRUCTURES CG3_MESHES CG3_ALGORITHMS CG3_CGAL CG3_CINOLIB CG3_LIBIGL CG3_VIEWER
+include(../cg3lib/cg3.pri)
+
+DEFINES += SERVER_MODE
+INCLUDEPATH += ..
+
+exists($$(GUROBI_HOME)){
+    INCLUDEPATH += $$(GUROBI_HOME)/include
+    LIBS += -L$$(GUROBI_HOME)/lib -lgurobi_g++5.2 -lgurobi90
+    DEFINES += GUROBI_DEFINED
+}
+
+HEADERS += \
+    tests.h \
+    testgrid.h
+
+SOURCES += \
+    main.cpp \
+    mappedgridtest.cpp \
+    boxsumstest.cpp \
+    setcovertest.cpp \
+    ../common.cpp \
+    ../engine/tricubic.cpp \
+    ../engine/tricubickernel.cpp \
+    ../engine/linesearch.cpp \
+    ../engine/boxminimizer.cpp \
+    ../engine/energy.cpp \
+    ../engine/box.cpp \
+    ../engine/setcover.cpp \
+    ../lib/grid/grid.cpp \
+    ../lib/grid/mappedfile.cpp